@@ -0,0 +1,52 @@
+#include <string.h>
+#include <stdint.h>
+#include "aes.h"
+#include "rijndael.h"
+#ifdef NTRU_DETECT_SIMD
+#include "aes_ni.h"
+#elif defined __AES__
+#include "aes_ni.h"
+#endif
+
+void ntru_aes256_set_key(NtruAes256Key *key, const uint8_t *k) {
+    key->Nr = rijndaelKeySetupEnc(key->ek, k, 256);
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("aes"))
+        ntru_aes256_set_key_aesni(k, key->rk);
+#elif defined __AES__
+    ntru_aes256_set_key_aesni(k, key->rk);
+#endif
+}
+
+void ntru_aes256_ctr_standard(NtruAes256Key *key, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len) {
+    uint8_t block[16];
+    uint8_t stream[16];
+    memset(block, 0, 8);
+    while (len > 0) {
+        uint8_t i;
+        for (i=0; i<8; i++)
+            block[8+i] = ctr >> (56-8*i);
+        rijndaelEncrypt(key->ek, key->Nr, block, stream);
+        uint8_t n = len<16 ? len : 16;
+        for (i=0; i<n; i++)
+            out[i] = in[i] ^ stream[i];
+        in += n;
+        out += n;
+        len -= n;
+        ctr++;
+    }
+    memset(stream, 0, sizeof stream);
+}
+
+void ntru_aes256_ctr(NtruAes256Key *key, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("aes"))
+        ntru_aes256_ctr_aesni(key->rk, ctr, in, out, len);
+    else
+        ntru_aes256_ctr_standard(key, ctr, in, out, len);
+#elif defined __AES__
+    ntru_aes256_ctr_aesni(key->rk, ctr, in, out, len);
+#else
+    ntru_aes256_ctr_standard(key, ctr, in, out, len);
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef NTRU_AES_H
+#define NTRU_AES_H
+
+#include <stdint.h>
+
+/** AES-256 key schedules for the table-based and the AES-NI implementation */
+typedef struct NtruAes256Key {
+    uint32_t ek[60];   /* rijndael.c encryption schedule */
+    int Nr;
+    uint8_t rk[240];   /* AES-NI round keys, only set if AES-NI is used */
+} NtruAes256Key;
+
+/**
+ * @brief AES-256 key setup
+ *
+ * @param key output parameter; the key schedule
+ * @param k a 32-byte key
+ */
+void ntru_aes256_set_key(NtruAes256Key *key, const uint8_t *k);
+
+/**
+ * @brief AES-256 in counter mode
+ *
+ * XORs len bytes of input with the key stream starting at block number ctr.
+ * Counter blocks are 8 zero bytes followed by the 64-bit block number in
+ * big-endian order. in and out may be the same.
+ * Uses AES-NI if available.
+ *
+ * @param key a key schedule set up with ntru_aes256_set_key()
+ * @param ctr the number of the first counter block
+ * @param in the input
+ * @param out output parameter; len bytes
+ * @param len the number of bytes to process
+ */
+void ntru_aes256_ctr(NtruAes256Key *key, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len);
+
+/**
+ * @brief AES-256 in counter mode, table-based version
+ *
+ * Same as ntru_aes256_ctr() but always uses rijndael.c.
+ *
+ * @param key a key schedule set up with ntru_aes256_set_key()
+ * @param ctr the number of the first counter block
+ * @param in the input
+ * @param out output parameter; len bytes
+ * @param len the number of bytes to process
+ */
+void ntru_aes256_ctr_standard(NtruAes256Key *key, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len);
+
+#endif   /* NTRU_AES_H */
@@ -0,0 +1,111 @@
+#ifdef __AES__
+#include <string.h>
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#include "aes_ni.h"
+
+/* #blocks encrypted in parallel to hide the latency of aesenc */
+#define NTRU_AES_NI_LANES 8
+
+/* derives the next even-numbered round key; t is the output of aeskeygenassist */
+static inline __m128i ntru_aes256_assist1(__m128i a, __m128i t) {
+    t = _mm_shuffle_epi32(t, 0xff);
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    return _mm_xor_si128(a, t);
+}
+
+/* derives the next odd-numbered round key from the previous two */
+static inline __m128i ntru_aes256_assist2(__m128i a, __m128i b) {
+    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(a, 0), 0xaa);
+    b = _mm_xor_si128(b, _mm_slli_si128(b, 4));
+    b = _mm_xor_si128(b, _mm_slli_si128(b, 4));
+    b = _mm_xor_si128(b, _mm_slli_si128(b, 4));
+    return _mm_xor_si128(b, t);
+}
+
+void ntru_aes256_set_key_aesni(const uint8_t *k, uint8_t *rk) {
+    __m128i *rk128 = (__m128i*)rk;
+    __m128i a = _mm_loadu_si128((__m128i*)k);
+    __m128i b = _mm_loadu_si128((__m128i*)(k+16));
+    _mm_storeu_si128(rk128, a);
+    _mm_storeu_si128(rk128+1, b);
+
+    /* aeskeygenassist needs the round constant as an immediate */
+#define NTRU_AES256_EXPAND(i, rcon)                                  \
+    a = ntru_aes256_assist1(a, _mm_aeskeygenassist_si128(b, rcon));  \
+    _mm_storeu_si128(rk128+i, a);                                    \
+    if (i < 14) {                                                    \
+        b = ntru_aes256_assist2(a, b);                               \
+        _mm_storeu_si128(rk128+i+1, b);                              \
+    }
+    NTRU_AES256_EXPAND(2, 0x01);
+    NTRU_AES256_EXPAND(4, 0x02);
+    NTRU_AES256_EXPAND(6, 0x04);
+    NTRU_AES256_EXPAND(8, 0x08);
+    NTRU_AES256_EXPAND(10, 0x10);
+    NTRU_AES256_EXPAND(12, 0x20);
+    NTRU_AES256_EXPAND(14, 0x40);
+#undef NTRU_AES256_EXPAND
+}
+
+/* the counter block for block number ctr: 8 zero bytes, then ctr in big-endian order */
+static inline __m128i ntru_aes_ctr_block(uint64_t ctr) {
+    return _mm_set_epi64x(__builtin_bswap64(ctr), 0);
+}
+
+static inline __m128i ntru_aes256_encrypt_block(__m128i *rk, __m128i b) {
+    b = _mm_xor_si128(b, rk[0]);
+    uint8_t r;
+    for (r=1; r<14; r++)
+        b = _mm_aesenc_si128(b, rk[r]);
+    return _mm_aesenclast_si128(b, rk[14]);
+}
+
+void ntru_aes256_ctr_aesni(const uint8_t *rk_bytes, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len) {
+    __m128i rk[15];
+    uint8_t r;
+    for (r=0; r<15; r++)
+        rk[r] = _mm_loadu_si128((__m128i*)(rk_bytes+16*r));
+
+    while (len >= 16*NTRU_AES_NI_LANES) {
+        __m128i b[NTRU_AES_NI_LANES];
+        uint8_t j;
+        for (j=0; j<NTRU_AES_NI_LANES; j++)
+            b[j] = _mm_xor_si128(ntru_aes_ctr_block(ctr+j), rk[0]);
+        for (r=1; r<14; r++)
+            for (j=0; j<NTRU_AES_NI_LANES; j++)
+                b[j] = _mm_aesenc_si128(b[j], rk[r]);
+        for (j=0; j<NTRU_AES_NI_LANES; j++) {
+            b[j] = _mm_aesenclast_si128(b[j], rk[14]);
+            __m128i x = _mm_loadu_si128((__m128i*)(in+16*j));
+            _mm_storeu_si128((__m128i*)(out+16*j), _mm_xor_si128(x, b[j]));
+        }
+        ctr += NTRU_AES_NI_LANES;
+        in += 16 * NTRU_AES_NI_LANES;
+        out += 16 * NTRU_AES_NI_LANES;
+        len -= 16 * NTRU_AES_NI_LANES;
+    }
+
+    while (len >= 16) {
+        __m128i b = ntru_aes256_encrypt_block(rk, ntru_aes_ctr_block(ctr));
+        __m128i x = _mm_loadu_si128((__m128i*)in);
+        _mm_storeu_si128((__m128i*)out, _mm_xor_si128(x, b));
+        ctr++;
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+
+    if (len > 0) {
+        uint8_t stream[16];
+        _mm_storeu_si128((__m128i*)stream, ntru_aes256_encrypt_block(rk, ntru_aes_ctr_block(ctr)));
+        uint8_t i;
+        for (i=0; i<len; i++)
+            out[i] = in[i] ^ stream[i];
+        memset(stream, 0, sizeof stream);
+    }
+}
+
+#endif   /* __AES__ */
@@ -0,0 +1,35 @@
+#ifndef NTRU_AES_NI_H
+#define NTRU_AES_NI_H
+
+#include <stdint.h>
+
+/**************************************
+ * AES-NI versions of aes.c functions *
+ **************************************/
+
+/**
+ * @brief AES-256 key setup, AES-NI version
+ *
+ * Computes the 15 round keys of AES-256.
+ * Requires AES-NI support.
+ *
+ * @param k a 32-byte key
+ * @param rk output parameter; 240 bytes for the round keys
+ */
+void ntru_aes256_set_key_aesni(const uint8_t *k, uint8_t *rk);
+
+/**
+ * @brief AES-256 in counter mode, AES-NI version
+ *
+ * See ntru_aes256_ctr().
+ * Requires AES-NI support.
+ *
+ * @param rk round keys computed by ntru_aes256_set_key_aesni()
+ * @param ctr the number of the first counter block
+ * @param in the input
+ * @param out output parameter; len bytes
+ * @param len the number of bytes to process
+ */
+void ntru_aes256_ctr_aesni(const uint8_t *rk, uint64_t ctr, const uint8_t *in, uint8_t *out, uint32_t len);
+
+#endif   /* NTRU_AES_NI_H */
@@ -0,0 +1,471 @@
+#ifdef __linux__
+#define _GNU_SOURCE   /* for pthread_setaffinity_np() */
+#include <sched.h>
+#include <sys/eventfd.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include "async.h"
+#include "ntru.h"
+#include "rand.h"
+#include "err.h"
+
+/* max #jobs a worker takes from the queue at once, so encryptions can be coalesced */
+#define NTRU_ASYNC_BATCH NTRU_ENCRYPT_MULTI_LANES
+
+/* #times a worker polls an empty queue before it goes to sleep */
+#define NTRU_ASYNC_SPIN 1000
+
+/* room for a ciphertext of any parameter set, at up to 16 bits per coefficient */
+#define NTRU_ASYNC_MAX_ENC_LEN (NTRU_INT_POLY_SIZE*2)
+
+/*
+ * Bounded lock-free multi-producer multi-consumer queue after Dmitry Vyukov.
+ * The sequence number of a cell tells producers whether it is free for a
+ * given enqueue position, and consumers whether it holds a job for a given
+ * dequeue position. The two positions are on separate cache lines.
+ */
+typedef struct NtruAsyncCell {
+    uint64_t seq;
+    NtruAsyncJob *job;
+} NtruAsyncCell;
+
+typedef struct NtruAsyncQueue {
+    NtruAsyncCell *cells;
+    uint64_t mask;
+    uint8_t pad1[64];
+    uint64_t enqueue_pos;
+    uint8_t pad2[64];
+    uint64_t dequeue_pos;
+    uint8_t pad3[64];
+} NtruAsyncQueue;
+
+typedef struct NtruAsyncWorker {
+    struct NtruAsyncPool *pool;
+    pthread_t thread;
+    uint16_t idx;
+} NtruAsyncWorker;
+
+struct NtruAsyncPool {
+    NtruAsyncQueue pending;
+    NtruAsyncQueue done;        /* completed jobs; only used if there is no callback */
+    uint32_t queue_len;
+    uint32_t num_queued;        /* jobs submitted but not yet handed back */
+    NtruAsyncCallback cb;
+    void *cb_arg;
+    int fd_read;                /* -1 if there is a callback */
+    int fd_write;
+    uint8_t flags;
+    uint16_t num_workers;
+    NtruAsyncWorker *workers;
+    pthread_mutex_t lock;       /* protects stop and the sleeping of workers */
+    pthread_cond_t wake;
+    uint32_t num_sleeping;
+    uint8_t stop;
+};
+
+/* Per-worker state */
+typedef struct NtruAsyncScratch {
+    NtruRandGen rng;
+    NtruRandContext rand_ctx;
+    uint8_t rand_ok;
+    NtruEncKeyPair kp;
+    NtruEncPubKey pub[NTRU_ASYNC_BATCH];
+    uint8_t enc[NTRU_ASYNC_BATCH*NTRU_ASYNC_MAX_ENC_LEN];
+} NtruAsyncScratch;
+
+uint8_t ntru_async_queue_init(NtruAsyncQueue *q, uint32_t len) {
+    memset(q, 0, sizeof *q);
+    q->cells = malloc(len * sizeof q->cells[0]);
+    if (q->cells == NULL)
+        return 0;
+    uint32_t i;
+    for (i=0; i<len; i++)
+        q->cells[i].seq = i;
+    q->mask = len - 1;
+    return 1;
+}
+
+/* Returns 0 if the queue is full */
+uint8_t ntru_async_enqueue(NtruAsyncQueue *q, NtruAsyncJob *job) {
+    uint64_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    NtruAsyncCell *cell;
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        int64_t diff = (int64_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return 0;
+        else
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+    cell->job = job;
+    __atomic_store_n(&cell->seq, pos+1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* Returns NULL if the queue is empty */
+NtruAsyncJob *ntru_async_dequeue(NtruAsyncQueue *q) {
+    uint64_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    NtruAsyncCell *cell;
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        int64_t diff = (int64_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos+1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return NULL;
+        else
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+    NtruAsyncJob *job = cell->job;
+    __atomic_store_n(&cell->seq, pos+q->mask+1, __ATOMIC_RELEASE);
+    return job;
+}
+
+/* Creates the completion descriptor */
+uint8_t ntru_async_fd_open(NtruAsyncPool *pool) {
+#ifdef __linux__
+    pool->fd_read = pool->fd_write = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return pool->fd_read >= 0;
+#elif !defined _WIN32
+    int fds[2];
+    if (pipe(fds) != 0)
+        return 0;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    pool->fd_read = fds[0];
+    pool->fd_write = fds[1];
+    return 1;
+#else
+    return 1;
+#endif
+}
+
+void ntru_async_fd_close(NtruAsyncPool *pool) {
+#ifndef _WIN32
+    if (pool->fd_read >= 0)
+        close(pool->fd_read);
+    if (pool->fd_write>=0 && pool->fd_write!=pool->fd_read)
+        close(pool->fd_write);
+#endif
+}
+
+/* Makes the completion descriptor readable */
+void ntru_async_fd_signal(NtruAsyncPool *pool) {
+#ifndef _WIN32
+    if (pool->fd_write < 0)
+        return;
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t ret = write(pool->fd_write, &one, sizeof one);
+#else
+    uint8_t one = 1;
+    ssize_t ret = write(pool->fd_write, &one, sizeof one);   /* a full pipe is readable anyway */
+#endif
+    (void)ret;
+#endif
+}
+
+/* Resets the completion descriptor */
+void ntru_async_fd_clear(NtruAsyncPool *pool) {
+#ifndef _WIN32
+    if (pool->fd_read < 0)
+        return;
+    uint8_t buf[64];
+    while (read(pool->fd_read, buf, sizeof buf) > 0);
+#endif
+}
+
+/* Pins the calling thread to the idx-th CPU it is allowed to run on */
+void ntru_async_pin(uint16_t idx) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0)
+        return;
+    int num_cpus = CPU_COUNT(&allowed);
+    if (num_cpus == 0)
+        return;
+    int n = idx % num_cpus;
+    int cpu;
+    for (cpu=0; cpu<CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed) && n--==0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+            return;
+        }
+#endif
+}
+
+/* Hands a completed job back to the application */
+void ntru_async_complete(NtruAsyncPool *pool, NtruAsyncJob *job) {
+    if (pool->cb != NULL) {
+        pool->cb(job, pool->cb_arg);
+        __atomic_sub_fetch(&pool->num_queued, 1, __ATOMIC_SEQ_CST);
+    }
+    else {
+        /* cannot fail because num_queued never exceeds queue_len */
+        ntru_async_enqueue(&pool->done, job);
+        ntru_async_fd_signal(pool);
+    }
+}
+
+/* Whether job2 can be encrypted together with the encryption job1 by one ntru_encrypt_multi() call */
+uint8_t ntru_async_same_msg(NtruAsyncJob *job1, NtruAsyncJob *job2) {
+    return job2->type==NTRU_ASYNC_ENCRYPT && job1->msg_len==job2->msg_len &&
+            (job1->params==job2->params || memcmp(job1->params->oid, job2->params->oid, sizeof job1->params->oid)==0) &&
+            memcmp(job1->msg, job2->msg, job1->msg_len)==0;
+}
+
+/* Encrypts the message of batch[0] for all num jobs, which have the same message and parameters */
+void ntru_async_encrypt(NtruAsyncPool *pool, NtruAsyncScratch *scratch, NtruAsyncJob **batch, uint8_t num) {
+    NtruAsyncJob *job = batch[0];
+    const NtruEncParams *params = job->params;
+    uint8_t retcode;
+    uint8_t i;
+    /*
+     * The polynomial code may reduce key coefficients in place, so work on
+     * copies in case other workers use the same public key.
+     */
+    for (i=0; i<num; i++)
+        scratch->pub[i] = *batch[i]->pub;
+    if (num == 1)
+        retcode = ntru_encrypt(job->msg, job->msg_len, scratch->pub, params, &scratch->rand_ctx, job->enc);
+    else {
+        uint16_t enc_len = ntru_enc_len(params);
+        retcode = ntru_encrypt_multi(job->msg, job->msg_len, scratch->pub, num, params, &scratch->rand_ctx, scratch->enc);
+        if (retcode == NTRU_SUCCESS)
+            for (i=0; i<num; i++)
+                memcpy(batch[i]->enc, scratch->enc+i*enc_len, enc_len);
+    }
+    for (i=0; i<num; i++) {
+        batch[i]->retcode = retcode;
+        ntru_async_complete(pool, batch[i]);
+    }
+}
+
+/* Runs a batch taken by ntru_async_take(): one job, or encryptions that can be done together */
+void ntru_async_run(NtruAsyncPool *pool, NtruAsyncScratch *scratch, NtruAsyncJob **batch, uint8_t num) {
+    NtruAsyncJob *job = batch[0];
+    uint8_t i;
+    if (!scratch->rand_ok && job->type!=NTRU_ASYNC_DECRYPT) {
+        for (i=0; i<num; i++) {
+            batch[i]->retcode = NTRU_ERR_PRNG;
+            ntru_async_complete(pool, batch[i]);
+        }
+        return;
+    }
+    switch (job->type) {
+    case NTRU_ASYNC_KEYGEN:
+        job->retcode = ntru_gen_key_pair(job->params, job->kp, &scratch->rand_ctx);
+        break;
+    case NTRU_ASYNC_ENCRYPT:
+        ntru_async_encrypt(pool, scratch, batch, num);
+        return;
+    case NTRU_ASYNC_DECRYPT:
+        scratch->kp = *job->kp;
+        job->retcode = ntru_decrypt(job->enc, &scratch->kp, job->params, job->msg, &job->msg_len);
+        break;
+    }
+    ntru_async_complete(pool, job);
+}
+
+/* Wakes a sleeping worker, if any, after a job was put on the queue */
+void ntru_async_wake(NtruAsyncPool *pool) {
+    /* ntru_async_take() increments num_sleeping, then checks the queue */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->num_sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/*
+ * Takes the next job from the queue, sleeping if there is none. If it is an
+ * encryption, also takes the encryptions of the same message that directly
+ * follow it, up to NTRU_ASYNC_BATCH. The first job that cannot be added is
+ * put back on the queue for another worker rather than run after the batch.
+ * Returns the number of jobs, or 0 if the pool is being destroyed.
+ */
+uint8_t ntru_async_take(NtruAsyncPool *pool, NtruAsyncJob **batch) {
+    NtruAsyncJob *job = NULL;
+    uint32_t i;
+    for (i=0; i<NTRU_ASYNC_SPIN && job==NULL; i++)
+        job = ntru_async_dequeue(&pool->pending);
+
+    if (job == NULL) {
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->num_sleeping, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            /* ntru_async_submit() enqueues, then checks num_sleeping */
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            job = ntru_async_dequeue(&pool->pending);
+            if (job!=NULL || pool->stop)
+                break;
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->num_sleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->lock);
+        if (job == NULL)
+            return 0;
+    }
+
+    batch[0] = job;
+    uint8_t num = 1;
+    if (batch[0]->type == NTRU_ASYNC_ENCRYPT)
+        while (num<NTRU_ASYNC_BATCH && (job=ntru_async_dequeue(&pool->pending))!=NULL) {
+            if (!ntru_async_same_msg(batch[0], job)) {
+                /*
+                 * There is room because num_queued counts the jobs held by
+                 * workers; the enqueue only fails while a consumer is still
+                 * releasing the cell.
+                 */
+                while (!ntru_async_enqueue(&pool->pending, job));
+                ntru_async_wake(pool);
+                break;
+            }
+            batch[num++] = job;
+        }
+    return num;
+}
+
+void *ntru_async_worker(void *arg) {
+    NtruAsyncWorker *worker = arg;
+    NtruAsyncPool *pool = worker->pool;
+    if (pool->flags & NTRU_ASYNC_PIN_CPUS)
+        ntru_async_pin(worker->idx);
+
+    /* on the worker's own stack, first written after pinning, so it is local to the worker's NUMA node */
+    NtruAsyncScratch scratch;
+    memset(&scratch, 0, sizeof scratch);
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    scratch.rng = rng;
+    scratch.rand_ok = ntru_rand_init(&scratch.rand_ctx, &scratch.rng) == NTRU_SUCCESS;
+
+    NtruAsyncJob *batch[NTRU_ASYNC_BATCH];
+    uint8_t num;
+    while ((num = ntru_async_take(pool, batch)) > 0)
+        ntru_async_run(pool, &scratch, batch, num);
+
+    if (scratch.rand_ok)
+        ntru_rand_release(&scratch.rand_ctx);
+    memset(&scratch, 0, sizeof scratch);
+    return NULL;
+}
+
+/* Stops and joins the first num_started workers, then frees the pool */
+void ntru_async_release(NtruAsyncPool *pool, uint16_t num_started) {
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->stop, 1, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    uint16_t i;
+    for (i=0; i<num_started; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    ntru_async_fd_close(pool);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->pending.cells);
+    free(pool->done.cells);
+    free(pool);
+}
+
+uint8_t ntru_async_create(uint16_t num_workers, uint32_t queue_len, uint8_t flags, NtruAsyncCallback cb, void *arg, NtruAsyncPool **pool) {
+    if (num_workers==0 || queue_len==0 || queue_len>0x80000000)
+        return NTRU_ERR_INVALID_PARAM;
+    uint32_t len = 1;
+    while (len < queue_len)
+        len <<= 1;
+
+    NtruAsyncPool *p = malloc(sizeof *p);
+    if (p == NULL)
+        return NTRU_ERR_OUT_OF_MEMORY;
+    memset(p, 0, sizeof *p);
+    p->queue_len = len;
+    p->cb = cb;
+    p->cb_arg = arg;
+    p->flags = flags;
+    p->fd_read = p->fd_write = -1;
+    p->workers = malloc(num_workers * sizeof p->workers[0]);
+    uint8_t valid = p->workers != NULL;
+    valid &= ntru_async_queue_init(&p->pending, len);
+    valid &= ntru_async_queue_init(&p->done, len);
+    if (valid && cb==NULL)
+        valid &= ntru_async_fd_open(p);
+    if (!valid) {
+        ntru_async_fd_close(p);
+        free(p->workers);
+        free(p->pending.cells);
+        free(p->done.cells);
+        free(p);
+        return NTRU_ERR_OUT_OF_MEMORY;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+
+    uint16_t i;
+    for (i=0; i<num_workers; i++) {
+        p->workers[i].pool = p;
+        p->workers[i].idx = i;
+        if (pthread_create(&p->workers[i].thread, NULL, ntru_async_worker, &p->workers[i]) != 0) {
+            ntru_async_release(p, i);
+            return NTRU_ERR_OUT_OF_MEMORY;
+        }
+    }
+    p->num_workers = num_workers;
+
+    *pool = p;
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_async_submit(NtruAsyncPool *pool, NtruAsyncJob *job) {
+    if (job->type > NTRU_ASYNC_DECRYPT || __atomic_load_n(&pool->stop, __ATOMIC_RELAXED))
+        return NTRU_ERR_INVALID_PARAM;
+    if (__atomic_add_fetch(&pool->num_queued, 1, __ATOMIC_SEQ_CST) > pool->queue_len) {
+        __atomic_sub_fetch(&pool->num_queued, 1, __ATOMIC_SEQ_CST);
+        return NTRU_ERR_QUEUE_FULL;
+    }
+    ntru_async_enqueue(&pool->pending, job);
+    ntru_async_wake(pool);
+    return NTRU_SUCCESS;
+}
+
+int ntru_async_fd(NtruAsyncPool *pool) {
+    return pool->fd_read;
+}
+
+uint32_t ntru_async_poll(NtruAsyncPool *pool, NtruAsyncJob **jobs, uint32_t max_jobs) {
+    /* clear first; jobs completed after this will signal again */
+    ntru_async_fd_clear(pool);
+    uint32_t num = 0;
+    while (num < max_jobs) {
+        NtruAsyncJob *job = ntru_async_dequeue(&pool->done);
+        if (job == NULL)
+            break;
+        jobs[num++] = job;
+    }
+    if (num == max_jobs && __atomic_load_n(&pool->done.enqueue_pos, __ATOMIC_SEQ_CST)!=__atomic_load_n(&pool->done.dequeue_pos, __ATOMIC_SEQ_CST))
+        ntru_async_fd_signal(pool);   /* more are waiting */
+    __atomic_sub_fetch(&pool->num_queued, num, __ATOMIC_SEQ_CST);
+    return num;
+}
+
+void ntru_async_destroy(NtruAsyncPool *pool) {
+    ntru_async_release(pool, pool->num_workers);
+}
@@ -0,0 +1,128 @@
+#ifndef NTRU_ASYNC_H
+#define NTRU_ASYNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "key.h"
+#include "encparams.h"
+
+/** job types */
+#define NTRU_ASYNC_KEYGEN 0
+#define NTRU_ASYNC_ENCRYPT 1
+#define NTRU_ASYNC_DECRYPT 2
+
+/** flags for ntru_async_create() */
+#define NTRU_ASYNC_PIN_CPUS 1   /* pin worker i to the i-th CPU the process may run on (Linux only) */
+
+/**
+ * A key generation, encryption, or decryption to be done by a worker pool.
+ * The caller owns the job and all buffers it points to; they must stay valid
+ * until the job has completed.
+ */
+typedef struct NtruAsyncJob {
+    uint8_t type;                   /* one of the NTRU_ASYNC_ job types */
+    const NtruEncParams *params;
+    NtruEncKeyPair *kp;             /* keygen: output; decrypt: the key pair */
+    NtruEncPubKey *pub;             /* encrypt: the public key */
+    uint8_t *msg;                   /* encrypt: input; decrypt: output, ntru_max_msg_len(params) bytes */
+    uint16_t msg_len;               /* encrypt: input; decrypt: output */
+    uint8_t *enc;                   /* encrypt: output; decrypt: input; ntru_enc_len(params) bytes */
+    void *user_data;                /* not used by libntru */
+    uint8_t retcode;                /* set when the job completes */
+} NtruAsyncJob;
+
+/**
+ * Called by a worker thread when a job has completed, with the arg passed to
+ * ntru_async_create(). It should return quickly because the worker does not
+ * take on other jobs while the callback runs.
+ */
+typedef void (*NtruAsyncCallback)(NtruAsyncJob *job, void *arg);
+
+typedef struct NtruAsyncPool NtruAsyncPool;
+
+/**
+ * @brief Worker pool setup
+ *
+ * Starts num_workers threads that run jobs submitted with ntru_async_submit().
+ * Each worker has its own random number generator (NTRU_RNG_DEFAULT) and
+ * allocates its own scratch memory after it has been pinned, so the memory
+ * is local to the worker's NUMA node.
+ * Completed jobs are either passed to cb, or, if cb is NULL, queued until
+ * they are picked up with ntru_async_poll().
+ *
+ * @param num_workers the number of worker threads
+ * @param queue_len the maximum number of jobs that can be pending or
+ *                  completed but not yet polled; rounded up to a power of two
+ * @param flags 0 or NTRU_ASYNC_PIN_CPUS
+ * @param cb the completion callback, or NULL
+ * @param arg passed to cb
+ * @param pool output parameter; the new pool
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_PARAM if num_workers or
+ *         queue_len is zero, or NTRU_ERR_OUT_OF_MEMORY if a thread or
+ *         notification descriptor could not be created
+ */
+uint8_t ntru_async_create(uint16_t num_workers, uint32_t queue_len, uint8_t flags, NtruAsyncCallback cb, void *arg, NtruAsyncPool **pool);
+
+/**
+ * @brief Job submission
+ *
+ * Queues a job without blocking. Jobs may complete in any order. Encryptions
+ * of the same message with the same parameters that are next to each other in
+ * the queue are run together by ntru_encrypt_multi() so the hash lanes stay
+ * full; other jobs are never held back by such a batch.
+ * Can be called from any thread.
+ *
+ * @param pool the worker pool
+ * @param job the job
+ * @return NTRU_SUCCESS on success, NTRU_ERR_QUEUE_FULL if queue_len jobs are
+ *         pending or waiting to be polled, or NTRU_ERR_INVALID_PARAM if the
+ *         job type is unknown or the pool is being destroyed
+ */
+uint8_t ntru_async_submit(NtruAsyncPool *pool, NtruAsyncJob *job);
+
+/**
+ * @brief Completion descriptor
+ *
+ * Returns a file descriptor that becomes readable when completed jobs can be
+ * picked up with ntru_async_poll(). It is an eventfd on Linux and the read
+ * end of a pipe elsewhere. Only ntru_async_poll() should read from it.
+ *
+ * @param pool the worker pool
+ * @return the descriptor, or -1 if the pool has a completion callback or the
+ *         platform has no pollable descriptors
+ */
+int ntru_async_fd(NtruAsyncPool *pool);
+
+/**
+ * @brief Completion polling
+ *
+ * Picks up completed jobs without blocking. Only for pools without a
+ * completion callback.
+ *
+ * @param pool the worker pool
+ * @param jobs output parameter; an array of max_jobs elements to store the
+ *             completed jobs
+ * @param max_jobs the size of jobs
+ * @return the number of jobs stored in jobs
+ */
+uint32_t ntru_async_poll(NtruAsyncPool *pool, NtruAsyncJob **jobs, uint32_t max_jobs);
+
+/**
+ * @brief Worker pool release
+ *
+ * Waits until all submitted jobs have completed, stops the workers, and
+ * frees the pool. Completed jobs that were not polled are dropped.
+ *
+ * @param pool the worker pool
+ */
+void ntru_async_destroy(NtruAsyncPool *pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_ASYNC_H */
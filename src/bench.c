@@ -1,10 +1,44 @@
+#ifdef __linux__
+#define _GNU_SOURCE   /* for sched_setaffinity() */
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#if defined __x86_64__ || defined __i386__
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include "ntru.h"
+#include "poly.h"
+#include "mgf.h"
+#include "idxgen.h"
+#ifdef __SSSE3__
+#include "poly_ssse3.h"
+#endif
+#include "pubstore.h"
+#include "keyring.h"
+#include "kem.h"
+#include "stream.h"
+#include "kernels.h"
+#ifdef __AVX2__
+#include "poly_avx2.h"
+#endif
 
 #define NUM_ITER_KEYGEN 50
 #define NUM_ITER_ENCDEC 10000
+#define NUM_ITER_MULT 1000
+#define NUM_KEYS_KEYRING 100000
+#define NUM_KEM_BATCH 64
+#define NUM_CHUNKS_STREAM 1024
+#define NUM_RECIPIENTS_MAX 64
+#define NUM_KEYS_ROTATION 8
 
 /*
  * The __MACH__ and __MINGW32__ code below is from
@@ -144,62 +178,1586 @@ void print_time(char *label, double *samples, int num_samples) {
     fflush(stdout);
 }
 
-int main(int argc, char **argv) {
-    printf("Please wait...\n");
+/* Prints the number of operations per second for samples in microseconds */
+void print_rate(char *label, double *samples, int num_samples) {
+    double time = median(samples, num_samples);
+    printf("%s %d/sec   ", label, (uint32_t)(1000000.0/time));
+    fflush(stdout);
+}
+
+/*
+ * "bench record <file>" runs a fixed matrix of benchmarks and saves the
+ * samples as a baseline; "bench compare <file> [threshold]" runs the same
+ * matrix and reports cases that got slower than the baseline. The matrix is
+ * run NUM_ROUNDS_CMP times, so that a temporary slowdown of the machine
+ * affects a few samples of many cases rather than all samples of a few. In
+ * each round, each case is warmed up and then timed NUM_SAMPLES_CMP/
+ * NUM_ROUNDS_CMP times. A sample is the average time of as many calls as fit
+ * into MIN_SAMPLE_NS_CMP. All inputs come from a fixed-seed DRBG, and the
+ * process is pinned to one CPU where supported.
+ */
+#define NUM_SAMPLES_CMP 100
+#define NUM_ROUNDS_CMP 10
+#define NUM_WARMUP_CMP 10
+#define MIN_SAMPLE_NS_CMP 100000
+#define BASELINE_FORMAT 1
+#define THRESHOLD_DEFAULT 5.0   /* percent */
+#define ALPHA_CMP 0.01
+
+#ifndef NTRU_VERSION
+#define NTRU_VERSION "unknown"
+#endif
+
+#ifdef __AVX2__
+#define BENCH_SIMD "avx2"
+#elif __SSSE3__
+#define BENCH_SIMD "ssse3"
+#else
+#define BENCH_SIMD "generic"
+#endif
+#ifdef NTRU_AVOID_HAMMING_WT_PATENT
+#define BENCH_CONFIG BENCH_SIMD "-noham"
+#else
+#define BENCH_CONFIG BENCH_SIMD
+#endif
+
+/* stages of ntru_encrypt() and ntru_decrypt() which are not in a header */
+void ntru_get_seed(uint8_t *msg, uint16_t msg_len, NtruIntPoly *h, uint8_t *b, const NtruEncParams *params, uint8_t *seed);
+void ntru_gen_blind_poly(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruPrivPoly *r);
+
+/* normally called by the functions in ntru.h */
+void ntru_set_optimized_impl();
+
+typedef struct BenchState {
+    NtruEncParams *params;
+    NtruEncKeyPair kp;
+    NtruEncKeyPair kp_tmp;
+    NtruRandGen rng;
+    NtruRandContext rand_ctx;
+    uint8_t plain[256];
+    uint16_t plain_len;
+    uint8_t enc[2*NTRU_INT_POLY_SIZE];       /* encryption of plain, input to decryption */
+    uint8_t enc_tmp[2*NTRU_INT_POLY_SIZE];   /* output of encryption */
+    uint8_t dec[256];
+    uint8_t b[64];          /* random part of the encoded message */
+    uint8_t sdata[512];     /* output of ntru_get_seed() */
+    uint16_t sdata_len;
+    NtruPrivPoly r;         /* blinding polynomial */
+    NtruIGFState igf;
+    NtruIntPoly a, b_poly, c;
+    NtruIntPoly m, mask;    /* inputs to ntru_encrypt_post() and ntru_decrypt_post() */
+    NtruTernPoly tern;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    NtruProdPoly prod;
+#endif
+    uint8_t success;
+} BenchState;
+
+typedef void (*BenchFunc)(BenchState *st);
+
+#define BENCH_ALL 0
+#define BENCH_TERN 1   /* only for parameter sets with a ternary private key */
+#define BENCH_PROD 2   /* only for parameter sets with a product-form private key */
+
+typedef struct BenchCase {
+    char *name;
+    BenchFunc func;
+    uint8_t applies_to;
+} BenchCase;
+
+void bench_keygen(BenchState *st) {
+    st->success &= ntru_gen_key_pair(st->params, &st->kp_tmp, &st->rand_ctx) == NTRU_SUCCESS;
+}
+
+void bench_encrypt(BenchState *st) {
+    st->success &= ntru_encrypt(st->plain, st->plain_len, &st->kp.pub, st->params, &st->rand_ctx, st->enc_tmp) == NTRU_SUCCESS;
+}
+
+void bench_decrypt(BenchState *st) {
+    uint16_t dec_len;
+    st->success &= ntru_decrypt(st->enc, &st->kp, st->params, st->dec, &dec_len) == NTRU_SUCCESS;
+}
+
+void bench_mgf(BenchState *st) {
+    ntru_MGF(st->enc, (st->params->N*2+7)/8, st->params, &st->c);
+}
+
+void bench_get_seed(BenchState *st) {
+    ntru_get_seed(st->plain, st->plain_len, &st->kp.pub.h, st->b, st->params, st->sdata);
+}
+
+void bench_gen_blind_poly(BenchState *st) {
+    ntru_gen_blind_poly(st->sdata, st->sdata_len, st->params, &st->r);
+}
+
+void bench_igf_next(BenchState *st) {
+    uint16_t idx;
+    ntru_IGF_next(&st->igf, &idx);
+}
+
+void bench_mult_priv(BenchState *st) {
+    st->success &= ntru_mult_priv(&st->r, &st->kp.pub.h, &st->c, st->params->q-1);
+}
+
+void bench_encrypt_post(BenchState *st) {
+    uint16_t weights[3];
+    ntru_encrypt_post(&st->m, &st->mask, &st->c, weights);
+}
+
+void bench_decrypt_post(BenchState *st) {
+    uint16_t weights[3];
+    ntru_decrypt_post(&st->m, &st->mask, st->params->q, &st->c, weights);
+}
+
+void bench_to_arr(BenchState *st) {
+    ntru_to_arr(&st->a, st->params->q, st->enc_tmp);
+}
+
+void bench_from_arr(BenchState *st) {
+    ntru_from_arr(st->enc, st->params->N, st->params->q, &st->c);
+}
+
+void bench_mult_int_16(BenchState *st) {
+    st->success &= ntru_mult_int_16(&st->a, &st->b_poly, &st->c, st->params->q-1);
+}
+
+#ifndef __ARMEL__
+void bench_mult_int_64(BenchState *st) {
+    st->success &= ntru_mult_int_64(&st->a, &st->b_poly, &st->c, st->params->q-1);
+}
+#endif
+
+void bench_mult_tern_32(BenchState *st) {
+    st->success &= ntru_mult_tern_32(&st->a, &st->tern, &st->c, st->params->q-1);
+}
+
+#ifndef __ARMEL__
+void bench_mult_tern_64(BenchState *st) {
+    st->success &= ntru_mult_tern_64(&st->a, &st->tern, &st->c, st->params->q-1);
+}
+#endif
+
+void bench_mult_tern_ct(BenchState *st) {
+    st->success &= ntru_mult_tern_ct(&st->a, &st->tern, &st->c, st->params->q-1);
+}
+
+#ifdef __SSSE3__
+void bench_mult_int_sse(BenchState *st) {
+    st->success &= ntru_mult_int_sse(&st->a, &st->b_poly, &st->c, st->params->q-1);
+}
 
+void bench_mult_tern_sse(BenchState *st) {
+    st->success &= ntru_mult_tern_sse(&st->a, &st->tern, &st->c, st->params->q-1);
+}
+#endif   /* __SSSE3__ */
+
+#ifdef __AVX2__
+void bench_mult_int_avx2_schoolbook(BenchState *st) {
+    st->success &= ntru_mult_int_avx2_schoolbook(&st->a, &st->b_poly, &st->c, st->params->q-1);
+}
+
+void bench_mult_int_avx2_toom4(BenchState *st) {
+    st->success &= ntru_mult_int_avx2_toom4(&st->a, &st->b_poly, &st->c, st->params->q-1);
+}
+
+void bench_mult_tern_avx2(BenchState *st) {
+    st->success &= ntru_mult_tern_avx2(&st->a, &st->tern, &st->c, st->params->q-1);
+}
+#endif   /* __AVX2__ */
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+void bench_mult_prod_standard(BenchState *st) {
+    st->success &= ntru_mult_prod_standard(&st->a, &st->prod, &st->c, st->params->q-1);
+}
+
+void bench_mult_prod_ct(BenchState *st) {
+    st->success &= ntru_mult_prod_ct(&st->a, &st->prod, &st->c, st->params->q-1);
+}
+
+#ifdef __SSSE3__
+void bench_mult_prod_sse(BenchState *st) {
+    st->success &= ntru_mult_prod_sse(&st->a, &st->prod, &st->c, st->params->q-1);
+}
+#endif
+
+#ifdef __AVX2__
+void bench_mult_prod_avx2(BenchState *st) {
+    st->success &= ntru_mult_prod_avx2(&st->a, &st->prod, &st->c, st->params->q-1);
+}
+#endif
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+BenchCase bench_cases[] = {
+    {"keygen", bench_keygen, BENCH_ALL},
+    {"encrypt", bench_encrypt, BENCH_ALL},
+    {"decrypt", bench_decrypt, BENCH_ALL},
+    {"get_seed", bench_get_seed, BENCH_ALL},
+    {"gen_blind_poly", bench_gen_blind_poly, BENCH_ALL},
+    {"igf_next", bench_igf_next, BENCH_ALL},
+    {"mult_priv", bench_mult_priv, BENCH_ALL},
+    {"mgf", bench_mgf, BENCH_ALL},
+    {"encrypt_post", bench_encrypt_post, BENCH_ALL},
+    {"decrypt_post", bench_decrypt_post, BENCH_ALL},
+    {"to_arr", bench_to_arr, BENCH_ALL},
+    {"from_arr", bench_from_arr, BENCH_ALL},
+    {"mult_int_16", bench_mult_int_16, BENCH_ALL},
+#ifndef __ARMEL__
+    {"mult_int_64", bench_mult_int_64, BENCH_ALL},
+#endif
+#ifdef __SSSE3__
+    {"mult_int_sse", bench_mult_int_sse, BENCH_ALL},
+#endif
+#ifdef __AVX2__
+    {"mult_int_avx2_schoolbook", bench_mult_int_avx2_schoolbook, BENCH_ALL},
+    {"mult_int_avx2_toom4", bench_mult_int_avx2_toom4, BENCH_ALL},
+#endif
+    {"mult_tern_32", bench_mult_tern_32, BENCH_TERN},
+#ifndef __ARMEL__
+    {"mult_tern_64", bench_mult_tern_64, BENCH_TERN},
+#endif
+#ifdef __SSSE3__
+    {"mult_tern_sse", bench_mult_tern_sse, BENCH_TERN},
+#endif
+#ifdef __AVX2__
+    {"mult_tern_avx2", bench_mult_tern_avx2, BENCH_TERN},
+#endif
+    {"mult_tern_ct", bench_mult_tern_ct, BENCH_TERN},
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    {"mult_prod_standard", bench_mult_prod_standard, BENCH_PROD},
+#ifdef __SSSE3__
+    {"mult_prod_sse", bench_mult_prod_sse, BENCH_PROD},
+#endif
+#ifdef __AVX2__
+    {"mult_prod_avx2", bench_mult_prod_avx2, BENCH_PROD},
+#endif
+    {"mult_prod_ct", bench_mult_prod_ct, BENCH_PROD},
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+};
+
+#define NUM_BENCH_CASES (sizeof(bench_cases)/sizeof(bench_cases[0]))
+
+typedef struct BenchResult {
+    char name[48];   /* parameter set/case */
+    uint32_t num_calls;   /* calls per sample */
+    uint32_t num_samples;
+    double samples[NUM_SAMPLES_CMP];   /* nanoseconds per call */
+} BenchResult;
+
+/* Keeps the benchmarks on one CPU so they are not disturbed by migrations */
+void bench_pin_cpu() {
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof set, &set);
+    }
+#endif
+}
+
+double bench_elapsed_ns(struct timespec *t1, struct timespec *t2) {
+    return 1000000000.0*(t2->tv_sec-t1->tv_sec) + t2->tv_nsec-t1->tv_nsec;
+}
+
+/* Adds NUM_SAMPLES_CMP/NUM_ROUNDS_CMP samples to res */
+void bench_run_case(BenchFunc func, BenchState *st, BenchResult *res) {
+    struct timespec t1, t2;
+    uint32_t i, j;
+
+    /* warm up, and in the first round, determine the number of calls per sample */
+    clock_gettime(CLOCK_REALTIME, &t1);
+    for (i=0; i<NUM_WARMUP_CMP; i++)
+        func(st);
+    clock_gettime(CLOCK_REALTIME, &t2);
+    if (res->num_samples == 0) {
+        double ns_per_call = bench_elapsed_ns(&t1, &t2) / NUM_WARMUP_CMP;
+        res->num_calls = ns_per_call>=MIN_SAMPLE_NS_CMP ? 1 : MIN_SAMPLE_NS_CMP/(ns_per_call+1) + 1;
+    }
+
+    for (i=0; i<NUM_SAMPLES_CMP/NUM_ROUNDS_CMP; i++) {
+        clock_gettime(CLOCK_REALTIME, &t1);
+        for (j=0; j<res->num_calls; j++)
+            func(st);
+        clock_gettime(CLOCK_REALTIME, &t2);
+        res->samples[res->num_samples++] = bench_elapsed_ns(&t1, &t2) / res->num_calls;
+    }
+}
+
+/*
+ * Generates the inputs for all cases; they are the same on every call.
+ * st->rand_ctx must be released when done.
+ */
+void bench_setup(BenchState *st, NtruEncParams *params) {
+    uint8_t seed[] = "libntru bench-compare";
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    st->rng = rng;
+    st->params = params;
+    st->success &= ntru_rand_init_det(&st->rand_ctx, &st->rng, seed, sizeof seed) == NTRU_SUCCESS;
+    st->success &= ntru_gen_key_pair(params, &st->kp, &st->rand_ctx) == NTRU_SUCCESS;
+    st->plain_len = ntru_max_msg_len(params);
+    st->success &= ntru_rand_generate(st->plain, st->plain_len, &st->rand_ctx) == NTRU_SUCCESS;
+    st->success &= ntru_encrypt(st->plain, st->plain_len, &st->kp.pub, params, &st->rand_ctx, st->enc) == NTRU_SUCCESS;
+    st->success &= ntru_rand_generate(st->b, params->db/8, &st->rand_ctx) == NTRU_SUCCESS;
+    ntru_get_seed(st->plain, st->plain_len, &st->kp.pub.h, st->b, params, st->sdata);
+    st->sdata_len = sizeof(params->oid) + st->plain_len + params->db/8 + params->db/8;
+    ntru_gen_blind_poly(st->sdata, st->sdata_len, params, &st->r);
+    ntru_IGF_init(st->sdata, st->sdata_len, params, &st->igf);
+
+    uint16_t i;
+    st->a.N = st->b_poly.N = st->m.N = st->mask.N = params->N;
+    st->success &= ntru_rand_generate((uint8_t*)st->a.coeffs, params->N*sizeof st->a.coeffs[0], &st->rand_ctx) == NTRU_SUCCESS;
+    st->success &= ntru_rand_generate((uint8_t*)st->b_poly.coeffs, params->N*sizeof st->b_poly.coeffs[0], &st->rand_ctx) == NTRU_SUCCESS;
+    for (i=0; i<params->N; i++) {
+        st->a.coeffs[i] &= params->q - 1;
+        st->b_poly.coeffs[i] &= params->q - 1;
+        st->m.coeffs[i] = st->a.coeffs[i] % 3;
+        st->mask.coeffs[i] = st->b_poly.coeffs[i] % 3;
+    }
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (params->prod_flag)
+        st->success &= ntru_rand_prod(params->N, params->df1, params->df2, params->df3, params->df3, &st->prod, &st->rand_ctx);
+    else
+#endif
+        st->success &= ntru_rand_tern(params->N, params->df1, params->df1, &st->tern, &st->rand_ctx);
+}
+
+/*
+ * Runs all benchmarks and returns the number of results, or 0 on failure.
+ * results must have room for NUM_BENCH_CASES results per parameter set.
+ */
+uint32_t bench_matrix(BenchResult *results) {
     NtruEncParams param_arr[] = ALL_PARAM_SETS;
-    uint8_t success = 1;
+    BenchState *st = malloc(sizeof *st);
+    if (st == NULL)
+        return 0;
+    st->success = 1;
+    uint32_t num_results = 0;
 
-    uint8_t param_idx;
-    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
-        NtruEncParams params = param_arr[param_idx];
-        NtruEncKeyPair kp;
-        uint32_t i;
-        struct timespec t1, t2;
-        printf("%-10s   ", params.name);
+    uint32_t round;
+    for (round=0; round<NUM_ROUNDS_CMP; round++) {
+        printf("round %2d/%d ", round+1, NUM_ROUNDS_CMP);
         fflush(stdout);
+        num_results = 0;
 
-        double samples_keygen[NUM_ITER_KEYGEN];
-        NtruRandGen rng = NTRU_RNG_DEFAULT;
-        NtruRandContext rand_ctx;
-        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
-        for (i=0; i<NUM_ITER_KEYGEN; i++) {
-            clock_gettime(CLOCK_REALTIME, &t1);
-            success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
-            clock_gettime(CLOCK_REALTIME, &t2);
-            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
-            samples_keygen[i] = duration / 1000.0;   /* microseconds */
+        uint8_t param_idx;
+        for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+            NtruEncParams *params = &param_arr[param_idx];
+            bench_setup(st, params);
+
+            uint32_t j;
+            for (j=0; j<NUM_BENCH_CASES; j++) {
+                BenchCase *bc = &bench_cases[j];
+                if ((bc->applies_to==BENCH_TERN && params->prod_flag) || (bc->applies_to==BENCH_PROD && !params->prod_flag))
+                    continue;
+                BenchResult *res = &results[num_results++];
+                if (round == 0) {
+                    snprintf(res->name, sizeof res->name, "%.10s/%.36s", params->name, bc->name);
+                    res->num_samples = 0;
+                }
+                bench_run_case(bc->func, st, res);
+            }
+            st->success &= ntru_rand_release(&st->rand_ctx) == NTRU_SUCCESS;
+            printf(".");
+            fflush(stdout);
         }
-        print_time("keygen", samples_keygen, NUM_ITER_KEYGEN);
+        printf("\n");
+    }
 
-        double samples_encdec[NUM_ITER_ENCDEC];
-        uint16_t max_len = ntru_max_msg_len(&params);   /* max message length for this param set */
-        uint8_t plain[max_len];
-        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
-        uint16_t enc_len = ntru_enc_len(&params);
-        uint8_t encrypted[enc_len];
-        uint8_t decrypted[max_len];
-        for (i=0; i<NUM_ITER_ENCDEC; i++) {
-            clock_gettime(CLOCK_REALTIME, &t1);
-            success &= ntru_encrypt((uint8_t*)&plain, max_len, &kp.pub, &params, &rand_ctx, (uint8_t*)&encrypted) == NTRU_SUCCESS;
-            clock_gettime(CLOCK_REALTIME, &t2);
-            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
-            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+    uint8_t success = st->success;
+    free(st);
+    return success ? num_results : 0;
+}
+
+int bench_record(char *filename) {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    BenchResult *results = malloc(sizeof(param_arr)/sizeof(param_arr[0]) * NUM_BENCH_CASES * sizeof(BenchResult));
+    if (results == NULL)
+        return 1;
+    bench_pin_cpu();
+    uint32_t num_results = bench_matrix(results);
+    FILE *f = num_results>0 ? fopen(filename, "w") : NULL;
+    if (f == NULL) {
+        printf("Error!\n");
+        free(results);
+        return 1;
+    }
+
+    fprintf(f, "libntru-bench %d\n", BASELINE_FORMAT);
+    fprintf(f, "version %s\n", NTRU_VERSION);
+    fprintf(f, "config %s\n", BENCH_CONFIG);
+    uint32_t i, j;
+    for (i=0; i<num_results; i++) {
+        fprintf(f, "case %s %d", results[i].name, results[i].num_samples);
+        for (j=0; j<results[i].num_samples; j++)
+            fprintf(f, " %.1f", results[i].samples[j]);
+        fprintf(f, "\n");
+    }
+    int err = ferror(f);
+    err |= fclose(f);
+    free(results);
+    if (err) {
+        printf("Error!\n");
+        return 1;
+    }
+    printf("%d cases written to %s\n", num_results, filename);
+    return 0;
+}
+
+/*
+ * Reads a baseline file into a newly allocated array. Returns the number of
+ * results, or -1 if the file cannot be read.
+ */
+int bench_read_baseline(char *filename, BenchResult **results, char *version, char *config) {
+    *results = NULL;
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        return -1;
+    int format;
+    if (fscanf(f, "libntru-bench %d version %31s config %31s", &format, version, config)!=3 || format!=BASELINE_FORMAT) {
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t num_results = 0;
+    uint32_t max_results = 0;
+    BenchResult res;
+    while (fscanf(f, " case %47s %u", res.name, &res.num_samples) == 2) {
+        if (res.num_samples > NUM_SAMPLES_CMP)
+            break;
+        uint32_t i;
+        for (i=0; i<res.num_samples; i++)
+            if (fscanf(f, "%lf", &res.samples[i]) != 1)
+                break;
+        if (i < res.num_samples)
+            break;
+        if (num_results == max_results) {
+            max_results = max_results==0 ? 256 : 2*max_results;
+            BenchResult *tmp = realloc(*results, max_results * sizeof(BenchResult));
+            if (tmp == NULL)
+                break;
+            *results = tmp;
         }
-        print_time("enc", samples_encdec, NUM_ITER_ENCDEC);
-        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+        (*results)[num_results++] = res;
+    }
+    int complete = fscanf(f, " %*s") == EOF;
+    fclose(f);
+    if (!complete) {
+        free(*results);
+        *results = NULL;
+        return -1;
+    }
+    return num_results;
+}
 
-        uint16_t dec_len;
-        for (i=0; i<NUM_ITER_ENCDEC; i++) {
-            clock_gettime(CLOCK_REALTIME, &t1);
-            success &= ntru_decrypt((uint8_t*)&encrypted, &kp, &params, (uint8_t*)&decrypted, &dec_len) == NTRU_SUCCESS;
-            clock_gettime(CLOCK_REALTIME, &t2);
-            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
-            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+typedef struct RankedSample {
+    double value;
+    uint8_t in_x;
+} RankedSample;
+
+int compare_ranked(const void *p1, const void *p2) {
+    double v1 = ((RankedSample*)p1)->value;
+    double v2 = ((RankedSample*)p2)->value;
+    return v1<v2 ? -1 : (v1>v2 ? 1 : 0);
+}
+
+/*
+ * One-sided Mann-Whitney U test. Returns the p-value for the hypothesis that
+ * the values in x tend to be larger than the values in y, using the normal
+ * approximation with corrections for ties and continuity.
+ */
+double mann_whitney_p(double *x, uint32_t nx, double *y, uint32_t ny) {
+    uint32_t n = nx + ny;
+    RankedSample *s = malloc(n * sizeof s[0]);
+    if (s == NULL)
+        return 1;
+    uint32_t i, j;
+    for (i=0; i<nx; i++) {
+        s[i].value = x[i];
+        s[i].in_x = 1;
+    }
+    for (i=0; i<ny; i++) {
+        s[nx+i].value = y[i];
+        s[nx+i].in_x = 0;
+    }
+    qsort(s, n, sizeof s[0], compare_ranked);
+
+    /* sum of the ranks of x; tied values get the average of their ranks */
+    double rank_sum_x = 0;
+    double ties = 0;
+    for (i=0; i<n; i=j) {
+        for (j=i+1; j<n && s[j].value==s[i].value; j++);
+        double rank = (i+1+j) / 2.0;
+        double t = j - i;
+        ties += t*t*t - t;
+        uint32_t k;
+        for (k=i; k<j; k++)
+            if (s[k].in_x)
+                rank_sum_x += rank;
+    }
+    free(s);
+
+    double u = rank_sum_x - nx*(nx+1)/2.0;
+    double mean = nx*(double)ny / 2;
+    double var = nx*(double)ny / 12 * ((n+1) - ties/((double)n*(n-1)));
+    if (var <= 0)
+        return 1;
+    double z = (u-mean-0.5) / sqrt(var);
+    return 0.5 * erfc(z/sqrt(2));
+}
+
+int bench_compare(char *filename, double threshold) {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    char version[32], config[32];
+    BenchResult *baseline;
+    int num_baseline = bench_read_baseline(filename, &baseline, version, config);
+    if (num_baseline < 0) {
+        printf("Cannot read baseline file %s\n", filename);
+        return 1;
+    }
+    BenchResult *results = malloc(sizeof(param_arr)/sizeof(param_arr[0]) * NUM_BENCH_CASES * sizeof(BenchResult));
+    if (results == NULL) {
+        free(baseline);
+        return 1;
+    }
+    printf("Comparing against libntru %s (%s)\n", version, config);
+    if (strcmp(config, BENCH_CONFIG) != 0)
+        printf("Warning: this build is %s; kernel results may not be comparable\n", BENCH_CONFIG);
+
+    bench_pin_cpu();
+    uint32_t num_results = bench_matrix(results);
+    if (num_results == 0) {
+        printf("Error!\n");
+        free(baseline);
+        free(results);
+        return 1;
+    }
+
+    uint32_t i;
+    int j;
+    printf("\n%-40s %12s %12s %8s %8s\n", "case", "baseline ns", "current ns", "change", "p");
+    uint32_t num_regressions = 0;
+    for (i=0; i<num_results; i++) {
+        BenchResult *cur = &results[i];
+        BenchResult *base = NULL;
+        for (j=0; j<num_baseline && base==NULL; j++)
+            if (strcmp(baseline[j].name, cur->name) == 0)
+                base = &baseline[j];
+        if (base == NULL) {
+            printf("%-40s %12s %12.1f\n", cur->name, "new", median(cur->samples, cur->num_samples));
+            continue;
         }
-        print_time("dec", samples_encdec, NUM_ITER_ENCDEC);
+
+        double p_slower = mann_whitney_p(cur->samples, cur->num_samples, base->samples, base->num_samples);
+        double p_faster = mann_whitney_p(base->samples, base->num_samples, cur->samples, cur->num_samples);
+        double med_base = median(base->samples, base->num_samples);
+        double med_cur = median(cur->samples, cur->num_samples);
+        double change = med_base>0 ? (med_cur/med_base-1) * 100 : 0;
+        char *verdict = "";
+        double p = p_slower<p_faster ? p_slower : p_faster;
+        if (p_slower<ALPHA_CMP && change>threshold) {
+            verdict = "REGRESSION";
+            num_regressions++;
+        }
+        else if (p_faster<ALPHA_CMP && change<-threshold)
+            verdict = "faster";
+        printf("%-40s %12.1f %12.1f %+7.1f%% %8.4f %s\n", cur->name, med_base, med_cur, change, p, verdict);
+    }
+
+    printf("\n%d regression(s) in %d cases (threshold %.1f%%, alpha %.2f)\n", num_regressions, num_results, threshold, ALPHA_CMP);
+    free(baseline);
+    free(results);
+    return num_regressions>0 ? 1 : 0;
+}
+
+/*
+ * "bench counters" reports hardware performance counters per call for every
+ * case of the benchmark matrix, including the individual stages of
+ * encryption and decryption. Instruction counts hardly vary between runs,
+ * so they show changes that are lost in the noise of wall-clock times. The
+ * counters are read through perf_event_open() on Linux; where they are not
+ * available, only TSC ticks (on x86) and nanoseconds are reported.
+ */
+#define NUM_BATCHES_COUNTERS 5
+#define MIN_BATCH_NS_COUNTERS 2000000
+#define NUM_COUNTERS 5
+
+char *counter_names[NUM_COUNTERS] = {"instructions", "cycles", "branch-miss", "L1D-miss", "LLC-miss"};
+
+#ifdef __linux__
+struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ<<8) | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ<<8) | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16)},
+};
+#endif
+
+typedef struct BenchCounters {
+    int fd[NUM_COUNTERS];   /* -1 if a counter is not available */
+    uint8_t num_open;
+    struct timespec t1;
+    uint64_t tsc1;
+} BenchCounters;
+
+/* values reported for a batch of calls: the counters, then TSC ticks and nanoseconds */
+#define COUNTER_TSC NUM_COUNTERS
+#define COUNTER_NS (NUM_COUNTERS+1)
+
+void bench_counters_open(BenchCounters *ctr) {
+    ctr->num_open = 0;
+    uint8_t i;
+    for (i=0; i<NUM_COUNTERS; i++) {
+        ctr->fd[i] = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = counter_events[i].type;
+        attr.config = counter_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        ctr->fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (ctr->fd[i] >= 0)
+            ctr->num_open++;
+#endif
+    }
+}
+
+void bench_counters_close(BenchCounters *ctr) {
+#ifdef __linux__
+    uint8_t i;
+    for (i=0; i<NUM_COUNTERS; i++)
+        if (ctr->fd[i] >= 0)
+            close(ctr->fd[i]);
+#endif
+}
+
+void bench_counters_start(BenchCounters *ctr) {
+#ifdef __linux__
+    uint8_t i;
+    for (i=0; i<NUM_COUNTERS; i++)
+        if (ctr->fd[i] >= 0) {
+            ioctl(ctr->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(ctr->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+#ifdef BENCH_HAVE_TSC
+    ctr->tsc1 = __rdtsc();
+#endif
+    clock_gettime(CLOCK_REALTIME, &ctr->t1);
+}
+
+/* Stops counting and stores the values divided by num_calls */
+void bench_counters_stop(BenchCounters *ctr, uint32_t num_calls, double *values) {
+    struct timespec t2;
+    clock_gettime(CLOCK_REALTIME, &t2);
+#ifdef BENCH_HAVE_TSC
+    values[COUNTER_TSC] = (double)(__rdtsc()-ctr->tsc1) / num_calls;
+#else
+    values[COUNTER_TSC] = 0;
+#endif
+    values[COUNTER_NS] = bench_elapsed_ns(&ctr->t1, &t2) / num_calls;
+
+    uint8_t i;
+    for (i=0; i<NUM_COUNTERS; i++) {
+        values[i] = 0;
+#ifdef __linux__
+        uint64_t buf[3];   /* value, time enabled, time running */
+        if (ctr->fd[i]>=0 && ioctl(ctr->fd[i], PERF_EVENT_IOC_DISABLE, 0)==0 && read(ctr->fd[i], buf, sizeof buf)==sizeof buf && buf[2]>0)
+            values[i] = (double)buf[0] * buf[1] / buf[2] / num_calls;   /* scale if the counter was multiplexed */
+#endif
+    }
+}
+
+/* Measures a case in NUM_BATCHES_COUNTERS batches and stores the median per call */
+void bench_counters_case(BenchCounters *ctr, BenchFunc func, BenchState *st, double *values) {
+    struct timespec t1, t2;
+    uint32_t i, j;
+
+    clock_gettime(CLOCK_REALTIME, &t1);
+    for (i=0; i<NUM_WARMUP_CMP; i++)
+        func(st);
+    clock_gettime(CLOCK_REALTIME, &t2);
+    double ns_per_call = bench_elapsed_ns(&t1, &t2) / NUM_WARMUP_CMP;
+    uint32_t num_calls = ns_per_call>=MIN_BATCH_NS_COUNTERS ? 1 : MIN_BATCH_NS_COUNTERS/(ns_per_call+1) + 1;
+
+    double batches[COUNTER_NS+1][NUM_BATCHES_COUNTERS];
+    for (i=0; i<NUM_BATCHES_COUNTERS; i++) {
+        double batch[COUNTER_NS+1];
+        bench_counters_start(ctr);
+        for (j=0; j<num_calls; j++)
+            func(st);
+        bench_counters_stop(ctr, num_calls, batch);
+        for (j=0; j<=COUNTER_NS; j++)
+            batches[j][i] = batch[j];
+    }
+    for (j=0; j<=COUNTER_NS; j++)
+        values[j] = median(batches[j], NUM_BATCHES_COUNTERS);
+}
+
+int bench_counters() {
+    BenchCounters ctr;
+    bench_counters_open(&ctr);
+    if (ctr.num_open == 0)
+        printf("Hardware counters are not available (no PMU, or see /proc/sys/kernel/perf_event_paranoid).\n");
+    printf("Values per call, median of %d batches\n", NUM_BATCHES_COUNTERS);
+    bench_pin_cpu();
+
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    BenchState *st = malloc(sizeof *st);
+    if (st == NULL)
+        return 1;
+    st->success = 1;
+
+    uint8_t param_idx;
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams *params = &param_arr[param_idx];
+        bench_setup(st, params);
+
+        printf("\n%-26s", params->name);
+        uint32_t i, j;
+        for (i=0; i<NUM_COUNTERS; i++)
+            if (ctr.fd[i] >= 0)
+                printf(" %13s", counter_names[i]);
+#ifdef BENCH_HAVE_TSC
+        printf(" %13s", "tsc");
+#endif
+        printf(" %13s\n", "ns");
+
+        for (j=0; j<NUM_BENCH_CASES; j++) {
+            BenchCase *bc = &bench_cases[j];
+            if ((bc->applies_to==BENCH_TERN && params->prod_flag) || (bc->applies_to==BENCH_PROD && !params->prod_flag))
+                continue;
+            double values[COUNTER_NS+1];
+            bench_counters_case(&ctr, bc->func, st, values);
+            printf("  %-24s", bc->name);
+            for (i=0; i<NUM_COUNTERS; i++)
+                if (ctr.fd[i] >= 0)
+                    printf(" %13.1f", values[i]);
+#ifdef BENCH_HAVE_TSC
+            printf(" %13.1f", values[COUNTER_TSC]);
+#endif
+            printf(" %13.1f\n", values[COUNTER_NS]);
+        }
+        st->success &= ntru_rand_release(&st->rand_ctx) == NTRU_SUCCESS;
+    }
+
+    bench_counters_close(&ctr);
+    uint8_t success = st->success;
+    free(st);
+    if (!success)
+        printf("Error!\n");
+    return success ? 0 : 1;
+}
+
+/*
+ * "bench kernels" runs every kernel compiled into libntru that the CPU
+ * supports (see kernels.h) on the same random operands for each parameter
+ * set. It checks that all implementations of a primitive produce identical
+ * output, and times each one in isolation. Times are per coefficient, in
+ * core cycles if the cycle counter is available, otherwise in TSC ticks or
+ * nanoseconds.
+ */
+void bench_kernel_args(NtruEncParams *params, NtruKernelArgs *args, NtruRandContext *rand_ctx, uint8_t *success) {
+    uint16_t N = params->N;
+    memset(args, 0, sizeof *args);
+    args->q = params->q;
+    args->a.N = args->b.N = args->c.N = N;
+    *success &= ntru_rand_generate((uint8_t*)args->a.coeffs, N*sizeof args->a.coeffs[0], rand_ctx) == NTRU_SUCCESS;
+    *success &= ntru_rand_generate((uint8_t*)args->b.coeffs, N*sizeof args->b.coeffs[0], rand_ctx) == NTRU_SUCCESS;
+    uint16_t i;
+    for (i=0; i<N; i++) {
+        args->a.coeffs[i] &= params->q - 1;
+        args->b.coeffs[i] &= params->q - 1;
+    }
+    *success &= ntru_rand_tern(N, params->df1, params->df1, &args->tern, rand_ctx);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (params->prod_flag)
+        *success &= ntru_rand_prod(N, params->df1, params->df2, params->df3, params->df3, &args->prod, rand_ctx);
+#endif
+}
+
+/* Sets the operands of a kernel, including those of in-place kernels */
+void bench_kernel_reset(const NtruKernel *k, NtruKernelArgs *src, NtruKernelArgs *args) {
+    memcpy(args, src, sizeof *args);
+    ntru_kernel_prepare(k, args);
+}
+
+/* Returns 1 if two kernels for the same primitive produced identical output */
+uint8_t bench_kernel_equal(const NtruKernel *k, NtruKernelArgs *args1, NtruKernelArgs *args2, NtruEncParams *params) {
+    if (k->primitive == NTRU_KERNEL_TO_ARR)
+        return memcmp(args1->arr, args2->arr, ntru_enc_len(params)) == 0;
+    if (k->primitive == NTRU_KERNEL_TERN_PACK)
+        return memcmp(args1->packed.ones, args2->packed.ones, sizeof args1->packed.ones)==0 &&
+                memcmp(args1->packed.neg_ones, args2->packed.neg_ones, sizeof args1->packed.neg_ones)==0;
+    uint8_t equal = memcmp(args1->c.coeffs, args2->c.coeffs, args1->c.N*sizeof args1->c.coeffs[0]) == 0;
+    if (k->primitive==NTRU_KERNEL_ENCRYPT_POST || k->primitive==NTRU_KERNEL_DECRYPT_POST)
+        equal &= memcmp(args1->r.coeffs, args2->r.coeffs, args1->c.N*sizeof args1->r.coeffs[0])==0 &&
+                memcmp(args1->weights, args2->weights, sizeof args1->weights)==0;
+    return equal;
+}
+
+/* Times a kernel in NUM_BATCHES_COUNTERS batches; returns the median value of the counter at idx per call */
+double bench_kernel_time(BenchCounters *ctr, const NtruKernel *k, NtruKernelArgs *args, uint8_t idx) {
+    struct timespec t1, t2;
+    uint32_t i, j;
+
+    clock_gettime(CLOCK_REALTIME, &t1);
+    for (i=0; i<NUM_WARMUP_CMP; i++)
+        ntru_kernel_run(k, args);
+    clock_gettime(CLOCK_REALTIME, &t2);
+    double ns_per_call = bench_elapsed_ns(&t1, &t2) / NUM_WARMUP_CMP;
+    uint32_t num_calls = ns_per_call>=MIN_BATCH_NS_COUNTERS ? 1 : MIN_BATCH_NS_COUNTERS/(ns_per_call+1) + 1;
+
+    double batches[NUM_BATCHES_COUNTERS];
+    for (i=0; i<NUM_BATCHES_COUNTERS; i++) {
+        double batch[COUNTER_NS+1];
+        bench_counters_start(ctr);
+        for (j=0; j<num_calls; j++)
+            ntru_kernel_run(k, args);
+        bench_counters_stop(ctr, num_calls, batch);
+        batches[i] = batch[idx];
+    }
+    return median(batches, NUM_BATCHES_COUNTERS);
+}
+
+int bench_kernels() {
+    ntru_set_optimized_impl();   /* some kernels call ntru_mod_mask() */
+    BenchCounters ctr;
+    bench_counters_open(&ctr);
+    uint8_t i;
+    for (i=0; i<NUM_COUNTERS; i++)   /* only the cycle counter is needed */
+        if (i!=1 && ctr.fd[i]>=0) {
+#ifdef __linux__
+            close(ctr.fd[i]);
+#endif
+            ctr.fd[i] = -1;
+        }
+    uint8_t idx = COUNTER_NS;
+    char *unit = "ns";
+#ifdef BENCH_HAVE_TSC
+    idx = COUNTER_TSC;
+    unit = "TSC ticks";
+#endif
+    if (ctr.fd[1] >= 0) {
+        idx = 1;
+        unit = "cycles";
+    }
+    printf("%s per coefficient, median of %d batches\n", unit, NUM_BATCHES_COUNTERS);
+    bench_pin_cpu();
+
+    NtruKernelArgs *src = malloc(sizeof *src);
+    NtruKernelArgs *ref = malloc(sizeof *ref);
+    NtruKernelArgs *args = malloc(sizeof *args);
+    uint8_t success = src!=NULL && ref!=NULL && args!=NULL;
+    uint32_t num_mismatches = 0;
+
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t param_idx;
+    for (param_idx=0; success && param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams *params = &param_arr[param_idx];
+        uint8_t seed[] = "libntru bench-kernels";
+        NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init_det(&rand_ctx, &rng, seed, sizeof seed) == NTRU_SUCCESS;
+        bench_kernel_args(params, src, &rand_ctx, &success);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+        printf("\n%s (N=%d)\n", params->name, params->N);
+
+        const NtruKernel *ref_kernel = NULL;
+        uint16_t j;
+        for (j=0; j<ntru_kernel_count(); j++) {
+            const NtruKernel *k = ntru_kernel_get(j);
+            if (!ntru_kernel_applies(k, params->N, params->q))
+                continue;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+            if (k->primitive==NTRU_KERNEL_MULT_PROD && !params->prod_flag)
+                continue;
+#endif
+            bench_kernel_reset(k, src, args);
+            success &= ntru_kernel_run(k, args);
+            uint8_t same = 1;
+            if (ref_kernel==NULL || ref_kernel->primitive!=k->primitive) {
+                ref_kernel = k;
+                memcpy(ref, args, sizeof *ref);
+            }
+            else
+                same = bench_kernel_equal(k, ref, args, params);
+            num_mismatches += !same;
+
+            bench_kernel_reset(k, src, args);
+            double t = bench_kernel_time(&ctr, k, args, idx);
+            printf("  %-30s %9.2f%s\n", k->name, t/params->N, same ? "" : "   MISMATCH");
+        }
+    }
+
+    bench_counters_close(&ctr);
+    free(src);
+    free(ref);
+    free(args);
+    if (num_mismatches > 0)
+        printf("\n%d kernel(s) disagree with the generic implementation\n", num_mismatches);
+    if (!success)
+        printf("Error!\n");
+    return success && num_mismatches==0 ? 0 : 1;
+}
+
+#define NUM_ITER_KEYGEN_LATENCY 500
+
+/*
+ * "bench keygen" compares the latency of ntru_gen_key_pair() with that of
+ * ntru_gen_key_pair_par() for 2 to NTRU_KEYGEN_MAX_THREADS threads. The
+ * median and the 99th percentile are shown in microseconds.
+ */
+int bench_keygen_latency() {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t success = 1;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    double *samples = malloc(NUM_ITER_KEYGEN_LATENCY * sizeof samples[0]);
+
+    printf("%-10s %8s %10s %10s\n", "", "threads", "median", "p99");
+    uint8_t param_idx;
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams *params = &param_arr[param_idx];
+        uint8_t num_threads;
+        for (num_threads=1; num_threads<=NTRU_KEYGEN_MAX_THREADS; num_threads++) {
+            NtruEncKeyPair kp;
+            uint32_t i;
+            for (i=0; i<NUM_ITER_KEYGEN_LATENCY; i++) {
+                struct timespec t1, t2;
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                if (num_threads == 1)
+                    success &= ntru_gen_key_pair(params, &kp, &rand_ctx) == NTRU_SUCCESS;
+                else
+                    success &= ntru_gen_key_pair_par(params, &kp, &rand_ctx, num_threads) == NTRU_SUCCESS;
+                clock_gettime(CLOCK_MONOTONIC, &t2);
+                samples[i] = (1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec) / 1000.0;
+            }
+            double med = median(samples, NUM_ITER_KEYGEN_LATENCY);   /* sorts samples */
+            printf("%-10s %8d %10.1f %10.1f\n", num_threads==1 ? params->name : "", num_threads, med, samples[NUM_ITER_KEYGEN_LATENCY*99/100]);
+        }
+    }
+
+    free(samples);
+    success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    if (!success)
+        printf("Error!\n");
+    return success ? 0 : 1;
+}
+
+/*
+ * "bench tune [file]" autotunes the multiplication kernels for all parameter
+ * sets, prints the winner for each (primitive, N, df, q), and saves the table
+ * to file if one is given.
+ */
+int bench_tune(char *filename) {
+    static const char *primitives[] = {"mult_int", "mult_tern", "mult_prod"};
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t success = ntru_kernel_autotune(param_arr, sizeof(param_arr)/sizeof(param_arr[0])) == NTRU_SUCCESS;
+
+    printf("%-10s %5s %5s %6s %-24s %10s\n", "", "N", "df", "q", "kernel", "ns");
+    uint16_t i;
+    for (i=0; i<ntru_kernel_tuned_count(); i++) {
+        const NtruKernelChoice *c = ntru_kernel_tuned_get(i);
+        printf("%-10s %5d %5d %6d %-24s %10.0f\n", primitives[c->primitive], c->N, c->df, c->q, c->kernel->name, c->ns);
+    }
+    if (filename != NULL)
+        success &= ntru_kernel_tuned_save(filename) == NTRU_SUCCESS;
+
+    if (!success)
+        printf("Error!\n");
+    return success ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc>=3 && strcmp(argv[1], "record")==0)
+        return bench_record(argv[2]);
+    if (argc>=3 && strcmp(argv[1], "compare")==0)
+        return bench_compare(argv[2], argc>=4 ? atof(argv[3]) : THRESHOLD_DEFAULT);
+    if (argc>=2 && strcmp(argv[1], "counters")==0)
+        return bench_counters();
+    if (argc>=2 && strcmp(argv[1], "kernels")==0)
+        return bench_kernels();
+    if (argc>=2 && strcmp(argv[1], "keygen")==0)
+        return bench_keygen_latency();
+    if (argc>=2 && strcmp(argv[1], "tune")==0)
+        return bench_tune(argc>=3 ? argv[2] : NULL);
+
+    printf("Please wait...\n");
+
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t success = 1;
+
+    uint8_t param_idx;
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        double samples_keygen[NUM_ITER_KEYGEN];
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        for (i=0; i<NUM_ITER_KEYGEN; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_keygen[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("keygen", samples_keygen, NUM_ITER_KEYGEN);
+
+        double samples_encdec[NUM_ITER_ENCDEC];
+        uint16_t max_len = ntru_max_msg_len(&params);   /* max message length for this param set */
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(&params);
+        uint8_t encrypted[enc_len];
+        uint8_t decrypted[max_len];
+        for (i=0; i<NUM_ITER_ENCDEC; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_encrypt((uint8_t*)&plain, max_len, &kp.pub, &params, &rand_ctx, (uint8_t*)&encrypted) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("enc", samples_encdec, NUM_ITER_ENCDEC);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+        uint16_t dec_len;
+        for (i=0; i<NUM_ITER_ENCDEC; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_decrypt((uint8_t*)&encrypted, &kp, &params, (uint8_t*)&decrypted, &dec_len) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("dec", samples_encdec, NUM_ITER_ENCDEC);
+        printf("\n");
+    }
+
+    /* NTRU Prime has no encryption, so encaps and decaps are timed instead */
+    {
+        NtruPrimeParams params = NTRUPRIME_739;
+        NtruPrimeKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s  ", params.name);
+        fflush(stdout);
+
+        double samples_keygen[NUM_ITER_KEYGEN];
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        for (i=0; i<NUM_ITER_KEYGEN; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntruprime_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_keygen[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("keygen", samples_keygen, NUM_ITER_KEYGEN);
+
+        double samples_encdec[NUM_ITER_ENCDEC];
+        uint8_t ct[ntruprime_enc_len(&params)];
+        uint8_t ss[NTRU_KEM_SECRET_LEN];
+        for (i=0; i<NUM_ITER_ENCDEC; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntruprime_kem_encaps(&kp.pub, &params, &rand_ctx, ct, ss) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("encaps", samples_encdec, NUM_ITER_ENCDEC);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+        for (i=0; i<NUM_ITER_ENCDEC; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntruprime_kem_decaps(ct, &kp, &params, ss) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("decaps", samples_encdec, NUM_ITER_ENCDEC);
+        printf("\n");
+    }
+
+    printf("\nconstant-time mode:\n");
+    ntru_set_constant_time(1);
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+
+        double samples_encdec[NUM_ITER_MULT];
+        uint16_t max_len = ntru_max_msg_len(&params);
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(&params);
+        uint8_t encrypted[enc_len];
+        uint8_t decrypted[max_len];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_encrypt((uint8_t*)&plain, max_len, &kp.pub, &params, &rand_ctx, (uint8_t*)&encrypted) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("enc", samples_encdec, NUM_ITER_MULT);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+        uint16_t dec_len;
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_decrypt((uint8_t*)&encrypted, &kp, &params, (uint8_t*)&decrypted, &dec_len) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_encdec[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("dec", samples_encdec, NUM_ITER_MULT);
+        printf("\n");
+    }
+    ntru_set_constant_time(0);
+
+    printf("\npublic key store (bytes per key; time to unpack one key; encryption with a stored key):\n");
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        NtruPubStore store;
+        success &= ntru_pubstore_init(&store, &params, 1) == NTRU_SUCCESS;
+        uint32_t key_id;
+        success &= ntru_pubstore_add(&store, &kp.pub, &key_id) == NTRU_SUCCESS;
+        printf("%4d bytes (NtruEncPubKey: %d)   ", store.key_len, (int)sizeof(NtruEncPubKey));
+        fflush(stdout);
+
+        double samples_pub[NUM_ITER_MULT];
+        NtruEncPubKey pub;
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_pubstore_get(&store, key_id, &pub) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_pub[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("unpack", samples_pub, NUM_ITER_MULT);
+
+        uint16_t max_len = ntru_max_msg_len(&params);
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint8_t encrypted[ntru_enc_len(&params)];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_pubstore_encrypt((uint8_t*)&plain, max_len, &store, key_id, &params, &rand_ctx, (uint8_t*)&encrypted) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_pub[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("enc", samples_pub, NUM_ITER_MULT);
+        printf("\n");
+
+        ntru_pubstore_release(&store);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    printf("\nseed-based private keys (time to expand a seed into t; into t and h):\n");
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        uint8_t seed[NTRU_PRIV_SEED_LEN];
+        success &= ntru_gen_key_pair_seed(&params, &kp, seed, &rand_ctx) == NTRU_SUCCESS;
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+        double samples_seed[NUM_ITER_MULT];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_priv_from_seed(&params, seed, &kp.priv, NULL) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_seed[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("priv", samples_seed, NUM_ITER_MULT);
+
+        for (i=0; i<NUM_ITER_KEYGEN; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_priv_from_seed(&params, seed, &kp.priv, &kp.pub) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_seed[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("priv+pub", samples_seed, NUM_ITER_KEYGEN);
+        printf("\n");
+    }
+
+
+    printf("\nmulti-recipient encryption (time per recipient: ntru_encrypt loop; ntru_encrypt_multi):\n");
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        /* the recipients' keys only need to be valid, not distinct */
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        NtruEncPubKey pub[NUM_RECIPIENTS_MAX];
+        for (i=0; i<NUM_RECIPIENTS_MAX; i++)
+            pub[i] = kp.pub;
+        uint16_t max_len = ntru_max_msg_len(&params);
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(&params);
+        uint8_t *encrypted = malloc((size_t)NUM_RECIPIENTS_MAX * enc_len);
+        success &= encrypted != NULL;
+
+        uint32_t num_rcpt;
+        for (num_rcpt=1; num_rcpt<=NUM_RECIPIENTS_MAX && encrypted!=NULL; num_rcpt*=8) {
+            uint32_t num_iter = NUM_ITER_MULT / num_rcpt;
+            double samples_multi[NUM_ITER_MULT];
+            char label[32];
+            for (i=0; i<num_iter; i++) {
+                clock_gettime(CLOCK_REALTIME, &t1);
+                uint32_t j;
+                for (j=0; j<num_rcpt; j++)
+                    success &= ntru_encrypt(plain, max_len, &pub[j], &params, &rand_ctx, encrypted+(size_t)j*enc_len) == NTRU_SUCCESS;
+                clock_gettime(CLOCK_REALTIME, &t2);
+                double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+                samples_multi[i] = duration / 1000.0 / num_rcpt;   /* microseconds */
+            }
+            sprintf(label, "loop%d", num_rcpt);
+            print_time(label, samples_multi, num_iter);
+
+            for (i=0; i<num_iter; i++) {
+                clock_gettime(CLOCK_REALTIME, &t1);
+                success &= ntru_encrypt_multi(plain, max_len, pub, num_rcpt, &params, &rand_ctx, encrypted) == NTRU_SUCCESS;
+                clock_gettime(CLOCK_REALTIME, &t2);
+                double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+                samples_multi[i] = duration / 1000.0 / num_rcpt;   /* microseconds */
+            }
+            sprintf(label, "multi%d", num_rcpt);
+            print_time(label, samples_multi, num_iter);
+        }
+        printf("\n");
+
+        free(encrypted);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+
+    printf("\ntrial decryption with %d keys, matching key last (ntru_decrypt loop; ntru_decrypt_any):\n", NUM_KEYS_ROTATION);
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp[NUM_KEYS_ROTATION];
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        for (i=0; i<NUM_KEYS_ROTATION; i++)
+            success &= ntru_gen_key_pair(&params, &kp[i], &rand_ctx) == NTRU_SUCCESS;
+        uint16_t max_len = ntru_max_msg_len(&params);
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint8_t encrypted[ntru_enc_len(&params)];
+        success &= ntru_encrypt(plain, max_len, &kp[NUM_KEYS_ROTATION-1].pub, &params, &rand_ctx, encrypted) == NTRU_SUCCESS;
+        uint8_t decrypted[max_len];
+        uint16_t decrypted_len;
+
+        double samples_any[NUM_ITER_MULT];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            uint32_t k;
+            for (k=0; k<NUM_KEYS_ROTATION; k++)
+                if (ntru_decrypt(encrypted, &kp[k], &params, decrypted, &decrypted_len) == NTRU_SUCCESS)
+                    break;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            success &= k == NUM_KEYS_ROTATION-1;
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_any[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("loop", samples_any, NUM_ITER_MULT);
+
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            uint32_t key_idx;
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_decrypt_any(encrypted, kp, NUM_KEYS_ROTATION, &params, decrypted, &decrypted_len, &key_idx) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            success &= key_idx == NUM_KEYS_ROTATION-1;
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_any[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("any", samples_any, NUM_ITER_MULT);
+        printf("\n");
+
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    printf("\nKEM operations per second (single; batches of %d):\n", NUM_KEM_BATCH);
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_kem_keypair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(&params);
+        uint8_t ct[NUM_KEM_BATCH*enc_len];
+        uint8_t ss[NUM_KEM_BATCH*NTRU_KEM_SECRET_LEN];
+        uint8_t retcodes[NUM_KEM_BATCH];
+
+        double samples_kem[NUM_ITER_MULT];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_kem_encaps(&kp.pub, &params, &rand_ctx, ct, ss) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kem[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_rate("encaps", samples_kem, NUM_ITER_MULT);
+
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_kem_decaps(ct, &kp, &params, ss) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kem[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_rate("decaps", samples_kem, NUM_ITER_MULT);
+
+        for (i=0; i<NUM_ITER_MULT/NUM_KEM_BATCH; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_kem_encaps_batch(&kp.pub, &params, &rand_ctx, NUM_KEM_BATCH, ct, ss) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kem[i] = duration / 1000.0 / NUM_KEM_BATCH;   /* microseconds */
+        }
+        print_rate("encaps_batch", samples_kem, NUM_ITER_MULT/NUM_KEM_BATCH);
+
+        for (i=0; i<NUM_ITER_MULT/NUM_KEM_BATCH; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_kem_decaps_batch(ct, NUM_KEM_BATCH, &kp, &params, ss, retcodes) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kem[i] = duration / 1000.0 / NUM_KEM_BATCH;   /* microseconds */
+        }
+        print_rate("decaps_batch", samples_kem, NUM_ITER_MULT/NUM_KEM_BATCH);
+        printf("\n");
+
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    printf("\nkeyring file with %d keys:\n", NUM_KEYS_KEYRING);
+    {
+        NtruEncParams params = NTRU_DEFAULT_PARAMS_128_BITS;
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        /* the same key pair under different key IDs */
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        NtruKeyringEntry *entries = malloc(NUM_KEYS_KEYRING * sizeof entries[0]);
+        success &= entries != NULL;
+        for (i=0; i<NUM_KEYS_KEYRING && entries!=NULL; i++) {
+            entries[i].key_id = i;
+            entries[i].params = &params;
+            entries[i].pub = &kp.pub;
+            entries[i].priv = &kp.priv;
+        }
+        char filename[] = "bench_keyring.tmp";
+        success &= entries!=NULL && ntru_keyring_write(filename, entries, NUM_KEYS_KEYRING)==NTRU_SUCCESS;
+        free(entries);
+
+        NtruKeyring kr;
+        clock_gettime(CLOCK_REALTIME, &t1);
+        success &= ntru_keyring_open(filename, &kr) == NTRU_SUCCESS;
+        clock_gettime(CLOCK_REALTIME, &t2);
+        double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+        double samples_kr[NUM_ITER_MULT];
+        samples_kr[0] = duration / 1000.0;   /* microseconds */
+        print_time("open", samples_kr, 1);
+
+        /* lookups are too fast to time individually */
+        NtruKeyView view;
+        clock_gettime(CLOCK_REALTIME, &t1);
+        for (i=0; i<NUM_ITER_ENCDEC; i++)
+            success &= ntru_keyring_find(&kr, (i*7919)%NUM_KEYS_KEYRING, &view) == NTRU_SUCCESS;
+        clock_gettime(CLOCK_REALTIME, &t2);
+        duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+        printf("find %dns   ", (uint32_t)(duration/NUM_ITER_ENCDEC));
+
+        uint16_t max_len = ntru_max_msg_len(&params);
+        uint8_t plain[max_len];
+        success &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint8_t encrypted[ntru_enc_len(&params)];
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_keyring_encrypt((uint8_t*)&plain, max_len, &view, &rand_ctx, (uint8_t*)&encrypted) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kr[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("enc", samples_kr, NUM_ITER_MULT);
+
+        uint8_t decrypted[max_len];
+        uint16_t decrypted_len;
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_keyring_decrypt((uint8_t*)&encrypted, &view, (uint8_t*)&decrypted, &decrypted_len) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_kr[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("dec", samples_kr, NUM_ITER_MULT);
+        printf("\n");
+
+        ntru_keyring_close(&kr);
+        remove(filename);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    printf("\nstreaming encryption of %dMB:\n", NUM_CHUNKS_STREAM*(NTRU_STREAM_CHUNK_LEN>>10)>>10);
+    {
+        NtruEncParams params = NTRU_DEFAULT_PARAMS_128_BITS;
+        NtruEncKeyPair kp;
+        uint32_t i;
+        struct timespec t1, t2;
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        uint8_t header[ntru_enc_len(&params)];
+
+        /* encrypted and decrypted in place, one chunk at a time */
+        uint32_t enc_chunk_len = NTRU_STREAM_CHUNK_LEN + NTRU_STREAM_TAG_LEN;
+        uint8_t *buf = malloc((size_t)NUM_CHUNKS_STREAM * enc_chunk_len);
+        success &= buf != NULL;
+        double gb = (double)NUM_CHUNKS_STREAM * NTRU_STREAM_CHUNK_LEN / 1000000000.0;
+        NtruStreamCtx ctx;
+        if (buf != NULL) {
+            memset(buf, 0x55, (size_t)NUM_CHUNKS_STREAM * enc_chunk_len);
+            success &= ntru_stream_encrypt_init(&ctx, &kp.pub, &params, &rand_ctx, header) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t1);
+            for (i=0; i<NUM_CHUNKS_STREAM-1; i++) {
+                uint8_t *chunk = buf + (size_t)i*enc_chunk_len;
+                success &= ntru_stream_encrypt_update(&ctx, chunk, chunk) == NTRU_SUCCESS;
+            }
+            success &= ntru_stream_encrypt_final(&ctx, buf+(size_t)i*enc_chunk_len, NTRU_STREAM_CHUNK_LEN, buf+(size_t)i*enc_chunk_len) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = (t2.tv_sec-t1.tv_sec) + (t2.tv_nsec-t1.tv_nsec)/1000000000.0;   /* seconds */
+            printf("enc %.2fGB/s   ", gb/duration);
+
+            success &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t1);
+            for (i=0; i<NUM_CHUNKS_STREAM-1; i++) {
+                uint8_t *chunk = buf + (size_t)i*enc_chunk_len;
+                success &= ntru_stream_decrypt_update(&ctx, chunk, chunk) == NTRU_SUCCESS;
+            }
+            success &= ntru_stream_decrypt_final(&ctx, buf+(size_t)i*enc_chunk_len, enc_chunk_len, buf+(size_t)i*enc_chunk_len) == NTRU_SUCCESS;
+            clock_gettime(CLOCK_REALTIME, &t2);
+            duration = (t2.tv_sec-t1.tv_sec) + (t2.tv_nsec-t1.tv_nsec)/1000000000.0;   /* seconds */
+            printf("dec %.2fGB/s", gb/duration);
+            success &= buf[0]==0x55 && buf[(size_t)i*enc_chunk_len]==0x55;
+        }
+        printf("\n");
+
+        free(buf);
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+#ifdef __AVX2__
+    printf("\nntru_mult_int_avx2:\n");
+    for (param_idx=0; param_idx<sizeof(param_arr)/sizeof(param_arr[0]); param_idx++) {
+        NtruEncParams params = param_arr[param_idx];
+        printf("%-10s   ", params.name);
+        fflush(stdout);
+
+        NtruIntPoly a, b, c;
+        a.N = b.N = params.N;
+        NtruRandGen rng = NTRU_RNG_DEFAULT;
+        NtruRandContext rand_ctx;
+        success &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+        success &= ntru_rand_generate((uint8_t*)a.coeffs, params.N*sizeof a.coeffs[0], &rand_ctx) == NTRU_SUCCESS;
+        success &= ntru_rand_generate((uint8_t*)b.coeffs, params.N*sizeof b.coeffs[0], &rand_ctx) == NTRU_SUCCESS;
+        success &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+        double samples_mult[NUM_ITER_MULT];
+        uint32_t i;
+        struct timespec t1, t2;
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_mult_int_avx2_schoolbook(&a, &b, &c, params.q-1);
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_mult[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("schoolbook", samples_mult, NUM_ITER_MULT);
+
+        for (i=0; i<NUM_ITER_MULT; i++) {
+            clock_gettime(CLOCK_REALTIME, &t1);
+            success &= ntru_mult_int_avx2_toom4(&a, &b, &c, params.q-1);
+            clock_gettime(CLOCK_REALTIME, &t2);
+            double duration = 1000000000.0*(t2.tv_sec-t1.tv_sec) + t2.tv_nsec-t1.tv_nsec;   /* nanoseconds */
+            samples_mult[i] = duration / 1000.0;   /* microseconds */
+        }
+        print_time("toom4", samples_mult, NUM_ITER_MULT);
         printf("\n");
     }
+#endif   /* __AVX2__ */
 
     if (!success)
         printf("Error!\n");
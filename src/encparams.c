@@ -28,6 +28,11 @@ const NtruEncParams EES401EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     114            /* pklen */\
 };
@@ -51,6 +56,11 @@ const NtruEncParams EES449EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     128            /* pklen */\
 };
@@ -74,6 +84,11 @@ const NtruEncParams EES677EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     192            /* pklen */\
 };
@@ -97,6 +112,11 @@ const NtruEncParams EES1087EP2 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     256            /* pklen */\
 };
@@ -120,6 +140,11 @@ const NtruEncParams EES541EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     112            /* pklen */\
 };
@@ -143,6 +168,11 @@ const NtruEncParams EES613EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     128            /* pklen */\
 };
@@ -166,6 +196,11 @@ const NtruEncParams EES887EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     192            /* pklen */\
 };
@@ -189,6 +224,11 @@ const NtruEncParams EES1171EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     256            /* pklen */\
 };
@@ -212,6 +252,11 @@ const NtruEncParams EES659EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     112            /* pklen */\
 };
@@ -235,6 +280,11 @@ const NtruEncParams EES761EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     128            /* pklen */\
 };
@@ -258,6 +308,11 @@ const NtruEncParams EES1087EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     192            /* pklen */\
 };
@@ -281,6 +336,11 @@ const NtruEncParams EES1499EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     256            /* pklen */\
 };
@@ -306,6 +366,11 @@ const NtruEncParams EES401EP2 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     112            /* pklen */\
 };
@@ -329,6 +394,11 @@ const NtruEncParams EES439EP1 = {\
     ntru_sha1,     /* hash */\
     ntru_sha1_4way, /* hash_4way */\
     ntru_sha1_8way, /* hash_8way */\
+    ntru_sha1_midstate, /* hash_midstate */\
+    ntru_sha1_resume, /* hash_resume */\
+    ntru_sha1_resume_4way, /* hash_resume_4way */\
+    ntru_sha1_resume_8way, /* hash_resume_8way */\
+    ntru_sha1_jobs, /* hash_jobs */\
     20,            /* hlen */\
     128            /* pklen */\
 };
@@ -352,6 +422,11 @@ const NtruEncParams EES443EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     128            /* pklen */\
 };
@@ -375,6 +450,11 @@ const NtruEncParams EES593EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     192            /* pklen */\
 };
@@ -398,6 +478,11 @@ const NtruEncParams EES587EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     192            /* pklen */\
 };
@@ -421,6 +506,11 @@ const NtruEncParams EES743EP1 = {\
     ntru_sha256,   /* hash */\
     ntru_sha256_4way, /* hash_4way */\
     ntru_sha256_8way, /* hash_8way */\
+    ntru_sha256_midstate, /* hash_midstate */\
+    ntru_sha256_resume, /* hash_resume */\
+    ntru_sha256_resume_4way, /* hash_resume_4way */\
+    ntru_sha256_resume_8way, /* hash_resume_8way */\
+    ntru_sha256_jobs, /* hash_jobs */\
     32,            /* hlen */\
     256            /* pklen */\
 };
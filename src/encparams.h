@@ -111,6 +111,21 @@ typedef struct NtruEncParams {
     /* hash function for 8 inputs, e.g. ntru_sha256_8way */
     void (*hash_8way)(uint8_t *[8], uint16_t, uint8_t *[8]);
 
+    /* computes the midstate of a constant prefix, e.g. ntru_sha256_midstate */
+    void (*hash_midstate)(uint8_t[], uint16_t, NtruHashMidstate *);
+
+    /* hash function that continues from a midstate, e.g. ntru_sha256_resume */
+    void (*hash_resume)(NtruHashMidstate *, uint8_t[], uint16_t, uint8_t[]);
+
+    /* hash_resume for 4 inputs, e.g. ntru_sha256_resume_4way */
+    void (*hash_resume_4way)(NtruHashMidstate *, uint8_t *[4], uint16_t, uint8_t *[4]);
+
+    /* hash_resume for 8 inputs, e.g. ntru_sha256_resume_8way */
+    void (*hash_resume_8way)(NtruHashMidstate *, uint8_t *[8], uint16_t, uint8_t *[8]);
+
+    /* runs a batch of hash jobs, e.g. ntru_sha256_jobs */
+    void (*hash_jobs)(NtruHashJob *, uint8_t);
+
     /* output length of the hash function */
     uint16_t hlen;
 
@@ -13,5 +13,7 @@
 #define NTRU_ERR_UNKNOWN_PARAM_SET 9
 #define NTRU_ERR_INVALID_PARAM 10
 #define NTRU_ERR_INVALID_KEY 11
+#define NTRU_ERR_IO 12
+#define NTRU_ERR_QUEUE_FULL 13
 
 #endif   /* NTRU_ERR_H */
@@ -4,6 +4,7 @@
 #include "sph_sha2.h"
 #include "hash.h"
 #include "hash_simd.h"
+#include "profile.h"
 
 #ifdef NTRU_DETECT_SIMD
 uint32_t OPENSSL_ia32cap_P[] __attribute__((visibility("hidden"))) = {0, 0, 0, 0};
@@ -16,6 +17,12 @@ uint32_t OPENSSL_ia32cap_P[] __attribute__((visibility("hidden"))) = {0, 0, 0, 0
 #endif
 #endif   /* NTRU_DETECT_SIMD */
 
+/* number of compressions to hash len bytes from scratch */
+#define NTRU_HASH_NUM_BLOCKS(len) (((len)+1+8+63) / 64)
+
+/* number of compressions to finish a hash from a midstate */
+#define NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len) (((ms)->tail_len+(suffix_len)+1+8+63) / 64)
+
 void (*ntru_sha1_4way_ptr)(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]);
 
 void (*ntru_sha256_4way_ptr)(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]);
@@ -25,57 +32,318 @@ void (*ntru_sha1_8way_ptr)(uint8_t *input[4], uint16_t input_len, uint8_t *diges
 void (*ntru_sha256_8way_ptr)(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]);
 
 inline void ntru_sha1_4way(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]) {
+    NTRU_PROF_ADD(hash_blocks_4way, 4*NTRU_HASH_NUM_BLOCKS(input_len));
     ntru_sha1_4way_ptr(input, input_len, digest);
 }
 
 void ntru_sha256_4way(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]) {
+    NTRU_PROF_ADD(hash_blocks_4way, 4*NTRU_HASH_NUM_BLOCKS(input_len));
     ntru_sha256_4way_ptr(input, input_len, digest);
 }
 
 inline void ntru_sha1_8way(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]) {
+    NTRU_PROF_ADD(hash_blocks_8way, 8*NTRU_HASH_NUM_BLOCKS(input_len));
     ntru_sha1_8way_ptr(input, input_len, digest);
 }
 
 void ntru_sha256_8way(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]) {
+    NTRU_PROF_ADD(hash_blocks_8way, 8*NTRU_HASH_NUM_BLOCKS(input_len));
     ntru_sha256_8way_ptr(input, input_len, digest);
 }
 
-void ntru_sha1(uint8_t *input, uint16_t input_len, uint8_t *digest) {
+void (*ntru_sha1_resume_4way_ptr)(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void (*ntru_sha1_resume_8way_ptr)(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+void (*ntru_sha256_resume_4way_ptr)(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void (*ntru_sha256_resume_8way_ptr)(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+void (*ntru_sha1_jobs_ptr)(NtruHashJob *jobs, uint8_t num_jobs);
+
+void (*ntru_sha256_jobs_ptr)(NtruHashJob *jobs, uint8_t num_jobs);
+
+#ifdef NTRU_PROFILE
+/* counts the compressions of a batch; the MB kernels work on 4 or 8 lanes */
+void ntru_hash_count_jobs(NtruHashJob *jobs, uint8_t num_jobs) {
+    uint64_t num_blocks = 0;
+    uint8_t i;
+    for (i=0; i<num_jobs; i++)
+        num_blocks += NTRU_HASH_NUM_FINAL_BLOCKS(jobs[i].ms, jobs[i].suffix_len);
+    if (num_jobs > 4)
+        NTRU_PROF_ADD(hash_blocks_8way, num_blocks);
+    else
+        NTRU_PROF_ADD(hash_blocks_4way, num_blocks);
+}
+#endif   /* NTRU_PROFILE */
+
+void ntru_sha1_jobs(NtruHashJob *jobs, uint8_t num_jobs) {
+#ifdef NTRU_PROFILE
+    ntru_hash_count_jobs(jobs, num_jobs);
+#endif
+    ntru_sha1_jobs_ptr(jobs, num_jobs);
+}
+
+void ntru_sha256_jobs(NtruHashJob *jobs, uint8_t num_jobs) {
+#ifdef NTRU_PROFILE
+    ntru_hash_count_jobs(jobs, num_jobs);
+#endif
+    ntru_sha256_jobs_ptr(jobs, num_jobs);
+}
+
+void ntru_sha1_resume_4way(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    NTRU_PROF_ADD(hash_blocks_4way, 4*NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha1_resume_4way_ptr(ms, suffix, suffix_len, digest);
+}
+
+void ntru_sha1_resume_8way(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    NTRU_PROF_ADD(hash_blocks_8way, 8*NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha1_resume_8way_ptr(ms, suffix, suffix_len, digest);
+}
+
+void ntru_sha256_resume_4way(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    NTRU_PROF_ADD(hash_blocks_4way, 4*NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha256_resume_4way_ptr(ms, suffix, suffix_len, digest);
+}
+
+void ntru_sha256_resume_8way(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    NTRU_PROF_ADD(hash_blocks_8way, 8*NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha256_resume_8way_ptr(ms, suffix, suffix_len, digest);
+}
+
+/* the single-lane hashes without profile counting, for use by the multi-lane fallbacks */
+void ntru_sha1_sph(uint8_t *input, uint16_t input_len, uint8_t *digest) {
     sph_sha1_context context;
     sph_sha1_init(&context);
     sph_sha1(&context, input, input_len);
     sph_sha1_close(&context, digest);
 }
 
-void ntru_sha256(uint8_t *input, uint16_t input_len, uint8_t *digest) {
+void ntru_sha256_sph(uint8_t *input, uint16_t input_len, uint8_t *digest) {
     sph_sha256_context context;
     sph_sha256_init(&context);
     sph_sha256(&context, input, input_len);
     sph_sha256_close(&context, digest);
 }
 
+void ntru_sha1(uint8_t *input, uint16_t input_len, uint8_t *digest) {
+    NTRU_PROF_ADD(hash_blocks_1way, NTRU_HASH_NUM_BLOCKS(input_len));
+    ntru_sha1_sph(input, input_len, digest);
+}
+
+void ntru_sha256(uint8_t *input, uint16_t input_len, uint8_t *digest) {
+    NTRU_PROF_ADD(hash_blocks_1way, NTRU_HASH_NUM_BLOCKS(input_len));
+    ntru_sha256_sph(input, input_len, digest);
+}
+
+static const uint32_t NTRU_SHA1_IV[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t NTRU_SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* decodes a 64-byte block into 16 big-endian words */
+static void ntru_hash_dec_block(uint8_t *block, sph_u32 msg[16]) {
+    uint8_t i;
+    for (i=0; i<16; i++)
+        msg[i] = ((sph_u32)block[4*i]<<24) | ((sph_u32)block[4*i+1]<<16) |
+                 ((sph_u32)block[4*i+2]<<8) | block[4*i+3];
+}
+
+/* writes num_words chaining words to digest in big-endian order */
+static void ntru_hash_enc_val(sph_u32 *val, uint8_t num_words, uint8_t *digest) {
+    uint8_t i;
+    for (i=0; i<num_words; i++) {
+        digest[4*i] = val[i] >> 24;
+        digest[4*i+1] = val[i] >> 16;
+        digest[4*i+2] = val[i] >> 8;
+        digest[4*i+3] = val[i];
+    }
+}
+
+uint8_t ntru_hash_final_blocks(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *blocks) {
+    uint16_t len = ms->tail_len + suffix_len;
+    memcpy(blocks, ms->tail, ms->tail_len);
+    memcpy(blocks+ms->tail_len, suffix, suffix_len);
+    uint8_t num_blocks = (len+1+8+63) / 64;
+    memset(blocks+len, 0, num_blocks*64-len);
+    blocks[len] = 0x80;
+
+    uint64_t bit_len = (((uint64_t)ms->num_blocks)*64 + len) * 8;
+    uint8_t *end = blocks + num_blocks*64;
+    uint8_t i;
+    for (i=1; i<=8; i++) {
+        *(end-i) = bit_len;
+        bit_len >>= 8;
+    }
+    return num_blocks;
+}
+
+void ntru_sha1_midstate(uint8_t *prefix, uint16_t prefix_len, NtruHashMidstate *ms) {
+    NTRU_PROF_ADD(hash_blocks_1way, prefix_len/64);
+    sph_u32 val[5];
+    sph_u32 msg[16];
+    memcpy(val, NTRU_SHA1_IV, sizeof val);
+    ms->num_blocks = 0;
+    while (prefix_len >= 64) {
+        ntru_hash_dec_block(prefix, msg);
+        sph_sha1_comp(msg, val);
+        prefix += 64;
+        prefix_len -= 64;
+        ms->num_blocks++;
+    }
+    memset(ms->val, 0, sizeof ms->val);
+    memcpy(ms->val, val, sizeof val);
+    memcpy(ms->tail, prefix, prefix_len);
+    ms->tail_len = prefix_len;
+}
+
+void ntru_sha1_resume_sph(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest) {
+    uint8_t blocks[NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    uint8_t num_blocks = ntru_hash_final_blocks(ms, suffix, suffix_len, blocks);
+    sph_u32 val[5];
+    sph_u32 msg[16];
+    memcpy(val, ms->val, sizeof val);
+    uint8_t i;
+    for (i=0; i<num_blocks; i++) {
+        ntru_hash_dec_block(blocks+64*i, msg);
+        sph_sha1_comp(msg, val);
+    }
+    ntru_hash_enc_val(val, 5, digest);
+}
+
+void ntru_sha1_resume(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest) {
+    NTRU_PROF_ADD(hash_blocks_1way, NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha1_resume_sph(ms, suffix, suffix_len, digest);
+}
+
+void ntru_sha256_midstate(uint8_t *prefix, uint16_t prefix_len, NtruHashMidstate *ms) {
+    NTRU_PROF_ADD(hash_blocks_1way, prefix_len/64);
+    sph_u32 val[8];
+    sph_u32 msg[16];
+    memcpy(val, NTRU_SHA256_IV, sizeof val);
+    ms->num_blocks = 0;
+    while (prefix_len >= 64) {
+        ntru_hash_dec_block(prefix, msg);
+        sph_sha256_comp(msg, val);
+        prefix += 64;
+        prefix_len -= 64;
+        ms->num_blocks++;
+    }
+    memcpy(ms->val, val, sizeof val);
+    memcpy(ms->tail, prefix, prefix_len);
+    ms->tail_len = prefix_len;
+}
+
+void ntru_sha256_resume_sph(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest) {
+    uint8_t blocks[NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    uint8_t num_blocks = ntru_hash_final_blocks(ms, suffix, suffix_len, blocks);
+    sph_u32 val[8];
+    sph_u32 msg[16];
+    memcpy(val, ms->val, sizeof val);
+    uint8_t i;
+    for (i=0; i<num_blocks; i++) {
+        ntru_hash_dec_block(blocks+64*i, msg);
+        sph_sha256_comp(msg, val);
+    }
+    ntru_hash_enc_val(val, 8, digest);
+}
+
+void ntru_sha256_resume(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest) {
+    NTRU_PROF_ADD(hash_blocks_1way, NTRU_HASH_NUM_FINAL_BLOCKS(ms, suffix_len));
+    ntru_sha256_resume_sph(ms, suffix, suffix_len, digest);
+}
+
 void ntru_sha1_4way_nosimd(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]) {
     uint8_t i;
     for (i=0; i<4; i++)
-        ntru_sha1(input[i], input_len, digest[i]);
+        ntru_sha1_sph(input[i], input_len, digest[i]);
 }
 
 void ntru_sha1_8way_nosimd(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]) {
     uint8_t i;
     for (i=0; i<8; i++)
-        ntru_sha1(input[i], input_len, digest[i]);
+        ntru_sha1_sph(input[i], input_len, digest[i]);
 }
 
 void ntru_sha256_4way_nosimd(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]) {
     uint8_t i;
     for (i=0; i<4; i++)
-        ntru_sha256(input[i], input_len, digest[i]);
+        ntru_sha256_sph(input[i], input_len, digest[i]);
 }
 
 void ntru_sha256_8way_nosimd(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]) {
     uint8_t i;
     for (i=0; i<8; i++)
-        ntru_sha256(input[i], input_len, digest[i]);
+        ntru_sha256_sph(input[i], input_len, digest[i]);
+}
+
+void ntru_sha1_resume_4way_nosimd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    uint8_t i;
+    for (i=0; i<4; i++)
+        ntru_sha1_resume_sph(ms, suffix[i], suffix_len, digest[i]);
+}
+
+void ntru_sha1_resume_8way_nosimd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    uint8_t i;
+    for (i=0; i<8; i++)
+        ntru_sha1_resume_sph(ms, suffix[i], suffix_len, digest[i]);
+}
+
+void ntru_sha256_resume_4way_nosimd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    uint8_t i;
+    for (i=0; i<4; i++)
+        ntru_sha256_resume_sph(ms, suffix[i], suffix_len, digest[i]);
+}
+
+void ntru_sha256_resume_8way_nosimd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    uint8_t i;
+    for (i=0; i<8; i++)
+        ntru_sha256_resume_sph(ms, suffix[i], suffix_len, digest[i]);
+}
+
+void ntru_sha1_jobs_nosimd(NtruHashJob *jobs, uint8_t num_jobs) {
+    uint8_t i;
+    for (i=0; i<num_jobs; i++)
+        ntru_sha1_resume_sph(jobs[i].ms, jobs[i].suffix, jobs[i].suffix_len, jobs[i].digest);
+}
+
+void ntru_sha256_jobs_nosimd(NtruHashJob *jobs, uint8_t num_jobs) {
+    uint8_t i;
+    for (i=0; i<num_jobs; i++)
+        ntru_sha256_resume_sph(jobs[i].ms, jobs[i].suffix, jobs[i].suffix_len, jobs[i].digest);
+}
+
+void ntru_hash_sched_init(NtruHashSched *s, void (*hash_jobs)(NtruHashJob *, uint8_t)) {
+    s->hash_jobs = hash_jobs;
+    s->num_pending = 0;
+    s->num_jobs = 0;
+    s->num_batches = 0;
+    s->num_lanes = 0;
+}
+
+void ntru_hash_sched_flush(NtruHashSched *s) {
+    if (s->num_pending == 0)
+        return;
+    s->hash_jobs(s->jobs, s->num_pending);
+    s->num_jobs += s->num_pending;
+    s->num_batches++;
+    s->num_lanes += s->num_pending>4 ? 8 : 4;   /* the MB kernels work on 4 or 8 lanes */
+    s->num_pending = 0;
+}
+
+void ntru_hash_sched_submit(NtruHashSched *s, NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest) {
+    NtruHashJob *job = &s->jobs[s->num_pending];
+    job->ms = ms;
+    job->suffix = suffix;
+    job->suffix_len = suffix_len;
+    job->digest = digest;
+    s->num_pending++;
+    if (s->num_pending == NTRU_HASH_SCHED_LANES)
+        ntru_hash_sched_flush(s);
 }
 
 void ntru_set_optimized_impl_hash() {
@@ -85,6 +353,12 @@ void ntru_set_optimized_impl_hash() {
         ntru_sha256_4way_ptr = ntru_sha256_4way_simd;
         ntru_sha1_8way_ptr = ntru_sha1_8way_simd;
         ntru_sha256_8way_ptr = ntru_sha256_8way_simd;
+        ntru_sha1_resume_4way_ptr = ntru_sha1_resume_4way_simd;
+        ntru_sha1_resume_8way_ptr = ntru_sha1_resume_8way_simd;
+        ntru_sha256_resume_4way_ptr = ntru_sha256_resume_4way_simd;
+        ntru_sha256_resume_8way_ptr = ntru_sha256_resume_8way_simd;
+        ntru_sha1_jobs_ptr = ntru_sha1_jobs_simd;
+        ntru_sha256_jobs_ptr = ntru_sha256_jobs_simd;
         if (__builtin_cpu_supports("avx2")) {
             OPENSSL_ia32cap_P[1] = 1<<28;
             OPENSSL_ia32cap_P[2] = 1<<5;
@@ -95,6 +369,12 @@ void ntru_set_optimized_impl_hash() {
         ntru_sha256_4way_ptr = ntru_sha256_4way_nosimd;
         ntru_sha1_8way_ptr = ntru_sha1_8way_nosimd;
         ntru_sha256_8way_ptr = ntru_sha256_8way_nosimd;
+        ntru_sha1_resume_4way_ptr = ntru_sha1_resume_4way_nosimd;
+        ntru_sha1_resume_8way_ptr = ntru_sha1_resume_8way_nosimd;
+        ntru_sha256_resume_4way_ptr = ntru_sha256_resume_4way_nosimd;
+        ntru_sha256_resume_8way_ptr = ntru_sha256_resume_8way_nosimd;
+        ntru_sha1_jobs_ptr = ntru_sha1_jobs_nosimd;
+        ntru_sha256_jobs_ptr = ntru_sha256_jobs_nosimd;
     }
 #else
 #if defined __SSSE3__ || __AVX2__
@@ -102,6 +382,12 @@ void ntru_set_optimized_impl_hash() {
     ntru_sha256_4way_ptr = ntru_sha256_4way_simd;
     ntru_sha1_8way_ptr = ntru_sha1_8way_simd;
     ntru_sha256_8way_ptr = ntru_sha256_8way_simd;
+    ntru_sha1_resume_4way_ptr = ntru_sha1_resume_4way_simd;
+    ntru_sha1_resume_8way_ptr = ntru_sha1_resume_8way_simd;
+    ntru_sha256_resume_4way_ptr = ntru_sha256_resume_4way_simd;
+    ntru_sha256_resume_8way_ptr = ntru_sha256_resume_8way_simd;
+    ntru_sha1_jobs_ptr = ntru_sha1_jobs_simd;
+    ntru_sha256_jobs_ptr = ntru_sha256_jobs_simd;
 #ifdef __AVX2__
     OPENSSL_ia32cap_P[1] = 1<<28;
     OPENSSL_ia32cap_P[2] = 1<<5;
@@ -111,6 +397,12 @@ void ntru_set_optimized_impl_hash() {
     ntru_sha256_4way_ptr = ntru_sha256_4way_nosimd;
     ntru_sha1_8way_ptr = ntru_sha1_8way_nosimd;
     ntru_sha256_8way_ptr = ntru_sha256_8way_nosimd;
+    ntru_sha1_resume_4way_ptr = ntru_sha1_resume_4way_nosimd;
+    ntru_sha1_resume_8way_ptr = ntru_sha1_resume_8way_nosimd;
+    ntru_sha256_resume_4way_ptr = ntru_sha256_resume_4way_nosimd;
+    ntru_sha256_resume_8way_ptr = ntru_sha256_resume_8way_nosimd;
+    ntru_sha1_jobs_ptr = ntru_sha1_jobs_nosimd;
+    ntru_sha256_jobs_ptr = ntru_sha256_jobs_nosimd;
 #endif   /*  __SSSE3__ || __AVX2__ */
 #endif   /* NTRU_DETECT_SIMD */
 }
@@ -3,6 +3,48 @@
 
 #include <stdint.h>
 
+/* max number of blocks needed to finish a hash from a midstate */
+#define NTRU_HASH_MAX_FINAL_BLOCKS 3
+
+/* max suffix length accepted by ntru_sha*_resume*() */
+#define NTRU_HASH_MAX_SUFFIX_LEN 64
+
+/**
+ * State of SHA-1 or SHA-256 after absorbing a constant prefix.
+ * Only full 64-byte blocks of the prefix are compressed; the remaining
+ * bytes are kept in tail and hashed together with each suffix.
+ */
+typedef struct NtruHashMidstate {
+    uint32_t val[8];      /* chaining value; SHA-1 only uses val[0..4] */
+    uint32_t num_blocks;  /* number of prefix blocks compressed into val */
+    uint8_t tail[64];
+    uint8_t tail_len;
+} NtruHashMidstate;
+
+/* a request to hash prefix||suffix where ms holds the midstate of the prefix */
+typedef struct NtruHashJob {
+    NtruHashMidstate *ms;
+    uint8_t *suffix;
+    uint16_t suffix_len;
+    uint8_t *digest;
+} NtruHashJob;
+
+/* max number of jobs hashed in parallel */
+#define NTRU_HASH_SCHED_LANES 8
+
+/**
+ * Collects independent hash jobs and runs them in groups of
+ * NTRU_HASH_SCHED_LANES. Jobs may come from different prefixes.
+ */
+typedef struct NtruHashSched {
+    void (*hash_jobs)(NtruHashJob *, uint8_t);
+    NtruHashJob jobs[NTRU_HASH_SCHED_LANES];
+    uint8_t num_pending;
+    uint32_t num_jobs;      /* number of jobs hashed so far */
+    uint32_t num_batches;   /* number of multi-lane hash calls */
+    uint32_t num_lanes;     /* lanes available in those calls, used or not */
+} NtruHashSched;
+
 void ntru_sha1(uint8_t *input, uint16_t input_len, uint8_t *digest);
 
 void ntru_sha1_4way(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]);
@@ -15,6 +57,131 @@ void ntru_sha256_4way(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4])
 
 void ntru_sha256_8way(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]);
 
+/**
+ * @brief SHA-1 midstate
+ *
+ * Compresses all full blocks of a prefix so that several inputs of the form
+ * prefix||suffix can be hashed without recompressing the prefix.
+ *
+ * @param prefix
+ * @param prefix_len
+ * @param ms output parameter for the midstate
+ */
+void ntru_sha1_midstate(uint8_t *prefix, uint16_t prefix_len, NtruHashMidstate *ms);
+
+/**
+ * @brief SHA-1 from midstate
+ *
+ * Computes SHA-1(prefix||suffix) from a midstate returned by
+ * ntru_sha1_midstate().
+ *
+ * @param ms the midstate of the prefix
+ * @param suffix
+ * @param suffix_len at most NTRU_HASH_MAX_SUFFIX_LEN
+ * @param digest output parameter for the hash value
+ */
+void ntru_sha1_resume(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest);
+
+void ntru_sha1_resume_4way(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void ntru_sha1_resume_8way(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+/**
+ * @brief SHA-256 midstate
+ *
+ * Same as ntru_sha1_midstate() but for SHA-256.
+ *
+ * @param prefix
+ * @param prefix_len
+ * @param ms output parameter for the midstate
+ */
+void ntru_sha256_midstate(uint8_t *prefix, uint16_t prefix_len, NtruHashMidstate *ms);
+
+/**
+ * @brief SHA-256 from midstate
+ *
+ * Computes SHA-256(prefix||suffix) from a midstate returned by
+ * ntru_sha256_midstate().
+ *
+ * @param ms the midstate of the prefix
+ * @param suffix
+ * @param suffix_len at most NTRU_HASH_MAX_SUFFIX_LEN
+ * @param digest output parameter for the hash value
+ */
+void ntru_sha256_resume(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest);
+
+void ntru_sha256_resume_4way(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void ntru_sha256_resume_8way(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+/**
+ * @brief SHA-1 of up to 8 jobs
+ *
+ * Hashes num_jobs jobs, each with its own midstate, in one multi-lane call.
+ *
+ * @param jobs
+ * @param num_jobs at most NTRU_HASH_SCHED_LANES
+ */
+void ntru_sha1_jobs(NtruHashJob *jobs, uint8_t num_jobs);
+
+/**
+ * @brief SHA-256 of up to 8 jobs
+ *
+ * Hashes num_jobs jobs, each with its own midstate, in one multi-lane call.
+ *
+ * @param jobs
+ * @param num_jobs at most NTRU_HASH_SCHED_LANES
+ */
+void ntru_sha256_jobs(NtruHashJob *jobs, uint8_t num_jobs);
+
+/**
+ * @brief Hash scheduler initialization
+ *
+ * Initializes a scheduler with no pending jobs and zeroed counters.
+ *
+ * @param s
+ * @param hash_jobs the function that runs a batch, e.g. ntru_sha256_jobs
+ */
+void ntru_hash_sched_init(NtruHashSched *s, void (*hash_jobs)(NtruHashJob *, uint8_t));
+
+/**
+ * @brief Submit a hash job
+ *
+ * Queues the hash of prefix||suffix; the batch is run as soon as all lanes
+ * are taken. ms, suffix and digest must remain valid until the job has
+ * run, i.e. until the next ntru_hash_sched_flush() at the latest.
+ *
+ * @param s
+ * @param ms the midstate of the prefix
+ * @param suffix
+ * @param suffix_len at most NTRU_HASH_MAX_SUFFIX_LEN
+ * @param digest output parameter for the hash value
+ */
+void ntru_hash_sched_submit(NtruHashSched *s, NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *digest);
+
+/**
+ * @brief Run pending hash jobs
+ *
+ * Hashes all jobs that have not run yet.
+ *
+ * @param s
+ */
+void ntru_hash_sched_flush(NtruHashSched *s);
+
+/**
+ * @brief Final blocks after a midstate
+ *
+ * Writes tail||suffix plus SHA padding to blocks and returns the number
+ * of 64-byte blocks written. Used by the ntru_sha*_resume*() functions.
+ *
+ * @param ms the midstate of the prefix
+ * @param suffix
+ * @param suffix_len at most NTRU_HASH_MAX_SUFFIX_LEN
+ * @param blocks output buffer, NTRU_HASH_MAX_FINAL_BLOCKS*64 bytes
+ * @return the number of blocks
+ */
+uint8_t ntru_hash_final_blocks(NtruHashMidstate *ms, uint8_t *suffix, uint16_t suffix_len, uint8_t *blocks);
+
 /**
  * @brief Choose fastest implementation
  *
@@ -8,6 +8,7 @@
 #else
 #include <netinet/in.h>
 #endif
+#include "hash.h"
 #include "hash_simd.h"
 
 typedef struct {
@@ -511,3 +512,169 @@ void ntru_sha256_8way_simd(uint8_t *input[8], uint16_t input_len, uint8_t *diges
     SHA256_MB_Update8(&ctx, input, input_len);
     SHA256_MB_Final8(digest, &ctx);
 }
+
+/* sets all lanes of a multi-buffer SHA-1 context to a midstate */
+void SHA1_MB_Init_Midstate(SHA1_MB_CTX *ctx, NtruHashMidstate *ms) {
+    memset(ctx, 0, sizeof(*ctx));
+    uint8_t i;
+    for (i=0; i<8; i++) {
+        ctx->A[i] = ms->val[0];
+        ctx->B[i] = ms->val[1];
+        ctx->C[i] = ms->val[2];
+        ctx->D[i] = ms->val[3];
+        ctx->E[i] = ms->val[4];
+    }
+}
+
+/* sets all lanes of a multi-buffer SHA-256 context to a midstate */
+void SHA256_MB_Init_Midstate(SHA256_MB_CTX *ctx, NtruHashMidstate *ms) {
+    memset(ctx, 0, sizeof(*ctx));
+    uint8_t i;
+    for (i=0; i<8; i++) {
+        ctx->A[i] = ms->val[0];
+        ctx->B[i] = ms->val[1];
+        ctx->C[i] = ms->val[2];
+        ctx->D[i] = ms->val[3];
+        ctx->E[i] = ms->val[4];
+        ctx->F[i] = ms->val[5];
+        ctx->G[i] = ms->val[6];
+        ctx->H[i] = ms->val[7];
+    }
+}
+
+/* hashes the final blocks of 4 or 8 inputs sharing the prefix in ms */
+void ntru_sha1_resume_simd(NtruHashMidstate *ms, uint8_t *suffix[], uint16_t suffix_len, uint8_t *digest[], uint8_t num_lanes) {
+    uint8_t blocks[8][NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    HASH_DESC hdesc[8];
+    uint8_t i;
+    for (i=0; i<num_lanes; i++) {
+        hdesc[i].ptr = blocks[i];
+        hdesc[i].blocks = ntru_hash_final_blocks(ms, suffix[i], suffix_len, blocks[i]);
+    }
+
+    SHA1_MB_CTX ctx;
+    SHA1_MB_Init_Midstate(&ctx, ms);
+    sha1_multi_block(&ctx, hdesc, num_lanes/4);
+
+    for (i=0; i<num_lanes; i++) {
+        uint32_t *d32 = (uint32_t*)digest[i];
+        *(d32++) = ntohl(ctx.A[i]);
+        *(d32++) = ntohl(ctx.B[i]);
+        *(d32++) = ntohl(ctx.C[i]);
+        *(d32++) = ntohl(ctx.D[i]);
+        *d32 = ntohl(ctx.E[i]);
+    }
+}
+
+void ntru_sha1_resume_4way_simd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    ntru_sha1_resume_simd(ms, suffix, suffix_len, digest, 4);
+}
+
+void ntru_sha1_resume_8way_simd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    ntru_sha1_resume_simd(ms, suffix, suffix_len, digest, 8);
+}
+
+/* hashes the final blocks of 4 or 8 inputs sharing the prefix in ms */
+void ntru_sha256_resume_simd(NtruHashMidstate *ms, uint8_t *suffix[], uint16_t suffix_len, uint8_t *digest[], uint8_t num_lanes) {
+    uint8_t blocks[8][NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    HASH_DESC hdesc[8];
+    uint8_t i;
+    for (i=0; i<num_lanes; i++) {
+        hdesc[i].ptr = blocks[i];
+        hdesc[i].blocks = ntru_hash_final_blocks(ms, suffix[i], suffix_len, blocks[i]);
+    }
+
+    SHA256_MB_CTX ctx;
+    SHA256_MB_Init_Midstate(&ctx, ms);
+    sha256_multi_block(&ctx, hdesc, num_lanes/4);
+
+    for (i=0; i<num_lanes; i++) {
+        uint32_t *d32 = (uint32_t*)digest[i];
+        *(d32++) = ntohl(ctx.A[i]);
+        *(d32++) = ntohl(ctx.B[i]);
+        *(d32++) = ntohl(ctx.C[i]);
+        *(d32++) = ntohl(ctx.D[i]);
+        *(d32++) = ntohl(ctx.E[i]);
+        *(d32++) = ntohl(ctx.F[i]);
+        *(d32++) = ntohl(ctx.G[i]);
+        *d32 = ntohl(ctx.H[i]);
+    }
+}
+
+void ntru_sha256_resume_4way_simd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]) {
+    ntru_sha256_resume_simd(ms, suffix, suffix_len, digest, 4);
+}
+
+void ntru_sha256_resume_8way_simd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]) {
+    ntru_sha256_resume_simd(ms, suffix, suffix_len, digest, 8);
+}
+
+void ntru_sha1_jobs_simd(NtruHashJob *jobs, uint8_t num_jobs) {
+    uint8_t blocks[8][NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    HASH_DESC hdesc[8];
+    SHA1_MB_CTX ctx;
+    memset(&ctx, 0, sizeof ctx);
+    uint8_t i;
+    for (i=0; i<8; i++) {
+        hdesc[i].ptr = blocks[i];
+        hdesc[i].blocks = 0;
+    }
+    for (i=0; i<num_jobs; i++) {
+        NtruHashMidstate *ms = jobs[i].ms;
+        ctx.A[i] = ms->val[0];
+        ctx.B[i] = ms->val[1];
+        ctx.C[i] = ms->val[2];
+        ctx.D[i] = ms->val[3];
+        ctx.E[i] = ms->val[4];
+        hdesc[i].blocks = ntru_hash_final_blocks(ms, jobs[i].suffix, jobs[i].suffix_len, blocks[i]);
+    }
+
+    sha1_multi_block(&ctx, hdesc, num_jobs>4 ? 2 : 1);
+
+    for (i=0; i<num_jobs; i++) {
+        uint32_t *d32 = (uint32_t*)jobs[i].digest;
+        *(d32++) = ntohl(ctx.A[i]);
+        *(d32++) = ntohl(ctx.B[i]);
+        *(d32++) = ntohl(ctx.C[i]);
+        *(d32++) = ntohl(ctx.D[i]);
+        *d32 = ntohl(ctx.E[i]);
+    }
+}
+
+void ntru_sha256_jobs_simd(NtruHashJob *jobs, uint8_t num_jobs) {
+    uint8_t blocks[8][NTRU_HASH_MAX_FINAL_BLOCKS*64];
+    HASH_DESC hdesc[8];
+    SHA256_MB_CTX ctx;
+    memset(&ctx, 0, sizeof ctx);
+    uint8_t i;
+    for (i=0; i<8; i++) {
+        hdesc[i].ptr = blocks[i];
+        hdesc[i].blocks = 0;
+    }
+    for (i=0; i<num_jobs; i++) {
+        NtruHashMidstate *ms = jobs[i].ms;
+        ctx.A[i] = ms->val[0];
+        ctx.B[i] = ms->val[1];
+        ctx.C[i] = ms->val[2];
+        ctx.D[i] = ms->val[3];
+        ctx.E[i] = ms->val[4];
+        ctx.F[i] = ms->val[5];
+        ctx.G[i] = ms->val[6];
+        ctx.H[i] = ms->val[7];
+        hdesc[i].blocks = ntru_hash_final_blocks(ms, jobs[i].suffix, jobs[i].suffix_len, blocks[i]);
+    }
+
+    sha256_multi_block(&ctx, hdesc, num_jobs>4 ? 2 : 1);
+
+    for (i=0; i<num_jobs; i++) {
+        uint32_t *d32 = (uint32_t*)jobs[i].digest;
+        *(d32++) = ntohl(ctx.A[i]);
+        *(d32++) = ntohl(ctx.B[i]);
+        *(d32++) = ntohl(ctx.C[i]);
+        *(d32++) = ntohl(ctx.D[i]);
+        *(d32++) = ntohl(ctx.E[i]);
+        *(d32++) = ntohl(ctx.F[i]);
+        *(d32++) = ntohl(ctx.G[i]);
+        *d32 = ntohl(ctx.H[i]);
+    }
+}
@@ -2,6 +2,7 @@
 #define NTRU_HASH_SIMD_H
 
 #include <stdint.h>
+#include "hash.h"
 
 void ntru_sha1_4way_simd(uint8_t *input[4], uint16_t input_len, uint8_t *digest[4]);
 
@@ -11,4 +12,16 @@ void ntru_sha256_4way_simd(uint8_t *input[4], uint16_t input_len, uint8_t *diges
 
 void ntru_sha256_8way_simd(uint8_t *input[8], uint16_t input_len, uint8_t *digest[8]);
 
+void ntru_sha1_resume_4way_simd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void ntru_sha1_resume_8way_simd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+void ntru_sha256_resume_4way_simd(NtruHashMidstate *ms, uint8_t *suffix[4], uint16_t suffix_len, uint8_t *digest[4]);
+
+void ntru_sha256_resume_8way_simd(NtruHashMidstate *ms, uint8_t *suffix[8], uint16_t suffix_len, uint8_t *digest[8]);
+
+void ntru_sha1_jobs_simd(NtruHashJob *jobs, uint8_t num_jobs);
+
+void ntru_sha256_jobs_simd(NtruHashJob *jobs, uint8_t num_jobs);
+
 #endif   /* NTRU_HASH_SIMD_H */
@@ -2,103 +2,82 @@
 #include <string.h>
 #include "idxgen.h"
 #include "ntru_endian.h"
+#include "profile.h"
 
-void ntru_IGF_init(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s) {
-    s->Z = seed;
-    s->zlen = seed_len;
+/* hashes Z||counter for the next num_calls counter values and appends the results to out */
+void ntru_IGF_hash(NtruIGFState *s, uint16_t num_calls, NtruBitStr *out) {
+    uint8_t H[num_calls][NTRU_MAX_HASH_LEN];
+    uint16_t counter_endian[num_calls];
+    uint16_t j;
+    for (j=0; j<num_calls; j++) {
+        counter_endian[j] = htole16(s->counter);
+        ntru_hash_sched_submit(&s->sched, &s->Z_mid, (uint8_t*)&counter_endian[j], sizeof s->counter, H[j]);
+        s->counter++;
+    }
+    ntru_hash_sched_flush(&s->sched);
+    for (j=0; j<num_calls; j++)
+        ntru_append(out, H[j], s->hlen);
+}
+
+/* sets up s for a seed without running any hashes */
+void ntru_IGF_setup(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s) {
     s->N = params->N;
     s->c = params->c;
     s->rnd_thresh = (1<<s->c) - (1<<s->c)%s->N;
     s->hlen = params->hlen;
-    s->rem_len = params->min_calls_r * 8 * s->hlen;
-    s->hash = params->hash;
-    s->hash_4way = params->hash_4way;
-    s->hash_8way = params->hash_8way;
     s->counter = 0;
+    params->hash_midstate(seed, seed_len, &s->Z_mid);
+    ntru_hash_sched_init(&s->sched, params->hash_jobs);
 
     s->buf.num_bytes = 0;
     s->buf.last_byte_bits = 0;
 
-    while (s->counter < params->min_calls_r-7) {
-        uint8_t H_arr[8][NTRU_MAX_HASH_LEN];
-        uint16_t inp_len = s->zlen + sizeof s->counter;
+    s->rem_len = params->min_calls_r * 8 * s->hlen;
+}
 
-        uint8_t j;
-        uint8_t hash_inp_arr[8][inp_len];
-        uint8_t *hash_inp[8];
-        for (j=0; j<8; j++) {
-            memcpy(&hash_inp_arr[j], (uint8_t*)s->Z, s->zlen);
-            uint16_t counter_endian = htole16(s->counter);
-            memcpy((uint8_t*)&hash_inp_arr[j] + s->zlen, &counter_endian, sizeof s->counter);
-            hash_inp[j] = hash_inp_arr[j];
-            s->counter++;
-        }
-        uint8_t *H[8];
-        for (j=0; j<8; j++)
-            H[j] = H_arr[j];
-        s->hash_8way(hash_inp, inp_len, H);
-        for (j=0; j<8; j++)
-            ntru_append(&s->buf, H[j], s->hlen);
-    }
-    while (s->counter < params->min_calls_r-3) {
-        uint8_t H_arr[4][NTRU_MAX_HASH_LEN];
-        uint16_t inp_len = s->zlen + sizeof s->counter;
+void ntru_IGF_init(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s) {
+    NTRU_PROF_START(t);
+    ntru_IGF_setup(seed, seed_len, params, s);
+    ntru_IGF_hash(s, params->min_calls_r, &s->buf);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_IGF, t);
+}
 
-        uint8_t j;
-        uint8_t hash_inp_arr[4][inp_len];
-        uint8_t *hash_inp[4];
-        for (j=0; j<4; j++) {
-            memcpy(&hash_inp_arr[j], (uint8_t*)s->Z, s->zlen);
-            uint16_t counter_endian = htole16(s->counter);
-            memcpy((uint8_t*)&hash_inp_arr[j] + s->zlen, &counter_endian, sizeof s->counter);
-            hash_inp[j] = hash_inp_arr[j];
-            s->counter++;
+void ntru_IGF_init_multi(uint8_t **seeds, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s, uint8_t num) {
+    NTRU_PROF_START(t);
+    uint16_t min_calls_r = params->min_calls_r;
+    NtruHashSched sched;
+    ntru_hash_sched_init(&sched, params->hash_jobs);
+    uint8_t H[num][min_calls_r][NTRU_MAX_HASH_LEN];
+    uint16_t counter_endian[num][min_calls_r];
+    uint8_t j;
+    uint16_t k;
+    for (j=0; j<num; j++) {
+        ntru_IGF_setup(seeds[j], seed_len, params, &s[j]);
+        for (k=0; k<min_calls_r; k++) {
+            counter_endian[j][k] = htole16(s[j].counter);
+            ntru_hash_sched_submit(&sched, &s[j].Z_mid, (uint8_t*)&counter_endian[j][k], sizeof s[j].counter, H[j][k]);
+            s[j].counter++;
         }
-        uint8_t *H[4];
-        for (j=0; j<4; j++)
-            H[j] = H_arr[j];
-        s->hash_4way(hash_inp, inp_len, H);
-        for (j=0; j<4; j++)
-            ntru_append(&s->buf, H[j], s->hlen);
-    }
-    while (s->counter < params->min_calls_r) {
-        uint8_t H[NTRU_MAX_HASH_LEN];
-        uint16_t inp_len = s->zlen + sizeof s->counter;
-        uint8_t hash_inp[inp_len];
-        memcpy(&hash_inp, (uint8_t*)s->Z, s->zlen);
-        uint16_t counter_endian = htole16(s->counter);
-        memcpy((uint8_t*)&hash_inp + s->zlen, &counter_endian, sizeof s->counter);
-        s->hash((uint8_t*)&hash_inp, inp_len, (uint8_t*)&H);
-
-        ntru_append(&s->buf, (uint8_t*)&H, s->hlen);
-        s->counter++;
     }
+    ntru_hash_sched_flush(&sched);
+    for (j=0; j<num; j++)
+        for (k=0; k<min_calls_r; k++)
+            ntru_append(&s[j].buf, H[j][k], s[j].hlen);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_IGF, t);
 }
 
 void ntru_IGF_next(NtruIGFState *s, uint16_t *i) {
     uint16_t N = s-> N;
     uint16_t c = s-> c;
 
-    uint8_t H[NTRU_MAX_HASH_LEN];
-
     for (;;) {
         if (s->rem_len < c) {
             NtruBitStr M;
             ntru_trailing(&s->buf, s->rem_len, &M);
             uint16_t tmp_len = c - s->rem_len;
-            uint16_t c_thresh = s->counter + (tmp_len+s->hlen-1) / s->hlen;
-            while (s->counter < c_thresh) {
-                uint16_t inp_len = s->zlen + sizeof s->counter;
-                uint8_t hash_inp[inp_len];
-                memcpy(&hash_inp, (uint8_t*)s->Z, s->zlen);
-                uint16_t counter_endian = htole16(s->counter);
-                memcpy((uint8_t*)&hash_inp + s->zlen, &counter_endian, sizeof s->counter);
-                s->hash((uint8_t*)&hash_inp, inp_len, (uint8_t*)&H);
-
-                ntru_append(&M, (uint8_t*)&H, s->hlen);
-                s->counter++;
-                s->rem_len += 8 * s->hlen;
-            }
+            uint16_t num_calls = (tmp_len+s->hlen-1) / s->hlen;
+            ntru_IGF_hash(s, num_calls, &M);
+            s->rem_len += num_calls * 8 * s->hlen;
             s->buf = M;
         }
 
@@ -110,5 +89,6 @@ void ntru_IGF_next(NtruIGFState *s, uint16_t *i) {
                 *i -= N;
             return;
         }
+        NTRU_PROF_INC(igf_rejects);
     }
 }
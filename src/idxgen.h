@@ -9,14 +9,11 @@ typedef struct NtruIGFState {
     uint16_t N;
     uint16_t c;
     uint16_t rnd_thresh;   /* value below which random numbers are accepted */
-    uint8_t *Z;
-    uint16_t zlen;
+    NtruHashMidstate Z_mid;   /* hash state after absorbing the seed */
     uint16_t rem_len;
     NtruBitStr buf;
     uint16_t counter;
-    void (*hash)(uint8_t[], uint16_t, uint8_t[]);
-    void (*hash_4way)(uint8_t*[4], uint16_t, uint8_t*[4]);
-    void (*hash_8way)(uint8_t*[8], uint16_t, uint8_t*[8]);
+    NtruHashSched sched;
     uint16_t hlen;
 } NtruIGFState;
 
@@ -25,6 +22,8 @@ typedef struct NtruIGFState {
  *
  * Initializes the Index Generation Function.
  * Based on IGF-2 from IEEE P1363.1 section 8.4.2.1.
+ * The seed is compressed once; each hash call then only processes
+ * the final block(s) containing the counter.
  *
  * @param seed
  * @param seed_len
@@ -33,6 +32,20 @@ typedef struct NtruIGFState {
  */
 void ntru_IGF_init(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s);
 
+/**
+ * @brief IGF initialization for several seeds
+ *
+ * Same as calling ntru_IGF_init() for each seed, but the initial hashes
+ * of all seeds are run together so more SIMD lanes are used.
+ *
+ * @param seeds num seeds of the same length
+ * @param seed_len length of each seed
+ * @param params
+ * @param s output parameter; num states
+ * @param num
+ */
+void ntru_IGF_init_multi(uint8_t **seeds, uint16_t seed_len, const NtruEncParams *params, NtruIGFState *s, uint8_t num);
+
 /**
  * @brief IGF next index
  *
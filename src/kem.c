@@ -0,0 +1,217 @@
+#include <string.h>
+#include <stdint.h>
+#include "kem.h"
+#include "ntru.h"
+#include "hash.h"
+#include "encparams.h"
+#include "types.h"
+#include "poly.h"
+#include "err.h"
+
+/* #ciphertexts whose shared secrets are hashed together in the batch functions */
+#define NTRU_KEM_LANES 8
+
+/* Computes ss[i] = SHA-256(in[i]) for num inputs of the same length */
+static void ntru_kem_derive(uint8_t **in, uint16_t len, uint8_t **ss, uint8_t num) {
+    uint8_t i = 0;
+    if (num-i >= 8) {
+        ntru_sha256_8way(in+i, len, ss+i);
+        i += 8;
+    }
+    if (num-i >= 4) {
+        ntru_sha256_4way(in+i, len, ss+i);
+        i += 4;
+    }
+    for (; i<num; i++)
+        ntru_sha256(in[i], len, ss[i]);
+}
+
+uint8_t ntru_kem_keypair(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx) {
+    return ntru_gen_key_pair(params, kp, rand_ctx);
+}
+
+/* Encrypts an empty message into ct and leaves its blinding polynomial seed in sdata */
+static uint8_t ntru_kem_encaps_sdata(NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *ct, uint8_t *sdata) {
+    uint8_t no_msg = 0;
+    return ntru_encrypt_sdata(&no_msg, 0, pub, params, rand_ctx, ct, sdata);
+}
+
+/*
+ * Decrypts ct and leaves the blinding polynomial seed in sdata, which must
+ * accommodate ntru_sdata_len(params, ntru_max_msg_len(params)) bytes.
+ */
+static uint8_t ntru_kem_decaps_sdata(uint8_t *ct, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *sdata) {
+    uint8_t retcode = ntru_decrypt_precheck(ct, ntru_enc_len(params), kp, params, NULL);
+    if (retcode != NTRU_SUCCESS)
+        return retcode;
+    uint8_t m[ntru_max_msg_len(params)];
+    uint16_t m_len;
+    retcode = ntru_decrypt_sdata(ct, kp, params, m, &m_len, sdata);
+    if (retcode==NTRU_SUCCESS && m_len!=0)
+        retcode = NTRU_ERR_INVALID_ENCODING;
+    memset(m, 0, sizeof m);
+    return retcode;
+}
+
+uint8_t ntru_kem_encaps(NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *ct, uint8_t *ss) {
+    uint16_t sdata_len = ntru_sdata_len(params, 0);
+    uint8_t sdata[sdata_len];
+    uint8_t retcode = ntru_kem_encaps_sdata(pub, params, rand_ctx, ct, sdata);
+    if (retcode == NTRU_SUCCESS)
+        ntru_sha256(sdata, sdata_len, ss);
+    memset(sdata, 0, sdata_len);
+    return retcode;
+}
+
+uint8_t ntru_kem_decaps(uint8_t *ct, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *ss) {
+    uint16_t buf_len = ntru_sdata_len(params, ntru_max_msg_len(params));
+    uint8_t sdata[buf_len];
+    uint8_t retcode = ntru_kem_decaps_sdata(ct, kp, params, sdata);
+    if (retcode == NTRU_SUCCESS)
+        ntru_sha256(sdata, ntru_sdata_len(params, 0), ss);
+    memset(sdata, 0, buf_len);
+    return retcode;
+}
+
+uint8_t ntru_kem_encaps_batch(NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint32_t num, uint8_t *ct, uint8_t *ss) {
+    uint16_t enc_len = ntru_enc_len(params);
+    uint16_t sdata_len = ntru_sdata_len(params, 0);
+    uint8_t sdata[NTRU_KEM_LANES][sdata_len];
+    uint8_t *in[NTRU_KEM_LANES];
+    uint8_t *out[NTRU_KEM_LANES];
+
+    uint8_t retcode = NTRU_SUCCESS;
+    uint32_t i;
+    for (i=0; i<num && retcode==NTRU_SUCCESS; i+=NTRU_KEM_LANES) {
+        uint8_t lanes = num-i<NTRU_KEM_LANES ? num-i : NTRU_KEM_LANES;
+        uint8_t j;
+        for (j=0; j<lanes && retcode==NTRU_SUCCESS; j++) {
+            retcode = ntru_kem_encaps_sdata(pub, params, rand_ctx, ct+(size_t)(i+j)*enc_len, sdata[j]);
+            in[j] = sdata[j];
+            out[j] = ss + (size_t)(i+j)*NTRU_KEM_SECRET_LEN;
+        }
+        if (retcode == NTRU_SUCCESS)
+            ntru_kem_derive(in, sdata_len, out, lanes);
+    }
+
+    memset(sdata, 0, sizeof sdata);
+    return retcode;
+}
+
+uint8_t ntru_kem_decaps_batch(uint8_t *ct, uint32_t num, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *ss, uint8_t *retcodes) {
+    uint16_t enc_len = ntru_enc_len(params);
+    uint16_t sdata_len = ntru_sdata_len(params, 0);
+    uint16_t buf_len = ntru_sdata_len(params, ntru_max_msg_len(params));
+    uint8_t sdata[NTRU_KEM_LANES][buf_len];
+    uint8_t *in[NTRU_KEM_LANES];
+    uint8_t *out[NTRU_KEM_LANES];
+
+    uint8_t retcode = NTRU_SUCCESS;
+    uint32_t i;
+    for (i=0; i<num; i+=NTRU_KEM_LANES) {
+        uint8_t lanes = num-i<NTRU_KEM_LANES ? num-i : NTRU_KEM_LANES;
+        uint8_t num_valid = 0;   /* failed items are left out of the hash */
+        uint8_t j;
+        for (j=0; j<lanes; j++) {
+            uint8_t *ss_j = ss + (size_t)(i+j)*NTRU_KEM_SECRET_LEN;
+            retcodes[i+j] = ntru_kem_decaps_sdata(ct+(size_t)(i+j)*enc_len, kp, params, sdata[num_valid]);
+            if (retcodes[i+j] == NTRU_SUCCESS) {
+                in[num_valid] = sdata[num_valid];
+                out[num_valid] = ss_j;
+                num_valid++;
+            }
+            else {
+                memset(ss_j, 0, NTRU_KEM_SECRET_LEN);
+                if (retcode == NTRU_SUCCESS)
+                    retcode = retcodes[i+j];
+            }
+        }
+        ntru_kem_derive(in, sdata_len, out, num_valid);
+    }
+
+    memset(sdata, 0, sizeof sdata);
+    return retcode;
+}
+
+/***************************************
+ *          NTRU Prime                 *
+ ***************************************/
+
+uint16_t ntruprime_enc_len(const NtruPrimeParams *params) {
+    return NTRUPRIME_CONFIRM_LEN + (12*params->p+7)/8;
+}
+
+/* Computes the ciphertext and the shared secret for a given r */
+void ntruprime_kem_encaps_r(NtruIntPoly *h, NtruIntPoly *r, const NtruPrimeParams *params, uint8_t *ct, uint8_t *ss) {
+    NtruIntPoly hr;
+    ntruprime_mult_small(h, r, &hr, params->q);
+    ntruprime_round3_to_arr(&hr, params->q, ct+NTRUPRIME_CONFIRM_LEN);
+
+    /* a domain separation byte followed by r, 2 bits per coefficient */
+    uint16_t p = params->p;
+    uint8_t buf[1+(p+3)/4];
+    memset(buf, 0, sizeof buf);
+    uint16_t i;
+    for (i=0; i<p; i++)
+        buf[1+i/4] |= r->coeffs[i] << (2*(i%4));
+    buf[0] = 0;
+    ntru_sha256(buf, sizeof buf, ct);
+    buf[0] = 1;
+    ntru_sha256(buf, sizeof buf, ss);
+    memset(buf, 0, sizeof buf);
+}
+
+uint8_t ntruprime_kem_encaps(NtruPrimePubKey *pub, const NtruPrimeParams *params, NtruRandContext *rand_ctx, uint8_t *ct, uint8_t *ss) {
+    NtruIntPoly r;
+    if (!ntruprime_rand_tern_t(params->p, params->t, &r, rand_ctx))
+        return NTRU_ERR_PRNG;
+    ntruprime_kem_encaps_r(&pub->h, &r, params, ct, ss);
+    memset(&r.coeffs, 0, params->p * sizeof r.coeffs[0]);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntruprime_kem_decaps(uint8_t *ct, NtruPrimeKeyPair *kp, const NtruPrimeParams *params, uint8_t *ss) {
+    uint16_t p = params->p;
+    uint16_t q = params->q;
+    NtruIntPoly c;
+    uint8_t valid = ntruprime_from_arr_round3(ct+NTRUPRIME_CONFIRM_LEN, p, q, &c);
+
+    /*
+     * 3*f*c = g*r + 3*f*(c-h*r) mod q. The right side is small enough that
+     * its centered representative mod q equals it, so reducing that mod 3
+     * yields g*r mod 3.
+     */
+    NtruIntPoly e;
+    ntruprime_mult_small(&c, &kp->priv.f, &e, q);
+    ntruprime_mult_mod(&e, 3, q);
+    uint16_t i;
+    for (i=0; i<p; i++) {
+        uint32_t x = (uint16_t)e.coeffs[i];
+        x += 2*q & -(uint32_t)(x > (uint32_t)(q-1)/2);   /* x-q+3q if x is negative when centered */
+        e.coeffs[i] = x % 3;
+    }
+    NtruIntPoly r;
+    ntruprime_mult_small(&e, &kp->priv.g_inv_mod3, &r, 3);
+
+    uint16_t weight = 0;
+    for (i=0; i<p; i++)
+        weight += (r.coeffs[i]+1) >> 1;   /* 0 for 0, 1 for 1 and 2 */
+    valid &= weight == params->t;
+
+    /* encapsulate again and compare in constant time */
+    uint16_t enc_len = ntruprime_enc_len(params);
+    uint8_t ct2[enc_len];
+    uint8_t ss2[NTRU_KEM_SECRET_LEN];
+    ntruprime_kem_encaps_r(&kp->pub.h, &r, params, ct2, ss2);
+    uint8_t diff = 0;
+    for (i=0; i<enc_len; i++)
+        diff |= ct[i] ^ ct2[i];
+    valid &= diff == 0;
+
+    if (valid)
+        memcpy(ss, ss2, NTRU_KEM_SECRET_LEN);
+    memset(&e.coeffs, 0, p * sizeof e.coeffs[0]);
+    memset(&r.coeffs, 0, p * sizeof r.coeffs[0]);
+    memset(ss2, 0, sizeof ss2);
+    return valid ? NTRU_SUCCESS : NTRU_ERR_INVALID_ENCODING;
+}
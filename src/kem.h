@@ -0,0 +1,157 @@
+#ifndef NTRU_KEM_H
+#define NTRU_KEM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "encparams.h"
+#include "rand.h"
+
+/** length of a shared secret in bytes */
+#define NTRU_KEM_SECRET_LEN 32
+
+/**
+ * @brief KEM key generation
+ *
+ * Generates a key pair for ntru_kem_encaps() and ntru_kem_decaps(). Same as
+ * ntru_gen_key_pair().
+ *
+ * @param params the NtruEncrypt parameters to use
+ * @param kp pointer to write the key pair to (output parameter)
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @return NTRU_SUCCESS for success, or a NTRU_ERR_ code for failure
+ */
+uint8_t ntru_kem_keypair(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx);
+
+/**
+ * @brief KEM encapsulation
+ *
+ * Encrypts an empty message with SVES and derives the shared secret as
+ * SHA-256(sData), where sData = OID|b|htrunc is the blinding polynomial seed
+ * (see ntru_encrypt_sdata()). The secret comes from the random bits b that SVES
+ * generates anyway, and sData determines the ciphertext, so the secret is bound
+ * to it without hashing the ciphertext.
+ *
+ * @param pub the public key to encapsulate to
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param ct output parameter; a pointer to store the ciphertext. Must accommodate
+             ntru_enc_len(params) bytes.
+ * @param ss output parameter; a pointer to store the NTRU_KEM_SECRET_LEN-byte shared secret
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_kem_encaps(NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *ct, uint8_t *ss);
+
+/**
+ * @brief KEM decapsulation
+ *
+ * Decrypts a ciphertext produced by ntru_kem_encaps() and derives the shared
+ * secret from the recomputed sData. The ciphertext is checked with
+ * ntru_decrypt_precheck() first, and rejected if it carries a nonempty message.
+ *
+ * @param ct a ciphertext of ntru_enc_len(params) bytes
+ * @param kp a key pair that contains the public key ct was encapsulated to,
+             and the corresponding private key
+ * @param params the NtruEncrypt parameters to use
+ * @param ss output parameter; a pointer to store the NTRU_KEM_SECRET_LEN-byte shared secret
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_kem_decaps(uint8_t *ct, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *ss);
+
+/**
+ * @brief Batch KEM encapsulation
+ *
+ * Same as num calls to ntru_kem_encaps() but computes the shared secrets with
+ * multi-buffer SHA-256.
+ *
+ * @param pub the public key to encapsulate to
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param num the number of ciphertexts to generate
+ * @param ct output parameter; num*ntru_enc_len(params) bytes to store the ciphertexts
+ * @param ss output parameter; num*NTRU_KEM_SECRET_LEN bytes to store the shared secrets
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_kem_encaps_batch(NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint32_t num, uint8_t *ct, uint8_t *ss);
+
+/**
+ * @brief Batch KEM decapsulation
+ *
+ * Same as num calls to ntru_kem_decaps() but computes the shared secrets with
+ * multi-buffer SHA-256. Ciphertexts that fail to decapsulate don't affect the
+ * others; their shared secrets are set to zero.
+ *
+ * @param ct num*ntru_enc_len(params) bytes of ciphertexts
+ * @param num the number of ciphertexts
+ * @param kp a key pair that contains the public key the ciphertexts were
+             encapsulated to, and the corresponding private key
+ * @param params the NtruEncrypt parameters to use
+ * @param ss output parameter; num*NTRU_KEM_SECRET_LEN bytes to store the shared secrets
+ * @param retcodes output parameter; an array of num elements to store the result
+                   of each item
+ * @return NTRU_SUCCESS if all ciphertexts were decapsulated, otherwise the
+ *         result of the first item that failed
+ */
+uint8_t ntru_kem_decaps_batch(uint8_t *ct, uint32_t num, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *ss, uint8_t *retcodes);
+
+/***************************************
+ *          NTRU Prime                 *
+ ***************************************/
+
+/** length of the key confirmation hash at the start of an NTRU Prime ciphertext */
+#define NTRUPRIME_CONFIRM_LEN 32
+
+/**
+ * @brief NTRU Prime ciphertext length
+ *
+ * Returns the length of a ciphertext produced by ntruprime_kem_encaps():
+ * a NTRUPRIME_CONFIRM_LEN-byte hash followed by p coefficients of 12 bits.
+ *
+ * @param params the NTRU Prime parameters
+ * @return the ciphertext length in bytes
+ */
+uint16_t ntruprime_enc_len(const NtruPrimeParams *params);
+
+/**
+ * @brief NTRU Prime encapsulation
+ *
+ * Streamlined NTRU Prime encapsulation to a key generated with
+ * ntruprime_gen_key_pair(): picks a random polynomial r with t nonzero
+ * coefficients and sends h*r rounded to multiples of 3. The shared secret
+ * and the key confirmation hash are SHA-256 hashes of r. Runs in constant
+ * time.
+ *
+ * @param pub the public key to encapsulate to
+ * @param params the NTRU Prime parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param ct output parameter; a pointer to store the ciphertext. Must accommodate
+             ntruprime_enc_len(params) bytes.
+ * @param ss output parameter; a pointer to store the NTRU_KEM_SECRET_LEN-byte shared secret
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntruprime_kem_encaps(NtruPrimePubKey *pub, const NtruPrimeParams *params, NtruRandContext *rand_ctx, uint8_t *ct, uint8_t *ss);
+
+/**
+ * @brief NTRU Prime decapsulation
+ *
+ * Recovers r from a ciphertext produced by ntruprime_kem_encaps(), then
+ * encapsulates again with r and only returns the shared secret if the result
+ * equals the ciphertext. Runs in constant time.
+ *
+ * @param ct a ciphertext of ntruprime_enc_len(params) bytes
+ * @param kp the key pair ct was encapsulated to
+ * @param params the NTRU Prime parameters to use
+ * @param ss output parameter; a pointer to store the NTRU_KEM_SECRET_LEN-byte shared secret
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_ENCODING if the ciphertext
+ *         is invalid
+ */
+uint8_t ntruprime_kem_decaps(uint8_t *ct, NtruPrimeKeyPair *kp, const NtruPrimeParams *params, uint8_t *ss);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_KEM_H */
@@ -0,0 +1,652 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#elif defined __MACH__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+#include "kernels.h"
+#include "poly.h"
+#include "rand.h"
+#include "err.h"
+#if defined NTRU_DETECT_SIMD || defined __SSSE3__
+#include "poly_ssse3.h"
+#endif
+#if defined NTRU_DETECT_SIMD || defined __AVX2__
+#include "poly_avx2.h"
+#endif
+
+#if defined NTRU_DETECT_SIMD || defined __SSSE3__
+#define NTRU_KERNELS_SSSE3
+#endif
+#if defined NTRU_DETECT_SIMD || defined __AVX2__
+#define NTRU_KERNELS_AVX2
+#endif
+
+#ifdef NTRU_KERNELS_AVX2
+/* Adapts ntru_from_arr_avx2_2048() to the from_arr signature; registered for q=2048 only */
+static void ntru_from_arr_avx2_2048_kernel(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p) {
+    ntru_from_arr_avx2_2048(arr, N, p);
+}
+
+static uint8_t ntru_q2048_applies(uint16_t N, uint16_t q) {
+    return q == 2048;
+}
+
+static uint8_t ntru_toom4_applies(uint16_t N, uint16_t q) {
+    return ntru_mult_int_avx2_toom4_exact(N, q-1);
+}
+#endif
+
+static const NtruKernel ntru_kernels[] = {
+    {"mult_int_16", NTRU_KERNEL_MULT_INT, NTRU_KERNEL_ISA_GENERIC, {.mult_int=ntru_mult_int_16}, NULL},
+#ifndef __ARMEL__
+    {"mult_int_64", NTRU_KERNEL_MULT_INT, NTRU_KERNEL_ISA_GENERIC, {.mult_int=ntru_mult_int_64}, NULL},
+#endif
+#ifdef NTRU_KERNELS_SSSE3
+    {"mult_int_sse", NTRU_KERNEL_MULT_INT, NTRU_KERNEL_ISA_SSSE3, {.mult_int=ntru_mult_int_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"mult_int_avx2_schoolbook", NTRU_KERNEL_MULT_INT, NTRU_KERNEL_ISA_AVX2, {.mult_int=ntru_mult_int_avx2_schoolbook}, NULL},
+    {"mult_int_avx2_toom4", NTRU_KERNEL_MULT_INT, NTRU_KERNEL_ISA_AVX2, {.mult_int=ntru_mult_int_avx2_toom4}, ntru_toom4_applies},
+#endif
+
+    {"mult_tern_32", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_GENERIC, {.mult_tern=ntru_mult_tern_32}, NULL},
+#ifndef __ARMEL__
+    {"mult_tern_64", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_GENERIC, {.mult_tern=ntru_mult_tern_64}, NULL},
+#endif
+    {"mult_tern_ct", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_GENERIC, {.mult_tern=ntru_mult_tern_ct}, NULL},
+#ifdef NTRU_KERNELS_SSSE3
+    {"mult_tern_sse_sparse", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_SSSE3, {.mult_tern=ntru_mult_tern_sse_sparse}, NULL},
+    {"mult_tern_sse_dense", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_SSSE3, {.mult_tern=ntru_mult_tern_sse_dense}, NULL},
+    {"mult_tern_sse_ct", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_SSSE3, {.mult_tern=ntru_mult_tern_sse_ct}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"mult_tern_avx2_sparse", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_AVX2, {.mult_tern=ntru_mult_tern_avx2_sparse}, NULL},
+    {"mult_tern_avx2_dense", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_AVX2, {.mult_tern=ntru_mult_tern_avx2_dense}, NULL},
+    {"mult_tern_avx2_ct", NTRU_KERNEL_MULT_TERN, NTRU_KERNEL_ISA_AVX2, {.mult_tern=ntru_mult_tern_avx2_ct}, NULL},
+#endif
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    {"mult_prod_standard", NTRU_KERNEL_MULT_PROD, NTRU_KERNEL_ISA_GENERIC, {.mult_prod=ntru_mult_prod_standard}, NULL},
+    {"mult_prod_ct", NTRU_KERNEL_MULT_PROD, NTRU_KERNEL_ISA_GENERIC, {.mult_prod=ntru_mult_prod_ct}, NULL},
+#ifdef NTRU_KERNELS_SSSE3
+    {"mult_prod_sse", NTRU_KERNEL_MULT_PROD, NTRU_KERNEL_ISA_SSSE3, {.mult_prod=ntru_mult_prod_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"mult_prod_avx2", NTRU_KERNEL_MULT_PROD, NTRU_KERNEL_ISA_AVX2, {.mult_prod=ntru_mult_prod_avx2}, NULL},
+#endif
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+    {"to_arr_32", NTRU_KERNEL_TO_ARR, NTRU_KERNEL_ISA_GENERIC, {.to_arr=ntru_to_arr_32}, NULL},
+#ifndef __ARMEL__
+    {"to_arr_64", NTRU_KERNEL_TO_ARR, NTRU_KERNEL_ISA_GENERIC, {.to_arr=ntru_to_arr_64}, NULL},
+#endif
+#ifdef NTRU_KERNELS_SSSE3
+    {"to_arr_sse", NTRU_KERNEL_TO_ARR, NTRU_KERNEL_ISA_SSSE3, {.to_arr=ntru_to_arr_sse}, NULL},
+#endif
+
+    {"mod_32", NTRU_KERNEL_MOD_MASK, NTRU_KERNEL_ISA_GENERIC, {.mod_mask=ntru_mod_32}, NULL},
+#ifndef __ARMEL__
+    {"mod_64", NTRU_KERNEL_MOD_MASK, NTRU_KERNEL_ISA_GENERIC, {.mod_mask=ntru_mod_64}, NULL},
+#endif
+#ifdef NTRU_KERNELS_SSSE3
+    {"mod_sse", NTRU_KERNEL_MOD_MASK, NTRU_KERNEL_ISA_SSSE3, {.mod_mask=ntru_mod_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"mod_avx2", NTRU_KERNEL_MOD_MASK, NTRU_KERNEL_ISA_AVX2, {.mod_mask=ntru_mod_avx2}, NULL},
+#endif
+
+    {"mod3_standard", NTRU_KERNEL_MOD3, NTRU_KERNEL_ISA_GENERIC, {.mod3=ntru_mod3_standard}, NULL},
+#ifdef NTRU_KERNELS_SSSE3
+    {"mod3_sse", NTRU_KERNEL_MOD3, NTRU_KERNEL_ISA_SSSE3, {.mod3=ntru_mod3_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"mod3_avx2", NTRU_KERNEL_MOD3, NTRU_KERNEL_ISA_AVX2, {.mod3=ntru_mod3_avx2}, NULL},
+#endif
+
+    {"from_arr_standard", NTRU_KERNEL_FROM_ARR, NTRU_KERNEL_ISA_GENERIC, {.from_arr=ntru_from_arr_standard}, NULL},
+#ifdef NTRU_KERNELS_AVX2
+    {"from_arr_avx2_2048", NTRU_KERNEL_FROM_ARR, NTRU_KERNEL_ISA_AVX2, {.from_arr=ntru_from_arr_avx2_2048_kernel}, ntru_q2048_applies},
+#endif
+
+    {"tern_pack_standard", NTRU_KERNEL_TERN_PACK, NTRU_KERNEL_ISA_GENERIC, {.tern_pack=ntru_tern_pack_standard}, NULL},
+#ifdef NTRU_KERNELS_AVX2
+    {"tern_pack_avx2", NTRU_KERNEL_TERN_PACK, NTRU_KERNEL_ISA_AVX2, {.tern_pack=ntru_tern_pack_avx2}, NULL},
+#endif
+
+    {"tern_packed_to_int_standard", NTRU_KERNEL_TERN_PACKED_TO_INT, NTRU_KERNEL_ISA_GENERIC, {.tern_packed_to_int=ntru_tern_packed_to_int_standard}, NULL},
+#ifdef NTRU_KERNELS_AVX2
+    {"tern_packed_to_int_avx2", NTRU_KERNEL_TERN_PACKED_TO_INT, NTRU_KERNEL_ISA_AVX2, {.tern_packed_to_int=ntru_tern_packed_to_int_avx2}, NULL},
+#endif
+
+    {"encrypt_post_standard", NTRU_KERNEL_ENCRYPT_POST, NTRU_KERNEL_ISA_GENERIC, {.encrypt_post=ntru_encrypt_post_standard}, NULL},
+#ifdef NTRU_KERNELS_SSSE3
+    {"encrypt_post_sse", NTRU_KERNEL_ENCRYPT_POST, NTRU_KERNEL_ISA_SSSE3, {.encrypt_post=ntru_encrypt_post_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"encrypt_post_avx2", NTRU_KERNEL_ENCRYPT_POST, NTRU_KERNEL_ISA_AVX2, {.encrypt_post=ntru_encrypt_post_avx2}, NULL},
+#endif
+
+    {"decrypt_post_standard", NTRU_KERNEL_DECRYPT_POST, NTRU_KERNEL_ISA_GENERIC, {.decrypt_post=ntru_decrypt_post_standard}, NULL},
+#ifdef NTRU_KERNELS_SSSE3
+    {"decrypt_post_sse", NTRU_KERNEL_DECRYPT_POST, NTRU_KERNEL_ISA_SSSE3, {.decrypt_post=ntru_decrypt_post_sse}, NULL},
+#endif
+#ifdef NTRU_KERNELS_AVX2
+    {"decrypt_post_avx2", NTRU_KERNEL_DECRYPT_POST, NTRU_KERNEL_ISA_AVX2, {.decrypt_post=ntru_decrypt_post_avx2}, NULL},
+#endif
+
+    {"ntruprime_mult_small_standard", NTRU_KERNEL_NTRUPRIME_MULT_SMALL, NTRU_KERNEL_ISA_GENERIC, {.ntruprime_mult_small=ntruprime_mult_small_standard}, NULL},
+#ifdef NTRU_KERNELS_AVX2
+    {"ntruprime_mult_small_avx2", NTRU_KERNEL_NTRUPRIME_MULT_SMALL, NTRU_KERNEL_ISA_AVX2, {.ntruprime_mult_small=ntruprime_mult_small_avx2}, NULL},
+#endif
+};
+
+uint16_t ntru_kernel_count() {
+    return sizeof ntru_kernels / sizeof ntru_kernels[0];
+}
+
+const NtruKernel *ntru_kernel_get(uint16_t idx) {
+    return idx<ntru_kernel_count() ? &ntru_kernels[idx] : NULL;
+}
+
+uint8_t ntru_kernel_supported(const NtruKernel *k) {
+#ifdef NTRU_DETECT_SIMD
+    if (k->isa == NTRU_KERNEL_ISA_AVX2)
+        return __builtin_cpu_supports("avx2") != 0;
+    if (k->isa == NTRU_KERNEL_ISA_SSSE3)
+        return __builtin_cpu_supports("ssse3") != 0;
+#endif
+    return 1;
+}
+
+uint8_t ntru_kernel_applies(const NtruKernel *k, uint16_t N, uint16_t q) {
+    return ntru_kernel_supported(k) && (k->applies==NULL || k->applies(N, q));
+}
+
+void ntru_kernel_prepare(const NtruKernel *k, NtruKernelArgs *args) {
+    uint16_t N = args->a.N;
+    uint16_t i;
+    args->c.N = args->r.N = N;
+    memset(args->weights, 0, sizeof args->weights);
+    switch (k->primitive) {
+    case NTRU_KERNEL_MOD_MASK:
+        /* arbitrary 16-bit values */
+        for (i=0; i<N; i++)
+            args->c.coeffs[i] = args->a.coeffs[i]*31 + args->b.coeffs[i];
+        break;
+    case NTRU_KERNEL_MOD3:
+        /* centered values as produced by ntru_mod_center() */
+        for (i=0; i<N; i++)
+            args->c.coeffs[i] = args->a.coeffs[i] - args->q/2;
+        break;
+    case NTRU_KERNEL_FROM_ARR:
+        ntru_to_arr_32(&args->a, args->q, args->arr);
+        break;
+    case NTRU_KERNEL_TERN_PACKED_TO_INT:
+        ntru_tern_pack_standard(&args->tern, &args->packed);
+        break;
+    case NTRU_KERNEL_ENCRYPT_POST:
+        /* a message representative, a mask in the -1..2 range, and R */
+        for (i=0; i<N; i++) {
+            args->c.coeffs[i] = (uint16_t)args->a.coeffs[i] % 3;
+            args->b.coeffs[i] = ((uint16_t)args->b.coeffs[i]&3) - 1;
+        }
+        args->r = args->a;
+        break;
+    case NTRU_KERNEL_DECRYPT_POST:
+        /* a product reduced modulo q */
+        for (i=0; i<N; i++)
+            args->c.coeffs[i] = (args->a.coeffs[i]*31+args->b.coeffs[i]) & (args->q-1);
+        break;
+    case NTRU_KERNEL_NTRUPRIME_MULT_SMALL:
+        for (i=0; i<N; i++)
+            args->b.coeffs[i] = (uint16_t)args->b.coeffs[i] % 3;
+        break;
+    }
+}
+
+uint8_t ntru_kernel_run(const NtruKernel *k, NtruKernelArgs *args) {
+    switch (k->primitive) {
+    case NTRU_KERNEL_MULT_INT:
+        return k->func.mult_int(&args->a, &args->b, &args->c, args->q-1);
+    case NTRU_KERNEL_MULT_TERN:
+        return k->func.mult_tern(&args->a, &args->tern, &args->c, args->q-1);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    case NTRU_KERNEL_MULT_PROD:
+        return k->func.mult_prod(&args->a, &args->prod, &args->c, args->q-1);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    case NTRU_KERNEL_TO_ARR:
+        k->func.to_arr(&args->a, args->q, args->arr);
+        return 1;
+    case NTRU_KERNEL_MOD_MASK:
+        k->func.mod_mask(&args->c, args->q-1);
+        return 1;
+    case NTRU_KERNEL_MOD3:
+        k->func.mod3(&args->c);
+        return 1;
+    case NTRU_KERNEL_FROM_ARR:
+        k->func.from_arr(args->arr, args->a.N, args->q, &args->c);
+        return 1;
+    case NTRU_KERNEL_TERN_PACK:
+        k->func.tern_pack(&args->tern, &args->packed);
+        return 1;
+    case NTRU_KERNEL_TERN_PACKED_TO_INT:
+        k->func.tern_packed_to_int(&args->packed, &args->c);
+        return 1;
+    case NTRU_KERNEL_ENCRYPT_POST:
+        k->func.encrypt_post(&args->c, &args->b, &args->r, args->weights);
+        return 1;
+    case NTRU_KERNEL_DECRYPT_POST:
+        k->func.decrypt_post(&args->c, &args->a, args->q, &args->r, args->weights);
+        return 1;
+    case NTRU_KERNEL_NTRUPRIME_MULT_SMALL:
+        return k->func.ntruprime_mult_small(&args->a, &args->b, &args->c, args->q);
+    default:
+        return 0;
+    }
+}
+
+/***************************************
+ *           Autotuning                *
+ ***************************************/
+
+/* number of timing rounds per candidate; the fastest round counts */
+#define NTRU_TUNE_ROUNDS 5
+
+/* number of calls per timing round */
+#define NTRU_TUNE_ITER 4
+
+/* version of the ntru_kernel_tuned_save() file format */
+#define NTRU_TUNE_FORMAT 1
+
+NtruKernelChoice ntru_tuned[NTRU_KERNEL_MAX_TUNED];
+uint16_t ntru_num_tuned = 0;
+
+/* whether ntru_kernel_tuned_install() installs the tuned dispatchers */
+uint8_t ntru_tuned_enabled = 1;
+
+/* the CPUID-based choices, for combinations that have not been tuned */
+uint8_t (*ntru_mult_int_untuned)(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+uint8_t (*ntru_mult_tern_untuned)(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+uint8_t (*ntru_mult_prod_untuned)(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+void ntru_set_optimized_impl();
+
+uint64_t ntru_kernel_now_ns() {
+#ifdef WIN32
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(t.QuadPart * (1000000000.0/freq.QuadPart));
+#elif defined __MACH__
+    static mach_timebase_info_data_t tb;
+    if (tb.denom == 0)
+        mach_timebase_info(&tb);
+    return mach_absolute_time() * tb.numer / tb.denom;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+#endif
+}
+
+NtruKernelChoice *ntru_kernel_choice_find(NtruKernelChoice *table, uint16_t num, uint8_t primitive, uint16_t N, uint16_t df, uint16_t q) {
+    uint16_t i;
+    for (i=0; i<num; i++) {
+        NtruKernelChoice *c = &table[i];
+        if (c->N==N && c->df==df && c->primitive==primitive && c->q==q)
+            return c;
+    }
+    return NULL;
+}
+
+/* Adds a decision to a table of *num decisions, or replaces the one for the same combination */
+uint8_t ntru_kernel_choice_add(NtruKernelChoice *table, uint16_t *num, NtruKernelChoice *choice) {
+    NtruKernelChoice *c = ntru_kernel_choice_find(table, *num, choice->primitive, choice->N, choice->df, choice->q);
+    if (c == NULL) {
+        if (*num >= NTRU_KERNEL_MAX_TUNED)
+            return NTRU_ERR_OUT_OF_MEMORY;
+        c = &table[(*num)++];
+    }
+    *c = *choice;
+    return NTRU_SUCCESS;
+}
+
+NtruKernelChoice *ntru_kernel_tuned_find(uint8_t primitive, uint16_t N, uint16_t df, uint16_t q) {
+    return ntru_kernel_choice_find(ntru_tuned, ntru_num_tuned, primitive, N, df, q);
+}
+
+uint8_t ntru_kernel_tuned_add(NtruKernelChoice *choice) {
+    return ntru_kernel_choice_add(ntru_tuned, &ntru_num_tuned, choice);
+}
+
+uint8_t ntru_mult_int_tuned(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NtruKernelChoice *choice = ntru_kernel_tuned_find(NTRU_KERNEL_MULT_INT, a->N, 0, mod_mask+1);
+    if (choice != NULL)
+        return choice->kernel->func.mult_int(a, b, c, mod_mask);
+    return ntru_mult_int_untuned(a, b, c, mod_mask);
+}
+
+uint8_t ntru_mult_tern_tuned(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NtruKernelChoice *choice = ntru_kernel_tuned_find(NTRU_KERNEL_MULT_TERN, a->N, b->num_ones, mod_mask+1);
+    if (choice != NULL)
+        return choice->kernel->func.mult_tern(a, b, c, mod_mask);
+    return ntru_mult_tern_untuned(a, b, c, mod_mask);
+}
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+uint8_t ntru_mult_prod_tuned(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NtruKernelChoice *choice = ntru_kernel_tuned_find(NTRU_KERNEL_MULT_PROD, a->N, b->f1.num_ones, mod_mask+1);
+    if (choice != NULL)
+        return choice->kernel->func.mult_prod(a, b, c, mod_mask);
+    return ntru_mult_prod_untuned(a, b, c, mod_mask);
+}
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+void ntru_kernel_tuned_install() {
+    if (!ntru_tuned_enabled || ntru_num_tuned==0)
+        return;
+    ntru_mult_int = ntru_mult_int_tuned;
+    ntru_mult_tern = ntru_mult_tern_tuned;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod = ntru_mult_prod_tuned;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+}
+
+/*
+ * Switches to the CPUID-based kernels with constant-time mode off, and records
+ * them as the fallbacks of the tuned dispatchers. Returns the previous
+ * constant-time setting for ntru_kernel_tuned_resume().
+ */
+uint8_t ntru_kernel_tuned_suspend() {
+    uint8_t constant_time = ntru_get_constant_time_poly();
+    ntru_tuned_enabled = 0;
+    ntru_set_constant_time_poly(0);
+    ntru_set_optimized_impl();
+    ntru_mult_int_untuned = ntru_mult_int;
+    ntru_mult_tern_untuned = ntru_mult_tern;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod_untuned = ntru_mult_prod;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    return constant_time;
+}
+
+void ntru_kernel_tuned_resume(uint8_t constant_time) {
+    ntru_tuned_enabled = 1;
+    ntru_set_constant_time_poly(constant_time);
+    ntru_set_optimized_impl();
+}
+
+uint16_t ntru_kernel_tuned_count() {
+    return ntru_num_tuned;
+}
+
+const NtruKernelChoice *ntru_kernel_tuned_get(uint16_t idx) {
+    return idx<ntru_num_tuned ? &ntru_tuned[idx] : NULL;
+}
+
+const NtruKernel *ntru_kernel_tuned_lookup(uint8_t primitive, uint16_t N, uint16_t df, uint16_t q) {
+    NtruKernelChoice *c = ntru_kernel_tuned_find(primitive, N, df, q);
+    return c==NULL ? NULL : c->kernel;
+}
+
+void ntru_kernel_tuned_reset() {
+    ntru_num_tuned = 0;
+    ntru_set_optimized_impl();
+}
+
+/*
+ * Fills args with random operands modulo q; tern gets df ones and df negative
+ * ones. If prod_df is not NULL, prod gets factors with prod_df[0..2] ones.
+ */
+uint8_t ntru_kernel_rand_args(uint16_t N, uint16_t q, uint16_t df, uint16_t *prod_df, NtruKernelArgs *args, NtruRandContext *rand_ctx) {
+    memset(args, 0, sizeof *args);
+    args->q = q;
+    args->a.N = args->b.N = N;
+    uint8_t valid = ntru_rand_generate((uint8_t*)args->a.coeffs, N*sizeof args->a.coeffs[0], rand_ctx) == NTRU_SUCCESS;
+    valid &= ntru_rand_generate((uint8_t*)args->b.coeffs, N*sizeof args->b.coeffs[0], rand_ctx) == NTRU_SUCCESS;
+    uint16_t i;
+    for (i=0; i<N; i++) {
+        args->a.coeffs[i] &= q - 1;
+        args->b.coeffs[i] &= q - 1;
+    }
+    valid &= ntru_rand_tern(N, df, df, &args->tern, rand_ctx);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (prod_df != NULL)
+        valid &= ntru_rand_prod(N, prod_df[0], prod_df[1], prod_df[2], prod_df[2], &args->prod, rand_ctx);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    return valid;
+}
+
+/* Fills args with random operands for a parameter set; see ntru_kernel_rand_args() */
+uint8_t ntru_kernel_tune_args(const NtruEncParams *params, uint16_t df, NtruKernelArgs *args, NtruRandContext *rand_ctx) {
+    uint16_t prod_df[] = {params->df1, params->df2, params->df3};
+    return ntru_kernel_rand_args(params->N, params->q, df, params->prod_flag ? prod_df : NULL, args, rand_ctx);
+}
+
+/*
+ * Runs the kernel of a decision and the generic kernel of its primitive on
+ * random operands of the decision's size and modulus, and returns 1 if the
+ * products are the same. All three factors of a product-form operand get df
+ * ones since the file does not record df2 and df3.
+ */
+uint8_t ntru_kernel_choice_verify(NtruKernelChoice *c, NtruKernelArgs *ref, NtruKernelArgs *args, NtruRandContext *rand_ctx) {
+    const NtruKernel *ref_kernel = NULL;
+    uint16_t i;
+    for (i=0; ref_kernel==NULL && i<ntru_kernel_count(); i++)
+        if (ntru_kernel_get(i)->primitive == c->primitive)
+            ref_kernel = ntru_kernel_get(i);
+    if (ref_kernel == NULL)
+        return 0;
+
+    uint16_t prod_df[] = {c->df, c->df, c->df};
+    if (!ntru_kernel_rand_args(c->N, c->q, c->df, c->primitive==NTRU_KERNEL_MULT_PROD ? prod_df : NULL, ref, rand_ctx))
+        return 0;
+    memcpy(args, ref, sizeof *args);
+    uint8_t valid = ntru_kernel_run(ref_kernel, ref);
+    valid &= ntru_kernel_run(c->kernel, args);
+    valid &= memcmp(ref->c.coeffs, args->c.coeffs, c->N*sizeof args->c.coeffs[0]) == 0;
+    return valid;
+}
+
+/*
+ * Times all supported kernels of a primitive on src and adds the fastest one
+ * whose output matches the generic kernel's to the decisions.
+ */
+uint8_t ntru_kernel_tune_one(uint8_t primitive, uint16_t df, NtruKernelArgs *src, NtruKernelArgs *ref, NtruKernelArgs *args) {
+    uint16_t num_kernels = ntru_kernel_count();
+    uint64_t best_ns[num_kernels];
+    uint8_t ok[num_kernels];
+    const NtruKernel *ref_kernel = NULL;
+    uint16_t i;
+    for (i=0; i<num_kernels; i++) {
+        const NtruKernel *k = ntru_kernel_get(i);
+        ok[i] = k->primitive==primitive && ntru_kernel_applies(k, src->a.N, src->q);
+        best_ns[i] = UINT64_MAX;
+        if (!ok[i])
+            continue;
+        memcpy(args, src, sizeof *args);
+        ok[i] = ntru_kernel_run(k, args);
+        if (ref_kernel == NULL) {
+            ref_kernel = k;
+            memcpy(ref, args, sizeof *ref);
+        }
+        else
+            ok[i] &= memcmp(ref->c.coeffs, args->c.coeffs, src->a.N*sizeof args->c.coeffs[0]) == 0;
+    }
+    if (ref_kernel == NULL)
+        return NTRU_SUCCESS;
+
+    /* alternate between the kernels so they all see the same machine state */
+    uint8_t r;
+    for (r=0; r<NTRU_TUNE_ROUNDS; r++)
+        for (i=0; i<num_kernels; i++) {
+            if (!ok[i])
+                continue;
+            const NtruKernel *k = ntru_kernel_get(i);
+            uint64_t t1 = ntru_kernel_now_ns();
+            uint8_t j;
+            for (j=0; j<NTRU_TUNE_ITER; j++)
+                ntru_kernel_run(k, args);
+            uint64_t t = ntru_kernel_now_ns() - t1;
+            if (t < best_ns[i])
+                best_ns[i] = t;
+        }
+
+    NtruKernelChoice choice = {primitive, src->a.N, df, src->q, ref_kernel, 0};
+    uint64_t min_ns = UINT64_MAX;
+    for (i=0; i<num_kernels; i++)
+        if (ok[i] && best_ns[i]<min_ns) {
+            min_ns = best_ns[i];
+            choice.kernel = ntru_kernel_get(i);
+        }
+    choice.ns = (double)min_ns / NTRU_TUNE_ITER;
+    return ntru_kernel_tuned_add(&choice);
+}
+
+uint8_t ntru_kernel_autotune(const NtruEncParams *params, uint16_t num_params) {
+    uint8_t constant_time = ntru_kernel_tuned_suspend();
+
+    NtruKernelArgs *src = malloc(sizeof *src);
+    NtruKernelArgs *ref = malloc(sizeof *ref);
+    NtruKernelArgs *args = malloc(sizeof *args);
+    uint8_t seed[] = "libntru autotune";
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    NtruRandContext rand_ctx;
+    uint8_t retcode = src==NULL || ref==NULL || args==NULL ? NTRU_ERR_OUT_OF_MEMORY : NTRU_SUCCESS;
+    if (retcode == NTRU_SUCCESS)
+        retcode = ntru_rand_init_det(&rand_ctx, &rng, seed, sizeof seed);
+    uint8_t rand_init = retcode == NTRU_SUCCESS;
+
+    uint16_t i;
+    for (i=0; retcode==NTRU_SUCCESS && i<num_params; i++) {
+        const NtruEncParams *p = &params[i];
+
+        /* the ternary operands: t and r (or their factors f1..f3 in product form), and g */
+        uint16_t tern_df[4];
+        uint8_t num_df = 0;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        if (p->prod_flag) {
+            tern_df[num_df++] = p->df1;
+            tern_df[num_df++] = p->df2;
+            tern_df[num_df++] = p->df3;
+        }
+        else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+            tern_df[num_df++] = p->df1;
+        tern_df[num_df++] = p->dg;
+
+        uint8_t j;
+        for (j=0; retcode==NTRU_SUCCESS && j<num_df; j++) {
+            if (!ntru_kernel_tune_args(p, tern_df[j], src, &rand_ctx))
+                retcode = NTRU_ERR_PRNG;
+            else
+                retcode = ntru_kernel_tune_one(NTRU_KERNEL_MULT_TERN, tern_df[j], src, ref, args);
+        }
+        if (retcode == NTRU_SUCCESS)
+            retcode = ntru_kernel_tune_one(NTRU_KERNEL_MULT_INT, 0, src, ref, args);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        if (retcode==NTRU_SUCCESS && p->prod_flag)
+            retcode = ntru_kernel_tune_one(NTRU_KERNEL_MULT_PROD, p->df1, src, ref, args);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    }
+
+    if (rand_init)
+        ntru_rand_release(&rand_ctx);
+    free(src);
+    free(ref);
+    free(args);
+    ntru_kernel_tuned_resume(constant_time);
+    return retcode;
+}
+
+uint8_t ntru_kernel_tuned_save(char *filename) {
+    FILE *f = fopen(filename, "w");
+    if (f == NULL)
+        return NTRU_ERR_IO;
+    uint8_t ok = fprintf(f, "libntru-kernels %d\n", NTRU_TUNE_FORMAT) > 0;
+    uint16_t i;
+    for (i=0; i<ntru_num_tuned; i++) {
+        NtruKernelChoice *c = &ntru_tuned[i];
+        ok &= fprintf(f, "%d %d %d %d %s %.1f\n", c->primitive, c->N, c->df, c->q, c->kernel->name, c->ns) > 0;
+    }
+    ok &= fclose(f) == 0;
+    return ok ? NTRU_SUCCESS : NTRU_ERR_IO;
+}
+
+uint8_t ntru_kernel_tuned_load(char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        return NTRU_ERR_IO;
+    int format;
+    if (fscanf(f, "libntru-kernels %d", &format)!=1 || format!=NTRU_TUNE_FORMAT) {
+        fclose(f);
+        return NTRU_ERR_INVALID_ENCODING;
+    }
+
+    uint8_t constant_time = ntru_kernel_tuned_suspend();
+
+    /* the decisions go into a copy of the table, which replaces it only if the whole file is valid */
+    NtruKernelChoice *loaded = malloc(sizeof ntru_tuned);
+    uint16_t num_loaded = ntru_num_tuned;
+    NtruKernelArgs *ref = malloc(sizeof *ref);
+    NtruKernelArgs *args = malloc(sizeof *args);
+    uint8_t seed[] = "libntru tuned load";
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    NtruRandContext rand_ctx;
+    uint8_t retcode = loaded==NULL || ref==NULL || args==NULL ? NTRU_ERR_OUT_OF_MEMORY : NTRU_SUCCESS;
+    if (retcode == NTRU_SUCCESS) {
+        memcpy(loaded, ntru_tuned, ntru_num_tuned * sizeof ntru_tuned[0]);
+        retcode = ntru_rand_init_det(&rand_ctx, &rng, seed, sizeof seed);
+    }
+    uint8_t rand_init = retcode == NTRU_SUCCESS;
+
+    unsigned primitive, N, df, q;
+    char name[48];
+    double ns;
+    int num_read = EOF;
+    while (retcode==NTRU_SUCCESS && (num_read=fscanf(f, "%u %u %u %u %47s %lf", &primitive, &N, &df, &q, name, &ns))==6) {
+        uint8_t mult = primitive==NTRU_KERNEL_MULT_INT || primitive==NTRU_KERNEL_MULT_TERN || primitive==NTRU_KERNEL_MULT_PROD;
+        if (!mult || N==0 || N>=NTRU_INT_POLY_SIZE || 2*df>N || q<2 || q>32768 || (q&(q-1))) {
+            retcode = NTRU_ERR_INVALID_ENCODING;
+            break;
+        }
+        /* skip kernels that are unknown or unsupported here */
+        uint16_t i;
+        for (i=0; i<ntru_kernel_count(); i++) {
+            const NtruKernel *k = ntru_kernel_get(i);
+            if (strcmp(k->name, name)!=0 || k->primitive!=primitive || !ntru_kernel_supported(k))
+                continue;
+            /* a kernel that is not exact for N and q, or disagrees with the generic one, means the file is stale or edited */
+            NtruKernelChoice choice = {primitive, N, df, q, k, ns};
+            if (!ntru_kernel_applies(k, N, q) || !ntru_kernel_choice_verify(&choice, ref, args, &rand_ctx))
+                retcode = NTRU_ERR_INVALID_ENCODING;
+            else
+                retcode = ntru_kernel_choice_add(loaded, &num_loaded, &choice);
+            break;
+        }
+    }
+    if (retcode==NTRU_SUCCESS && num_read!=EOF)
+        retcode = NTRU_ERR_INVALID_ENCODING;
+    if (retcode == NTRU_SUCCESS) {
+        memcpy(ntru_tuned, loaded, num_loaded * sizeof ntru_tuned[0]);
+        ntru_num_tuned = num_loaded;
+    }
+
+    if (rand_init)
+        ntru_rand_release(&rand_ctx);
+    free(loaded);
+    free(ref);
+    free(args);
+    fclose(f);
+    ntru_kernel_tuned_resume(constant_time);
+    return retcode;
+}
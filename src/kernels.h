@@ -0,0 +1,266 @@
+#ifndef NTRU_KERNELS_H
+#define NTRU_KERNELS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "encparams.h"
+
+/** primitives that have more than one implementation */
+#define NTRU_KERNEL_MULT_INT 0
+#define NTRU_KERNEL_MULT_TERN 1
+#define NTRU_KERNEL_MULT_PROD 2
+#define NTRU_KERNEL_TO_ARR 3
+#define NTRU_KERNEL_MOD_MASK 4
+#define NTRU_KERNEL_MOD3 5
+#define NTRU_KERNEL_FROM_ARR 6
+#define NTRU_KERNEL_TERN_PACK 7
+#define NTRU_KERNEL_TERN_PACKED_TO_INT 8
+#define NTRU_KERNEL_ENCRYPT_POST 9
+#define NTRU_KERNEL_DECRYPT_POST 10
+#define NTRU_KERNEL_NTRUPRIME_MULT_SMALL 11
+#define NTRU_KERNEL_NUM_PRIMITIVES 12
+
+/** instruction sets a kernel can require */
+#define NTRU_KERNEL_ISA_GENERIC 0
+#define NTRU_KERNEL_ISA_SSSE3 1
+#define NTRU_KERNEL_ISA_AVX2 2
+
+/**
+ * An implementation of one of the NTRU_KERNEL_* primitives. Only the member
+ * of func that matches the primitive is set. applies returns 1 for the
+ * polynomial sizes and moduli the kernel computes exact results for, or is
+ * NULL if the kernel handles all of them.
+ */
+typedef struct NtruKernel {
+    char *name;
+    uint8_t primitive;
+    uint8_t isa;
+    union {
+        uint8_t (*mult_int)(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+        uint8_t (*mult_tern)(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        uint8_t (*mult_prod)(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        void (*to_arr)(NtruIntPoly *p, uint16_t q, uint8_t *a);
+        void (*mod_mask)(NtruIntPoly *p, uint16_t mod_mask);
+        void (*mod3)(NtruIntPoly *p);
+        void (*from_arr)(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p);
+        void (*tern_pack)(NtruTernPoly *a, NtruTernPolyPacked *b);
+        void (*tern_packed_to_int)(NtruTernPolyPacked *a, NtruIntPoly *b);
+        void (*encrypt_post)(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights);
+        void (*decrypt_post)(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights);
+        uint8_t (*ntruprime_mult_small)(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus);
+    } func;
+    uint8_t (*applies)(uint16_t N, uint16_t q);
+} NtruKernel;
+
+/**
+ * Operands and results for ntru_kernel_run(). The mult kernels compute
+ * c=a*b, c=a*tern, or c=a*prod modulo q; ntruprime_mult_small computes c=a*b
+ * modulo x^N-x-1 and q. to_arr encodes a into arr, and from_arr decodes arr
+ * into c. tern_pack packs tern into packed, and tern_packed_to_int unpacks
+ * packed into c. The mod kernels reduce c in place, modulo q or modulo 3.
+ * encrypt_post uses c as the message representative and b as the mask, and
+ * updates r; decrypt_post uses c as the product and a as the ciphertext, and
+ * writes r. Both store the weights of c.
+ */
+typedef struct NtruKernelArgs {
+    NtruIntPoly a;
+    NtruIntPoly b;
+    NtruTernPoly tern;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    NtruProdPoly prod;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    uint16_t q;
+    NtruIntPoly c;
+    uint8_t arr[NTRU_INT_POLY_SIZE*2];   /* room for 16 bits per coefficient */
+    NtruTernPolyPacked packed;
+    NtruIntPoly r;
+    uint16_t weights[3];
+} NtruKernelArgs;
+
+/**
+ * @brief Number of kernels
+ *
+ * @return the number of kernels compiled into libntru, including ones the
+ *         CPU may not support
+ */
+uint16_t ntru_kernel_count();
+
+/**
+ * @brief Kernel by index
+ *
+ * Kernels are ordered by primitive. For each primitive, the first kernel is
+ * the generic reference implementation.
+ *
+ * @param idx an index less than ntru_kernel_count()
+ * @return the kernel, or NULL if idx is out of range
+ */
+const NtruKernel *ntru_kernel_get(uint16_t idx);
+
+/**
+ * @brief Kernel support
+ *
+ * @param k a kernel
+ * @return 1 if the CPU supports the instruction set k requires, 0 otherwise
+ */
+uint8_t ntru_kernel_supported(const NtruKernel *k);
+
+/**
+ * @brief Kernel applicability
+ *
+ * Kernels that are not applicable may return wrong results, e.g. the AVX2
+ * Toom-4 multiplication for moduli above 2^13.
+ *
+ * @param k a kernel
+ * @param N the number of coefficients
+ * @param q the modulus
+ * @return 1 if the CPU supports k and k is exact for N and q, 0 otherwise
+ */
+uint8_t ntru_kernel_applies(const NtruKernel *k, uint16_t N, uint16_t q);
+
+/**
+ * @brief Kernel operand preparation
+ *
+ * Derives the inputs a kernel reads besides a, b, tern, prod, and q from those
+ * fields, e.g. the encoded polynomial for from_arr, or a mask with coefficients
+ * in the -1..2 range for encrypt_post. Call it on a fresh copy of the operands
+ * before ntru_kernel_run(), so that all kernels of a primitive see the same
+ * inputs.
+ *
+ * @param k a kernel
+ * @param args input and output parameter; operands
+ */
+void ntru_kernel_prepare(const NtruKernel *k, NtruKernelArgs *args);
+
+/**
+ * @brief Kernel invocation
+ *
+ * Calls a kernel with the operands in args; see NtruKernelArgs.
+ *
+ * @param k a kernel the CPU supports
+ * @param args input and output parameter; operands and results
+ * @return 1 on success, 0 if a mult kernel failed
+ */
+uint8_t ntru_kernel_run(const NtruKernel *k, NtruKernelArgs *args);
+
+/** max number of decisions ntru_kernel_autotune() and ntru_kernel_tuned_load() can store */
+#define NTRU_KERNEL_MAX_TUNED 128
+
+/**
+ * A decision of the autotuner: the kernel to use for a primitive with
+ * polynomials of N coefficients modulo q. df is the number of ones in the
+ * ternary operand for NTRU_KERNEL_MULT_TERN, the number of ones in f1 for
+ * NTRU_KERNEL_MULT_PROD, and 0 for NTRU_KERNEL_MULT_INT.
+ */
+typedef struct NtruKernelChoice {
+    uint8_t primitive;
+    uint16_t N;
+    uint16_t df;
+    uint16_t q;
+    const NtruKernel *kernel;
+    double ns;   /* time per call in nanoseconds as measured by ntru_kernel_autotune() */
+} NtruKernelChoice;
+
+/**
+ * @brief Kernel autotuning
+ *
+ * Times every kernel the CPU supports for the multiplications done with the
+ * given parameter sets, i.e. for each (N, df) combination of the private key,
+ * blinding polynomial, and g, and for the integer multiplication used by key
+ * generation. Kernels whose output differs from the generic one are skipped.
+ * From then on, ntru_mult_int, ntru_mult_tern, and ntru_mult_prod dispatch
+ * to the fastest kernel for those combinations and fall back to the usual
+ * CPUID-based choice otherwise. Constant-time mode (see ntru_set_constant_time())
+ * takes precedence over tuned kernels.
+ * Takes on the order of 10ms per parameter set. Not thread-safe; call it before
+ * other threads use libntru.
+ *
+ * @param params an array of parameter sets
+ * @param num_params the number of elements in params
+ * @return NTRU_SUCCESS on success, NTRU_ERR_OUT_OF_MEMORY if more than
+ *         NTRU_KERNEL_MAX_TUNED decisions would be needed, or NTRU_ERR_PRNG
+ */
+uint8_t ntru_kernel_autotune(const NtruEncParams *params, uint16_t num_params);
+
+/**
+ * @brief Number of tuned decisions
+ *
+ * @return the number of decisions made by ntru_kernel_autotune() or loaded
+ *         with ntru_kernel_tuned_load()
+ */
+uint16_t ntru_kernel_tuned_count();
+
+/**
+ * @brief Tuned decision by index
+ *
+ * @param idx an index less than ntru_kernel_tuned_count()
+ * @return the decision, or NULL if idx is out of range
+ */
+const NtruKernelChoice *ntru_kernel_tuned_get(uint16_t idx);
+
+/**
+ * @brief Tuned kernel lookup
+ *
+ * @param primitive NTRU_KERNEL_MULT_INT, NTRU_KERNEL_MULT_TERN, or NTRU_KERNEL_MULT_PROD
+ * @param N the number of coefficients
+ * @param df see NtruKernelChoice
+ * @param q the modulus
+ * @return the kernel that is used for the combination, or NULL if it has not
+ *         been tuned
+ */
+const NtruKernel *ntru_kernel_tuned_lookup(uint8_t primitive, uint16_t N, uint16_t df, uint16_t q);
+
+/**
+ * @brief Tuning reset
+ *
+ * Discards all tuned decisions and goes back to choosing kernels by CPUID.
+ */
+void ntru_kernel_tuned_reset();
+
+/**
+ * @brief Tuning cache export
+ *
+ * Writes the tuned decisions to a text file that ntru_kernel_tuned_load() can
+ * read, so later runs on the same machine can skip ntru_kernel_autotune().
+ *
+ * @param filename the file to create or overwrite
+ * @return NTRU_SUCCESS on success, or NTRU_ERR_IO
+ */
+uint8_t ntru_kernel_tuned_save(char *filename);
+
+/**
+ * @brief Tuning cache import
+ *
+ * Reads decisions written by ntru_kernel_tuned_save() and adds them to the
+ * current ones, replacing decisions for the same combination. Decisions for
+ * kernels that are not compiled in or that the CPU does not support are
+ * ignored, so a file from a different machine is safe to load. Every other
+ * decision is checked with ntru_kernel_applies() and by comparing one product
+ * against the generic kernel. If any line is malformed or fails these checks,
+ * no decision from the file is used. Not thread-safe.
+ *
+ * @param filename the file to read
+ * @return NTRU_SUCCESS on success, NTRU_ERR_IO if the file cannot be read,
+ *         NTRU_ERR_INVALID_ENCODING if it is malformed or a decision fails the
+ *         checks, or NTRU_ERR_OUT_OF_MEMORY if there are more than
+ *         NTRU_KERNEL_MAX_TUNED decisions
+ */
+uint8_t ntru_kernel_tuned_load(char *filename);
+
+/**
+ * Called by ntru_set_optimized_impl_poly() to point ntru_mult_int,
+ * ntru_mult_tern, and ntru_mult_prod to the tuned dispatchers if there are
+ * tuned decisions.
+ */
+void ntru_kernel_tuned_install();
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_KERNELS_H */
@@ -0,0 +1,505 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "keyring.h"
+#include "ntru.h"
+#include "poly.h"
+#include "encparams.h"
+#include "types.h"
+#include "err.h"
+
+#define NTRU_KEYRING_MAGIC "NTRUKEYR"
+#define NTRU_KEYRING_VERSION 1
+#define NTRU_KEYRING_HEADER_LEN 64
+#define NTRU_KEYRING_PARAM_LEN 8
+#define NTRU_KEYRING_SLOT_LEN 16
+
+/*
+ * Key record layout:
+ *   0   key ID (8 bytes)
+ *   8   index into the param set table (2 bytes)
+ *   10  flags (2 bytes)
+ *   12  #ones and #neg_ones of t, or of f1, f2, f3 if t is in product form (6*2 bytes)
+ *   24  reserved (8 bytes)
+ *   32  h as written by ntru_to_arr_32()
+ *   ... private key indices, 2 bytes each, starting at an even offset
+ * The record is padded to a multiple of NTRU_KEYRING_ALIGN bytes.
+ */
+#define NTRU_KEYRING_REC_HEADER_LEN 32
+#define NTRU_KEYRING_FLAG_PRIV 1
+#define NTRU_KEYRING_FLAG_PROD 2
+
+static void ntru_put16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void ntru_put32(uint8_t *p, uint32_t v) {
+    ntru_put16(p, v);
+    ntru_put16(p+2, v>>16);
+}
+
+static void ntru_put64(uint8_t *p, uint64_t v) {
+    ntru_put32(p, v);
+    ntru_put32(p+4, v>>32);
+}
+
+static uint16_t ntru_get16(const uint8_t *p) {
+    return p[0] | (uint16_t)p[1]<<8;
+}
+
+static uint32_t ntru_get32(const uint8_t *p) {
+    return ntru_get16(p) | (uint32_t)ntru_get16(p+2)<<16;
+}
+
+static uint64_t ntru_get64(const uint8_t *p) {
+    return ntru_get32(p) | (uint64_t)ntru_get32(p+4)<<32;
+}
+
+static uint64_t ntru_keyring_align(uint64_t len) {
+    return (len+NTRU_KEYRING_ALIGN-1) & ~(uint64_t)(NTRU_KEYRING_ALIGN-1);
+}
+
+/* Returns the index slot at which to start searching for a key ID */
+static uint64_t ntru_keyring_slot(uint64_t key_id, uint8_t index_bits) {
+    return (key_id*0x9E3779B97F4A7C15ULL) >> (64-index_bits);
+}
+
+/* Writes the #ones and #neg_ones of the private polynomial to counts */
+static void ntru_keyring_counts(NtruEncPrivKey *priv, uint16_t counts[6]) {
+    memset(counts, 0, 6*sizeof counts[0]);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (priv->t.prod_flag) {
+        NtruProdPoly *prod = &priv->t.poly.prod;
+        counts[0] = prod->f1.num_ones;
+        counts[1] = prod->f1.num_neg_ones;
+        counts[2] = prod->f2.num_ones;
+        counts[3] = prod->f2.num_neg_ones;
+        counts[4] = prod->f3.num_ones;
+        counts[5] = prod->f3.num_neg_ones;
+        return;
+    }
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    counts[0] = priv->t.poly.tern.num_ones;
+    counts[1] = priv->t.poly.tern.num_neg_ones;
+}
+
+static uint32_t ntru_keyring_priv_offset(uint16_t N, uint16_t q) {
+    uint32_t offset = NTRU_KEYRING_REC_HEADER_LEN + ntru_enc_len_Nq(N, q);
+    return (offset+1) & ~1;
+}
+
+/* Returns the length of a key record in bytes, not including padding */
+static uint32_t ntru_keyring_rec_len(NtruKeyringEntry *entry) {
+    uint32_t len = ntru_keyring_priv_offset(entry->params->N, entry->params->q);
+    if (entry->priv != NULL) {
+        uint16_t counts[6];
+        ntru_keyring_counts(entry->priv, counts);
+        uint8_t i;
+        for (i=0; i<6; i++)
+            len += 2 * counts[i];
+    }
+    return len;
+}
+
+static uint8_t *ntru_keyring_put_tern(uint8_t *p, NtruTernPoly *poly) {
+    uint16_t i;
+    for (i=0; i<poly->num_ones; i++, p+=2)
+        ntru_put16(p, poly->ones[i]);
+    for (i=0; i<poly->num_neg_ones; i++, p+=2)
+        ntru_put16(p, poly->neg_ones[i]);
+    return p;
+}
+
+/* Writes a key record to rec, which must be zeroed */
+static void ntru_keyring_put_rec(NtruKeyringEntry *entry, uint16_t param_idx, uint8_t *rec) {
+    ntru_put64(rec, entry->key_id);
+    ntru_put16(rec+8, param_idx);
+    ntru_to_arr_32(&entry->pub->h, entry->pub->q, rec+NTRU_KEYRING_REC_HEADER_LEN);
+    if (entry->priv == NULL)
+        return;
+
+    uint16_t flags = NTRU_KEYRING_FLAG_PRIV;
+    uint16_t counts[6];
+    ntru_keyring_counts(entry->priv, counts);
+    uint8_t i;
+    for (i=0; i<6; i++)
+        ntru_put16(rec+12+2*i, counts[i]);
+    uint8_t *p = rec + ntru_keyring_priv_offset(entry->params->N, entry->params->q);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (entry->priv->t.prod_flag) {
+        flags |= NTRU_KEYRING_FLAG_PROD;
+        p = ntru_keyring_put_tern(p, &entry->priv->t.poly.prod.f1);
+        p = ntru_keyring_put_tern(p, &entry->priv->t.poly.prod.f2);
+        ntru_keyring_put_tern(p, &entry->priv->t.poly.prod.f3);
+    }
+    else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        ntru_keyring_put_tern(p, &entry->priv->t.poly.tern);
+    ntru_put16(rec+10, flags);
+}
+
+/* Checks that a key matches its parameter set */
+static uint8_t ntru_keyring_check_entry(NtruKeyringEntry *entry) {
+    const NtruEncParams *params = entry->params;
+    if (entry->pub->h.N!=params->N || entry->pub->q!=params->q)
+        return 0;
+    if (entry->priv == NULL)
+        return 1;
+    uint16_t N;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (entry->priv->t.prod_flag)
+        N = entry->priv->t.poly.prod.N;
+    else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        N = entry->priv->t.poly.tern.N;
+    return N==params->N && entry->priv->q==params->q;
+}
+
+uint8_t ntru_keyring_write(const char *filename, NtruKeyringEntry *entries, uint32_t num_entries) {
+    /* build the param set table */
+    const NtruEncParams *params[NTRU_KEYRING_MAX_PARAMS];
+    uint16_t *param_idx = malloc((num_entries>0 ? num_entries : 1) * sizeof param_idx[0]);
+    if (param_idx == NULL)
+        return NTRU_ERR_OUT_OF_MEMORY;
+    uint32_t num_params = 0;
+    uint32_t i, j;
+    for (i=0; i<num_entries; i++) {
+        if (!ntru_keyring_check_entry(&entries[i])) {
+            free(param_idx);
+            return NTRU_ERR_INVALID_KEY;
+        }
+        for (j=0; j<num_params; j++)
+            if (memcmp(params[j]->oid, entries[i].params->oid, sizeof params[j]->oid) == 0)
+                break;
+        if (j == num_params) {
+            if (num_params >= NTRU_KEYRING_MAX_PARAMS) {
+                free(param_idx);
+                return NTRU_ERR_INVALID_PARAM;
+            }
+            params[num_params] = entries[i].params;
+            num_params++;
+        }
+        param_idx[i] = j;
+    }
+
+    /* build the hash index; use at least twice as many slots as there are keys */
+    uint8_t index_bits = 1;
+    while (((uint64_t)1<<index_bits) < 2*(uint64_t)num_entries)
+        index_bits++;
+    uint64_t num_slots = (uint64_t)1 << index_bits;
+    uint64_t index_off = ntru_keyring_align(NTRU_KEYRING_HEADER_LEN + num_params*NTRU_KEYRING_PARAM_LEN);
+    uint64_t records_off = ntru_keyring_align(index_off + num_slots*NTRU_KEYRING_SLOT_LEN);
+    uint8_t *index = calloc(num_slots, NTRU_KEYRING_SLOT_LEN);
+    if (index == NULL) {
+        free(param_idx);
+        return NTRU_ERR_OUT_OF_MEMORY;
+    }
+    uint64_t rec_off = records_off;
+    uint32_t max_rec_len = 0;
+    for (i=0; i<num_entries; i++) {
+        uint64_t key_id = entries[i].key_id;
+        uint64_t slot = ntru_keyring_slot(key_id, index_bits);
+        while (ntru_get64(index+slot*NTRU_KEYRING_SLOT_LEN+8) != 0) {
+            if (ntru_get64(index+slot*NTRU_KEYRING_SLOT_LEN) == key_id) {
+                free(index);
+                free(param_idx);
+                return NTRU_ERR_INVALID_KEY;
+            }
+            slot = (slot+1) & (num_slots-1);
+        }
+        ntru_put64(index+slot*NTRU_KEYRING_SLOT_LEN, key_id);
+        ntru_put64(index+slot*NTRU_KEYRING_SLOT_LEN+8, rec_off);
+        uint32_t rec_len = ntru_keyring_align(ntru_keyring_rec_len(&entries[i]));
+        if (rec_len > max_rec_len)
+            max_rec_len = rec_len;
+        rec_off += rec_len;
+    }
+
+    /* header and param set table */
+    uint8_t head[index_off];
+    memset(head, 0, sizeof head);
+    memcpy(head, NTRU_KEYRING_MAGIC, 8);
+    ntru_put32(head+8, NTRU_KEYRING_VERSION);
+    ntru_put32(head+12, num_params);
+    ntru_put64(head+16, num_entries);
+    ntru_put64(head+24, index_off);
+    ntru_put64(head+32, index_bits);
+    ntru_put64(head+40, records_off);
+    ntru_put64(head+48, rec_off);
+    for (j=0; j<num_params; j++) {
+        uint8_t *p = head + NTRU_KEYRING_HEADER_LEN + j*NTRU_KEYRING_PARAM_LEN;
+        memcpy(p, params[j]->oid, sizeof params[j]->oid);
+        ntru_put16(p+4, params[j]->N);
+        ntru_put16(p+6, params[j]->q);
+    }
+
+    uint8_t retcode = NTRU_SUCCESS;
+    uint8_t *rec = malloc(max_rec_len>0 ? max_rec_len : 1);
+    FILE *f = fopen(filename, "wb");
+    if (rec==NULL || f==NULL) {
+        retcode = rec==NULL ? NTRU_ERR_OUT_OF_MEMORY : NTRU_ERR_IO;
+        if (f != NULL)
+            fclose(f);
+    }
+    else {
+        uint8_t pad[NTRU_KEYRING_ALIGN];
+        memset(pad, 0, sizeof pad);
+        uint8_t ok = fwrite(head, 1, sizeof head, f) == sizeof head;
+        ok &= fwrite(index, NTRU_KEYRING_SLOT_LEN, num_slots, f) == num_slots;
+        uint64_t pad_len = records_off - index_off - num_slots*NTRU_KEYRING_SLOT_LEN;
+        ok &= fwrite(pad, 1, pad_len, f) == pad_len;
+        for (i=0; i<num_entries && ok; i++) {
+            uint32_t rec_len = ntru_keyring_align(ntru_keyring_rec_len(&entries[i]));
+            memset(rec, 0, rec_len);
+            ntru_keyring_put_rec(&entries[i], param_idx[i], rec);
+            ok &= fwrite(rec, 1, rec_len, f) == rec_len;
+        }
+        ok &= fclose(f) == 0;
+        if (!ok)
+            retcode = NTRU_ERR_IO;
+    }
+
+    free(rec);
+    free(index);
+    free(param_idx);
+    return retcode;
+}
+
+/* Maps a file read-only; returns a pointer to the mapping or NULL */
+static const uint8_t *ntru_keyring_map(const char *filename, uint64_t *size, void **handle) {
+#ifdef WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart==0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+    const uint8_t *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (base == NULL) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+    *size = file_size.QuadPart;
+    *handle = mapping;
+    return base;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st)!=0 || st.st_size==0) {
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+    *size = st.st_size;
+    *handle = NULL;
+    return base;
+#endif
+}
+
+static void ntru_keyring_unmap(NtruKeyring *kr) {
+#ifdef WIN32
+    UnmapViewOfFile(kr->base);
+    CloseHandle(kr->handle);
+#else
+    munmap((void*)kr->base, kr->size);
+#endif
+}
+
+/* Looks up a param set by its OID */
+static uint8_t ntru_keyring_params_from_oid(const uint8_t *oid, NtruEncParams *params) {
+    NtruEncParams all[] = ALL_PARAM_SETS;
+    uint8_t i;
+    for (i=0; i<sizeof(all)/sizeof(all[0]); i++)
+        if (memcmp(all[i].oid, oid, sizeof all[i].oid) == 0) {
+            *params = all[i];
+            return 1;
+        }
+    return 0;
+}
+
+uint8_t ntru_keyring_open(const char *filename, NtruKeyring *kr) {
+    kr->base = ntru_keyring_map(filename, &kr->size, &kr->handle);
+    if (kr->base == NULL)
+        return NTRU_ERR_IO;
+
+    uint8_t retcode = NTRU_SUCCESS;
+    const uint8_t *head = kr->base;
+    if (kr->size<NTRU_KEYRING_HEADER_LEN || memcmp(head, NTRU_KEYRING_MAGIC, 8)!=0 || ntru_get32(head+8)!=NTRU_KEYRING_VERSION)
+        retcode = NTRU_ERR_INVALID_ENCODING;
+    else {
+        kr->num_params = ntru_get32(head+12);
+        kr->num_keys = ntru_get64(head+16);
+        uint64_t index_off = ntru_get64(head+24);
+        uint64_t index_bits = ntru_get64(head+32);
+        uint64_t records_off = ntru_get64(head+40);
+        /* compare against differences so that no sum of file values can wrap */
+        if (kr->num_params>NTRU_KEYRING_MAX_PARAMS || index_bits<1 || index_bits>40 ||
+                ntru_get64(head+48)!=kr->size || index_off<NTRU_KEYRING_HEADER_LEN+kr->num_params*NTRU_KEYRING_PARAM_LEN ||
+                records_off>kr->size || index_off>records_off ||
+                ((uint64_t)NTRU_KEYRING_SLOT_LEN<<index_bits) > records_off-index_off ||
+                kr->num_keys>((uint64_t)1<<index_bits)/2)
+            retcode = NTRU_ERR_INVALID_ENCODING;
+        else {
+            kr->index = kr->base + index_off;
+            kr->index_bits = index_bits;
+            kr->records_off = records_off;
+            uint32_t i;
+            for (i=0; i<kr->num_params && retcode==NTRU_SUCCESS; i++) {
+                const uint8_t *p = head + NTRU_KEYRING_HEADER_LEN + i*NTRU_KEYRING_PARAM_LEN;
+                if (!ntru_keyring_params_from_oid(p, &kr->params[i]))
+                    retcode = NTRU_ERR_UNKNOWN_PARAM_SET;
+                else if (kr->params[i].N!=ntru_get16(p+4) || kr->params[i].q!=ntru_get16(p+6))
+                    retcode = NTRU_ERR_INVALID_ENCODING;
+            }
+        }
+    }
+
+    if (retcode != NTRU_SUCCESS) {
+        ntru_keyring_unmap(kr);
+        kr->base = NULL;
+    }
+    return retcode;
+}
+
+uint8_t ntru_keyring_find(NtruKeyring *kr, uint64_t key_id, NtruKeyView *view) {
+    uint64_t mask = ((uint64_t)1<<kr->index_bits) - 1;
+    uint64_t slot = ntru_keyring_slot(key_id, kr->index_bits);
+    uint64_t rec_off = 0;
+    uint64_t i;
+    /* a corrupt file can have no empty slots, so probe each slot at most once */
+    for (i=0; i<=mask; i++) {
+        const uint8_t *s = kr->index + slot*NTRU_KEYRING_SLOT_LEN;
+        rec_off = ntru_get64(s+8);
+        if (rec_off == 0)
+            return NTRU_ERR_INVALID_KEY;
+        if (ntru_get64(s) == key_id)
+            break;
+        slot = (slot+1) & mask;
+    }
+    if (i > mask)
+        return NTRU_ERR_INVALID_KEY;
+
+    /* the record must lie within the records section; written as a difference to avoid overflow */
+    if (rec_off<kr->records_off || kr->size<NTRU_KEYRING_REC_HEADER_LEN || rec_off>kr->size-NTRU_KEYRING_REC_HEADER_LEN)
+        return NTRU_ERR_INVALID_ENCODING;
+    const uint8_t *rec = kr->base + rec_off;
+    uint16_t param_idx = ntru_get16(rec+8);
+    if (ntru_get64(rec)!=key_id || param_idx>=kr->num_params)
+        return NTRU_ERR_INVALID_ENCODING;
+    const NtruEncParams *params = &kr->params[param_idx];
+    uint32_t priv_off = ntru_keyring_priv_offset(params->N, params->q);
+    uint64_t rec_len = priv_off;
+    uint8_t j;
+    for (j=0; j<6; j++) {
+        view->counts[j] = ntru_get16(rec+12+2*j);
+        if (view->counts[j] > NTRU_MAX_ONES)
+            return NTRU_ERR_INVALID_ENCODING;
+        rec_len += 2 * view->counts[j];
+    }
+    if (rec_len>kr->size || rec_off>kr->size-rec_len)
+        return NTRU_ERR_INVALID_ENCODING;
+
+    view->key_id = key_id;
+    view->params = params;
+    view->flags = ntru_get16(rec+10);
+    view->h = rec + NTRU_KEYRING_REC_HEADER_LEN;
+    view->priv = view->flags&NTRU_KEYRING_FLAG_PRIV ? rec+priv_off : NULL;
+    return NTRU_SUCCESS;
+}
+
+void ntru_keyring_get_pub(NtruKeyView *view, NtruEncPubKey *pub) {
+    pub->q = view->params->q;
+    ntru_from_arr((uint8_t*)view->h, view->params->N, view->params->q, &pub->h);
+}
+
+/* Reads num_ones and num_neg_ones indices into a ternary polynomial */
+static const uint8_t *ntru_keyring_get_tern(const uint8_t *p, uint16_t N, uint16_t num_ones, uint16_t num_neg_ones, NtruTernPoly *poly, uint8_t *valid) {
+    poly->N = N;
+    poly->num_ones = num_ones;
+    poly->num_neg_ones = num_neg_ones;
+    uint16_t i;
+    for (i=0; i<num_ones; i++, p+=2) {
+        poly->ones[i] = ntru_get16(p);
+        *valid &= poly->ones[i] < N;
+    }
+    for (i=0; i<num_neg_ones; i++, p+=2) {
+        poly->neg_ones[i] = ntru_get16(p);
+        *valid &= poly->neg_ones[i] < N;
+    }
+    return p;
+}
+
+uint8_t ntru_keyring_get_key_pair(NtruKeyView *view, NtruEncKeyPair *kp) {
+    if (view->priv == NULL)
+        return NTRU_ERR_INVALID_KEY;
+    uint16_t N = view->params->N;
+    uint8_t valid = 1;
+    const uint8_t *p = view->priv;
+    if (view->flags & NTRU_KEYRING_FLAG_PROD) {
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        NtruProdPoly *prod = &kp->priv.t.poly.prod;
+        kp->priv.t.prod_flag = 1;
+        prod->N = N;
+        p = ntru_keyring_get_tern(p, N, view->counts[0], view->counts[1], &prod->f1, &valid);
+        p = ntru_keyring_get_tern(p, N, view->counts[2], view->counts[3], &prod->f2, &valid);
+        ntru_keyring_get_tern(p, N, view->counts[4], view->counts[5], &prod->f3, &valid);
+#else
+        return NTRU_ERR_INVALID_KEY;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    }
+    else {
+        kp->priv.t.prod_flag = 0;
+        ntru_keyring_get_tern(p, N, view->counts[0], view->counts[1], &kp->priv.t.poly.tern, &valid);
+    }
+    if (!valid)
+        return NTRU_ERR_INVALID_KEY;
+    kp->priv.q = view->params->q;
+    ntru_keyring_get_pub(view, &kp->pub);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_keyring_encrypt(uint8_t *msg, uint16_t msg_len, NtruKeyView *view, NtruRandContext *rand_ctx, uint8_t *enc) {
+    NtruEncPubKey pub;
+    ntru_keyring_get_pub(view, &pub);
+    return ntru_encrypt(msg, msg_len, &pub, view->params, rand_ctx, enc);
+}
+
+uint8_t ntru_keyring_decrypt(uint8_t *enc, NtruKeyView *view, uint8_t *dec, uint16_t *dec_len) {
+    NtruEncKeyPair kp;
+    uint8_t retcode = ntru_keyring_get_key_pair(view, &kp);
+    if (retcode != NTRU_SUCCESS)
+        return retcode;
+    retcode = ntru_decrypt(enc, &kp, view->params, dec, dec_len);
+    ntru_clear_priv(&kp.priv.t);
+    return retcode;
+}
+
+void ntru_keyring_close(NtruKeyring *kr) {
+    if (kr->base != NULL)
+        ntru_keyring_unmap(kr);
+    kr->base = NULL;
+    kr->index = NULL;
+    kr->num_keys = 0;
+}
@@ -0,0 +1,175 @@
+#ifndef NTRU_KEYRING_H
+#define NTRU_KEYRING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "encparams.h"
+#include "rand.h"
+
+/** max number of different parameter sets in one keyring file */
+#define NTRU_KEYRING_MAX_PARAMS 32
+
+/** alignment of key records in a keyring file */
+#define NTRU_KEYRING_ALIGN 64
+
+/**
+ * A key to be written to a keyring file by ntru_keyring_write().
+ * priv can be NULL if only the public key is to be stored.
+ */
+typedef struct NtruKeyringEntry {
+    uint64_t key_id;
+    const NtruEncParams *params;
+    NtruEncPubKey *pub;
+    NtruEncPrivKey *priv;
+} NtruKeyringEntry;
+
+/**
+ * A keyring file mapped into memory by ntru_keyring_open().
+ * The file is laid out as follows; all integers are little endian:
+ *   header (64 bytes):    magic "NTRUKEYR", version, #param sets, #keys,
+ *                         index offset, log2(#index slots), record offset, file size
+ *   param set table:      8 bytes per param set: oid, 0, N, q
+ *   hash index:           16 bytes per slot: key ID, record offset (0 = empty slot)
+ *   key records:          NTRU_KEYRING_ALIGN-aligned, see keyring.c
+ */
+typedef struct NtruKeyring {
+    const uint8_t *base;     /* start of the mapping */
+    uint64_t size;           /* file size */
+    uint64_t num_keys;
+    const uint8_t *index;    /* start of the hash index */
+    uint8_t index_bits;      /* log2 of the number of index slots */
+    uint64_t records_off;    /* offset of the first key record */
+    uint32_t num_params;
+    NtruEncParams params[NTRU_KEYRING_MAX_PARAMS];
+    void *handle;            /* platform-specific mapping handle */
+} NtruKeyring;
+
+/**
+ * A read-only view of a key record inside a mapped keyring. Views are valid
+ * until the keyring is closed.
+ */
+typedef struct NtruKeyView {
+    uint64_t key_id;
+    const NtruEncParams *params;
+    const uint8_t *h;        /* packed public key, in the format of ntru_to_arr_32() */
+    const uint8_t *priv;     /* private key indices, or NULL if the record has no private key */
+    uint16_t flags;
+    uint16_t counts[6];      /* #ones and #neg_ones of each private polynomial */
+} NtruKeyView;
+
+/**
+ * @brief Keyring file creation
+ *
+ * Writes a set of keys to a keyring file. Key IDs must be unique.
+ *
+ * @param filename the file to create or overwrite
+ * @param entries the keys to write
+ * @param num_entries the number of elements in entries
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if a key ID occurs more
+ *         than once or a key does not match its parameter set,
+ *         NTRU_ERR_INVALID_PARAM if there are more than NTRU_KEYRING_MAX_PARAMS
+ *         parameter sets, NTRU_ERR_OUT_OF_MEMORY, or NTRU_ERR_IO
+ */
+uint8_t ntru_keyring_write(const char *filename, NtruKeyringEntry *entries, uint32_t num_entries);
+
+/**
+ * @brief Keyring file mapping
+ *
+ * Maps a keyring file into memory read-only. Only the header and the parameter
+ * set table are read; keys are not touched until they are looked up.
+ *
+ * @param filename the keyring file
+ * @param kr output parameter; the mapped keyring
+ * @return NTRU_SUCCESS on success, NTRU_ERR_IO if the file cannot be mapped,
+ *         NTRU_ERR_INVALID_ENCODING if it is not a valid keyring file, or
+ *         NTRU_ERR_UNKNOWN_PARAM_SET if it uses a parameter set that is not
+ *         supported by this build
+ */
+uint8_t ntru_keyring_open(const char *filename, NtruKeyring *kr);
+
+/**
+ * @brief Key lookup
+ *
+ * Looks up a key by its ID and returns a view of its record. Does not
+ * allocate memory or copy key material.
+ *
+ * @param kr a mapped keyring
+ * @param key_id the ID of the key
+ * @param view output parameter; a view of the key record
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if there is no key with
+ *         the given ID, or NTRU_ERR_INVALID_ENCODING if the record is damaged
+ */
+uint8_t ntru_keyring_find(NtruKeyring *kr, uint64_t key_id, NtruKeyView *view);
+
+/**
+ * @brief Public key from a key view
+ *
+ * Unpacks the public key of a key record.
+ *
+ * @param view a key view
+ * @param pub output parameter; a pointer to store the public key
+ */
+void ntru_keyring_get_pub(NtruKeyView *view, NtruEncPubKey *pub);
+
+/**
+ * @brief Key pair from a key view
+ *
+ * Unpacks the public and private key of a key record.
+ *
+ * @param view a key view
+ * @param kp output parameter; a pointer to store the key pair
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if the record has no
+ *         private key or one that this build does not support
+ */
+uint8_t ntru_keyring_get_key_pair(NtruKeyView *view, NtruEncKeyPair *kp);
+
+/**
+ * @brief Encryption with a key view
+ *
+ * Same as ntru_encrypt() but takes the public key and the parameters from a key
+ * view. The key is unpacked on the caller's stack.
+ *
+ * @param msg The message to encrypt
+ * @param msg_len length of msg. Must not exceed ntru_max_msg_len(view->params).
+ * @param view a key view
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param enc output parameter; a pointer to store the encrypted message. Must accommodate
+              ntru_enc_len(view->params) bytes.
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_keyring_encrypt(uint8_t *msg, uint16_t msg_len, NtruKeyView *view, NtruRandContext *rand_ctx, uint8_t *enc);
+
+/**
+ * @brief Decryption with a key view
+ *
+ * Same as ntru_decrypt() but takes the key pair and the parameters from a key
+ * view. The keys are unpacked on the caller's stack.
+ *
+ * @param enc The message to decrypt
+ * @param view a key view
+ * @param dec output parameter; a pointer to store the decrypted message. Must accommodate
+              ntru_max_msg_len(view->params) bytes.
+ * @param dec_len output parameter; pointer to store the length of dec
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if the record has no
+ *         private key, or one of the other NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_keyring_decrypt(uint8_t *enc, NtruKeyView *view, uint8_t *dec, uint16_t *dec_len);
+
+/**
+ * @brief Keyring unmapping
+ *
+ * Unmaps a keyring file. All views of the keyring become invalid.
+ *
+ * @param kr the keyring to close
+ */
+void ntru_keyring_close(NtruKeyring *kr);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_KEYRING_H */
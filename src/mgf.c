@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #ifdef WIN32
 #include <stdint.h>
@@ -7,6 +8,7 @@
 #endif
 #include "encparams.h"
 #include "poly.h"
+#include "profile.h"
 
 int16_t NTRU_MGF_TRIT_TBL[243][5] = {
     { 0,  0,  0,  0,  0},
@@ -254,7 +256,17 @@ int16_t NTRU_MGF_TRIT_TBL[243][5] = {
     {-1, -1, -1, -1, -1}
 };
 
-void ntru_MGF(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIntPoly *i) {
+/* submits the first min_calls_mask hashes of Z_mid||counter to sched */
+void ntru_MGF_submit(NtruHashSched *sched, NtruHashMidstate *Z_mid, uint16_t min_calls_mask, uint16_t *counter_endian, uint8_t (*H_arr)[NTRU_MAX_HASH_LEN]) {
+    uint16_t counter;
+    for (counter=0; counter<min_calls_mask; counter++) {
+        counter_endian[counter] = htons(counter);   /* convert to network byte order */
+        ntru_hash_sched_submit(sched, Z_mid, (uint8_t*)&counter_endian[counter], sizeof counter, H_arr[counter]);
+    }
+}
+
+/* turns the hashes from ntru_MGF_submit() into trits, hashing more if needed */
+void ntru_MGF_finish(uint8_t *Z, uint8_t (*H_arr)[NTRU_MAX_HASH_LEN], const NtruEncParams *params, NtruIntPoly *i) {
     uint16_t N = params->N;
     i->N = N;
     uint16_t min_calls_mask = params->min_calls_mask;
@@ -262,80 +274,18 @@ void ntru_MGF(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, Ntr
 
     uint8_t buf[min_calls_mask * hlen];
     uint16_t buf_len = 0;
-    uint8_t Z[hlen];
-    params->hash(seed, seed_len, (uint8_t*)&Z);   /* hashSeed is always true */
-    uint16_t counter = 0;
-    uint8_t H[hlen];
-    uint16_t inp_len = hlen + sizeof counter;
-    uint8_t hash_inp[inp_len];
-    while (counter < min_calls_mask-7) {
-        uint8_t H_arr[8][NTRU_MAX_HASH_LEN];
-
-        uint8_t j;
-        uint8_t hash_inp_arr[8][inp_len];
-        uint8_t *hash_inp[8];
-        for (j=0; j<8; j++) {
-            uint16_t counter_endian = htons(counter);   /* convert to network byte order */
-            memcpy(&hash_inp_arr[j], Z, sizeof Z);
-            memcpy((uint8_t*)&hash_inp_arr[j] + sizeof Z, &counter_endian, sizeof counter_endian);
-            hash_inp[j] = hash_inp_arr[j];
-            counter++;
-        }
-        uint8_t *H[8];
-        for (j=0; j<8; j++)
-            H[j] = H_arr[j];
-        params->hash_8way(hash_inp, inp_len, H);
-
-        uint16_t i;
-        for (j=0; j<8; j++)
-            for (i=0; i<hlen; i++)
-                if (H[j][i] < 243) {   /* 243 = 3^5 */
-                    buf[buf_len] = H[j][i];
-                    buf_len++;
-                }
-    }
-    while (counter < min_calls_mask-3) {
-        uint8_t H_arr[4][NTRU_MAX_HASH_LEN];
-
-        uint8_t j;
-        uint8_t hash_inp_arr[4][inp_len];
-        uint8_t *hash_inp[4];
-        for (j=0; j<4; j++) {
-            uint16_t counter_endian = htons(counter);   /* convert to network byte order */
-            memcpy(&hash_inp_arr[j], Z, sizeof Z);
-            memcpy((uint8_t*)&hash_inp_arr[j] + sizeof Z, &counter_endian, sizeof counter_endian);
-            hash_inp[j] = hash_inp_arr[j];
-            counter++;
-        }
-        uint8_t *H[4];
-        for (j=0; j<4; j++)
-            H[j] = H_arr[j];
-        params->hash_4way(hash_inp, inp_len, H);
-
-        uint16_t i;
-        for (j=0; j<4; j++)
-            for (i=0; i<hlen; i++)
-                if (H[j][i] < 243) {   /* 243 = 3^5 */
-                    buf[buf_len] = H[j][i];
-                    buf_len++;
-                }
-    }
-    while (counter < min_calls_mask) {
-        uint16_t counter_endian = htons(counter);   /* convert to network byte order */
-        memcpy(&hash_inp, Z, sizeof Z);
-        memcpy((uint8_t*)&hash_inp + sizeof Z, &counter_endian, sizeof counter_endian);
-        params->hash((uint8_t*)&hash_inp, inp_len, (uint8_t*)&H);
-
-        uint16_t i;
-        for (i=0; i<hlen; i++)
-            if (H[i] < 243) {   /* 243 = 3^5 */
-                buf[buf_len] = H[i];
+    uint16_t j, k;
+    for (j=0; j<min_calls_mask; j++)
+        for (k=0; k<hlen; k++)
+            if (H_arr[j][k] < 243) {   /* 243 = 3^5 */
+                buf[buf_len] = H_arr[j][k];
                 buf_len++;
             }
 
-        counter++;
-    }
-
+    uint16_t counter = min_calls_mask;
+    uint8_t H[hlen];
+    uint16_t inp_len = hlen + sizeof counter;
+    uint8_t hash_inp[inp_len];
     for (;;) {
         uint16_t cur = 0;
         uint16_t j;
@@ -350,10 +300,91 @@ void ntru_MGF(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, Ntr
         if (cur >= N)
             return;
 
-        memcpy(&hash_inp, Z, sizeof Z);
+        memcpy(&hash_inp, Z, hlen);
         memcpy((uint8_t*)&hash_inp + hlen, &counter, sizeof counter);
         params->hash((uint8_t*)&hash_inp, inp_len, (uint8_t*)&H);
         memcpy(&buf, &H, hlen);
         buf_len = hlen;
     }
 }
+
+void ntru_MGF(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIntPoly *i) {
+    NTRU_PROF_START(t);
+    uint16_t min_calls_mask = params->min_calls_mask;
+    uint16_t hlen = params->hlen;
+
+    uint8_t Z[hlen];
+    params->hash(seed, seed_len, (uint8_t*)&Z);   /* hashSeed is always true */
+    NtruHashMidstate Z_mid;
+    params->hash_midstate(Z, hlen, &Z_mid);
+
+    /* submit all min_calls_mask hashes at once so they fill the SIMD lanes */
+    NtruHashSched sched;
+    ntru_hash_sched_init(&sched, params->hash_jobs);
+    uint8_t H_arr[min_calls_mask][NTRU_MAX_HASH_LEN];
+    uint16_t counter_endian[min_calls_mask];
+    ntru_MGF_submit(&sched, &Z_mid, min_calls_mask, counter_endian, H_arr);
+    ntru_hash_sched_flush(&sched);
+
+    ntru_MGF_finish(Z, H_arr, params, i);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_MGF, t);
+}
+
+/* number of seeds ntru_MGF_multi() processes together */
+#define NTRU_MGF_GROUP 8
+
+void ntru_MGF_multi(uint8_t **seeds, uint16_t seed_len, const NtruEncParams *params, NtruIntPoly **polys, uint8_t num) {
+    uint16_t min_calls_mask = params->min_calls_mask;
+    uint16_t hlen = params->hlen;
+
+    uint8_t (*H_arr)[NTRU_MAX_HASH_LEN] = malloc(NTRU_MGF_GROUP * min_calls_mask * sizeof *H_arr);
+    uint16_t *counter_endian = malloc(NTRU_MGF_GROUP * min_calls_mask * sizeof *counter_endian);
+    if (H_arr==NULL || counter_endian==NULL) {
+        free(H_arr);
+        free(counter_endian);
+        uint8_t j;
+        for (j=0; j<num; j++)
+            ntru_MGF(seeds[j], seed_len, params, polys[j]);
+        return;
+    }
+
+    NTRU_PROF_START(t);
+    uint8_t Z[NTRU_MGF_GROUP][NTRU_MAX_HASH_LEN];
+    uint8_t *Z_ptr[NTRU_MGF_GROUP];
+    NtruHashMidstate Z_mid[NTRU_MGF_GROUP];
+    uint8_t j;
+    for (j=0; j<NTRU_MGF_GROUP; j++)
+        Z_ptr[j] = Z[j];
+
+    uint16_t first;
+    for (first=0; first<num; first+=NTRU_MGF_GROUP) {
+        uint8_t group = num-first<NTRU_MGF_GROUP ? num-first : NTRU_MGF_GROUP;
+        j = 0;
+        if (group >= 8) {
+            params->hash_8way(seeds+first, seed_len, Z_ptr);
+            j = 8;
+        }
+        if (group-j >= 4) {
+            params->hash_4way(seeds+first+j, seed_len, Z_ptr+j);
+            j += 4;
+        }
+        for (; j<group; j++)
+            params->hash(seeds[first+j], seed_len, Z[j]);
+
+        /* one scheduler for the whole group, so the lanes stay full across seed boundaries */
+        NtruHashSched sched;
+        ntru_hash_sched_init(&sched, params->hash_jobs);
+        for (j=0; j<group; j++) {
+            params->hash_midstate(Z[j], hlen, &Z_mid[j]);
+            ntru_MGF_submit(&sched, &Z_mid[j], min_calls_mask, counter_endian+j*min_calls_mask, H_arr+j*min_calls_mask);
+        }
+        ntru_hash_sched_flush(&sched);
+
+        for (j=0; j<group; j++)
+            ntru_MGF_finish(Z[j], H_arr+j*min_calls_mask, params, polys[first+j]);
+    }
+
+    free(H_arr);
+    free(counter_endian);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_MGF, t);
+}
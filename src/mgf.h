@@ -15,4 +15,18 @@
  */
 void ntru_MGF(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruIntPoly *i);
 
+/**
+ * @brief Mask Generation Function for several seeds
+ *
+ * Same as calling ntru_MGF() for each seed, but the hashes of all seeds
+ * are run together so more SIMD lanes are used.
+ *
+ * @param seeds num seeds of the same length
+ * @param seed_len length of each seed
+ * @param params NTRUEncrypt parameters
+ * @param polys output parameter: num ternary polynomials
+ * @param num the number of seeds
+ */
+void ntru_MGF_multi(uint8_t **seeds, uint16_t seed_len, const NtruEncParams *params, NtruIntPoly **polys, uint8_t num);
+
 #endif   /* NTRU_MGF_H */
@@ -1,11 +1,15 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
 #include "ntru.h"
 #include "rand.h"
 #include "poly.h"
 #include "idxgen.h"
 #include "mgf.h"
+#include "arith.h"
+#include "profile.h"
+#include "probes.h"
 
 /***************************************
  *          NTRU Prime                 *
@@ -18,7 +22,7 @@ uint8_t ntruprime_gen_key_pair(const NtruPrimeParams *params, NtruPrimeKeyPair *
     do {
         if (!ntruprime_rand_tern(params->p, &g, rand_ctx))
             return NTRU_ERR_PRNG;
-        invertible = ntruprime_inv_poly(&g, g_inv, params->q);
+        invertible = ntruprime_inv_poly(&g, g_inv, params->q) && ntruprime_inv_poly(&g, &kp->priv.g_inv_mod3, 3);
     } while (!invertible);
 
     NtruIntPoly *f = &kp->priv.f;
@@ -29,9 +33,10 @@ uint8_t ntruprime_gen_key_pair(const NtruPrimeParams *params, NtruPrimeKeyPair *
         return NTRU_ERR_INVALID_PARAM;
 
     NtruIntPoly *h = &kp->pub.h;
-    if (!ntruprime_mult_poly(&g, &f_inv, h, params->q))
+    if (!ntruprime_mult_small(&f_inv, &g, h, params->q))
         return NTRU_ERR_INVALID_PARAM;
     ntruprime_mult_mod(h, params->inv_3, params->q);
+    kp->priv.p = kp->pub.p = params->p;
 
     return NTRU_SUCCESS;
 }
@@ -54,6 +59,11 @@ void ntru_set_optimized_impl() {
     ntru_set_optimized_impl_hash();
 }
 
+void ntru_set_constant_time(uint8_t enable) {
+    ntru_set_constant_time_poly(enable);
+    ntru_set_optimized_impl();
+}
+
 /* Generates a random g. If NTRU_CHECK_INVERTIBILITY_G, g will be invertible mod q */
 uint8_t ntru_gen_g(const NtruEncParams *params, NtruPrivPoly *g, NtruRandContext *rand_ctx) {
     uint16_t N = params->N;
@@ -135,13 +145,145 @@ uint8_t ntru_gen_key_pair_single(const NtruEncParams *params, NtruEncPrivKey *pr
 
 uint8_t ntru_gen_key_pair(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx) {
     ntru_set_optimized_impl();
+    NTRU_PROBE1(keygen_entry, params->N);
+    NTRU_PROF_START(t);
 
     NtruIntPoly fq;
     uint8_t result = ntru_gen_key_pair_single(params, &kp->priv, &kp->pub, &fq, rand_ctx);
     ntru_clear_int(&fq);
+    NTRU_PROBE1(keygen_return, result);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_KEYGEN, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_KEYGEN);
+    return result;
+}
+
+/* domain separation labels for the streams derived from a private key seed */
+#define NTRU_SEED_LABEL_T 1
+#define NTRU_SEED_LABEL_G 2
+
+/* Initializes a CTR_DRBG with seed||label */
+uint8_t ntru_seed_rand_init(uint8_t *seed, uint8_t label, NtruRandGen *rng, NtruRandContext *rand_ctx) {
+    uint8_t material[NTRU_PRIV_SEED_LEN+1];
+    memcpy(material, seed, NTRU_PRIV_SEED_LEN);
+    material[NTRU_PRIV_SEED_LEN] = label;
+    uint8_t result = ntru_rand_init_det(rand_ctx, rng, material, sizeof material);
+    memset(material, 0, sizeof material);
+    return result;
+}
+
+/* Samples t and g from a seed */
+uint8_t ntru_expand_seed(const NtruEncParams *params, uint8_t *seed, NtruPrivPoly *t, NtruPrivPoly *g) {
+    uint16_t N = params->N;
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    NtruRandContext rand_ctx;
+    uint8_t result = 1;
+
+    if (t != NULL) {
+        if (ntru_seed_rand_init(seed, NTRU_SEED_LABEL_T, &rng, &rand_ctx) != NTRU_SUCCESS)
+            return NTRU_ERR_PRNG;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        t->prod_flag = params->prod_flag;
+        if (params->prod_flag)
+            result &= ntru_rand_prod(N, params->df1, params->df2, params->df3, params->df3, &t->poly.prod, &rand_ctx);
+        else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        {
+            t->prod_flag = 0;
+            result &= ntru_rand_tern(N, params->df1, params->df1, &t->poly.tern, &rand_ctx);
+        }
+        result &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    if (g != NULL) {
+        if (ntru_seed_rand_init(seed, NTRU_SEED_LABEL_G, &rng, &rand_ctx) != NTRU_SUCCESS)
+            return NTRU_ERR_PRNG;
+        result &= ntru_gen_g(params, g, &rand_ctx) == NTRU_SUCCESS;
+        result &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    }
+
+    return result ? NTRU_SUCCESS : NTRU_ERR_PRNG;
+}
+
+/**
+ * @brief Public key from a seed
+ *
+ * Samples g from a private key seed and computes h=3*g*fq. g and fq are
+ * wiped before returning, whether or not the computation succeeded.
+ *
+ * @param params NtruEncrypt parameters
+ * @param seed the private key seed
+ * @param fq the inverse of f mod q; zeroed on return
+ * @param pub output parameter for the public key
+ * @return NTRU_SUCCESS for success, or a NTRU_ERR_ code for failure
+ */
+static uint8_t ntru_seed_pub(const NtruEncParams *params, uint8_t *seed, NtruIntPoly *fq, NtruEncPubKey *pub) {
+    uint16_t q = params->q;
+    NtruPrivPoly g;
+    uint8_t result = ntru_expand_seed(params, seed, NULL, &g);
+    if (result == NTRU_SUCCESS) {
+        NtruIntPoly *h = &pub->h;
+        if (ntru_mult_priv(&g, fq, h, q-1)) {
+            ntru_mult_fac(h, 3);
+            ntru_mod_mask(h, q-1);
+            pub->q = q;
+        }
+        else
+            result = NTRU_ERR_INVALID_PARAM;
+    }
+
+    /* g may be partially sampled on failure, so wipe the whole struct */
+    memset(&g, 0, sizeof g);
+    memset(fq, 0, sizeof *fq);
     return result;
 }
 
+uint8_t ntru_gen_key_pair_seed(const NtruEncParams *params, NtruEncKeyPair *kp, uint8_t *seed, NtruRandContext *rand_ctx) {
+    ntru_set_optimized_impl();
+
+    uint16_t q = params->q;
+    if (q & (q-1))   /* check that modulus is a power of 2 */
+        return NTRU_ERR_INVALID_PARAM;
+
+    /* choose seeds until t is invertible */
+    NtruIntPoly fq;
+    for (;;) {
+        uint8_t result;
+        if (ntru_rand_generate(seed, NTRU_PRIV_SEED_LEN, rand_ctx) != NTRU_SUCCESS)
+            result = NTRU_ERR_PRNG;
+        else
+            result = ntru_expand_seed(params, seed, &kp->priv.t, NULL);
+        if (result != NTRU_SUCCESS) {
+            /* fq can hold the output of a failed inversion */
+            memset(&fq, 0, sizeof fq);
+            return result;
+        }
+        if (ntru_invert(&kp->priv.t, q-1, &fq))
+            break;
+    }
+    kp->priv.q = q;
+
+    return ntru_seed_pub(params, seed, &fq, &kp->pub);
+}
+
+uint8_t ntru_priv_from_seed(const NtruEncParams *params, uint8_t *seed, NtruEncPrivKey *priv, NtruEncPubKey *pub) {
+    ntru_set_optimized_impl();
+
+    uint16_t q = params->q;
+    uint8_t result = ntru_expand_seed(params, seed, &priv->t, NULL);
+    if (result != NTRU_SUCCESS)
+        return result;
+    priv->q = q;
+    if (pub == NULL)
+        return NTRU_SUCCESS;
+
+    NtruIntPoly fq;
+    if (!ntru_invert(&priv->t, q-1, &fq)) {
+        memset(&fq, 0, sizeof fq);
+        return NTRU_ERR_INVALID_KEY;
+    }
+    return ntru_seed_pub(params, seed, &fq, pub);
+}
+
 uint8_t ntru_gen_key_pair_multi(const NtruEncParams *params, NtruEncPrivKey *priv, NtruEncPubKey *pub, NtruRandContext *rand_ctx, uint32_t num_pub) {
     ntru_set_optimized_impl();
 
@@ -188,6 +330,176 @@ uint8_t ntru_gen_pub(const NtruEncParams *params, NtruEncPrivKey *priv, NtruEncP
     return NTRU_SUCCESS;
 }
 
+/* worker i of ntru_gen_key_pair_par() draws its candidates from seed||(NTRU_SEED_LABEL_PAR+i) */
+#define NTRU_SEED_LABEL_PAR 3
+
+typedef struct NtruKeygenWorker {
+    const NtruEncParams *params;
+    uint32_t idx;             /* worker index */
+    uint32_t num_workers;
+    uint32_t *best;           /* shared; the lowest candidate number found to be invertible */
+    NtruRandContext rand_ctx;
+    NtruPrivPoly t;           /* the last candidate */
+    NtruIntPoly fq;           /* the inverse of 3t+1 if the last candidate is invertible */
+    uint32_t cand;            /* number of the last candidate */
+    uint8_t found;            /* whether the last candidate is invertible */
+    uint8_t retcode;
+    pthread_t thread;
+} NtruKeygenWorker;
+
+/*
+ * Samples candidates number idx, idx+num_workers, idx+2*num_workers, ... until one
+ * is invertible or a lower-numbered candidate has been found to be invertible.
+ */
+void *ntru_keygen_worker(void *arg) {
+    NtruKeygenWorker *w = arg;
+    const NtruEncParams *params = w->params;
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    w->cand = w->idx;
+    while (w->cand < __atomic_load_n(w->best, __ATOMIC_ACQUIRE)) {
+        NtruPrivPoly *t = &w->t;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        t->prod_flag = params->prod_flag;
+        if (params->prod_flag) {
+            t->poly.prod.N = N;
+            if (!ntru_rand_prod(N, params->df1, params->df2, params->df3, params->df3, &t->poly.prod, &w->rand_ctx)) {
+                w->retcode = NTRU_ERR_PRNG;
+                break;
+            }
+        }
+        else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        {
+            t->prod_flag = 0;
+            if (!ntru_rand_tern(N, params->df1, params->df1, &t->poly.tern, &w->rand_ctx)) {
+                w->retcode = NTRU_ERR_PRNG;
+                break;
+            }
+        }
+        if (ntru_invert(t, q-1, &w->fq)) {
+            w->found = 1;
+            /* lower *best to cand unless a lower candidate got there first */
+            uint32_t best = __atomic_load_n(w->best, __ATOMIC_RELAXED);
+            while (w->cand<best && !__atomic_compare_exchange_n(w->best, &best, w->cand, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+            break;
+        }
+        w->cand += w->num_workers;
+    }
+    /* a failed worker stops the others */
+    if (w->retcode != NTRU_SUCCESS)
+        __atomic_store_n(w->best, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+uint8_t ntru_gen_key_pair_par(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx, uint8_t num_threads) {
+    if (num_threads < 2)
+        return ntru_gen_key_pair(params, kp, rand_ctx);
+    if (num_threads > NTRU_KEYGEN_MAX_THREADS)
+        num_threads = NTRU_KEYGEN_MAX_THREADS;
+
+    ntru_set_optimized_impl();
+    NTRU_PROBE1(keygen_entry, params->N);
+    NTRU_PROF_START(t);
+
+    /* every exit below goes through keygen_return and the profiler */
+    uint16_t q = params->q;
+    uint8_t result = NTRU_SUCCESS;
+    if (q & (q-1))   /* check that modulus is a power of 2 */
+        result = NTRU_ERR_INVALID_PARAM;
+
+    uint8_t seed[NTRU_PRIV_SEED_LEN];
+    if (result==NTRU_SUCCESS && ntru_rand_generate(seed, sizeof seed, rand_ctx)!=NTRU_SUCCESS)
+        result = NTRU_ERR_PRNG;
+
+    /*
+     * One thread samples g while the others sample and invert candidates for t.
+     * The RNGs are set up here so that a failure stops keygen before any thread starts.
+     */
+    uint32_t num_workers = num_threads - 1;
+    uint32_t best = UINT32_MAX;
+    NtruKeygenWorker workers[NTRU_KEYGEN_MAX_THREADS-1];
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    NtruRandContext g_rand_ctx;
+    if (result == NTRU_SUCCESS)
+        result = ntru_seed_rand_init(seed, NTRU_SEED_LABEL_G, &rng, &g_rand_ctx);
+    uint8_t g_rand_init = result == NTRU_SUCCESS;
+    uint32_t num_init = 0;   /* #workers whose RNG has been initialized */
+    while (num_init<num_workers && result==NTRU_SUCCESS) {
+        NtruKeygenWorker *w = &workers[num_init];
+        w->params = params;
+        w->idx = num_init;
+        w->num_workers = num_workers;
+        w->best = &best;
+        memset(&w->t, 0, sizeof w->t);
+        w->fq.N = 0;
+        w->found = 0;
+        w->retcode = NTRU_SUCCESS;
+        result = ntru_seed_rand_init(seed, NTRU_SEED_LABEL_PAR+num_init, &rng, &w->rand_ctx);
+        if (result == NTRU_SUCCESS)
+            num_init++;
+    }
+    memset(seed, 0, sizeof seed);
+
+    /* if a thread cannot be started, its worker runs in this thread after g */
+    uint8_t started[NTRU_KEYGEN_MAX_THREADS-1];
+    uint32_t i;
+    for (i=0; i<num_init; i++)
+        started[i] = result==NTRU_SUCCESS && pthread_create(&workers[i].thread, NULL, ntru_keygen_worker, &workers[i])==0;
+
+    NtruPrivPoly g;
+    memset(&g, 0, sizeof g);
+    if (result == NTRU_SUCCESS) {
+        result = ntru_gen_g(params, &g, &g_rand_ctx);
+        if (result != NTRU_SUCCESS)
+            __atomic_store_n(&best, 0, __ATOMIC_RELEASE);
+    }
+    for (i=0; i<num_init; i++) {
+        if (started[i])
+            pthread_join(workers[i].thread, NULL);
+        else if (result == NTRU_SUCCESS)
+            ntru_keygen_worker(&workers[i]);
+    }
+
+    /* the winner is the worker whose last candidate is number best */
+    NtruKeygenWorker *winner = NULL;
+    for (i=0; i<num_init; i++) {
+        NtruKeygenWorker *w = &workers[i];
+        if (w->retcode != NTRU_SUCCESS && result == NTRU_SUCCESS)
+            result = w->retcode;
+        if (w->found && w->cand==best)
+            winner = w;
+    }
+    if (result==NTRU_SUCCESS && winner==NULL)
+        result = NTRU_ERR_PRNG;
+
+    if (result == NTRU_SUCCESS) {
+        kp->priv.q = q;
+        kp->priv.t = winner->t;
+        NtruIntPoly *h = &kp->pub.h;
+        if (ntru_mult_priv(&g, &winner->fq, h, q-1)) {
+            ntru_mult_fac(h, 3);
+            ntru_mod_mask(h, q-1);
+            kp->pub.q = q;
+        }
+        else
+            result = NTRU_ERR_INVALID_PARAM;
+    }
+
+    ntru_clear_priv(&g);
+    if (g_rand_init)
+        ntru_rand_release(&g_rand_ctx);
+    for (i=0; i<num_init; i++) {
+        ntru_clear_priv(&workers[i].t);
+        ntru_clear_int(&workers[i].fq);
+        ntru_rand_release(&workers[i].rand_ctx);
+    }
+    NTRU_PROBE1(keygen_return, result);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_KEYGEN, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_KEYGEN);
+    return result;
+}
+
 /**
  * @brief byte array to ternary polynomial
  *
@@ -321,6 +633,11 @@ uint8_t ntru_to_sves(NtruIntPoly *poly, uint8_t *data) {
     return valid;
 }
 
+uint16_t ntru_sdata_len(const NtruEncParams *params, uint16_t msg_len) {
+    uint16_t blen = params->db / 8;
+    return sizeof(params->oid) + msg_len + blen + blen;
+}
+
 /**
  * @brief Seed generation
  *
@@ -370,6 +687,8 @@ void ntru_gen_tern_poly(NtruIGFState *s, uint16_t df, NtruTernPoly *p) {
             r[idx] = 1;
             t++;
         }
+        else
+            NTRU_PROF_INC(igf_duplicates);
     }
     t = 0;
     while (t < df) {
@@ -379,42 +698,38 @@ void ntru_gen_tern_poly(NtruIGFState *s, uint16_t df, NtruTernPoly *p) {
             r[idx] = 1;
             t++;
         }
+        else
+            NTRU_PROF_INC(igf_duplicates);
     }
 }
 
-void ntru_gen_blind_poly(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruPrivPoly *r) {
-    NtruIGFState s;
-    ntru_IGF_init(seed, seed_len, params, &s);
-
+/* generates a blinding polynomial from an initialized IGF state */
+void ntru_gen_blind_poly_igf(NtruIGFState *s, const NtruEncParams *params, NtruPrivPoly *r) {
+    NTRU_PROF_START(t);
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
     if (params->prod_flag) {
-        r->poly.prod.N = s.N;
-        ntru_gen_tern_poly(&s, params->df1, &r->poly.prod.f1);
-        ntru_gen_tern_poly(&s, params->df2, &r->poly.prod.f2);
-        ntru_gen_tern_poly(&s, params->df3, &r->poly.prod.f3);
+        r->poly.prod.N = s->N;
+        ntru_gen_tern_poly(s, params->df1, &r->poly.prod.f1);
+        ntru_gen_tern_poly(s, params->df2, &r->poly.prod.f2);
+        ntru_gen_tern_poly(s, params->df3, &r->poly.prod.f3);
     }
     else
 #endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     {
-        r->poly.tern.N = s.N;
-        ntru_gen_tern_poly(&s, params->df1, &r->poly.tern);
+        r->poly.tern.N = s->N;
+        ntru_gen_tern_poly(s, params->df1, &r->poly.tern);
     }
     r->prod_flag = params->prod_flag;
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_IGF, t);
 }
 
-/* All elements of p->coeffs must be in the [0..2] range */
-uint8_t ntru_check_rep_weight(NtruIntPoly *p, uint16_t dm0) {
-    uint16_t i;
-    uint16_t weights[3];
-    weights[0] = weights[1] = weights[2] = 0;
-
-    for (i=0; i<p->N; i++)
-        weights[p->coeffs[i]]++;
-
-    return (weights[0]>=dm0 && weights[1]>=dm0 && weights[2]>=dm0);
+void ntru_gen_blind_poly(uint8_t *seed, uint16_t seed_len, const NtruEncParams *params, NtruPrivPoly *r) {
+    NtruIGFState s;
+    ntru_IGF_init(seed, seed_len, params, &s);
+    ntru_gen_blind_poly_igf(&s, params, r);
 }
 
-uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc) {
+uint8_t ntru_encrypt_sdata(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc, uint8_t *sdata_out) {
     ntru_set_optimized_impl();
 
     uint16_t N = params->N;
@@ -430,11 +745,16 @@ uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const N
     if (msg_len > max_len_bytes)
         return NTRU_ERR_MSG_TOO_LONG;
 
+    NTRU_PROBE2(encrypt_entry, N, msg_len);
+    NTRU_PROF_START(t);
+    uint8_t retcode = NTRU_SUCCESS;
     for (;;) {
         /* M = b|octL|msg|p0 */
         uint8_t b[db/8];
-        if (ntru_rand_generate(b, db/8, rand_ctx) != NTRU_SUCCESS)
-            return NTRU_ERR_PRNG;
+        if (ntru_rand_generate(b, db/8, rand_ctx) != NTRU_SUCCESS) {
+            retcode = NTRU_ERR_PRNG;
+            break;
+        }
 
         uint16_t M_len = db/8 + 1 + max_len_bytes + 1;
         uint8_t M[M_len];
@@ -449,78 +769,215 @@ uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const N
         NtruIntPoly mtrin;
         ntru_from_sves((uint8_t*)&M, M_len, N, &mtrin);
 
-        uint16_t blen = params->db / 8;
-        uint16_t sdata_len = sizeof(params->oid) + msg_len + blen + blen;
-        uint8_t sdata[sdata_len];
-        ntru_get_seed(msg, msg_len, &pub->h, (uint8_t*)&b, params, (uint8_t*)&sdata);
+        uint16_t sdata_len = ntru_sdata_len(params, msg_len);
+        uint8_t sdata_local[sdata_out!=NULL ? 1 : sdata_len];
+        uint8_t *sdata = sdata_out!=NULL ? sdata_out : sdata_local;
+        NTRU_PROBE(seed_start);
+        ntru_get_seed(msg, msg_len, &pub->h, (uint8_t*)&b, params, sdata);
+        NTRU_PROBE(seed_done);
 
         NtruIntPoly R;
         NtruPrivPoly r;
-        ntru_gen_blind_poly((uint8_t*)&sdata, sdata_len, params, &r);
-        if (!ntru_mult_priv(&r, &pub->h, &R, q-1))
-            return NTRU_ERR_INVALID_PARAM;
+        NTRU_PROBE(blind_start);
+        ntru_gen_blind_poly(sdata, sdata_len, params, &r);
+        NTRU_PROBE(blind_done);
+        NTRU_PROBE(mult_start);
+        uint8_t mult_ok = ntru_mult_priv(&r, &pub->h, &R, q-1);
+        NTRU_PROBE(mult_done);
+        if (!mult_ok) {
+            retcode = NTRU_ERR_INVALID_PARAM;
+            break;
+        }
         uint16_t oR4_len = (N*2+7) / 8;
         uint8_t oR4[oR4_len];
         ntru_to_arr4(&R, (uint8_t*)&oR4);
         NtruIntPoly mask;
+        NTRU_PROBE(mgf_start);
         ntru_MGF((uint8_t*)&oR4, oR4_len, params, &mask);
-        ntru_add(&mtrin, &mask);
-
-        ntru_mod3(&mtrin);
-
-        if (!ntru_check_rep_weight(&mtrin, dm0))
+        NTRU_PROBE(mgf_done);
+
+        /* mtrin = (mtrin+mask) mod 3, R += mtrin; R is discarded if the weights are off */
+        uint16_t weights[3];
+        ntru_encrypt_post(&mtrin, &mask, &R, weights);
+        if (weights[0]<dm0 || weights[1]<dm0 || weights[2]<dm0) {
+            NTRU_PROF_INC(encrypt_retries);
+            NTRU_PROBE(encrypt_retry);
             continue;
+        }
 
-        ntru_add(&R, &mtrin);
         ntru_to_arr(&R, q, enc);
-        return NTRU_SUCCESS;
+        break;
     }
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_ENCRYPT, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_ENCRYPT);
+    NTRU_PROBE1(encrypt_return, retcode);
+    return retcode;
 }
 
-void ntru_decrypt_poly(NtruIntPoly *e, NtruEncPrivKey *priv, uint16_t q, NtruIntPoly *d) {
-    ntru_mult_priv(&priv->t, e, d, q-1);
-    ntru_mult_fac(d, 3);
-    ntru_add(d, e);
-    ntru_mod_center(d, q);
-    ntru_mod3(d);
+uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc) {
+    return ntru_encrypt_sdata(msg, msg_len, pub, params, rand_ctx, enc, NULL);
 }
 
-uint8_t ntru_decrypt(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len) {
+/*
+ * Encrypts the same message for num recipients whose hashes are run together.
+ * M_tmpl is the encoded message with room for b at the start; sdata_tmpl is
+ * OID|m, followed by room for b and htrunc. Sets bit j of *retry if recipient
+ * j has to be encrypted again because the weights of its ciphertext were off.
+ */
+uint8_t ntru_encrypt_lanes(uint8_t *M_tmpl, uint16_t M_len, uint8_t *sdata_tmpl, uint16_t sdata_len, NtruEncPubKey **pub, uint8_t num, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t **enc, uint8_t *retry) {
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    uint16_t blen = params->db / 8;
+    uint16_t dm0 = params->dm0;
+    uint16_t prefix_len = sdata_len - blen - blen;
+
+    /* one call for the random bits of all recipients */
+    uint8_t b[num*blen];
+    if (ntru_rand_generate(b, num*blen, rand_ctx) != NTRU_SUCCESS)
+        return NTRU_ERR_PRNG;
+
+    uint8_t sdata[num][sdata_len];
+    uint8_t *sdata_ptr[num];
+    uint8_t j;
+    for (j=0; j<num; j++) {
+        uint8_t bh[ntru_enc_len(params)];
+        ntru_to_arr(&pub[j]->h, q, bh);
+        memcpy(sdata[j], sdata_tmpl, prefix_len);
+        memcpy(sdata[j]+prefix_len, b+j*blen, blen);
+        memcpy(sdata[j]+prefix_len+blen, bh, params->pklen/8);
+        sdata_ptr[j] = sdata[j];
+    }
+
+    NtruIGFState s[num];
+    ntru_IGF_init_multi(sdata_ptr, sdata_len, params, s, num);
+
+    NtruIntPoly R[num];
+    uint16_t oR4_len = (N*2+7) / 8;
+    uint8_t oR4[num][oR4_len];
+    uint8_t *oR4_ptr[num];
+    for (j=0; j<num; j++) {
+        NtruPrivPoly r;
+        ntru_gen_blind_poly_igf(&s[j], params, &r);
+        if (!ntru_mult_priv(&r, &pub[j]->h, &R[j], q-1))
+            return NTRU_ERR_INVALID_PARAM;
+        ntru_to_arr4(&R[j], oR4[j]);
+        oR4_ptr[j] = oR4[j];
+    }
+
+    NtruIntPoly mask[num];
+    NtruIntPoly *mask_ptr[num];
+    for (j=0; j<num; j++)
+        mask_ptr[j] = &mask[j];
+    ntru_MGF_multi(oR4_ptr, oR4_len, params, mask_ptr, num);
+
+    *retry = 0;
+    for (j=0; j<num; j++) {
+        memcpy(M_tmpl, b+j*blen, blen);
+        NtruIntPoly mtrin;
+        ntru_from_sves(M_tmpl, M_len, N, &mtrin);
+
+        uint16_t weights[3];
+        ntru_encrypt_post(&mtrin, &mask[j], &R[j], weights);
+        if (weights[0]<dm0 || weights[1]<dm0 || weights[2]<dm0) {
+            *retry |= 1 << j;
+            NTRU_PROF_INC(encrypt_retries);
+        }
+        else
+            ntru_to_arr(&R[j], q, enc[j]);
+    }
+    memset(M_tmpl, 0, blen);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_encrypt_multi(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, uint32_t num_pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc) {
     ntru_set_optimized_impl();
 
-    uint16_t N = params->N;
     uint16_t q = params->q;
-    uint16_t db = params->db;
     uint16_t max_len_bytes = ntru_max_msg_len(params);
-    uint16_t dm0 = params->dm0;
 
     if (q & (q-1))   /* check that modulus is a power of 2 */
         return NTRU_ERR_INVALID_PARAM;
     if (max_len_bytes > 255)
         return NTRU_ERR_INVALID_MAX_LEN;
-
-    uint16_t blen = db / 8;
+    if (msg_len > max_len_bytes)
+        return NTRU_ERR_MSG_TOO_LONG;
+    NTRU_PROF_START(t);
+
+    /* M = b|octL|msg|p0; b differs for each recipient, the rest is the same */
+    uint16_t blen = params->db / 8;
+    uint16_t M_len = blen + 1 + max_len_bytes + 1;
+    uint8_t M[M_len];
+    memset(M, 0, M_len);
+    M[blen] = msg_len;
+    memcpy(M+blen+1, msg, msg_len);
+
+    /* sdata = OID|m|b|htrunc; only OID|m is the same for all recipients */
+    uint16_t sdata_len = sizeof(params->oid) + msg_len + blen + blen;
+    uint8_t sdata[sdata_len];
+    memcpy(sdata, &params->oid, sizeof params->oid);
+    memcpy(sdata+sizeof params->oid, msg, msg_len);
+
+    uint16_t enc_len = ntru_enc_len(params);
+    NtruEncPubKey *pub_lanes[NTRU_ENCRYPT_MULTI_LANES];
+    uint8_t *enc_lanes[NTRU_ENCRYPT_MULTI_LANES];
+    uint32_t next = 0;   /* the next recipient that has not been added to a lane */
+    uint8_t num_lanes = 0;
     uint8_t retcode = NTRU_SUCCESS;
+    while (num_lanes>0 || next<num_pub) {
+        /* fill lanes that are free or whose recipient was done */
+        while (num_lanes<NTRU_ENCRYPT_MULTI_LANES && next<num_pub) {
+            pub_lanes[num_lanes] = &pub[next];
+            enc_lanes[num_lanes] = enc + (size_t)next*enc_len;
+            num_lanes++;
+            next++;
+        }
 
-    NtruIntPoly e;
-    ntru_from_arr(enc, N, q, &e);
-    NtruIntPoly ci;
-    ntru_decrypt_poly(&e, &kp->priv, q, &ci);
+        uint8_t retry;
+        retcode = ntru_encrypt_lanes(M, M_len, sdata, sdata_len, pub_lanes, num_lanes, params, rand_ctx, enc_lanes, &retry);
+        if (retcode != NTRU_SUCCESS)
+            break;
 
-    if (!ntru_check_rep_weight(&ci, dm0) && retcode==NTRU_SUCCESS)
-        retcode = NTRU_ERR_DM0_VIOLATION;
+        /* keep the recipients that need another try */
+        uint8_t j;
+        uint8_t num_retry = 0;
+        for (j=0; j<num_lanes; j++)
+            if (retry & (1<<j)) {
+                pub_lanes[num_retry] = pub_lanes[j];
+                enc_lanes[num_retry] = enc_lanes[j];
+                num_retry++;
+            }
+        num_lanes = num_retry;
+    }
+
+    memset(M, 0, M_len);
+    memset(sdata, 0, sdata_len);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_ENCRYPT, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_ENCRYPT);
+    return retcode;
+}
 
-    NtruIntPoly cR = e;
-    ntru_sub(&cR, &ci);
-    ntru_mod_mask(&cR, q-1);
+/*
+ * Decodes the message from ci and cR and checks it against the public key
+ * (MGF, SVES decoding, and re-encryption). retcode is the result of the
+ * checks done so far; the first error is returned. If sdata_out is not NULL,
+ * the blinding polynomial seed is left there.
+ */
+uint8_t ntru_decrypt_finish(NtruIntPoly *ci, NtruIntPoly *cR, uint8_t retcode, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len, uint8_t *sdata_out) {
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    uint16_t db = params->db;
+    uint16_t max_len_bytes = ntru_max_msg_len(params);
+    uint16_t blen = db / 8;
 
     uint16_t coR4_len = (N*2+7) / 8;
     uint8_t coR4[coR4_len];
-    ntru_to_arr4(&cR, (uint8_t*)&coR4);
+    ntru_to_arr4(cR, (uint8_t*)&coR4);
 
     NtruIntPoly mask;
+    NTRU_PROBE(mgf_start);
     ntru_MGF((uint8_t*)&coR4, coR4_len, params, &mask);
-    NtruIntPoly cmtrin = ci;
+    NTRU_PROBE(mgf_done);
+    NtruIntPoly cmtrin = *ci;
     ntru_sub(&cmtrin, &mask);
     ntru_mod3(&cmtrin);
     uint16_t cM_len_bits = (N*3+1) / 2;
@@ -549,21 +1006,178 @@ uint8_t ntru_decrypt(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *para
         if (*i && retcode==NTRU_SUCCESS)
             retcode = NTRU_ERR_NO_ZERO_PAD;
 
-    uint16_t sdata_len = sizeof(params->oid) + cl + blen + db/8;
-    uint8_t sdata[sdata_len];
-    ntru_get_seed(dec, cl, &kp->pub.h, (uint8_t*)&cb, params, (uint8_t*)&sdata);
+    uint16_t sdata_len = ntru_sdata_len(params, cl);
+    uint8_t sdata_local[sdata_out!=NULL ? 1 : sdata_len];
+    uint8_t *sdata = sdata_out!=NULL ? sdata_out : sdata_local;
+    NTRU_PROBE(seed_start);
+    ntru_get_seed(dec, cl, &kp->pub.h, (uint8_t*)&cb, params, sdata);
+    NTRU_PROBE(seed_done);
 
     NtruPrivPoly cr;
-    ntru_gen_blind_poly((uint8_t*)&sdata, sdata_len, params, &cr);
+    NTRU_PROBE(blind_start);
+    ntru_gen_blind_poly(sdata, sdata_len, params, &cr);
+    NTRU_PROBE(blind_done);
     NtruIntPoly cR_prime;
+    NTRU_PROBE(recheck_start);
     ntru_mult_priv(&cr, &kp->pub.h, &cR_prime, q-1);
-    if (!ntru_equals_int(&cR_prime, &cR) && retcode==NTRU_SUCCESS)
+    if (!ntru_equals_int(&cR_prime, cR) && retcode==NTRU_SUCCESS)
         retcode = NTRU_ERR_INVALID_ENCODING;
+    NTRU_PROBE(recheck_done);
 
     *dec_len = cl;
     return retcode;
 }
 
+uint8_t ntru_decrypt_sdata(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len, uint8_t *sdata_out) {
+    ntru_set_optimized_impl();
+
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    uint16_t max_len_bytes = ntru_max_msg_len(params);
+    uint16_t dm0 = params->dm0;
+
+    if (q & (q-1))   /* check that modulus is a power of 2 */
+        return NTRU_ERR_INVALID_PARAM;
+    if (max_len_bytes > 255)
+        return NTRU_ERR_INVALID_MAX_LEN;
+
+    NTRU_PROBE1(decrypt_entry, N);
+    NTRU_PROF_START(t);
+    uint8_t retcode = NTRU_SUCCESS;
+
+    NtruIntPoly e;
+    ntru_from_arr(enc, N, q, &e);
+    NtruIntPoly ci;
+    NTRU_PROBE(mult_start);
+    ntru_mult_priv(&kp->priv.t, &e, &ci, q-1);
+    NTRU_PROBE(mult_done);
+
+    /* ci = center(3*ci+e) mod 3, cR = (e-ci) mod q */
+    NtruIntPoly cR;
+    uint16_t weights[3];
+    ntru_decrypt_post(&ci, &e, q, &cR, weights);
+
+    if ((weights[0]<dm0 || weights[1]<dm0 || weights[2]<dm0) && retcode==NTRU_SUCCESS)
+        retcode = NTRU_ERR_DM0_VIOLATION;
+
+    retcode = ntru_decrypt_finish(&ci, &cR, retcode, kp, params, dec, dec_len, sdata_out);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_DECRYPT, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_DECRYPT);
+    NTRU_PROBE1(decrypt_return, retcode);
+    return retcode;
+}
+
+uint8_t ntru_decrypt(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len) {
+    return ntru_decrypt_sdata(enc, kp, params, dec, dec_len, NULL);
+}
+
+uint8_t ntru_decrypt_any(uint8_t *enc, NtruEncKeyPair *kp, uint32_t num_keys, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len, uint32_t *key_idx) {
+    ntru_set_optimized_impl();
+
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    uint16_t max_len_bytes = ntru_max_msg_len(params);
+    uint16_t dm0 = params->dm0;
+
+    if (q & (q-1))   /* check that modulus is a power of 2 */
+        return NTRU_ERR_INVALID_PARAM;
+    if (max_len_bytes > 255)
+        return NTRU_ERR_INVALID_MAX_LEN;
+
+    NTRU_PROBE1(decrypt_entry, N);
+    NTRU_PROF_START(t);
+
+    /* decode e once; it stays in cache for all the multiplications */
+    NtruIntPoly e;
+    ntru_from_arr(enc, N, q, &e);
+
+    uint8_t retcode = NTRU_ERR_DM0_VIOLATION;
+    uint32_t k;
+    for (k=0; k<num_keys; k++) {
+        NtruIntPoly ci;
+        NTRU_PROBE(mult_start);
+        ntru_mult_priv(&kp[k].priv.t, &e, &ci, q-1);
+        NTRU_PROBE(mult_done);
+        NtruIntPoly cR;
+        uint16_t weights[3];
+        ntru_decrypt_post(&ci, &e, q, &cR, weights);
+
+        /* only keys that pass the weight check get the MGF and re-encryption check */
+        if (weights[0]<dm0 || weights[1]<dm0 || weights[2]<dm0)
+            continue;
+        retcode = ntru_decrypt_finish(&ci, &cR, NTRU_SUCCESS, &kp[k], params, dec, dec_len, NULL);
+        if (retcode == NTRU_SUCCESS) {
+            *key_idx = k;
+            break;
+        }
+    }
+
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_DECRYPT, t);
+    NTRU_PROF_REPORT(NTRU_PROF_STAGE_DECRYPT);
+    NTRU_PROBE1(decrypt_return, retcode);
+    return retcode;
+}
+
+uint8_t ntru_decrypt_precheck(uint8_t *enc, uint16_t enc_len, NtruEncKeyPair *kp, const NtruEncParams *params, NtruPrecheckStats *stats) {
+    uint16_t N = params->N;
+    uint16_t q = params->q;
+    uint8_t retcode = NTRU_SUCCESS;
+
+    if (stats != NULL)
+        stats->num_checked++;
+    uint16_t N_priv;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (kp->priv.t.prod_flag)
+        N_priv = kp->priv.t.poly.prod.N;
+    else
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+        N_priv = kp->priv.t.poly.tern.N;
+    if ((q&(q-1)) || kp->pub.q!=q || kp->priv.q!=q || kp->pub.h.N!=N || N_priv!=N) {
+        retcode = NTRU_ERR_INVALID_PARAM;
+        if (stats != NULL)
+            stats->num_bad_params++;
+    }
+    else if (enc_len != ntru_enc_len(params)) {
+        retcode = NTRU_ERR_INVALID_ENCODING;
+        if (stats != NULL)
+            stats->num_bad_length++;
+    }
+    else {
+        /* ntru_to_arr() fills the last byte from the least significant bit up */
+        uint8_t pad_bits = enc_len*8 - N*ntru_log2(q);
+        if (pad_bits>0 && enc[enc_len-1]>>(8-pad_bits)) {
+            retcode = NTRU_ERR_INVALID_ENCODING;
+            if (stats != NULL)
+                stats->num_bad_padding++;
+        }
+    }
+
+    if (retcode==NTRU_SUCCESS && stats!=NULL)
+        stats->num_accepted++;
+    return retcode;
+}
+
+uint8_t ntru_decrypt_batch(uint8_t **enc, uint16_t *enc_len, uint32_t num, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t **dec, uint16_t *dec_len, uint8_t *retcodes, NtruPrecheckStats *stats) {
+    /* reject invalid items up front so they don't hold up the valid ones */
+    uint32_t i;
+    for (i=0; i<num; i++)
+        retcodes[i] = ntru_decrypt_precheck(enc[i], enc_len[i], kp, params, stats);
+
+    uint8_t retcode = NTRU_SUCCESS;
+    for (i=0; i<num; i++) {
+        if (retcodes[i] == NTRU_SUCCESS) {
+            retcodes[i] = ntru_decrypt(enc[i], kp, params, dec[i], &dec_len[i]);
+            if (retcodes[i]!=NTRU_SUCCESS && stats!=NULL)
+                stats->num_decrypt_failed++;
+        }
+        else
+            dec_len[i] = 0;
+        if (retcodes[i]!=NTRU_SUCCESS && retcode==NTRU_SUCCESS)
+            retcode = retcodes[i];
+    }
+    return retcode;
+}
+
 uint8_t ntru_max_msg_len(const NtruEncParams *params) {
     uint16_t N = params->N;
     uint8_t llen = 1;   /* ceil(log2(max_len)) */
@@ -39,6 +39,67 @@ uint8_t ntruprime_gen_key_pair(const NtruPrimeParams *params, NtruPrimeKeyPair *
  */
 uint8_t ntru_gen_key_pair(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx);
 
+/** max number of threads used by ntru_gen_key_pair_par() */
+#define NTRU_KEYGEN_MAX_THREADS 4
+
+/**
+ * @brief Multithreaded NtruEncrypt key generation
+ *
+ * Generates a NtruEncrypt key pair like ntru_gen_key_pair(), but with lower latency.
+ * One thread samples g while num_threads-1 threads sample private key candidates and
+ * invert them speculatively; the lowest-numbered invertible candidate is used, so a
+ * deterministic RNG still yields a deterministic key pair for a given num_threads.
+ * The key pair differs from the one ntru_gen_key_pair() would generate from the same
+ * random seed. Only NTRU_PRIV_SEED_LEN bytes are drawn from rand_ctx.
+ * This only helps if num_threads CPUs are available; on a busy or single-CPU machine,
+ * ntru_gen_key_pair() is faster.
+ *
+ * @param params the NtruEncrypt parameters to use
+ * @param kp pointer to write the key pair to (output parameter)
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param num_threads the number of threads including the calling thread; values above
+ *                    NTRU_KEYGEN_MAX_THREADS are reduced to it, and values below 2 make
+ *                    this function call ntru_gen_key_pair()
+ * @return NTRU_SUCCESS for success, or a NTRU_ERR_ code for failure
+ */
+uint8_t ntru_gen_key_pair_par(const NtruEncParams *params, NtruEncKeyPair *kp, NtruRandContext *rand_ctx, uint8_t num_threads);
+
+/** length of the seeds used by ntru_gen_key_pair_seed() and ntru_priv_from_seed() */
+#define NTRU_PRIV_SEED_LEN 32
+
+/**
+ * @brief NtruEncrypt key generation from a seed
+ *
+ * Generates a NtruEncrypt key pair whose private and public key can be recomputed from a
+ * NTRU_PRIV_SEED_LEN-byte seed with ntru_priv_from_seed(), so only the seed needs to be stored.
+ * The seed is drawn from rand_ctx. Seeds whose private polynomial is not invertible are
+ * discarded, so every seed returned by this function expands to a valid key.
+ *
+ * @param params the NtruEncrypt parameters to use
+ * @param kp pointer to write the key pair to (output parameter)
+ * @param seed output parameter; a pointer to store the NTRU_PRIV_SEED_LEN-byte seed
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @return NTRU_SUCCESS for success, or a NTRU_ERR_ code for failure
+ */
+uint8_t ntru_gen_key_pair_seed(const NtruEncParams *params, NtruEncKeyPair *kp, uint8_t *seed, NtruRandContext *rand_ctx);
+
+/**
+ * @brief NtruEncrypt private key from a seed
+ *
+ * Recomputes the private key, and optionally the public key, generated by
+ * ntru_gen_key_pair_seed(). The private key only takes a deterministic sampling
+ * step; the public key additionally requires an inversion, so pass NULL for pub
+ * if it is not needed.
+ *
+ * @param params the NtruEncrypt parameters the seed was generated with
+ * @param seed a NTRU_PRIV_SEED_LEN-byte seed
+ * @param priv output parameter; a pointer to store the private key
+ * @param pub output parameter; a pointer to store the public key, or NULL
+ * @return NTRU_SUCCESS for success, NTRU_ERR_INVALID_KEY if the seed does not
+ *         yield an invertible private polynomial, or another NTRU_ERR_ code
+ */
+uint8_t ntru_priv_from_seed(const NtruEncParams *params, uint8_t *seed, NtruEncPrivKey *priv, NtruEncPubKey *pub);
+
 /**
  * @brief NtruEncrypt key generation with multiple public keys
  *
@@ -100,6 +161,64 @@ uint8_t ntru_gen_pub(const NtruEncParams *params, NtruEncPrivKey *priv, NtruEncP
  */
 uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc);
 
+/**
+ * @brief Blinding polynomial seed length
+ *
+ * Returns the length of the seed sData = OID|m|b|htrunc that SVES derives the
+ * blinding polynomial from, for a message of msg_len bytes.
+ *
+ * @param params the NtruEncrypt parameters
+ * @param msg_len the length of the message
+ * @return the seed length in bytes
+ */
+uint16_t ntru_sdata_len(const NtruEncParams *params, uint16_t msg_len);
+
+/**
+ * @brief NtruEncrypt Encryption with seed output
+ *
+ * Same as ntru_encrypt() but also leaves the blinding polynomial seed sData in
+ * sdata. sData contains the random bits b of the ciphertext, so a key
+ * encapsulation mechanism can derive its shared secret from it without
+ * generating extra randomness (see kem.h).
+ *
+ * @param msg The message to encrypt
+ * @param msg_len length of msg. Must not exceed ntru_max_msg_len(params).
+ * @param pub the public key to encrypt the message with
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param enc output parameter; a pointer to store the encrypted message. Must accommodate
+              ntru_enc_len(params) bytes.
+ * @param sdata output parameter; ntru_sdata_len(params, msg_len) bytes to store the seed
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_encrypt_sdata(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc, uint8_t *sdata);
+
+/* #recipients encrypted together by ntru_encrypt_multi() */
+#define NTRU_ENCRYPT_MULTI_LANES 8
+
+/**
+ * @brief NtruEncrypt Encryption for multiple recipients
+ *
+ * Encrypts one message for num_pub public keys. The result is the same as calling
+ * ntru_encrypt() once for each key, but the message is only encoded once, the random
+ * data is generated in one call, and the index and mask generation hashes of
+ * NTRU_ENCRYPT_MULTI_LANES recipients are run together so the SIMD lanes stay full.
+ * Each ciphertext still uses its own random data.
+ * rand_ctx is not thread-safe; to use multiple threads, split pub into parts and give
+ * each thread its own rand_ctx.
+ *
+ * @param msg The message to encrypt
+ * @param msg_len length of msg. Must not exceed ntru_max_msg_len(params).
+ * @param pub an array of num_pub public keys
+ * @param num_pub the number of public keys
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param enc output parameter; num_pub*ntru_enc_len(params) bytes to store the encrypted
+ *            messages. The i-th ciphertext starts at enc+i*ntru_enc_len(params).
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_encrypt_multi(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, uint32_t num_pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc);
+
 /**
  * @brief NtruEncrypt Decryption
  *
@@ -117,6 +236,122 @@ uint8_t ntru_encrypt(uint8_t *msg, uint16_t msg_len, NtruEncPubKey *pub, const N
  */
 uint8_t ntru_decrypt(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len);
 
+/**
+ * @brief NtruEncrypt Decryption with seed output
+ *
+ * Same as ntru_decrypt() but also leaves the blinding polynomial seed sData that
+ * was recomputed from the decrypted message in sdata. It is only meaningful if
+ * NTRU_SUCCESS is returned.
+ *
+ * @param enc The message to decrypt
+ * @param kp a key pair that contains the public key the message was encrypted
+             with, and the corresponding private key
+ * @param params the NtruEncrypt parameters the message was encrypted with
+ * @param dec output parameter; a pointer to store the decrypted message. Must accommodate
+              ntru_max_msg_len(params) bytes.
+ * @param dec_len output parameter; pointer to store the length of dec
+ * @param sdata output parameter; ntru_sdata_len(params, ntru_max_msg_len(params)) bytes
+ *              to store the seed, which is ntru_sdata_len(params, *dec_len) bytes long
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_decrypt_sdata(uint8_t *enc, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len, uint8_t *sdata);
+
+/**
+ * @brief NtruEncrypt Decryption with one of several keys
+ *
+ * Decrypts a message that was encrypted for one of num_keys key pairs, e.g. during key
+ * rotation. The ciphertext is decoded once and multiplied by each private key in turn.
+ * Keys whose result fails the dm0 weight check are skipped without running the MGF and
+ * re-encryption check. The first key that decrypts the message is reported in key_idx.
+ *
+ * @param enc The message to decrypt
+ * @param kp an array of num_keys key pairs
+ * @param num_keys the number of key pairs
+ * @param params the NtruEncrypt parameters the message was encrypted with
+ * @param dec output parameter; a pointer to store the decrypted message. Must accommodate
+              ntru_max_msg_len(params) bytes.
+ * @param dec_len output parameter; pointer to store the length of dec
+ * @param key_idx output parameter; the index of the key pair that decrypted the message
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure. If no key
+ *         pair can decrypt the message, the error of the last key pair that passed the
+ *         weight check is returned, or NTRU_ERR_DM0_VIOLATION if none did.
+ */
+uint8_t ntru_decrypt_any(uint8_t *enc, NtruEncKeyPair *kp, uint32_t num_keys, const NtruEncParams *params, uint8_t *dec, uint16_t *dec_len, uint32_t *key_idx);
+
+/**
+ * Counters for ntru_decrypt_precheck() and ntru_decrypt_batch(). Not thread-safe;
+ * use one instance per thread.
+ */
+typedef struct NtruPrecheckStats {
+    uint64_t num_checked;
+    uint64_t num_accepted;
+    uint64_t num_bad_length;     /* wrong ciphertext length for the parameter set */
+    uint64_t num_bad_padding;    /* nonzero bits after the last coefficient */
+    uint64_t num_bad_params;     /* key pair does not match the parameter set */
+    uint64_t num_decrypt_failed; /* passed the precheck but ntru_decrypt() failed */
+} NtruPrecheckStats;
+
+/**
+ * @brief Ciphertext pre-validation
+ *
+ * Performs checks that don't involve the private key and are much cheaper than
+ * ntru_decrypt(). The precheck is stricter than ntru_decrypt(): the latter
+ * ignores the unused bits in the last byte, so a ciphertext with nonzero padding
+ * is rejected here but may still decrypt successfully. The checks are:
+ *  - enc_len equals ntru_enc_len(params)
+ *  - the unused bits in the last byte of enc are zero
+ *  - the key pair matches N and q of the parameter set
+ * The ciphertext does not contain the parameter set OID, so ciphertexts for a
+ * different parameter set are only detected if their length or padding differs.
+ *
+ * @param enc the ciphertext
+ * @param enc_len the length of enc in bytes
+ * @param kp the key pair that will be used for decryption
+ * @param params the NtruEncrypt parameters that will be used for decryption
+ * @param stats counters to update, or NULL
+ * @return NTRU_SUCCESS if the ciphertext passes the checks, NTRU_ERR_INVALID_ENCODING
+ *         if its length or padding is wrong, or NTRU_ERR_INVALID_PARAM if the key
+ *         pair does not match the parameter set
+ */
+uint8_t ntru_decrypt_precheck(uint8_t *enc, uint16_t enc_len, NtruEncKeyPair *kp, const NtruEncParams *params, NtruPrecheckStats *stats);
+
+/**
+ * @brief Batch decryption with pre-validation
+ *
+ * Runs ntru_decrypt_precheck() on all ciphertexts first, then decrypts those that
+ * passed. The result of each item is stored in retcodes.
+ *
+ * @param enc an array of num ciphertexts
+ * @param enc_len an array of num ciphertext lengths
+ * @param num the number of ciphertexts
+ * @param kp a key pair that contains the public key the messages were encrypted
+             with, and the corresponding private key
+ * @param params the NtruEncrypt parameters the messages were encrypted with
+ * @param dec an array of num output buffers of ntru_max_msg_len(params) bytes each
+ * @param dec_len output parameter; an array of num elements to store the lengths of
+                  the decrypted messages
+ * @param retcodes output parameter; an array of num elements to store the result
+                   of each item
+ * @param stats counters to update, or NULL
+ * @return NTRU_SUCCESS if all ciphertexts were decrypted, otherwise the
+ *         result of the first item that failed
+ */
+uint8_t ntru_decrypt_batch(uint8_t **enc, uint16_t *enc_len, uint32_t num, NtruEncKeyPair *kp, const NtruEncParams *params, uint8_t **dec, uint16_t *dec_len, uint8_t *retcodes, NtruPrecheckStats *stats);
+
+/**
+ * @brief Constant-time mode
+ *
+ * Enables or disables constant-time multiplication by private polynomials.
+ * When enabled, key generation, encryption, and decryption multiply by
+ * ternary and product-form polynomials without memory accesses that depend
+ * on the positions of their nonzero coefficients. This is slower for
+ * parameter sets with large N and few nonzero coefficients.
+ * The setting is global and off by default.
+ *
+ * @param enable 1 to enable constant-time mode, 0 to disable it
+ */
+void ntru_set_constant_time(uint8_t enable);
+
 /**
  * @brief Maximum NtruEncrypt message length
  *
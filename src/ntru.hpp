@@ -0,0 +1,401 @@
+#ifndef NTRU_NTRU_HPP
+#define NTRU_NTRU_HPP
+
+/*
+ * Header-only C++20 interface to libntru. It adds owning key and RNG types,
+ * std::span-based encryption and decryption into caller buffers, parameter
+ * sets whose sizes are known at compile time, and std::pmr-allocated output
+ * buffers. Like the C API, functions return NTRU_SUCCESS or a NTRU_ERR_ code
+ * rather than throwing.
+ */
+
+#if __cplusplus < 202002L
+#error "ntru.hpp requires C++20"
+#endif
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <vector>
+#include "ntru.h"
+
+namespace ntru {
+
+namespace detail {
+
+constexpr uint8_t log2(uint16_t n) {
+    uint8_t log = 0;
+    while (n > 1) {
+        n /= 2;
+        log++;
+    }
+    return log;
+}
+
+/* a plain memset of an object that is about to die may be optimized away */
+inline void secure_zero(void *p, std::size_t len) noexcept {
+    volatile uint8_t *v = static_cast<volatile uint8_t*>(p);
+    while (len--)
+        *v++ = 0;
+}
+
+}   /* namespace detail */
+
+/**
+ * An NtruEncrypt parameter set. The fields duplicate the ones the lengths
+ * depend on so they can be evaluated at compile time; c points to the
+ * corresponding C parameter set.
+ */
+struct EncParams {
+    const NtruEncParams *c;
+    uint16_t N;
+    uint16_t q;
+    uint8_t prod_flag;
+    uint16_t df1;
+    uint16_t df2;
+    uint16_t df3;
+    uint16_t db;
+
+    /** Same as ntru_enc_len() */
+    constexpr uint16_t enc_len() const {
+        return (N*detail::log2(q)+7) / 8;
+    }
+
+    /** Same as ntru_pub_len() */
+    constexpr uint16_t pub_len() const {
+        return 4 + enc_len();
+    }
+
+    /** Same as ntru_priv_len() */
+    constexpr uint16_t priv_len() const {
+        uint8_t bits_per_idx = detail::log2(N-1) + 1;
+        if (prod_flag)
+            return 5 + 4+(bits_per_idx*2*df1+7)/8 + 4+(bits_per_idx*2*df2+7)/8 + 4+(bits_per_idx*2*df3+7)/8;
+        else
+            return 5 + 4 + (bits_per_idx*2*df1+7)/8;
+    }
+
+    /** Same as ntru_max_msg_len() */
+    constexpr uint8_t max_msg_len() const {
+        return N/2*3/8 - 1 - db/8;
+    }
+};
+
+inline constexpr EncParams ees401ep1 {&EES401EP1, 401, 2048, 0, 113, 0, 0, 112};
+inline constexpr EncParams ees449ep1 {&EES449EP1, 449, 2048, 0, 134, 0, 0, 128};
+inline constexpr EncParams ees677ep1 {&EES677EP1, 677, 2048, 0, 157, 0, 0, 192};
+inline constexpr EncParams ees1087ep2 {&EES1087EP2, 1087, 2048, 0, 120, 0, 0, 256};
+inline constexpr EncParams ees541ep1 {&EES541EP1, 541, 2048, 0, 49, 0, 0, 112};
+inline constexpr EncParams ees613ep1 {&EES613EP1, 613, 2048, 0, 55, 0, 0, 128};
+inline constexpr EncParams ees887ep1 {&EES887EP1, 887, 2048, 0, 81, 0, 0, 192};
+inline constexpr EncParams ees1171ep1 {&EES1171EP1, 1171, 2048, 0, 106, 0, 0, 256};
+inline constexpr EncParams ees659ep1 {&EES659EP1, 659, 2048, 0, 38, 0, 0, 112};
+inline constexpr EncParams ees761ep1 {&EES761EP1, 761, 2048, 0, 42, 0, 0, 128};
+inline constexpr EncParams ees1087ep1 {&EES1087EP1, 1087, 2048, 0, 63, 0, 0, 192};
+inline constexpr EncParams ees1499ep1 {&EES1499EP1, 1499, 2048, 0, 79, 0, 0, 256};
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+inline constexpr EncParams ees401ep2 {&EES401EP2, 401, 2048, 1, 8, 8, 6, 112};
+inline constexpr EncParams ees439ep1 {&EES439EP1, 439, 2048, 1, 9, 8, 5, 128};
+inline constexpr EncParams ees443ep1 {&EES443EP1, 443, 2048, 1, 9, 8, 5, 128};
+inline constexpr EncParams ees593ep1 {&EES593EP1, 593, 2048, 1, 10, 10, 8, 192};
+inline constexpr EncParams ees587ep1 {&EES587EP1, 587, 2048, 1, 10, 10, 8, 192};
+inline constexpr EncParams ees743ep1 {&EES743EP1, 743, 2048, 1, 11, 11, 15, 256};
+
+/** The C++ counterpart of ALL_PARAM_SETS, in the same order */
+inline constexpr std::array all_param_sets {ees401ep1, ees449ep1, ees677ep1, ees1087ep2, ees541ep1, ees613ep1, ees887ep1, ees1171ep1, ees659ep1, ees761ep1, ees1087ep1, ees1499ep1, ees401ep2, ees439ep1, ees443ep1, ees593ep1, ees587ep1, ees743ep1};
+#else
+inline constexpr std::array all_param_sets {ees401ep1, ees449ep1, ees677ep1, ees1087ep2, ees541ep1, ees613ep1, ees887ep1, ees1171ep1, ees659ep1, ees761ep1, ees1087ep1, ees1499ep1};
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+/** A ciphertext buffer whose size is fixed at compile time */
+template <const EncParams &P>
+using Ciphertext = std::array<uint8_t, P.enc_len()>;
+
+/** A plaintext buffer large enough for any message under P */
+template <const EncParams &P>
+using Plaintext = std::array<uint8_t, P.max_msg_len()>;
+
+/** A byte buffer that gets its memory from a std::pmr::memory_resource */
+using Buffer = std::pmr::vector<uint8_t>;
+
+/**
+ * A random number generator; see rand.h. Not copyable or movable because the
+ * C context points into the object.
+ */
+class RandContext {
+public:
+    /** Initializes a nondeterministic RNG such as NTRU_RNG_DEFAULT */
+    explicit RandContext(NtruRandGen gen) : gen_(gen), ctx_() {
+        status_ = ntru_rand_init(&ctx_, &gen_);
+    }
+
+    /** Initializes a deterministic RNG such as NTRU_RNG_CTR_DRBG; the seed is copied */
+    RandContext(NtruRandGen gen, std::span<const uint8_t> seed) : gen_(gen), ctx_() {
+        status_ = ntru_rand_init_det(&ctx_, &gen_, const_cast<uint8_t*>(seed.data()), seed.size());
+    }
+
+    RandContext(const RandContext&) = delete;
+    RandContext& operator=(const RandContext&) = delete;
+
+    ~RandContext() {
+        if (status_ == NTRU_SUCCESS)
+            ntru_rand_release(&ctx_);
+    }
+
+    /** NTRU_SUCCESS, or NTRU_ERR_PRNG if the RNG could not be initialized */
+    uint8_t status() const noexcept { return status_; }
+
+    NtruRandContext *get() noexcept { return &ctx_; }
+
+private:
+    NtruRandGen gen_;
+    NtruRandContext ctx_;
+    uint8_t status_;
+};
+
+/** An NtruEncrypt public key. Move-only; zeroized when destroyed or moved from. */
+class PubKey {
+public:
+    PubKey() noexcept : key_() {}
+
+    explicit PubKey(const NtruEncPubKey &key) noexcept : key_(key) {}
+
+    PubKey(const PubKey&) = delete;
+    PubKey& operator=(const PubKey&) = delete;
+
+    PubKey(PubKey &&other) noexcept : key_(other.key_) {
+        detail::secure_zero(&other.key_, sizeof other.key_);
+    }
+
+    PubKey& operator=(PubKey &&other) noexcept {
+        if (this != &other) {
+            key_ = other.key_;
+            detail::secure_zero(&other.key_, sizeof other.key_);
+        }
+        return *this;
+    }
+
+    ~PubKey() { detail::secure_zero(&key_, sizeof key_); }
+
+    /** Makes an independent copy; public keys are not secret but copies must be explicit */
+    PubKey clone() const noexcept { return PubKey(key_); }
+
+    /** Imports a key exported with export_to(); returns false if arr is too short */
+    bool import_from(std::span<const uint8_t> arr, const EncParams &params) noexcept {
+        if (arr.size() < params.pub_len())
+            return false;
+        ntru_import_pub(const_cast<uint8_t*>(arr.data()), &key_);
+        return true;
+    }
+
+    /** Writes params.pub_len() bytes to arr; returns false if arr is too short */
+    bool export_to(std::span<uint8_t> arr, const EncParams &params) const noexcept {
+        if (arr.size() < params.pub_len())
+            return false;
+        ntru_export_pub(const_cast<NtruEncPubKey*>(&key_), arr.data());
+        return true;
+    }
+
+    NtruEncPubKey *get() noexcept { return &key_; }
+    const NtruEncPubKey *get() const noexcept { return &key_; }
+
+private:
+    NtruEncPubKey key_;
+};
+
+/** An NtruEncrypt key pair. Move-only; zeroized when destroyed or moved from. */
+class EncKeyPair {
+public:
+    EncKeyPair() noexcept : kp_() {}
+
+    EncKeyPair(const EncKeyPair&) = delete;
+    EncKeyPair& operator=(const EncKeyPair&) = delete;
+
+    EncKeyPair(EncKeyPair &&other) noexcept : kp_(other.kp_) {
+        detail::secure_zero(&other.kp_, sizeof other.kp_);
+    }
+
+    EncKeyPair& operator=(EncKeyPair &&other) noexcept {
+        if (this != &other) {
+            kp_ = other.kp_;
+            detail::secure_zero(&other.kp_, sizeof other.kp_);
+        }
+        return *this;
+    }
+
+    ~EncKeyPair() { detail::secure_zero(&kp_, sizeof kp_); }
+
+    /** Returns a copy of the public key */
+    PubKey pub() const noexcept { return PubKey(kp_.pub); }
+
+    NtruEncKeyPair *get() noexcept { return &kp_; }
+    const NtruEncKeyPair *get() const noexcept { return &kp_; }
+
+private:
+    NtruEncKeyPair kp_;
+};
+
+/**
+ * @brief NtruEncrypt key generation
+ *
+ * See ntru_gen_key_pair().
+ *
+ * @return NTRU_SUCCESS for success, or a NTRU_ERR_ code for failure
+ */
+inline uint8_t gen_key_pair(const EncParams &params, EncKeyPair &kp, RandContext &rand_ctx) {
+    return ntru_gen_key_pair(params.c, kp.get(), rand_ctx.get());
+}
+
+/**
+ * @brief NtruEncrypt encryption
+ *
+ * Encrypts a message into a caller-provided buffer. See ntru_encrypt().
+ * pub is not const because the multiplication kernels clear the unused tail
+ * of its coefficient array; threads encrypting with the same key at the same
+ * time need their own PubKey::clone().
+ *
+ * @param msg the message; at most params.max_msg_len() bytes
+ * @param pub the public key to encrypt the message with
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator
+ * @param enc output parameter; must accommodate params.enc_len() bytes
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_PARAM if enc is too short,
+ *         or another NTRU_ERR_ code
+ */
+inline uint8_t encrypt(std::span<const uint8_t> msg, PubKey &pub, const EncParams &params, RandContext &rand_ctx, std::span<uint8_t> enc) {
+    if (msg.size() > params.max_msg_len())
+        return NTRU_ERR_MSG_TOO_LONG;
+    if (enc.size() < params.enc_len())
+        return NTRU_ERR_INVALID_PARAM;
+    return ntru_encrypt(const_cast<uint8_t*>(msg.data()), msg.size(), pub.get(), params.c, rand_ctx.get(), enc.data());
+}
+
+/**
+ * @brief NtruEncrypt encryption into an allocator-aware buffer
+ *
+ * Like encrypt() but resizes enc to params.enc_len() bytes first, so the
+ * memory comes from the buffer's memory resource.
+ */
+inline uint8_t encrypt(std::span<const uint8_t> msg, PubKey &pub, const EncParams &params, RandContext &rand_ctx, Buffer &enc) {
+    enc.resize(params.enc_len());
+    return encrypt(msg, pub, params, rand_ctx, std::span<uint8_t>(enc));
+}
+
+/**
+ * @brief NtruEncrypt decryption
+ *
+ * Decrypts a message into a caller-provided buffer. See ntru_decrypt().
+ * kp is not const for the same reason as pub in encrypt(), so it must not be
+ * used by several threads at the same time.
+ *
+ * @param enc the ciphertext; must be params.enc_len() bytes
+ * @param kp the key pair the message was encrypted for
+ * @param params the NtruEncrypt parameters the message was encrypted with
+ * @param dec output parameter; must accommodate params.max_msg_len() bytes
+ * @param dec_len output parameter; the length of the decrypted message
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_ENCODING if enc has the
+ *         wrong length, NTRU_ERR_INVALID_PARAM if dec is too short, or another
+ *         NTRU_ERR_ code
+ */
+inline uint8_t decrypt(std::span<const uint8_t> enc, EncKeyPair &kp, const EncParams &params, std::span<uint8_t> dec, uint16_t &dec_len) {
+    if (enc.size() != params.enc_len())
+        return NTRU_ERR_INVALID_ENCODING;
+    if (dec.size() < params.max_msg_len())
+        return NTRU_ERR_INVALID_PARAM;
+    return ntru_decrypt(const_cast<uint8_t*>(enc.data()), kp.get(), params.c, dec.data(), &dec_len);
+}
+
+/**
+ * @brief NtruEncrypt decryption into an allocator-aware buffer
+ *
+ * Like decrypt() but resizes dec to the length of the decrypted message.
+ */
+inline uint8_t decrypt(std::span<const uint8_t> enc, EncKeyPair &kp, const EncParams &params, Buffer &dec) {
+    dec.resize(params.max_msg_len());
+    uint16_t dec_len = 0;
+    uint8_t retcode = decrypt(enc, kp, params, std::span<uint8_t>(dec), dec_len);
+    dec.resize(retcode==NTRU_SUCCESS ? dec_len : 0);
+    return retcode;
+}
+
+/** A range whose elements can be viewed as byte spans, e.g. a vector of Buffers */
+template <typename R>
+concept ByteSpanRange = std::ranges::input_range<R> &&
+        std::convertible_to<std::ranges::range_reference_t<R>, std::span<const uint8_t>>;
+
+/**
+ * @brief Batch encryption
+ *
+ * Encrypts each message in msgs with the same public key. The ciphertexts are
+ * stored back to back in enc, params.enc_len() bytes each.
+ *
+ * @param msgs the messages
+ * @param pub the public key
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator
+ * @param enc output parameter; must accommodate params.enc_len() bytes per message
+ * @return NTRU_SUCCESS if all messages were encrypted, otherwise the result of
+ *         the first message that failed; later messages are not encrypted
+ */
+template <ByteSpanRange R>
+uint8_t encrypt_batch(R &&msgs, PubKey &pub, const EncParams &params, RandContext &rand_ctx, std::span<uint8_t> enc) {
+    std::size_t enc_len = params.enc_len();
+    std::size_t offset = 0;
+    for (std::span<const uint8_t> msg : msgs) {
+        if (enc.size()-offset < enc_len)
+            return NTRU_ERR_INVALID_PARAM;
+        uint8_t retcode = encrypt(msg, pub, params, rand_ctx, enc.subspan(offset, enc_len));
+        if (retcode != NTRU_SUCCESS)
+            return retcode;
+        offset += enc_len;
+    }
+    return NTRU_SUCCESS;
+}
+
+/**
+ * @brief Batch decryption
+ *
+ * Decrypts each ciphertext in encs with ntru_decrypt_batch(), so invalid
+ * ciphertexts are rejected cheaply. The messages are stored back to back in
+ * dec, params.max_msg_len() bytes apart. The pointer arrays ntru_decrypt_batch()
+ * needs are allocated from mr.
+ *
+ * @param encs the ciphertexts
+ * @param kp the key pair the messages were encrypted for
+ * @param params the NtruEncrypt parameters the messages were encrypted with
+ * @param dec output parameter; must accommodate params.max_msg_len() bytes per ciphertext
+ * @param dec_len output parameter; one element per ciphertext
+ * @param retcodes output parameter; the result of each ciphertext
+ * @param stats counters to update, or NULL
+ * @param mr the memory resource for temporary arrays
+ * @return NTRU_SUCCESS if all ciphertexts were decrypted, NTRU_ERR_INVALID_PARAM
+ *         if an output buffer is too short, otherwise the result of the first
+ *         ciphertext that failed
+ */
+template <ByteSpanRange R>
+uint8_t decrypt_batch(R &&encs, EncKeyPair &kp, const EncParams &params, std::span<uint8_t> dec, std::span<uint16_t> dec_len, std::span<uint8_t> retcodes, NtruPrecheckStats *stats = NULL, std::pmr::memory_resource *mr = std::pmr::get_default_resource()) {
+    std::pmr::vector<uint8_t*> enc_ptrs(mr);
+    std::pmr::vector<uint16_t> enc_lens(mr);
+    std::pmr::vector<uint8_t*> dec_ptrs(mr);
+    std::size_t max_len = params.max_msg_len();
+    for (std::span<const uint8_t> enc : encs) {
+        if (enc.size() > UINT16_MAX)
+            return NTRU_ERR_INVALID_ENCODING;
+        enc_ptrs.push_back(const_cast<uint8_t*>(enc.data()));
+        enc_lens.push_back(enc.size());
+    }
+    std::size_t num = enc_ptrs.size();
+    if (dec.size()/max_len<num || dec_len.size()<num || retcodes.size()<num)
+        return NTRU_ERR_INVALID_PARAM;
+    for (std::size_t i=0; i<num; i++)
+        dec_ptrs.push_back(dec.data() + i*max_len);
+    return ntru_decrypt_batch(enc_ptrs.data(), enc_lens.data(), num, kp.get(), params.c, dec_ptrs.data(), dec_len.data(), retcodes.data(), stats);
+}
+
+}   /* namespace ntru */
+
+#endif   /* NTRU_NTRU_HPP */
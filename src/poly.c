@@ -9,10 +9,20 @@
 #include "arith.h"
 #include "encparams.h"
 #include "ntru_endian.h"
+#include "profile.h"
+#include "kernels.h"
 
 #define NTRU_KARATSUBA_THRESH_16 40
 #define NTRU_KARATSUBA_THRESH_64 120
 
+/* swaps a and b if a>b without branching on either */
+#define NTRUPRIME_MINMAX(a, b) do {\
+    uint32_t mask = -(uint32_t)(((uint64_t)(b)-(a)) >> 63);\
+    uint32_t d = ((a)^(b)) & mask;\
+    (a) ^= d;\
+    (b) ^= d;\
+} while (0)
+
 /***************************************
  *          NTRU Prime                 *
  ***************************************/
@@ -56,37 +66,154 @@ uint8_t ntruprime_rand_tern(uint16_t N, NtruIntPoly *poly, NtruRandContext *rand
     return 1;
 }
 
+/*
+ * Sorts an array of 32-bit integers with a sorting network. The sequence of
+ * comparisons and memory accesses only depends on len.
+ */
+void ntruprime_sort_ct(uint32_t *x, uint16_t len) {
+    if (len < 2)
+        return;
+    uint16_t top = 1;
+    while (top < len-top)
+        top += top;
+
+    uint16_t p, q, r, i;
+    for (p=top; p>0; p>>=1) {
+        for (i=0; i<len-p; i++)
+            if (!(i & p))
+                NTRUPRIME_MINMAX(x[i], x[i+p]);
+        i = 0;
+        for (q=top; q>p; q>>=1)
+            for (; i<len-q; i++)
+                if (!(i & p)) {
+                    uint32_t a = x[i+p];
+                    for (r=q; r>p; r>>=1)
+                        NTRUPRIME_MINMAX(a, x[i+r]);
+                    x[i+p] = a;
+                }
+    }
+}
+
+/*
+ * Constant time: t random values are tagged with a nonzero coefficient in
+ * their two lowest bits, the others with a zero coefficient, and the tagged
+ * values are put in random order by sorting them.
+ */
 uint8_t ntruprime_rand_tern_t(uint16_t N, uint16_t t, NtruIntPoly *poly, NtruRandContext *rand_ctx) {
     poly->N = N;
 
-    uint8_t rand_bits[(2*t+7)/8];
-    if (ntru_rand_generate((uint8_t*)rand_bits, sizeof rand_bits, rand_ctx) != NTRU_SUCCESS)
+    uint32_t arr[N];
+    if (ntru_rand_generate((uint8_t*)arr, N*sizeof(arr[0]), rand_ctx) != NTRU_SUCCESS)
         return 0;
     uint16_t i;
-    for (i=0; i<2*t; i++) {
-        uint8_t r = (rand_bits[i/8] >> (i%8)) & 1;
-        poly->coeffs[i] = r ? 1 : 2;
-    }
+    for (i=0; i<t; i++)
+        arr[i] = (arr[i] & ~3) | (1 + (arr[i] & 1));   /* 1 or 2 */
     for (; i<N; i++)
-        poly->coeffs[i] = 0;
+        arr[i] &= ~3;
+    ntruprime_sort_ct(arr, N);
+    for (i=0; i<N; i++)
+        poly->coeffs[i] = arr[i] & 3;
+
+    memset(arr, 0, sizeof arr);
+    return 1;
+}
+
+/* Adds the terms of degree N and higher to the lower ones, modulo x^N-x-1 */
+void ntruprime_mult_small_reduce(uint32_t *t, uint16_t N, NtruIntPoly *c, uint16_t modulus) {
+    c->N = N;
+    c->coeffs[0] = (t[0]+t[N]) % modulus;
+    uint16_t k;
+    for (k=1; k<N; k++)
+        c->coeffs[k] = (t[k]+t[N+k]+t[N+k-1]) % modulus;
+}
 
-    uint32_t rand_indices[N];
-    if (ntru_rand_generate((uint8_t*)rand_indices, N*sizeof(rand_indices[0]), rand_ctx) != NTRU_SUCCESS)
+uint8_t ntruprime_mult_small_standard(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus) {
+    uint16_t N = a->N;
+    if (N != b->N)
         return 0;
+    uint32_t t[2*NTRU_INT_POLY_SIZE];
+    memset(t, 0, (2*N+1) * sizeof t[0]);
 
-    /* Fisher-Yates shuffle */
-    uint32_t rand_idx = 0;
-    for (i=N-1; i>0; i--) {
-        /* slightly biased; for N=739, P(poly contains a biased coeff) = 1/10798 */
-        uint32_t j = rand_indices[rand_idx] % (i+1);
-        uint16_t temp = poly->coeffs[i];
-        poly->coeffs[i] = poly->coeffs[j];
-        poly->coeffs[j] = temp;
-        rand_idx++;
+    uint16_t i, j;
+    for (i=0; i<N; i++) {
+        uint32_t b_i = (uint16_t)b->coeffs[i];
+        for (j=0; j<N; j++)
+            t[i+j] += b_i * (uint16_t)a->coeffs[j];
     }
+    ntruprime_mult_small_reduce(t, N, c, modulus);
     return 1;
 }
 
+uint8_t ntruprime_mult_small(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return ntruprime_mult_small_avx2(a, b, c, modulus);
+    else
+        return ntruprime_mult_small_standard(a, b, c, modulus);
+#else
+#ifdef __AVX2__
+    return ntruprime_mult_small_avx2(a, b, c, modulus);
+#else
+    return ntruprime_mult_small_standard(a, b, c, modulus);
+#endif   /* __AVX2__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
+/*
+ * The centered representative of each coefficient is rounded to a multiple
+ * of 3, 3k-(q-1)/2, and k is stored in 12 bits. Two coefficients are
+ * packed into three bytes.
+ */
+void ntruprime_round3_to_arr(NtruIntPoly *a, uint16_t modulus, uint8_t *arr) {
+    uint16_t N = a->N;
+    uint16_t k[N];
+    uint16_t i;
+    for (i=0; i<N; i++) {
+        /* a+(q-1)/2 mod q is the centered representative plus (q-1)/2 */
+        uint32_t x = (uint16_t)a->coeffs[i] + (modulus-1)/2;
+        x -= modulus & -(uint32_t)(x >= modulus);
+        k[i] = (x+1) / 3;
+    }
+
+    for (i=0; i+1<N; i+=2) {
+        *arr++ = k[i];
+        *arr++ = (k[i]>>8) | (k[i+1]<<4);
+        *arr++ = k[i+1] >> 4;
+    }
+    if (i < N) {
+        *arr++ = k[i];
+        *arr++ = k[i] >> 8;
+    }
+}
+
+uint8_t ntruprime_from_arr_round3(uint8_t *arr, uint16_t N, uint16_t modulus, NtruIntPoly *c) {
+    c->N = N;
+    uint16_t k_max = (modulus-1) / 3;
+    uint16_t invalid = 0;
+    uint16_t i;
+    for (i=0; i+1<N; i+=2) {
+        uint16_t k0 = arr[0] | ((arr[1]&15)<<8);
+        uint16_t k1 = (arr[1]>>4) | (arr[2]<<4);
+        invalid |= (k_max-k0) | (k_max-k1);   /* top bit set if k>k_max */
+        c->coeffs[i] = k0;
+        c->coeffs[i+1] = k1;
+        arr += 3;
+    }
+    if (i < N) {
+        uint16_t k0 = arr[0] | ((arr[1]&15)<<8);
+        invalid |= (k_max-k0) | -(arr[1]>>4);   /* the 4 unused bits must be zero */
+        c->coeffs[i] = k0;
+    }
+
+    for (i=0; i<N; i++) {
+        /* 3k-(q-1)/2 mod q */
+        uint32_t x = 3*(uint16_t)c->coeffs[i] + modulus - (modulus-1)/2;
+        x -= modulus & -(uint32_t)(x >= modulus);
+        c->coeffs[i] = x;
+    }
+    return !(invalid & 0x8000);
+}
+
 /* Zeros a polynomial and sets the number of coefficients */
 void ntruprime_zero(NtruIntPoly *a, uint16_t N) {
     a->N = N;
@@ -440,6 +567,7 @@ void ntru_mult_karatsuba_16(int16_t *a, int16_t *b, int16_t *c, uint16_t len, ui
 }
 
 uint8_t ntru_mult_int_16(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_INT_16);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -558,6 +686,7 @@ void ntru_mult_karatsuba_64(int16_t *a, int16_t *b, int16_t *c, uint16_t len, ui
 }
 
 uint8_t ntru_mult_int_64(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_INT_64);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -570,6 +699,7 @@ uint8_t ntru_mult_int_64(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_
 }
 
 uint8_t ntru_mult_tern_32(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_32);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -645,6 +775,7 @@ uint8_t ntru_mult_tern_32(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint1
 }
 
 uint8_t ntru_mult_tern_64(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_64);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -721,7 +852,8 @@ uint8_t ntru_mult_tern_64(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint1
 }
 
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
-uint8_t ntru_mult_prod(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+uint8_t ntru_mult_prod_standard(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_PROD_STANDARD);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -740,13 +872,161 @@ uint8_t ntru_mult_prod(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t
 }
 #endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 
+/* whether ntru_mult_tern and ntru_mult_prod point to the constant-time versions */
+static uint8_t ntru_constant_time = 0;
+
+/*
+ * Scatters a list of indices into a bit mask, touching every word that can
+ * hold an index below N for every index. All NTRU_TERN_PACKED_WORDS words are set.
+ */
+void ntru_indices_to_mask_ct(uint16_t *indices, uint16_t num_indices, uint64_t *mask, uint16_t N) {
+    uint16_t num_words = (N+63) / 64;
+    uint16_t i, j;
+    for (j=0; j<NTRU_TERN_PACKED_WORDS; j++)
+        mask[j] = 0;
+    for (i=0; i<num_indices; i++) {
+        uint16_t idx = indices[i];
+        uint64_t bit = 1ULL << (idx%64);
+        uint32_t word = idx / 64;
+        for (j=0; j<num_words; j++) {
+            /* sel = 1 if j==word, 0 otherwise; j^word < 2^16 so bit 31 is only set if j==word */
+            uint64_t sel = (((uint32_t)(j^word)) - 1) >> 31;
+            mask[j] |= bit & -sel;
+        }
+    }
+}
+
+void ntru_tern_pack_standard(NtruTernPoly *a, NtruTernPolyPacked *b) {
+    b->N = a->N;
+    ntru_indices_to_mask_ct(a->ones, a->num_ones, b->ones, a->N);
+    ntru_indices_to_mask_ct(a->neg_ones, a->num_neg_ones, b->neg_ones, a->N);
+}
+
+void ntru_tern_pack(NtruTernPoly *a, NtruTernPolyPacked *b) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return ntru_tern_pack_avx2(a, b);
+    else
+        return ntru_tern_pack_standard(a, b);
+#else
+#ifdef __AVX2__
+    ntru_tern_pack_avx2(a, b);
+#else
+    ntru_tern_pack_standard(a, b);
+#endif   /* __AVX2__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
+/* appends the indices of the set bits in mask to indices, in ascending order */
+uint16_t ntru_mask_to_indices(uint64_t *mask, uint16_t num_words, uint16_t *indices) {
+    uint16_t num_indices = 0;
+    uint16_t i;
+    for (i=0; i<num_words; i++) {
+        uint64_t w = mask[i];
+        while (w) {
+            indices[num_indices] = i*64 + __builtin_ctzll(w);
+            num_indices++;
+            w &= w - 1;
+        }
+    }
+    return num_indices;
+}
+
+void ntru_tern_unpack(NtruTernPolyPacked *a, NtruTernPoly *b) {
+    b->N = a->N;
+    b->num_ones = ntru_mask_to_indices(a->ones, NTRU_TERN_PACKED_WORDS, b->ones);
+    b->num_neg_ones = ntru_mask_to_indices(a->neg_ones, NTRU_TERN_PACKED_WORDS, b->neg_ones);
+}
+
+void ntru_tern_packed_to_int_standard(NtruTernPolyPacked *a, NtruIntPoly *b) {
+    uint16_t N = a->N;
+    b->N = N;
+    uint16_t i;
+    for (i=0; i<N; i++)
+        b->coeffs[i] = ((a->ones[i/64]>>(i%64)) & 1) - ((a->neg_ones[i/64]>>(i%64)) & 1);
+    for (; i<NTRU_INT_POLY_SIZE; i++)
+        b->coeffs[i] = 0;
+}
+
+void ntru_tern_packed_to_int(NtruTernPolyPacked *a, NtruIntPoly *b) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return ntru_tern_packed_to_int_avx2(a, b);
+    else
+        return ntru_tern_packed_to_int_standard(a, b);
+#else
+#ifdef __AVX2__
+    ntru_tern_packed_to_int_avx2(a, b);
+#else
+    ntru_tern_packed_to_int_standard(a, b);
+#endif   /* __AVX2__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
+void ntru_tern_packed_to_mod2_64(NtruTernPolyPacked *a, uint64_t *b_coeffs64) {
+    uint16_t N64 = (a->N+1+63) / 64;   /* one extra coefficient for ntru_invert_mod2_64() */
+    uint16_t i;
+    for (i=0; i<N64; i++)
+        b_coeffs64[i] = a->ones[i] | a->neg_ones[i];
+}
+
+void ntru_tern_to_int_ct(NtruTernPoly *a, NtruIntPoly *b) {
+    NtruTernPolyPacked a_packed;
+    ntru_tern_pack(a, &a_packed);
+    ntru_tern_packed_to_int(&a_packed, b);
+}
+
+uint8_t ntru_mult_tern_packed(NtruIntPoly *a, NtruTernPolyPacked *b, NtruIntPoly *c, uint16_t mod_mask) {
+    if (a->N != b->N)
+        return 0;
+    NtruIntPoly b_int;
+    ntru_tern_packed_to_int(b, &b_int);
+    return ntru_mult_int(a, &b_int, c, mod_mask);
+}
+
+uint8_t ntru_mult_tern_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_CT);
+    NtruTernPolyPacked b_packed;
+    ntru_tern_pack(b, &b_packed);
+    return ntru_mult_tern_packed(a, &b_packed, c, mod_mask);
+}
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+uint8_t ntru_mult_prod_ct(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_PROD_CT);
+    if (a->N != b->N)
+        return 0;
+
+    /* c = a*(f1*f2+f3), which takes one multiplication less than a*f1*f2+a*f3 */
+    NtruIntPoly f1, f2, f3, f;
+    ntru_tern_to_int_ct(&b->f1, &f1);
+    ntru_tern_to_int_ct(&b->f2, &f2);
+    ntru_tern_to_int_ct(&b->f3, &f3);
+    ntru_mult_int(&f1, &f2, &f, mod_mask);
+    ntru_add(&f, &f3);
+    return ntru_mult_int(a, &f, c, mod_mask);
+}
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+void ntru_set_constant_time_poly(uint8_t enable) {
+    ntru_constant_time = enable;
+}
+
+uint8_t ntru_get_constant_time_poly() {
+    return ntru_constant_time;
+}
+
 uint8_t ntru_mult_priv(NtruPrivPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_START(t);
+    uint8_t result;
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
     if (a->prod_flag)
-        return ntru_mult_prod(b, &a->poly.prod, c, mod_mask);
+        result = ntru_mult_prod(b, &a->poly.prod, c, mod_mask);
     else
 #endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
-        return ntru_mult_tern(b, &a->poly.tern, c, mod_mask);
+        result = ntru_mult_tern(b, &a->poly.tern, c, mod_mask);
+    NTRU_PROF_STOP(NTRU_PROF_STAGE_MULT, t);
+    return result;
 }
 
 /** NtruPrivPoly to binary (coefficients reduced mod 2), 64 bit version */
@@ -1013,7 +1293,7 @@ void ntru_to_arr4(NtruIntPoly *p, uint8_t *arr) {
     arr[last] |= (p->coeffs[i]&3) << 6;
 }
 
-void ntru_from_arr(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p) {
+void ntru_from_arr_standard(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p) {
     p->N = N;
     memset(&p->coeffs, 0, N * sizeof p->coeffs[0]);
 
@@ -1042,6 +1322,24 @@ void ntru_from_arr(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p) {
     }
 }
 
+void ntru_from_arr(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p) {
+#ifdef NTRU_DETECT_SIMD
+    if (q==2048 && __builtin_cpu_supports("avx2"))
+        return ntru_from_arr_avx2_2048(arr, N, p);
+    else
+        return ntru_from_arr_standard(arr, N, q, p);
+#else
+#ifdef __AVX2__
+    if (q == 2048)
+        ntru_from_arr_avx2_2048(arr, N, p);
+    else
+        ntru_from_arr_standard(arr, N, q, p);
+#else
+    ntru_from_arr_standard(arr, N, q, p);
+#endif   /* __AVX2__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
 void ntru_mult_fac(NtruIntPoly *a, int16_t factor) {
     uint16_t i;
     for (i=0; i<a->N; i++)
@@ -1110,6 +1408,84 @@ void ntru_mod_center(NtruIntPoly *p, uint16_t modulus) {
     }
 }
 
+void ntru_decrypt_post_tail(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights, uint16_t start) {
+    uint16_t m2 = modulus / 2;
+    uint16_t mod_mask = modulus - 1;
+    r->N = d->N;
+    uint16_t i;
+    for (i=start; i<d->N; i++) {
+        uint16_t c = (3*d->coeffs[i]+e->coeffs[i]) & mod_mask;   // note that c is unsigned
+        if (c > m2)
+            c -= modulus;
+        int8_t c3 = (int16_t)c % 3;
+        if (c3 < 0)
+            c3 += 3;
+        d->coeffs[i] = c3;
+        r->coeffs[i] = (e->coeffs[i]-c3) & mod_mask;
+        weights[c3]++;
+    }
+}
+
+void ntru_decrypt_post_standard(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights) {
+    weights[0] = weights[1] = weights[2] = 0;
+    ntru_decrypt_post_tail(d, e, modulus, r, weights, 0);
+}
+
+void ntru_decrypt_post(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return ntru_decrypt_post_avx2(d, e, modulus, r, weights);
+    else if (__builtin_cpu_supports("ssse3"))
+        return ntru_decrypt_post_sse(d, e, modulus, r, weights);
+    else
+        return ntru_decrypt_post_standard(d, e, modulus, r, weights);
+#else
+#ifdef __AVX2__
+    ntru_decrypt_post_avx2(d, e, modulus, r, weights);
+#elif __SSSE3__
+    ntru_decrypt_post_sse(d, e, modulus, r, weights);
+#else
+    ntru_decrypt_post_standard(d, e, modulus, r, weights);
+#endif   /* __SSSE3__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
+void ntru_encrypt_post_tail(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights, uint16_t start) {
+    uint16_t i;
+    for (i=start; i<m->N; i++) {
+        int8_t c3 = (m->coeffs[i]+mask->coeffs[i]) % 3;
+        if (c3 < 0)
+            c3 += 3;
+        m->coeffs[i] = c3;
+        r->coeffs[i] += c3;
+        weights[c3]++;
+    }
+}
+
+void ntru_encrypt_post_standard(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights) {
+    weights[0] = weights[1] = weights[2] = 0;
+    ntru_encrypt_post_tail(m, mask, r, weights, 0);
+}
+
+void ntru_encrypt_post(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights) {
+#ifdef NTRU_DETECT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return ntru_encrypt_post_avx2(m, mask, r, weights);
+    else if (__builtin_cpu_supports("ssse3"))
+        return ntru_encrypt_post_sse(m, mask, r, weights);
+    else
+        return ntru_encrypt_post_standard(m, mask, r, weights);
+#else
+#ifdef __AVX2__
+    ntru_encrypt_post_avx2(m, mask, r, weights);
+#elif __SSSE3__
+    ntru_encrypt_post_sse(m, mask, r, weights);
+#else
+    ntru_encrypt_post_standard(m, mask, r, weights);
+#endif   /* __SSSE3__ */
+#endif   /* NTRU_DETECT_SIMD */
+}
+
 uint8_t ntru_equals_int(NtruIntPoly *a, NtruIntPoly *b) {
     if (a->N != b->N)
         return 0;
@@ -1169,24 +1545,22 @@ void ntru_clear_int(NtruIntPoly *p) {
         p->coeffs[i] = 0;
 }
 
-/**
- * @brief Lift inverse
- *
- * Given a polynomial a and the inverse of (1+3a) mod 2, this function
- * calculates the inverse of (1+3a) mod q.
- *
- * @param a a polynomial such that Fq = (1+3a)^(-1) (mod 2)
- * @param Fq the inverse of 1+3a modulo 2
- * @param q the modulus
+/*
+ * Newton iteration that lifts the inverse of (1+3a) mod 2 to mod q. a is
+ * a_priv if that is not NULL, and a_int otherwise, so private keys keep
+ * their sparse multiplication.
  */
-void ntru_lift_inverse(NtruPrivPoly *a, NtruIntPoly *Fq, uint16_t q) {
+static void ntru_lift_inverse_newton(NtruPrivPoly *a_priv, NtruIntPoly *a_int, NtruIntPoly *Fq, uint16_t q) {
     NtruIntPoly temp1, temp2;
     uint32_t v = 2;
     while (v < q) {
         v *= v;
 
         /* temp1 = (1+3a)*Fq */
-        ntru_mult_priv(a, Fq, &temp1, q-1);
+        if (a_priv != NULL)
+            ntru_mult_priv(a_priv, Fq, &temp1, q-1);
+        else
+            ntru_mult_int(a_int, Fq, &temp1, q-1);
         ntru_mult_fac(&temp1, 3);
         ntru_add(&temp1, Fq);
 
@@ -1197,6 +1571,20 @@ void ntru_lift_inverse(NtruPrivPoly *a, NtruIntPoly *Fq, uint16_t q) {
     }
 }
 
+/**
+ * @brief Lift inverse
+ *
+ * Given a polynomial a and the inverse of (1+3a) mod 2, this function
+ * calculates the inverse of (1+3a) mod q.
+ *
+ * @param a a polynomial such that Fq = (1+3a)^(-1) (mod 2)
+ * @param Fq the inverse of 1+3a modulo 2
+ * @param q the modulus
+ */
+void ntru_lift_inverse(NtruPrivPoly *a, NtruIntPoly *Fq, uint16_t q) {
+    ntru_lift_inverse_newton(a, NULL, Fq, q);
+}
+
 uint8_t ntru_invert_32(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
     int16_t i;
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
@@ -1310,12 +1698,11 @@ uint8_t ntru_invert_32(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
     return 1;
 }
 
-uint8_t ntru_invert_64(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
-#ifndef NTRU_AVOID_HAMMING_WT_PATENT
-    uint16_t N = a->prod_flag ? a->poly.prod.N : a->poly.tern.N;
-#else
-    uint16_t N = a->poly.tern.N;
-#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+/*
+ * Computes the inverse of f mod 2, where f is given as a bitmap of
+ * (N+1+63)/64 words. Overwrites f_coeffs64.
+ */
+uint8_t ntru_invert_mod2_64(uint64_t *f_coeffs64, uint16_t N, NtruIntPoly *Fq) {
     uint16_t k = 0;
     uint16_t N64 = (N+1+63) / 64;   /* #uint64_t's needed for N+1 coeffs */
 
@@ -1330,12 +1717,6 @@ uint8_t ntru_invert_64(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
     uint64_t *c_coeffs64 = c_coeffs64_arr;
     memset(c_coeffs64, 0, N64*8);
 
-    /* f=3a+1; skip multiplication by 3 because f=3f (mod 2) */
-    uint64_t f_coeffs64_arr[N64];
-    uint64_t *f_coeffs64 = f_coeffs64_arr;
-    ntru_priv_to_mod2_64(a, f_coeffs64);
-    f_coeffs64[0] ^= 1;
-
     /* g(x) = x^N − 1 */
     uint64_t g_coeffs64_arr[N64];
     uint64_t *g_coeffs64 = g_coeffs64_arr;
@@ -1419,11 +1800,51 @@ uint8_t ntru_invert_64(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
         Fq->coeffs[j] = (b_coeffs64[i/64]>>(i%64)) & 1;   /* Fq->coeffs[j]=b[i] */
     }
 
+    return 1;
+}
+
+uint8_t ntru_invert_64(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq) {
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    uint16_t N = a->prod_flag ? a->poly.prod.N : a->poly.tern.N;
+#else
+    uint16_t N = a->poly.tern.N;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    uint16_t N64 = (N+1+63) / 64;   /* #uint64_t's needed for N+1 coeffs */
+
+    /* f=3a+1; skip multiplication by 3 because f=3f (mod 2) */
+    uint64_t f_coeffs64[N64];
+    ntru_priv_to_mod2_64(a, f_coeffs64);
+    f_coeffs64[0] ^= 1;
+
+    if (!ntru_invert_mod2_64(f_coeffs64, N, Fq))
+        return 0;
+
     ntru_lift_inverse(a, Fq, mod_mask+1);
 
     return 1;
 }
 
+uint8_t ntru_invert_tern_packed(NtruTernPolyPacked *a, uint16_t mod_mask, NtruIntPoly *Fq) {
+    uint16_t N = a->N;
+    uint16_t N64 = (N+1+63) / 64;   /* #uint64_t's needed for N+1 coeffs */
+
+    /* f=3a+1 (mod 2) */
+    uint64_t f_coeffs64[N64];
+    ntru_tern_packed_to_mod2_64(a, f_coeffs64);
+    f_coeffs64[0] ^= 1;
+
+    if (!ntru_invert_mod2_64(f_coeffs64, N, Fq))
+        return 0;
+
+    /* lift the inverse to mod q */
+    NtruIntPoly a_int;
+    ntru_tern_packed_to_int(a, &a_int);
+    ntru_lift_inverse_newton(NULL, &a_int, Fq, mod_mask+1);
+    ntru_clear_int(&a_int);
+
+    return 1;
+}
+
 uint8_t (*ntru_invert)(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq);
 
 void ntru_set_optimized_impl_poly() {
@@ -1433,24 +1854,36 @@ void ntru_set_optimized_impl_poly() {
         ntru_mult_tern = ntru_mult_tern_avx2;
         ntru_to_arr = ntru_to_arr_sse;
         ntru_mod_mask = ntru_mod_avx2;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        ntru_mult_prod = ntru_mult_prod_avx2;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     }
     else if (__builtin_cpu_supports("ssse3")) {
         ntru_mult_int = ntru_mult_int_sse;
         ntru_mult_tern = ntru_mult_tern_sse;
         ntru_to_arr = ntru_to_arr_sse;
         ntru_mod_mask = ntru_mod_sse;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        ntru_mult_prod = ntru_mult_prod_sse;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     }
     else if (sizeof(void*) >= 8) {   /* 64-bit arch */
         ntru_mult_int = ntru_mult_int_64;
         ntru_mult_tern = ntru_mult_tern_64;
         ntru_to_arr = ntru_to_arr_64;
         ntru_mod_mask = ntru_mod_64;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        ntru_mult_prod = ntru_mult_prod_standard;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     }
     else {
         ntru_mult_int = ntru_mult_int_16;
         ntru_mult_tern = ntru_mult_tern_32;
         ntru_to_arr = ntru_to_arr_32;
         ntru_mod_mask = ntru_mod_32;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        ntru_mult_prod = ntru_mult_prod_standard;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     }
 
     if (sizeof(void*) >= 8)   /* 64-bit arch */
@@ -1465,21 +1898,33 @@ void ntru_set_optimized_impl_poly() {
     ntru_mult_tern = ntru_mult_tern_avx2;
     ntru_to_arr = ntru_to_arr_sse;
     ntru_mod_mask = ntru_mod_avx2;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod = ntru_mult_prod_avx2;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 #elif __SSSE3__
     ntru_mult_int = ntru_mult_int_sse;
     ntru_mult_tern = ntru_mult_tern_sse;
     ntru_to_arr = ntru_to_arr_sse;
     ntru_mod_mask = ntru_mod_sse;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod = ntru_mult_prod_sse;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 #elif _LP64
     ntru_mult_int = ntru_mult_int_64;
     ntru_mult_tern = ntru_mult_tern_64;
     ntru_to_arr = ntru_to_arr_64;
     ntru_mod_mask = ntru_mod_64;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod = ntru_mult_prod_standard;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 #else
     ntru_mult_int = ntru_mult_int_16;
     ntru_mult_tern = ntru_mult_tern_32;
     ntru_to_arr = ntru_to_arr_32;
     ntru_mod_mask = ntru_mod_32;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    ntru_mult_prod = ntru_mult_prod_standard;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 #endif
 
 #if _LP64
@@ -1488,4 +1933,27 @@ void ntru_set_optimized_impl_poly() {
     ntru_invert = ntru_invert_32;
 #endif
 #endif   /* NTRU_DETECT_SIMD */
+
+    /* autotuned kernels override CPUID but not constant-time mode */
+    ntru_kernel_tuned_install();
+
+    if (ntru_constant_time) {
+#ifdef NTRU_DETECT_SIMD
+        if (__builtin_cpu_supports("avx2"))
+            ntru_mult_tern = ntru_mult_tern_avx2_ct;
+        else if (__builtin_cpu_supports("ssse3"))
+            ntru_mult_tern = ntru_mult_tern_sse_ct;
+        else
+            ntru_mult_tern = ntru_mult_tern_ct;
+#elif defined __AVX2__
+        ntru_mult_tern = ntru_mult_tern_avx2_ct;
+#elif defined __SSSE3__
+        ntru_mult_tern = ntru_mult_tern_sse_ct;
+#else
+        ntru_mult_tern = ntru_mult_tern_ct;
+#endif   /* NTRU_DETECT_SIMD */
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+        ntru_mult_prod = ntru_mult_prod_ct;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    }
 }
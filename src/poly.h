@@ -33,6 +33,7 @@ uint8_t ntruprime_rand_tern(uint16_t N, NtruIntPoly *poly, NtruRandContext *rand
  * @brief Random t-small polynomial
  *
  * Generates a random ternary polynomial for NTRU Prime with t nonzero coefficients.
+ * Runs in constant time.
  *
  * @param N the number of coefficients; must be NTRU_MAX_DEGREE or less
  * @param t number of ones + number of negative ones
@@ -69,6 +70,57 @@ uint16_t ntruprime_inv_int(uint16_t a, uint16_t modulus);
  */
 uint8_t ntruprime_inv_poly(NtruIntPoly *a, NtruIntPoly *b, uint16_t modulus);
 
+/**
+ * @brief NTRU Prime multiplication by a small polynomial
+ *
+ * Multiplies a polynomial by a polynomial with coefficients between 0 and 2
+ * in (Z/q)[x]/[x^p-x-1]. Faster than ntruprime_mult_poly() because the
+ * products fit into 16 bits and the sums into 32 bits. Runs in constant time.
+ *
+ * @param a a polynomial reduced modulo q
+ * @param b a polynomial with coefficients between 0 and 2
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param modulus q; at most 32768
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntruprime_mult_small(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus);
+
+uint8_t ntruprime_mult_small_standard(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus);
+
+/*
+ * Reduces an unreduced product of 2N coefficients modulo x^N-x-1 and modulus,
+ * for ntruprime_mult_small() implementations
+ */
+void ntruprime_mult_small_reduce(uint32_t *t, uint16_t N, NtruIntPoly *c, uint16_t modulus);
+
+/**
+ * @brief Rounding and encoding
+ *
+ * Rounds each coefficient of a polynomial to the nearest multiple of 3 and
+ * encodes the result in 12 bits per coefficient, (12*N+7)/8 bytes in total.
+ * The centered representatives of the rounded coefficients are -(q-1)/2 to
+ * (q-1)/2, so q must be 1 modulo 6, and (q-1)/3 must fit into 12 bits.
+ *
+ * @param a a polynomial reduced modulo q
+ * @param modulus q
+ * @param arr output parameter; a pointer to store the encoded polynomial
+ */
+void ntruprime_round3_to_arr(NtruIntPoly *a, uint16_t modulus, uint8_t *arr);
+
+/**
+ * @brief Decoding of a rounded polynomial
+ *
+ * Decodes a polynomial encoded with ntruprime_round3_to_arr(). Runs in
+ * constant time.
+ *
+ * @param arr the encoded polynomial
+ * @param N the number of coefficients
+ * @param modulus q
+ * @param c output parameter; a pointer to store the polynomial, reduced modulo q
+ * @return 1 if arr is a valid encoding, 0 otherwise
+ */
+uint8_t ntruprime_from_arr_round3(uint8_t *arr, uint16_t N, uint16_t modulus, NtruIntPoly *c);
+
 /**
  * @brief Random ternary polynomial
  *
@@ -180,9 +232,154 @@ uint8_t ntru_mult_tern_64(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint1
  * @param mod_mask an AND mask to apply; must be a power of two minus one
  * @return 0 if the number of coefficients differ, 1 otherwise
  */
-uint8_t ntru_mult_prod(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+uint8_t (*ntru_mult_prod)(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief General polynomial by product-form polynomial multiplication
+ *
+ * Multiplies a NtruIntPoly by a NtruProdPoly using three calls to
+ * ntru_mult_tern(). The number of coefficients must be the same for both
+ * polynomials.
+ *
+ * @param a a general polynomial
+ * @param b a product-form polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_prod_standard(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
+/**
+ * @brief Packing of a ternary polynomial
+ *
+ * Converts a NtruTernPoly to a NtruTernPolyPacked. Runs in constant time,
+ * i.e. the memory access pattern only depends on N and the number of ones
+ * and negative ones, not on their positions.
+ *
+ * @param a a ternary polynomial
+ * @param b output parameter; a pointer to store the packed polynomial
+ */
+void ntru_tern_pack(NtruTernPoly *a, NtruTernPolyPacked *b);
+
+void ntru_tern_pack_standard(NtruTernPoly *a, NtruTernPolyPacked *b);
+
+/**
+ * @brief Unpacking of a ternary polynomial
+ *
+ * Converts a NtruTernPolyPacked to a NtruTernPoly with the indices of the
+ * ones and negative ones in ascending order. Not constant time.
+ *
+ * @param a a packed ternary polynomial
+ * @param b output parameter; a pointer to store the ternary polynomial
+ */
+void ntru_tern_unpack(NtruTernPolyPacked *a, NtruTernPoly *b);
+
+/**
+ * @brief Packed ternary to general polynomial
+ *
+ * Converts a NtruTernPolyPacked to a NtruIntPoly with coefficients -1, 0,
+ * and 1. Runs in constant time.
+ *
+ * @param a a packed ternary polynomial
+ * @param b output parameter; a pointer to store the new polynomial.
+ *          Coefficients past N are set to zero.
+ */
+void ntru_tern_packed_to_int(NtruTernPolyPacked *a, NtruIntPoly *b);
+
+void ntru_tern_packed_to_int_standard(NtruTernPolyPacked *a, NtruIntPoly *b);
+
+/**
+ * @brief Packed ternary polynomial modulo 2
+ *
+ * Reduces a NtruTernPolyPacked modulo 2 and stores the coefficients as
+ * a bitmap.
+ *
+ * @param a a packed ternary polynomial
+ * @param b_coeffs64 output parameter; must accommodate (N+1+63)/64 words
+ */
+void ntru_tern_packed_to_mod2_64(NtruTernPolyPacked *a, uint64_t *b_coeffs64);
+
+/**
+ * @brief General polynomial by packed ternary polynomial multiplication
+ *
+ * Multiplies a NtruIntPoly by a NtruTernPolyPacked. b is expanded with
+ * ntru_tern_packed_to_int() and multiplied with ntru_mult_int(), so the
+ * memory access pattern does not depend on b. The number of coefficients
+ * must be the same for both polynomials.
+ *
+ * @param a a general polynomial
+ * @param b a packed ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_packed(NtruIntPoly *a, NtruTernPolyPacked *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief Ternary to general polynomial, constant time
+ *
+ * Converts a NtruTernPoly to a NtruIntPoly with coefficients -1, 0, and 1
+ * via ntru_tern_pack() and ntru_tern_packed_to_int(), so the memory access
+ * pattern only depends on N and the number of ones and negative ones, not on
+ * their positions.
+ *
+ * @param a a ternary polynomial
+ * @param b output parameter; a pointer to store the new polynomial.
+ *          Coefficients past N are set to zero.
+ */
+void ntru_tern_to_int_ct(NtruTernPoly *a, NtruIntPoly *b);
+
+/**
+ * @brief General polynomial by ternary polynomial multiplication, constant time
+ *
+ * Multiplies a NtruIntPoly by a NtruTernPoly without secret-dependent memory
+ * accesses or branches. b is converted with ntru_tern_to_int_ct() and then
+ * multiplied with ntru_mult_tern_packed(). The number of coefficients must be
+ * the same for both polynomials.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+/**
+ * @brief General polynomial by product-form polynomial multiplication, constant time
+ *
+ * Multiplies a NtruIntPoly by a NtruProdPoly without secret-dependent memory
+ * accesses or branches by computing a*(f1*f2+f3) with ntru_mult_int().
+ * The number of coefficients must be the same for both polynomials.
+ *
+ * @param a a general polynomial
+ * @param b a product-form polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_prod_ct(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
 #endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
 
+/**
+ * @brief Constant-time mode
+ *
+ * Selects whether ntru_set_optimized_impl_poly() points ntru_mult_tern and
+ * ntru_mult_prod to the constant-time versions.
+ *
+ * @param enable 1 for constant-time multiplication, 0 for the fastest variant
+ */
+void ntru_set_constant_time_poly(uint8_t enable);
+
+/**
+ * @brief Constant-time mode
+ *
+ * @return 1 if constant-time multiplication is selected, 0 otherwise
+ */
+uint8_t ntru_get_constant_time_poly();
+
 /**
  * @brief General polynomial by private polynomial multiplication
  *
@@ -249,8 +446,21 @@ void (*ntru_to_arr)(NtruIntPoly *p, uint16_t q, uint8_t *a);
  */
 void ntru_to_arr4(NtruIntPoly *p, uint8_t *arr);
 
+/**
+ * @brief Binary to polynomial
+ *
+ * Decodes a uint8_t array encoded with ntru_to_arr() to a polynomial.
+ * Uses ntru_from_arr_avx2_2048() if q=2048 and AVX2 is available.
+ *
+ * @param arr a byte array
+ * @param N the number of coefficients
+ * @param q the modulus; must be a power of two
+ * @param p output parameter; a pointer to store the polynomial
+ */
 void ntru_from_arr(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p);
 
+void ntru_from_arr_standard(uint8_t *arr, uint16_t N, uint16_t q, NtruIntPoly *p);
+
 /**
  * @brief Multiplies a polynomial by a factor
  *
@@ -315,6 +525,28 @@ uint8_t ntru_mult_int_64(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_
  */
 void (*ntru_mod_mask)(NtruIntPoly *p, uint16_t mod_mask);
 
+/**
+ * @brief Reduction modulo a power of two, 32-bit version
+ *
+ * Reduces the coefficients of an NtruIntPoly modulo a power of two,
+ * processing two coefficients at a time.
+ *
+ * @param p input and output parameter; coefficients are overwritten
+ * @param mod_mask an AND mask to apply to the coefficients of c
+ */
+void ntru_mod_32(NtruIntPoly *p, uint16_t mod_mask);
+
+/**
+ * @brief Reduction modulo a power of two, 64-bit version
+ *
+ * Reduces the coefficients of an NtruIntPoly modulo a power of two,
+ * processing four coefficients at a time.
+ *
+ * @param p input and output parameter; coefficients are overwritten
+ * @param mod_mask an AND mask to apply to the coefficients of c
+ */
+void ntru_mod_64(NtruIntPoly *p, uint16_t mod_mask);
+
 /**
  * @brief Reduction modulo 3
  *
@@ -325,6 +557,15 @@ void (*ntru_mod_mask)(NtruIntPoly *p, uint16_t mod_mask);
  */
 void ntru_mod3(NtruIntPoly *p);
 
+/**
+ * @brief Reduction modulo 3, generic version
+ *
+ * Same as ntru_mod3() but does not use SIMD instructions.
+ *
+ * @param p input and output parameter; coefficients are overwritten
+ */
+void ntru_mod3_standard(NtruIntPoly *p);
+
 /**
  * @brief Reduction modulo an integer, centered
  *
@@ -336,6 +577,52 @@ void ntru_mod3(NtruIntPoly *p);
  */
 void ntru_mod_center(NtruIntPoly *p, uint16_t modulus);
 
+/**
+ * @brief Fused decryption post-processing
+ *
+ * Computes d = center(3*d+e mod q) mod 3 and r = (e-d) mod q in a single
+ * pass, and counts the number of coefficients of d equal to 0, 1, and 2.
+ * This is equivalent to ntru_mult_fac(d, 3), ntru_add(d, e),
+ * ntru_mod_center(d, q), ntru_mod3(d), followed by r=e, ntru_sub(r, d),
+ * and ntru_mod_mask(r, q-1).
+ *
+ * @param d input and output parameter; must be reduced modulo q on input
+ * @param e the encrypted polynomial
+ * @param modulus the modulus q; must be a power of two no greater than 2048
+ * @param r output parameter; a pointer to store (e-d) mod q
+ * @param weights output parameter; an array of size 3 for the number of
+ *                coefficients of d that are 0, 1, and 2, respectively
+ */
+void ntru_decrypt_post(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights);
+
+void ntru_decrypt_post_standard(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights);
+
+/* Scalar version of ntru_decrypt_post() for coefficients start..N-1; adds to weights */
+void ntru_decrypt_post_tail(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights, uint16_t start);
+
+/**
+ * @brief Fused encryption post-processing
+ *
+ * Computes m = (m+mask) mod 3 and r = r+m in a single pass, and counts the
+ * number of coefficients of m equal to 0, 1, and 2.
+ * This is equivalent to ntru_add(m, mask), ntru_mod3(m), and ntru_add(r, m)
+ * followed by a count of each coefficient value, which the caller checks
+ * against dm0.
+ *
+ * @param m input and output parameter; the message representative
+ * @param mask the MGF output; coefficients must be in the -1..2 range
+ * @param r input and output parameter; m is added to it. Coefficients are
+ *          not reduced.
+ * @param weights output parameter; an array of size 3 for the number of
+ *                coefficients of m that are 0, 1, and 2, respectively
+ */
+void ntru_encrypt_post(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights);
+
+void ntru_encrypt_post_standard(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights);
+
+/* Scalar version of ntru_encrypt_post() for coefficients start..N-1; adds to weights */
+void ntru_encrypt_post_tail(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights, uint16_t start);
+
 /**
  * @brief Equality of two polynomials
  *
@@ -413,6 +700,20 @@ uint8_t ntru_invert_32(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq);
  */
 uint8_t ntru_invert_64(NtruPrivPoly *a, uint16_t mod_mask, NtruIntPoly *Fq);
 
+/**
+ * @brief Inverse modulo q of a packed ternary polynomial
+ *
+ * Computes the inverse of 1+3a mod q, where a is a NtruTernPolyPacked.
+ * q must be a power of 2. Same as ntru_invert() but operates on the bitmaps
+ * directly.
+ *
+ * @param a a packed ternary polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @param Fq output parameter; a pointer to store the new polynomial
+ * @return 1 if a is invertible, 0 otherwise
+ */
+uint8_t ntru_invert_tern_packed(NtruTernPolyPacked *a, uint16_t mod_mask, NtruIntPoly *Fq);
+
 /**
  * @brief Choose fastest implementation
  *
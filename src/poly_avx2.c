@@ -1,12 +1,19 @@
 #ifdef __AVX2__
 #include <string.h>
 #include <immintrin.h>
+#include "poly.h"
 #include "poly_avx2.h"
 #include "types.h"
+#include "profile.h"
 
 #define NTRU_SPARSE_THRESH_AVX2 14
+#define NTRU_TOOM4_THRESH_AVX2 64   /* min N for ntru_mult_int_avx2_toom4() */
+#define NTRU_KARATSUBA_LEAF_AVX2 64   /* max size for a schoolbook product */
+#define NTRU_CT_TOOM4_THRESH_AVX2 416   /* min N for Toom-4 in ntru_mult_tern_avx2_ct() */
+#define NTRU_CT_BLOCKS_AVX2 12   /* accumulators (16 coefficients each) in ntru_mult_tern_avx2_ct() */
 
-uint8_t ntru_mult_int_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+uint8_t ntru_mult_int_avx2_schoolbook(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_INT_AVX2_SCHOOLBOOK);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -72,8 +79,235 @@ uint8_t ntru_mult_int_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint1
     return 1;
 }
 
+/*
+ * Schoolbook product of two polynomials of s coefficients, s a multiple of 16
+ * and at most NTRU_KARATSUBA_LEAF_AVX2. Writes 2s coefficients to c.
+ */
+void ntru_mult_leaf_avx2(uint16_t *a, uint16_t *b, uint16_t *c, uint16_t s) {
+    /* b with s zeros on either side so every 16-coefficient window can be loaded */
+    uint16_t b_pad[3*NTRU_KARATSUBA_LEAF_AVX2];
+    memset(b_pad, 0, s * sizeof b_pad[0]);
+    memcpy(&b_pad[s], b, s * sizeof b_pad[0]);
+    memset(&b_pad[2*s], 0, s * sizeof b_pad[0]);
+
+    uint16_t k;
+    for (k=0; k<2*s; k+=16) {
+        /* c[k..k+15] = sum of a[i]*b[k-i..k-i+15] */
+        uint16_t i_start = k+1>s ? k+1-s : 0;
+        uint16_t i_end = k+16<s ? k+16 : s;
+        __m256i c256 = _mm256_setzero_si256();
+        uint16_t i;
+        for (i=i_start; i<i_end; i++) {
+            __m256i a256 = _mm256_set1_epi16(a[i]);
+            __m256i b256 = _mm256_lddqu_si256((__m256i*)&b_pad[s+k-i]);
+            c256 = _mm256_add_epi16(c256, _mm256_mullo_epi16(a256, b256));
+        }
+        _mm256_storeu_si256((__m256i*)&c[k], c256);
+    }
+}
+
+/* adds len coefficients of b to a, len a multiple of 16 */
+void ntru_add_coeffs_avx2(uint16_t *a, uint16_t *b, uint16_t len) {
+    uint16_t i;
+    for (i=0; i<len; i+=16) {
+        __m256i a256 = _mm256_lddqu_si256((__m256i*)&a[i]);
+        __m256i b256 = _mm256_lddqu_si256((__m256i*)&b[i]);
+        _mm256_storeu_si256((__m256i*)&a[i], _mm256_add_epi16(a256, b256));
+    }
+}
+
+/* subtracts len coefficients of b from a, len a multiple of 16 */
+void ntru_sub_coeffs_avx2(uint16_t *a, uint16_t *b, uint16_t len) {
+    uint16_t i;
+    for (i=0; i<len; i+=16) {
+        __m256i a256 = _mm256_lddqu_si256((__m256i*)&a[i]);
+        __m256i b256 = _mm256_lddqu_si256((__m256i*)&b[i]);
+        _mm256_storeu_si256((__m256i*)&a[i], _mm256_sub_epi16(a256, b256));
+    }
+}
+
+/*
+ * Karatsuba product of two polynomials of s coefficients, s a multiple of 16.
+ * Writes 2s coefficients to c. No reduction takes place; results are exact
+ * mod 2^16.
+ */
+void ntru_mult_karatsuba_avx2(uint16_t *a, uint16_t *b, uint16_t *c, uint16_t s) {
+    if (s <= NTRU_KARATSUBA_LEAF_AVX2) {
+        ntru_mult_leaf_avx2(a, b, c, s);
+        return;
+    }
+
+    /* split into a lower half of h and an upper half of l<=h coefficients */
+    uint16_t h = (s/2+15) / 16 * 16;
+    uint16_t l = s - h;
+    uint16_t a01[h], b01[h];
+    memcpy(a01, a, h * sizeof a01[0]);
+    memcpy(b01, b, h * sizeof b01[0]);
+    ntru_add_coeffs_avx2(a01, a+h, l);
+    ntru_add_coeffs_avx2(b01, b+h, l);
+
+    ntru_mult_karatsuba_avx2(a, b, c, h);   /* c[0..2h-1] = a0*b0 */
+    ntru_mult_karatsuba_avx2(a+h, b+h, c+2*h, l);   /* c[2h..2s-1] = a1*b1 */
+    uint16_t p1[2*h];
+    ntru_mult_karatsuba_avx2(a01, b01, p1, h);
+    ntru_sub_coeffs_avx2(p1, c, 2*h);
+    ntru_sub_coeffs_avx2(p1, c+2*h, 2*l);
+    ntru_add_coeffs_avx2(c+h, p1, 2*h);   /* h+2h <= 2s because s > NTRU_KARATSUBA_LEAF_AVX2 */
+}
+
+/*
+ * Toom-4 product of two polynomials of n coefficients, n a multiple of 64.
+ * Writes 2n coefficients to c. The interpolation step divides by 8, so only
+ * the lower 13 bits of each coefficient are correct.
+ * Evaluation points are 0, 1, -1, 2, 1/2, -1/2 and infinity; the values at
+ * 1/2 and -1/2 are scaled by 8 to stay integral.
+ */
+void ntru_mult_toom4_avx2(uint16_t *a, uint16_t *b, uint16_t *c, uint16_t n) {
+    uint16_t m = n / 4;
+    uint16_t aw[7][m], bw[7][m];
+    uint16_t i, j;
+
+    /* evaluation */
+    uint16_t *x, *xw;
+    for (j=0; j<2; j++) {
+        x = j ? b : a;
+        for (i=0; i<m; i+=16) {
+            __m256i x0 = _mm256_lddqu_si256((__m256i*)&x[i]);
+            __m256i x1 = _mm256_lddqu_si256((__m256i*)&x[m+i]);
+            __m256i x2 = _mm256_lddqu_si256((__m256i*)&x[2*m+i]);
+            __m256i x3 = _mm256_lddqu_si256((__m256i*)&x[3*m+i]);
+
+            __m256i even = _mm256_add_epi16(x0, x2);
+            __m256i odd = _mm256_add_epi16(x1, x3);
+            __m256i p1 = _mm256_add_epi16(even, odd);   /* x(1) */
+            __m256i m1 = _mm256_sub_epi16(even, odd);   /* x(-1) */
+
+            even = _mm256_slli_epi16(_mm256_add_epi16(_mm256_slli_epi16(x0, 2), x2), 1);
+            odd = _mm256_add_epi16(_mm256_slli_epi16(x1, 2), x3);
+            __m256i ph = _mm256_add_epi16(even, odd);   /* 8*x(1/2) */
+            __m256i mh = _mm256_sub_epi16(even, odd);   /* 8*x(-1/2) */
+
+            __m256i p2 = _mm256_add_epi16(_mm256_slli_epi16(x3, 3), _mm256_slli_epi16(x2, 2));
+            p2 = _mm256_add_epi16(p2, _mm256_add_epi16(_mm256_slli_epi16(x1, 1), x0));   /* x(2) */
+
+            xw = j ? &bw[0][0] : &aw[0][0];
+            _mm256_storeu_si256((__m256i*)&xw[0*m+i], x3);
+            _mm256_storeu_si256((__m256i*)&xw[1*m+i], p2);
+            _mm256_storeu_si256((__m256i*)&xw[2*m+i], p1);
+            _mm256_storeu_si256((__m256i*)&xw[3*m+i], m1);
+            _mm256_storeu_si256((__m256i*)&xw[4*m+i], ph);
+            _mm256_storeu_si256((__m256i*)&xw[5*m+i], mh);
+            _mm256_storeu_si256((__m256i*)&xw[6*m+i], x0);
+        }
+    }
+
+    /* multiplication */
+    uint16_t w[7][2*m];
+    for (j=0; j<7; j++)
+        ntru_mult_karatsuba_avx2(aw[j], bw[j], w[j], m);
+
+    /* interpolation */
+    memset(c, 0, 2 * n * sizeof c[0]);
+    __m256i inv3 = _mm256_set1_epi16(43691);   /* 3^-1 mod 2^16 */
+    __m256i inv9 = _mm256_set1_epi16(36409);   /* 9^-1 mod 2^16 */
+    __m256i inv15 = _mm256_set1_epi16(61167);   /* 15^-1 mod 2^16 */
+    __m256i _45 = _mm256_set1_epi16(45);
+    __m256i _30 = _mm256_set1_epi16(30);
+    for (i=0; i<2*m; i+=16) {
+        __m256i r0 = _mm256_lddqu_si256((__m256i*)&w[0][i]);
+        __m256i r1 = _mm256_lddqu_si256((__m256i*)&w[1][i]);
+        __m256i r2 = _mm256_lddqu_si256((__m256i*)&w[2][i]);
+        __m256i r3 = _mm256_lddqu_si256((__m256i*)&w[3][i]);
+        __m256i r4 = _mm256_lddqu_si256((__m256i*)&w[4][i]);
+        __m256i r5 = _mm256_lddqu_si256((__m256i*)&w[5][i]);
+        __m256i r6 = _mm256_lddqu_si256((__m256i*)&w[6][i]);
+
+        r1 = _mm256_add_epi16(r1, r4);
+        r5 = _mm256_sub_epi16(r5, r4);
+        r3 = _mm256_srli_epi16(_mm256_sub_epi16(r3, r2), 1);
+        r4 = _mm256_sub_epi16(r4, r0);
+        r4 = _mm256_sub_epi16(r4, _mm256_slli_epi16(r6, 6));
+        r4 = _mm256_add_epi16(_mm256_slli_epi16(r4, 1), r5);
+        r2 = _mm256_add_epi16(r2, r3);
+        r1 = _mm256_sub_epi16(r1, _mm256_slli_epi16(r2, 6));
+        r1 = _mm256_sub_epi16(r1, r2);
+        r2 = _mm256_sub_epi16(r2, r6);
+        r2 = _mm256_sub_epi16(r2, r0);
+        r1 = _mm256_add_epi16(r1, _mm256_mullo_epi16(r2, _45));
+        r4 = _mm256_sub_epi16(r4, _mm256_slli_epi16(r2, 3));
+        r4 = _mm256_srli_epi16(_mm256_mullo_epi16(r4, inv3), 3);
+        r5 = _mm256_add_epi16(r5, r1);
+        r1 = _mm256_add_epi16(r1, _mm256_slli_epi16(r3, 4));
+        r1 = _mm256_srli_epi16(_mm256_mullo_epi16(r1, inv9), 1);
+        r3 = _mm256_sub_epi16(_mm256_setzero_si256(), _mm256_add_epi16(r3, r1));
+        r5 = _mm256_sub_epi16(_mm256_mullo_epi16(r1, _30), r5);
+        r5 = _mm256_srli_epi16(_mm256_mullo_epi16(r5, inv15), 2);
+        r2 = _mm256_sub_epi16(r2, r4);
+        r1 = _mm256_sub_epi16(r1, r5);
+
+        __m256i *ci;
+        ci = (__m256i*)&c[i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r6));
+        ci = (__m256i*)&c[m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r5));
+        ci = (__m256i*)&c[2*m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r4));
+        ci = (__m256i*)&c[3*m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r3));
+        ci = (__m256i*)&c[4*m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r2));
+        ci = (__m256i*)&c[5*m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r1));
+        ci = (__m256i*)&c[6*m+i];
+        _mm256_storeu_si256(ci, _mm256_add_epi16(_mm256_lddqu_si256(ci), r0));
+    }
+}
+
+uint8_t ntru_mult_int_avx2_toom4(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_INT_AVX2_TOOM4);
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    c->N = N;
+
+    uint16_t n = (N+63) / 64 * 64;
+    uint16_t a_pad[n], b_pad[n];
+    memcpy(a_pad, a->coeffs, N * sizeof a_pad[0]);
+    memset(&a_pad[N], 0, (n-N) * sizeof a_pad[0]);
+    memcpy(b_pad, b->coeffs, N * sizeof b_pad[0]);
+    memset(&b_pad[N], 0, (n-N) * sizeof b_pad[0]);
+
+    uint16_t c_pad[2*n];
+    ntru_mult_toom4_avx2(a_pad, b_pad, c_pad, n);
+
+    /* reduce mod X^N-1 and apply mod_mask */
+    __m256i mod_mask_256 = _mm256_set1_epi16(mod_mask);
+    uint16_t i;
+    for (i=0; i<N; i+=16) {
+        __m256i lo = _mm256_lddqu_si256((__m256i*)&c_pad[i]);
+        __m256i hi = _mm256_lddqu_si256((__m256i*)&c_pad[N+i]);
+        __m256i sum = _mm256_and_si256(_mm256_add_epi16(lo, hi), mod_mask_256);
+        _mm256_storeu_si256((__m256i*)&c->coeffs[i], sum);
+    }
+
+    return 1;
+}
+
+uint8_t ntru_mult_int_avx2_toom4_exact(uint16_t N, uint16_t mod_mask) {
+    /* Toom-4 only yields 13 correct bits */
+    return N>=NTRU_TOOM4_THRESH_AVX2 && mod_mask<(1<<13);
+}
+
+uint8_t ntru_mult_int_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    if (ntru_mult_int_avx2_toom4_exact(a->N, mod_mask))
+        return ntru_mult_int_avx2_toom4(a, b, c, mod_mask);
+    else
+        return ntru_mult_int_avx2_schoolbook(a, b, c, mod_mask);
+}
+
 /* Optimized for small df */
 uint8_t ntru_mult_tern_avx2_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_AVX2_SPARSE);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -134,6 +368,7 @@ uint8_t ntru_mult_tern_avx2_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly
 
 /* Optimized for large df */
 uint8_t ntru_mult_tern_avx2_dense(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_AVX2_DENSE);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -233,6 +468,75 @@ uint8_t ntru_mult_tern_avx2(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uin
         return ntru_mult_tern_avx2_dense(a, b, c, mod_mask);
 }
 
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+/*
+ * Adds a*b to the 2N-coefficient accumulator acc without reducing.
+ * a must be zero-padded to a multiple of 16 coefficients.
+ */
+void ntru_acc_tern_avx2(int16_t *acc, int16_t *a, uint16_t N, NtruTernPoly *b) {
+    uint16_t i, j;
+    for (i=0; i<b->num_ones; i++) {
+        int16_t *ck = &acc[b->ones[i]];
+        for (j=0; j<N; j+=16) {
+            __m256i c256 = _mm256_lddqu_si256((__m256i*)&ck[j]);
+            __m256i a256 = _mm256_lddqu_si256((__m256i*)&a[j]);
+            _mm256_storeu_si256((__m256i*)&ck[j], _mm256_add_epi16(c256, a256));
+        }
+    }
+    for (i=0; i<b->num_neg_ones; i++) {
+        int16_t *ck = &acc[b->neg_ones[i]];
+        for (j=0; j<N; j+=16) {
+            __m256i c256 = _mm256_lddqu_si256((__m256i*)&ck[j]);
+            __m256i a256 = _mm256_lddqu_si256((__m256i*)&a[j]);
+            _mm256_storeu_si256((__m256i*)&ck[j], _mm256_sub_epi16(c256, a256));
+        }
+    }
+}
+
+uint8_t ntru_mult_prod_avx2(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_PROD_AVX2);
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    c->N = N;
+
+    uint16_t i;
+    for (i=N; i<NTRU_INT_POLY_SIZE; i++)
+        a->coeffs[i] = 0;
+    uint16_t N16 = (N+15) / 16 * 16;
+    int16_t acc[2*NTRU_INT_POLY_SIZE];   /* double capacity for intermediate result */
+    int16_t t[NTRU_INT_POLY_SIZE];
+
+    /*
+     * t = a*f1. Coefficients are left unreduced because int16 arithmetic
+     * is exact mod 2^16, and mod_mask+1 divides 2^16.
+     */
+    memset(acc, 0, (N16+N+16) * sizeof acc[0]);
+    ntru_acc_tern_avx2(acc, a->coeffs, N, &b->f1);
+    for (i=0; i<N; i+=16) {
+        __m256i lo = _mm256_lddqu_si256((__m256i*)&acc[i]);
+        __m256i hi = _mm256_lddqu_si256((__m256i*)&acc[N+i]);
+        _mm256_storeu_si256((__m256i*)&t[i], _mm256_add_epi16(lo, hi));
+    }
+    for (i=N; i<N16; i++)
+        t[i] = 0;
+
+    /* c = t*f2 + a*f3, reduced once at the end */
+    memset(acc, 0, (N16+N+16) * sizeof acc[0]);
+    ntru_acc_tern_avx2(acc, t, N, &b->f2);
+    ntru_acc_tern_avx2(acc, a->coeffs, N, &b->f3);
+    __m256i mod_mask_256 = _mm256_set1_epi16(mod_mask);
+    for (i=0; i<N; i+=16) {
+        __m256i lo = _mm256_lddqu_si256((__m256i*)&acc[i]);
+        __m256i hi = _mm256_lddqu_si256((__m256i*)&acc[N+i]);
+        __m256i sum = _mm256_and_si256(_mm256_add_epi16(lo, hi), mod_mask_256);
+        _mm256_storeu_si256((__m256i*)&c->coeffs[i], sum);
+    }
+
+    return 1;
+}
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
 void ntru_mod_avx2(NtruIntPoly *p, uint16_t mod_mask) {
     uint16_t i;
     __m256i mod_mask_256 = _mm256_set1_epi16(mod_mask);
@@ -246,48 +550,329 @@ void ntru_mod_avx2(NtruIntPoly *p, uint16_t mod_mask) {
 
 __m256i NTRU_MOD3_LUT_AVX = {0x0403050403050403, 0, 0x0403050403050403, 0};
 
+/* Reduces the coefficients of a to the range 0..2; requires -3000 <= a < 29768 */
+static inline __m256i ntru_mod3_256(__m256i a) {
+    /* make positive */
+    __m256i _3000 = _mm256_set1_epi16(3000);
+    a = _mm256_add_epi16(a, _3000);
+
+    /* a = (a>>8) + (a&0xFF);  (sum base 2**8 digits) */
+    __m256i a1 = _mm256_srli_epi16(a, 8);
+    __m256i mask = _mm256_set1_epi16(0x00FF);
+    __m256i a2 = _mm256_and_si256(a, mask);
+    a = _mm256_add_epi16(a1, a2);
+
+    /* a = (a>>4) + (a&0xF);  (sum base 2**4 digits; worst case 0x3B) */
+    a1 = _mm256_srli_epi16(a, 4);
+    mask = _mm256_set1_epi16(0x000F);
+    a2 = _mm256_and_si256(a, mask);
+    a = _mm256_add_epi16(a1, a2);
+    /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x1B) */
+    a1 = _mm256_srli_epi16(a, 2);
+    mask = _mm256_set1_epi16(0x0003);
+    a2 = _mm256_and_si256(a, mask);
+    a = _mm256_add_epi16(a1, a2);
+
+    /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x7) */
+    a1 = _mm256_srli_epi16(a, 2);
+    mask = _mm256_set1_epi16(0x0003);
+    a2 = _mm256_and_si256(a, mask);
+    a = _mm256_add_epi16(a1, a2);
+
+    __m256i a_mod3 = _mm256_shuffle_epi8(NTRU_MOD3_LUT_AVX, a);
+    /* _mm256_shuffle_epi8 changed bytes 1, 3, 5, ... to non-zero; change them back to zero */
+    mask = _mm256_set1_epi16(0x00FF);
+    a_mod3 = _mm256_and_si256(a_mod3, mask);
+    /* subtract 3 so coefficients are in the 0..2 range */
+    __m256i three = _mm256_set1_epi16(0x0003);
+    return _mm256_sub_epi16(a_mod3, three);
+}
+
 void ntru_mod3_avx2(NtruIntPoly *p) {
     uint16_t i;
     for (i=0; i<(p->N+15)/16*16; i+=16) {
         __m256i a = _mm256_lddqu_si256((__m256i*)&p->coeffs[i]);
+        _mm256_storeu_si256((__m256i*)&p->coeffs[i], ntru_mod3_256(a));
+    }
+}
+
+/* Adds up the 16-bit lanes of a */
+static inline uint16_t ntru_hsum_256(__m256i a) {
+    __m128i s = _mm_add_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    s = _mm_add_epi16(s, _mm_srli_si128(s, 8));
+    s = _mm_add_epi16(s, _mm_srli_si128(s, 4));
+    s = _mm_add_epi16(s, _mm_srli_si128(s, 2));
+    return _mm_extract_epi16(s, 0);
+}
+
+void ntru_from_arr_avx2_2048(uint8_t *arr, uint16_t N, NtruIntPoly *p) {
+    p->N = N;
+    uint16_t arr_len = (N*11+7) / 8;
+
+    /*
+     * Coefficient i of a group of 8 starts at bit 11*i, i.e. at byte
+     * 11*i/8, bit 11*i%8. Each 32-bit lane gets the 3 bytes that contain
+     * one coefficient and is shifted right by the bit offset.
+     */
+    __m256i shuf = _mm256_setr_epi8(0, 1, 2, -1, 1, 2, 3, -1, 2, 3, 4, -1, 4, 5, 6, -1,
+                                    5, 6, 7, -1, 6, 7, 8, -1, 8, 9, 10, -1, 9, 10, 11, -1);
+    __m256i shift = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    __m256i mask = _mm256_set1_epi32(2047);
+
+    /* 16 coefficients from 22 bytes per iteration; the loads read 27 bytes */
+    uint16_t p_idx = 0;
+    uint16_t a_idx = 0;
+    while (p_idx+16<=N && a_idx+27<=arr_len) {
+        __m256i a_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)&arr[a_idx]));
+        __m256i a_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)&arr[a_idx+11]));
+        __m256i c_lo = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(a_lo, shuf), shift), mask);
+        __m256i c_hi = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(a_hi, shuf), shift), mask);
+        /* packus works on 128-bit lanes, so the result is in the order 0..3, 8..11, 4..7, 12..15 */
+        __m256i c = _mm256_packus_epi32(c_lo, c_hi);
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(3,1,2,0));
+        _mm256_storeu_si256((__m256i*)&p->coeffs[p_idx], c);
+        p_idx += 16;
+        a_idx += 22;
+    }
+
+    /* remaining coefficients; a_idx is at a byte boundary */
+    uint32_t coeff_buf = 0;
+    uint8_t coeff_bits = 0;
+    while (p_idx < N) {
+        while (coeff_bits < 11) {
+            coeff_buf += arr[a_idx] << coeff_bits;
+            coeff_bits += 8;
+            a_idx++;
+        }
+        p->coeffs[p_idx] = coeff_buf & 2047;
+        p_idx++;
+        coeff_buf >>= 11;
+        coeff_bits -= 11;
+    }
+}
+
+/* Same as ntru_indices_to_mask_ct() with four mask words per register */
+void ntru_indices_to_mask_ct_avx2(uint16_t *indices, uint16_t num_indices, uint64_t *mask, uint16_t N) {
+    __m256i m[(NTRU_TERN_PACKED_WORDS+3)/4];
+    uint16_t num_vec = (N+255) / 256;
+    uint16_t i, v;
+    for (v=0; v<(NTRU_TERN_PACKED_WORDS+3)/4; v++)
+        m[v] = _mm256_setzero_si256();
+    __m256i four = _mm256_set1_epi64x(4);
+    for (i=0; i<num_indices; i++) {
+        uint16_t idx = indices[i];
+        __m256i bit = _mm256_set1_epi64x(1ULL << (idx%64));
+        __m256i word = _mm256_set1_epi64x(idx / 64);
+        __m256i j = _mm256_setr_epi64x(0, 1, 2, 3);
+        for (v=0; v<num_vec; v++) {
+            m[v] = _mm256_or_si256(m[v], _mm256_and_si256(bit, _mm256_cmpeq_epi64(j, word)));
+            j = _mm256_add_epi64(j, four);
+        }
+    }
+    memcpy(mask, m, NTRU_TERN_PACKED_WORDS * sizeof mask[0]);
+}
+
+void ntru_tern_pack_avx2(NtruTernPoly *a, NtruTernPolyPacked *b) {
+    b->N = a->N;
+    ntru_indices_to_mask_ct_avx2(a->ones, a->num_ones, b->ones, a->N);
+    ntru_indices_to_mask_ct_avx2(a->neg_ones, a->num_neg_ones, b->neg_ones, a->N);
+}
+
+void ntru_tern_packed_to_int_avx2(NtruTernPolyPacked *a, NtruIntPoly *b) {
+    typedef uint16_t __attribute__((__may_alias__)) uint16_t_alias;
+    uint16_t_alias *ones = (uint16_t_alias*)a->ones;
+    uint16_t_alias *neg_ones = (uint16_t_alias*)a->neg_ones;
+    __m256i bitsel = _mm256_setr_epi16(1<<0, 1<<1, 1<<2, 1<<3, 1<<4, 1<<5, 1<<6, 1<<7,
+                                       1<<8, 1<<9, 1<<10, 1<<11, 1<<12, 1<<13, 1<<14, (int16_t)(1<<15));
+    b->N = a->N;
+    uint16_t i;
+    /* unused bits are zero, so whole blocks of 16 can be converted */
+    for (i=0; i<(a->N+15)/16*16; i+=16) {
+        __m256i pos = _mm256_and_si256(_mm256_set1_epi16(ones[i/16]), bitsel);
+        __m256i neg = _mm256_and_si256(_mm256_set1_epi16(neg_ones[i/16]), bitsel);
+        pos = _mm256_cmpeq_epi16(pos, bitsel);   /* -1 where the coefficient is 1 */
+        neg = _mm256_cmpeq_epi16(neg, bitsel);   /* -1 where the coefficient is -1 */
+        _mm256_storeu_si256((__m256i*)&b->coeffs[i], _mm256_sub_epi16(neg, pos));
+    }
+    for (; i<NTRU_INT_POLY_SIZE; i++)
+        b->coeffs[i] = 0;
+}
+
+/*
+ * Adds sum_j b_j*a[i-j mod N] to 16*NTRU_CT_BLOCKS_AVX2 coefficients starting
+ * at i0, keeping the sums in registers. a_pad holds a twice, followed by its
+ * first 16 coefficients, so every load is at a public offset.
+ */
+static inline void ntru_mult_tern_avx2_ct_block(int16_t *a_pad, int16_t *b_coeffs, uint16_t N, uint16_t i0, int16_t *c_coeffs) {
+    /* separate variables rather than an array so gcc keeps them in registers */
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    __m256i acc4 = acc0, acc5 = acc0, acc6 = acc0, acc7 = acc0;
+    __m256i acc8 = acc0, acc9 = acc0, acc10 = acc0, acc11 = acc0;
+    uint16_t j;
+    for (j=0; j<N; j++) {
+        /* a*b_j via sign: a, -a, or 0 without a branch or a secret-dependent address */
+        __m256i bj = _mm256_set1_epi16(b_coeffs[j]);
+        int16_t *ap = &a_pad[N+i0-j];
+#define NTRU_CT_ACC_AVX2(r) acc##r = _mm256_add_epi16(acc##r, _mm256_sign_epi16(_mm256_loadu_si256((__m256i*)&ap[16*r]), bj))
+        NTRU_CT_ACC_AVX2(0); NTRU_CT_ACC_AVX2(1); NTRU_CT_ACC_AVX2(2); NTRU_CT_ACC_AVX2(3);
+        NTRU_CT_ACC_AVX2(4); NTRU_CT_ACC_AVX2(5); NTRU_CT_ACC_AVX2(6); NTRU_CT_ACC_AVX2(7);
+        NTRU_CT_ACC_AVX2(8); NTRU_CT_ACC_AVX2(9); NTRU_CT_ACC_AVX2(10); NTRU_CT_ACC_AVX2(11);
+#undef NTRU_CT_ACC_AVX2
+    }
+    __m256i *c256 = (__m256i*)&c_coeffs[i0];
+    _mm256_storeu_si256(c256+0, acc0); _mm256_storeu_si256(c256+1, acc1);
+    _mm256_storeu_si256(c256+2, acc2); _mm256_storeu_si256(c256+3, acc3);
+    _mm256_storeu_si256(c256+4, acc4); _mm256_storeu_si256(c256+5, acc5);
+    _mm256_storeu_si256(c256+6, acc6); _mm256_storeu_si256(c256+7, acc7);
+    _mm256_storeu_si256(c256+8, acc8); _mm256_storeu_si256(c256+9, acc9);
+    _mm256_storeu_si256(c256+10, acc10); _mm256_storeu_si256(c256+11, acc11);
+}
+
+/* Same as ntru_mult_tern_avx2_ct_block() for 16 coefficients */
+static inline void ntru_mult_tern_avx2_ct_one(int16_t *a_pad, int16_t *b_coeffs, uint16_t N, uint16_t i0, int16_t *c_coeffs) {
+    __m256i acc = _mm256_setzero_si256();
+    uint16_t j;
+    for (j=0; j<N; j++) {
+        __m256i bj = _mm256_set1_epi16(b_coeffs[j]);
+        __m256i a256 = _mm256_loadu_si256((__m256i*)&a_pad[N+i0-j]);
+        acc = _mm256_add_epi16(acc, _mm256_sign_epi16(a256, bj));
+    }
+    _mm256_storeu_si256((__m256i*)&c_coeffs[i0], acc);
+}
+
+uint8_t ntru_mult_tern_avx2_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    if (N >= NTRU_CT_TOOM4_THRESH_AVX2)
+        return ntru_mult_tern_ct(a, b, c, mod_mask);
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_AVX2_CT);
+    c->N = N;
+
+    NtruTernPolyPacked b_packed;
+    NtruIntPoly b_int;
+    ntru_tern_pack_avx2(b, &b_packed);
+    ntru_tern_packed_to_int_avx2(&b_packed, &b_int);
+
+    uint16_t N16 = (N+15) / 16 * 16;
+    int16_t a_pad[2*NTRU_INT_POLY_SIZE+16];
+    memcpy(a_pad, a->coeffs, N * sizeof a->coeffs[0]);
+    memcpy(a_pad+N, a->coeffs, N * sizeof a->coeffs[0]);
+    memcpy(a_pad+2*N, a->coeffs, 16 * sizeof a->coeffs[0]);
 
-        /* make positive */
-        __m256i _3000 = _mm256_set1_epi16(3000);
-        a = _mm256_add_epi16(a, _3000);
-
-        /* a = (a>>8) + (a&0xFF);  (sum base 2**8 digits) */
-        __m256i a1 = _mm256_srli_epi16(a, 8);
-        __m256i mask = _mm256_set1_epi16(0x00FF);
-        __m256i a2 = _mm256_and_si256(a, mask);
-        a = _mm256_add_epi16(a1, a2);
-
-        /* a = (a>>4) + (a&0xF);  (sum base 2**4 digits; worst case 0x3B) */
-        a1 = _mm256_srli_epi16(a, 4);
-        mask = _mm256_set1_epi16(0x000F);
-        a2 = _mm256_and_si256(a, mask);
-        a = _mm256_add_epi16(a1, a2);
-        /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x1B) */
-        a1 = _mm256_srli_epi16(a, 2);
-        mask = _mm256_set1_epi16(0x0003);
-        a2 = _mm256_and_si256(a, mask);
-        a = _mm256_add_epi16(a1, a2);
-
-        /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x7) */
-        a1 = _mm256_srli_epi16(a, 2);
-        mask = _mm256_set1_epi16(0x0003);
-        a2 = _mm256_and_si256(a, mask);
-        a = _mm256_add_epi16(a1, a2);
-
-        __m256i a_mod3 = _mm256_shuffle_epi8(NTRU_MOD3_LUT_AVX, a);
-        /* _mm256_shuffle_epi8 changed bytes 1, 3, 5, ... to non-zero; change them back to zero */
-        mask = _mm256_set1_epi16(0x00FF);
-        a_mod3 = _mm256_and_si256(a_mod3, mask);
-        /* subtract 3 so coefficients are in the 0..2 range */
-        __m256i three = _mm256_set1_epi16(0x0003);
-        a_mod3 = _mm256_sub_epi16(a_mod3, three);
-
-        _mm256_storeu_si256((__m256i*)&p->coeffs[i], a_mod3);
+    int16_t c_coeffs[NTRU_INT_POLY_SIZE+16*NTRU_CT_BLOCKS_AVX2];
+    uint16_t i0;
+    for (i0=0; i0+16*NTRU_CT_BLOCKS_AVX2<=N16; i0+=16*NTRU_CT_BLOCKS_AVX2)
+        ntru_mult_tern_avx2_ct_block(a_pad, b_int.coeffs, N, i0, c_coeffs);
+    for (; i0<N16; i0+=16)
+        ntru_mult_tern_avx2_ct_one(a_pad, b_int.coeffs, N, i0, c_coeffs);
+
+    __m256i mod_mask_256 = _mm256_set1_epi16(mod_mask);
+    for (i0=0; i0<N16; i0+=16) {
+        __m256i c256 = _mm256_loadu_si256((__m256i*)&c_coeffs[i0]);
+        _mm256_storeu_si256((__m256i*)&c->coeffs[i0], _mm256_and_si256(c256, mod_mask_256));
     }
+    return 1;
+}
+
+void ntru_decrypt_post_avx2(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights) {
+    uint16_t N = d->N;
+    r->N = N;
+    __m256i mod_mask = _mm256_set1_epi16(modulus-1);
+    __m256i m2 = _mm256_set1_epi16(modulus/2);
+    __m256i q = _mm256_set1_epi16(modulus);
+    __m256i one = _mm256_set1_epi16(1);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i w0 = zero;
+    __m256i w1 = zero;
+
+    uint16_t i;
+    for (i=0; i+16<=N; i+=16) {
+        __m256i d_i = _mm256_lddqu_si256((__m256i*)&d->coeffs[i]);
+        __m256i e_i = _mm256_lddqu_si256((__m256i*)&e->coeffs[i]);
+
+        /* c = 3*d+e mod q, centered */
+        __m256i c = _mm256_add_epi16(_mm256_add_epi16(d_i, _mm256_slli_epi16(d_i, 1)), e_i);
+        c = _mm256_and_si256(c, mod_mask);
+        __m256i gt = _mm256_cmpgt_epi16(c, m2);
+        c = _mm256_sub_epi16(c, _mm256_and_si256(gt, q));
+
+        c = ntru_mod3_256(c);
+        _mm256_storeu_si256((__m256i*)&d->coeffs[i], c);
+        __m256i r_i = _mm256_and_si256(_mm256_sub_epi16(e_i, c), mod_mask);
+        _mm256_storeu_si256((__m256i*)&r->coeffs[i], r_i);
+
+        /* count zeros and ones; cmpeq yields -1 for a match */
+        w0 = _mm256_sub_epi16(w0, _mm256_cmpeq_epi16(c, zero));
+        w1 = _mm256_sub_epi16(w1, _mm256_cmpeq_epi16(c, one));
+    }
+    weights[0] = ntru_hsum_256(w0);
+    weights[1] = ntru_hsum_256(w1);
+    weights[2] = i - weights[0] - weights[1];
+
+    ntru_decrypt_post_tail(d, e, modulus, r, weights, i);
+}
+
+void ntru_encrypt_post_avx2(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights) {
+    uint16_t N = m->N;
+    __m256i one = _mm256_set1_epi16(1);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i w0 = zero;
+    __m256i w1 = zero;
+
+    uint16_t i;
+    for (i=0; i+16<=N; i+=16) {
+        __m256i m_i = _mm256_lddqu_si256((__m256i*)&m->coeffs[i]);
+        __m256i mask_i = _mm256_lddqu_si256((__m256i*)&mask->coeffs[i]);
+        __m256i r_i = _mm256_lddqu_si256((__m256i*)&r->coeffs[i]);
+
+        __m256i c = ntru_mod3_256(_mm256_add_epi16(m_i, mask_i));
+        _mm256_storeu_si256((__m256i*)&m->coeffs[i], c);
+        _mm256_storeu_si256((__m256i*)&r->coeffs[i], _mm256_add_epi16(r_i, c));
+
+        w0 = _mm256_sub_epi16(w0, _mm256_cmpeq_epi16(c, zero));
+        w1 = _mm256_sub_epi16(w1, _mm256_cmpeq_epi16(c, one));
+    }
+    weights[0] = ntru_hsum_256(w0);
+    weights[1] = ntru_hsum_256(w1);
+    weights[2] = i - weights[0] - weights[1];
+
+    ntru_encrypt_post_tail(m, mask, r, weights, i);
+}
+
+/*
+ * Computes 16 coefficients of the unreduced product at a time, keeping the
+ * sums in registers. a is padded with 16 zeros on the left and at least 16
+ * on the right so that all loads are in bounds.
+ */
+uint8_t ntruprime_mult_small_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus) {
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    uint16_t a_pad[NTRU_INT_POLY_SIZE+32];
+    memset(a_pad, 0, sizeof a_pad);
+    memcpy(a_pad+16, a->coeffs, N * sizeof a->coeffs[0]);
+    uint32_t t[2*NTRU_INT_POLY_SIZE+16];
+
+    uint16_t k;
+    for (k=0; k<2*N; k+=16) {
+        __m256i lo = _mm256_setzero_si256();
+        __m256i hi = _mm256_setzero_si256();
+        uint16_t i = k<N ? 0 : k-N+1;
+        uint16_t i_end = k+16<N ? k+16 : N;
+        for (; i<i_end; i++) {
+            /* a[k-i..k-i+15]*b[i] */
+            __m256i a_i = _mm256_loadu_si256((__m256i*)&a_pad[16+k-i]);
+            __m256i prod = _mm256_mullo_epi16(a_i, _mm256_set1_epi16(b->coeffs[i]));
+            lo = _mm256_add_epi32(lo, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(prod)));
+            hi = _mm256_add_epi32(hi, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(prod, 1)));
+        }
+        _mm256_storeu_si256((__m256i*)&t[k], lo);
+        _mm256_storeu_si256((__m256i*)&t[k+8], hi);
+    }
+
+    ntruprime_mult_small_reduce(t, N, c, modulus);
+    return 1;
 }
 
 #endif   /* __AVX2__ */
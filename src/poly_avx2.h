@@ -13,6 +13,7 @@
  *
  * Multiplies a NtruIntPoly by another, taking the coefficient values modulo an integer.
  * The number of coefficients must be the same for both polynomials.
+ * Uses ntru_mult_int_avx2_toom4() for large N if mod_mask permits.
  * Requires AVX2 support.
  *
  * @param a input and output parameter; coefficients are overwritten
@@ -23,6 +24,47 @@
  */
 uint8_t ntru_mult_int_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask);
 
+/**
+ * @brief Multiplication of two general polynomials with a modulus, AVX2 schoolbook version
+ *
+ * Same as ntru_mult_int_avx2() but always uses schoolbook multiplication.
+ * Requires AVX2 support.
+ *
+ * @param a input and output parameter; coefficients are overwritten
+ * @param b a polynomial to multiply by
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply to the coefficients of c
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_int_avx2_schoolbook(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief Multiplication of two general polynomials with a modulus, AVX2 Toom-4 version
+ *
+ * Multiplies using one level of Toom-4, Karatsuba for the seven smaller
+ * products and AVX2 schoolbook multiplication at the bottom.
+ * Only the lower 13 bits of each coefficient are correct, so mod_mask
+ * must be less than 2^13 (for example q=2048).
+ * Requires AVX2 support.
+ *
+ * @param a a polynomial
+ * @param b a polynomial to multiply by
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply to the coefficients of c; at most 2^13-1
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_int_avx2_toom4(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief Toom-4 applicability
+ *
+ * @param N the number of coefficients
+ * @param mod_mask the mask ntru_mult_int_avx2_toom4() would be called with
+ * @return 1 if ntru_mult_int_avx2_toom4() computes exact products for N and
+ *         mod_mask, 0 otherwise
+ */
+uint8_t ntru_mult_int_avx2_toom4_exact(uint16_t N, uint16_t mod_mask);
+
 /**
  * @brief General polynomial by ternary polynomial multiplication, AVX2 version
  *
@@ -38,8 +80,108 @@ uint8_t ntru_mult_int_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint1
  */
 uint8_t ntru_mult_tern_avx2(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
 
+/**
+ * @brief General polynomial by sparse ternary polynomial multiplication, AVX2 version
+ *
+ * Same as ntru_mult_tern_avx2() but always uses the algorithm for ternary
+ * polynomials with few nonzero coefficients.
+ * This variant requires AVX2 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_avx2_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief General polynomial by dense ternary polynomial multiplication, AVX2 version
+ *
+ * Same as ntru_mult_tern_avx2() but always uses the algorithm for ternary
+ * polynomials with many nonzero coefficients.
+ * This variant requires AVX2 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_avx2_dense(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief General polynomial by ternary polynomial multiplication, constant time, AVX2 version
+ *
+ * Same result as ntru_mult_tern_ct(). For N below 416, b is expanded to
+ * trits via its bit masks (ntru_tern_pack()), and c is accumulated in
+ * registers as the sum of b_j times a rotated by j, where the product with
+ * b_j is a sign instruction. Larger N use ntru_mult_tern_ct(), whose
+ * Toom-4 multiplication is faster there. Either way, memory access and
+ * timing depend only on N and the weight of b.
+ * Requires AVX2 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_avx2_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+/**
+ * @brief General polynomial by product-form polynomial multiplication, AVX2 version
+ *
+ * Computes a*(f1*f2+f3) in two passes: t=a*f1, then t*f2+a*f3 into the
+ * same accumulator. Intermediate results are not reduced, only the final
+ * sum is. The number of coefficients must be the same for both polynomials.
+ * Requires AVX2 support.
+ *
+ * @param a a general polynomial
+ * @param b a product-form polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_prod_avx2(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
 void ntru_mod_avx2(NtruIntPoly *p, uint16_t mod_mask);
 
 void ntru_mod3_avx2(NtruIntPoly *p);
 
+/**
+ * @brief Byte array to polynomial, AVX2 version for q=2048
+ *
+ * Decodes a byte array encoded with ntru_to_arr() into a NtruIntPoly
+ * for q=2048. Requires AVX2 support.
+ *
+ * @param arr a byte array, (N*11+7)/8 bytes long
+ * @param N the number of coefficients
+ * @param p output parameter; a pointer to store the polynomial
+ */
+void ntru_from_arr_avx2_2048(uint8_t *arr, uint16_t N, NtruIntPoly *p);
+
+void ntru_tern_pack_avx2(NtruTernPoly *a, NtruTernPolyPacked *b);
+
+void ntru_tern_packed_to_int_avx2(NtruTernPolyPacked *a, NtruIntPoly *b);
+
+void ntru_decrypt_post_avx2(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights);
+
+void ntru_encrypt_post_avx2(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights);
+
+/**
+ * @brief NTRU Prime multiplication by a small polynomial, AVX2 version
+ *
+ * See ntruprime_mult_small(). Requires AVX2 support.
+ *
+ * @param a a polynomial reduced modulo q
+ * @param b a polynomial with coefficients between 0 and 2
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param modulus q; at most 32768
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntruprime_mult_small_avx2(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t modulus);
+
 #endif   /* NTRU_POLY_AVX2_H */
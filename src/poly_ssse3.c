@@ -4,10 +4,13 @@
 #include "poly.h"   /* for ntru_to_arr_32() */
 #include "poly_ssse3.h"
 #include "types.h"
+#include "profile.h"
 
 #define NTRU_SPARSE_THRESH_SSSE3 14
+#define NTRU_CT_BLOCKS_SSSE3 12   /* accumulators (8 coefficients each) in ntru_mult_tern_sse_ct() */
 
 uint8_t ntru_mult_int_sse(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_INT_SSE);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -64,6 +67,7 @@ uint8_t ntru_mult_int_sse(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16
 
 /* Optimized for small df */
 uint8_t ntru_mult_tern_sse_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_SSE_SPARSE);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -125,6 +129,7 @@ uint8_t ntru_mult_tern_sse_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *
 
 /* Optimized for large df */
 uint8_t ntru_mult_tern_sse_dense(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_SSE_DENSE);
     uint16_t N = a->N;
     if (N != b->N)
         return 0;
@@ -291,6 +296,75 @@ void ntru_to_arr_sse(NtruIntPoly *p, uint16_t q, uint8_t *a) {
         ntru_to_arr_32(p, q, a);
 }
 
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+/*
+ * Adds a*b to the 2N-coefficient accumulator acc without reducing.
+ * a must be zero-padded to a multiple of 8 coefficients.
+ */
+void ntru_acc_tern_sse(int16_t *acc, int16_t *a, uint16_t N, NtruTernPoly *b) {
+    uint16_t i, j;
+    for (i=0; i<b->num_ones; i++) {
+        int16_t *ck = &acc[b->ones[i]];
+        for (j=0; j<N; j+=8) {
+            __m128i c128 = _mm_lddqu_si128((__m128i*)&ck[j]);
+            __m128i a128 = _mm_lddqu_si128((__m128i*)&a[j]);
+            _mm_storeu_si128((__m128i*)&ck[j], _mm_add_epi16(c128, a128));
+        }
+    }
+    for (i=0; i<b->num_neg_ones; i++) {
+        int16_t *ck = &acc[b->neg_ones[i]];
+        for (j=0; j<N; j+=8) {
+            __m128i c128 = _mm_lddqu_si128((__m128i*)&ck[j]);
+            __m128i a128 = _mm_lddqu_si128((__m128i*)&a[j]);
+            _mm_storeu_si128((__m128i*)&ck[j], _mm_sub_epi16(c128, a128));
+        }
+    }
+}
+
+uint8_t ntru_mult_prod_sse(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_PROD_SSE);
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    c->N = N;
+
+    uint16_t i;
+    for (i=N; i<NTRU_INT_POLY_SIZE; i++)
+        a->coeffs[i] = 0;
+    uint16_t N8 = (N+7) / 8 * 8;
+    int16_t acc[2*NTRU_INT_POLY_SIZE];   /* double capacity for intermediate result */
+    int16_t t[NTRU_INT_POLY_SIZE];
+
+    /*
+     * t = a*f1. Coefficients are left unreduced because int16 arithmetic
+     * is exact mod 2^16, and mod_mask+1 divides 2^16.
+     */
+    memset(acc, 0, (N8+N+8) * sizeof acc[0]);
+    ntru_acc_tern_sse(acc, a->coeffs, N, &b->f1);
+    for (i=0; i<N; i+=8) {
+        __m128i lo = _mm_lddqu_si128((__m128i*)&acc[i]);
+        __m128i hi = _mm_lddqu_si128((__m128i*)&acc[N+i]);
+        _mm_storeu_si128((__m128i*)&t[i], _mm_add_epi16(lo, hi));
+    }
+    for (i=N; i<N8; i++)
+        t[i] = 0;
+
+    /* c = t*f2 + a*f3, reduced once at the end */
+    memset(acc, 0, (N8+N+8) * sizeof acc[0]);
+    ntru_acc_tern_sse(acc, t, N, &b->f2);
+    ntru_acc_tern_sse(acc, a->coeffs, N, &b->f3);
+    __m128i mod_mask_128 = _mm_set1_epi16(mod_mask);
+    for (i=0; i<N; i+=8) {
+        __m128i lo = _mm_lddqu_si128((__m128i*)&acc[i]);
+        __m128i hi = _mm_lddqu_si128((__m128i*)&acc[N+i]);
+        __m128i sum = _mm_and_si128(_mm_add_epi16(lo, hi), mod_mask_128);
+        _mm_storeu_si128((__m128i*)&c->coeffs[i], sum);
+    }
+
+    return 1;
+}
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
 void ntru_mod_sse(NtruIntPoly *p, uint16_t mod_mask) {
     uint16_t i;
     __m128i mod_mask_128 = _mm_set1_epi16(mod_mask);
@@ -305,6 +379,44 @@ void ntru_mod_sse(NtruIntPoly *p, uint16_t mod_mask) {
 /* (i%3)+3 for i=0..7 */
 __m128i NTRU_MOD3_LUT = {0x0403050403050403, 0};
 
+/* Reduces the coefficients of a to the range 0..2; requires -3000 <= a < 29768 */
+static inline __m128i ntru_mod3_128(__m128i a) {
+    /* make positive */
+    __m128i _3000 = _mm_set1_epi16(3000);
+    a = _mm_add_epi16(a, _3000);
+
+    /* a = (a>>8) + (a&0xFF);  (sum base 2**8 digits) */
+    __m128i a1 = _mm_srli_epi16(a, 8);
+    __m128i mask = _mm_set1_epi16(0x00FF);
+    __m128i a2 = _mm_and_si128(a, mask);
+    a = _mm_add_epi16(a1, a2);
+
+    /* a = (a>>4) + (a&0xF);  (sum base 2**4 digits; worst case 0x3B) */
+    a1 = _mm_srli_epi16(a, 4);
+    mask = _mm_set1_epi16(0x000F);
+    a2 = _mm_and_si128(a, mask);
+    a = _mm_add_epi16(a1, a2);
+    /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x1B) */
+    a1 = _mm_srli_epi16(a, 2);
+    mask = _mm_set1_epi16(0x0003);
+    a2 = _mm_and_si128(a, mask);
+    a = _mm_add_epi16(a1, a2);
+
+    /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x7) */
+    a1 = _mm_srli_epi16(a, 2);
+    mask = _mm_set1_epi16(0x0003);
+    a2 = _mm_and_si128(a, mask);
+    a = _mm_add_epi16(a1, a2);
+
+    __m128i a_mod3 = _mm_shuffle_epi8(NTRU_MOD3_LUT, a);
+    /* _mm_shuffle_epi8 changed bytes 1, 3, 5, ... to non-zero; change them back to zero */
+    mask = _mm_set1_epi16(0x00FF);
+    a_mod3 = _mm_and_si128(a_mod3, mask);
+    /* subtract 3 so coefficients are in the 0..2 range */
+    __m128i three = _mm_set1_epi16(0x0003);
+    return _mm_sub_epi16(a_mod3, three);
+}
+
 /**
  * SSE version of ntru_mod3.
  * Based on Douglas W Jones' mod3 function at
@@ -314,44 +426,147 @@ void ntru_mod3_sse(NtruIntPoly *p) {
     uint16_t i;
     for (i=0; i<(p->N+7)/8*8; i+=8) {
         __m128i a = _mm_lddqu_si128((__m128i*)&p->coeffs[i]);
+        _mm_storeu_si128((__m128i*)&p->coeffs[i], ntru_mod3_128(a));
+    }
+}
+
+/* Adds up the 16-bit lanes of a */
+static inline uint16_t ntru_hsum_128(__m128i a) {
+    a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+    a = _mm_add_epi16(a, _mm_srli_si128(a, 4));
+    a = _mm_add_epi16(a, _mm_srli_si128(a, 2));
+    return _mm_extract_epi16(a, 0);
+}
 
-        /* make positive */
-        __m128i _3000 = _mm_set1_epi16(3000);
-        a = _mm_add_epi16(a, _3000);
-
-        /* a = (a>>8) + (a&0xFF);  (sum base 2**8 digits) */
-        __m128i a1 = _mm_srli_epi16(a, 8);
-        __m128i mask = _mm_set1_epi16(0x00FF);
-        __m128i a2 = _mm_and_si128(a, mask);
-        a = _mm_add_epi16(a1, a2);
-
-        /* a = (a>>4) + (a&0xF);  (sum base 2**4 digits; worst case 0x3B) */
-        a1 = _mm_srli_epi16(a, 4);
-        mask = _mm_set1_epi16(0x000F);
-        a2 = _mm_and_si128(a, mask);
-        a = _mm_add_epi16(a1, a2);
-        /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x1B) */
-        a1 = _mm_srli_epi16(a, 2);
-        mask = _mm_set1_epi16(0x0003);
-        a2 = _mm_and_si128(a, mask);
-        a = _mm_add_epi16(a1, a2);
-
-        /* a = (a>>2) + (a&0x3);  (sum base 2**2 digits; worst case 0x7) */
-        a1 = _mm_srli_epi16(a, 2);
-        mask = _mm_set1_epi16(0x0003);
-        a2 = _mm_and_si128(a, mask);
-        a = _mm_add_epi16(a1, a2);
-
-        __m128i a_mod3 = _mm_shuffle_epi8(NTRU_MOD3_LUT, a);
-        /* _mm_shuffle_epi8 changed bytes 1, 3, 5, ... to non-zero; change them back to zero */
-        mask = _mm_set1_epi16(0x00FF);
-        a_mod3 = _mm_and_si128(a_mod3, mask);
-        /* subtract 3 so coefficients are in the 0..2 range */
-        __m128i three = _mm_set1_epi16(0x0003);
-        a_mod3 = _mm_sub_epi16(a_mod3, three);
-
-        _mm_storeu_si128((__m128i*)&p->coeffs[i], a_mod3);
+/*
+ * Adds sum_j b_j*a[i-j mod N] to 8*NTRU_CT_BLOCKS_SSSE3 coefficients starting
+ * at i0, keeping the sums in registers. a_pad holds a twice, followed by its
+ * first 8 coefficients, so every load is at a public offset.
+ */
+static inline void ntru_mult_tern_sse_ct_block(int16_t *a_pad, int16_t *b_coeffs, uint16_t N, uint16_t i0, int16_t *c_coeffs) {
+    __m128i acc[NTRU_CT_BLOCKS_SSSE3];
+    uint16_t j, r;
+    for (r=0; r<NTRU_CT_BLOCKS_SSSE3; r++)
+        acc[r] = _mm_setzero_si128();
+    for (j=0; j<N; j++) {
+        /* a*b_j via sign: a, -a, or 0 without a branch or a secret-dependent address */
+        __m128i bj = _mm_set1_epi16(b_coeffs[j]);
+        int16_t *ap = &a_pad[N+i0-j];
+        for (r=0; r<NTRU_CT_BLOCKS_SSSE3; r++) {
+            __m128i a128 = _mm_loadu_si128((__m128i*)&ap[8*r]);
+            acc[r] = _mm_add_epi16(acc[r], _mm_sign_epi16(a128, bj));
+        }
+    }
+    for (r=0; r<NTRU_CT_BLOCKS_SSSE3; r++)
+        _mm_storeu_si128((__m128i*)&c_coeffs[i0+8*r], acc[r]);
+}
+
+/* Same as ntru_mult_tern_sse_ct_block() for 8 coefficients */
+static inline void ntru_mult_tern_sse_ct_one(int16_t *a_pad, int16_t *b_coeffs, uint16_t N, uint16_t i0, int16_t *c_coeffs) {
+    __m128i acc = _mm_setzero_si128();
+    uint16_t j;
+    for (j=0; j<N; j++) {
+        __m128i bj = _mm_set1_epi16(b_coeffs[j]);
+        __m128i a128 = _mm_loadu_si128((__m128i*)&a_pad[N+i0-j]);
+        acc = _mm_add_epi16(acc, _mm_sign_epi16(a128, bj));
+    }
+    _mm_storeu_si128((__m128i*)&c_coeffs[i0], acc);
+}
+
+uint8_t ntru_mult_tern_sse_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask) {
+    NTRU_PROF_KERNEL(NTRU_PROF_MULT_TERN_SSE_CT);
+    uint16_t N = a->N;
+    if (N != b->N)
+        return 0;
+    c->N = N;
+
+    NtruIntPoly b_int;
+    ntru_tern_to_int_ct(b, &b_int);
+
+    uint16_t N8 = (N+7) / 8 * 8;
+    int16_t a_pad[2*NTRU_INT_POLY_SIZE+8];
+    memcpy(a_pad, a->coeffs, N * sizeof a->coeffs[0]);
+    memcpy(a_pad+N, a->coeffs, N * sizeof a->coeffs[0]);
+    memcpy(a_pad+2*N, a->coeffs, 8 * sizeof a->coeffs[0]);
+
+    int16_t c_coeffs[NTRU_INT_POLY_SIZE+8*NTRU_CT_BLOCKS_SSSE3];
+    uint16_t i0;
+    for (i0=0; i0+8*NTRU_CT_BLOCKS_SSSE3<=N8; i0+=8*NTRU_CT_BLOCKS_SSSE3)
+        ntru_mult_tern_sse_ct_block(a_pad, b_int.coeffs, N, i0, c_coeffs);
+    for (; i0<N8; i0+=8)
+        ntru_mult_tern_sse_ct_one(a_pad, b_int.coeffs, N, i0, c_coeffs);
+
+    __m128i mod_mask_128 = _mm_set1_epi16(mod_mask);
+    for (i0=0; i0<N8; i0+=8) {
+        __m128i c128 = _mm_loadu_si128((__m128i*)&c_coeffs[i0]);
+        _mm_storeu_si128((__m128i*)&c->coeffs[i0], _mm_and_si128(c128, mod_mask_128));
     }
+    return 1;
+}
+
+void ntru_decrypt_post_sse(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights) {
+    uint16_t N = d->N;
+    r->N = N;
+    __m128i mod_mask = _mm_set1_epi16(modulus-1);
+    __m128i m2 = _mm_set1_epi16(modulus/2);
+    __m128i q = _mm_set1_epi16(modulus);
+    __m128i one = _mm_set1_epi16(1);
+    __m128i zero = _mm_setzero_si128();
+    __m128i w0 = zero;
+    __m128i w1 = zero;
+
+    uint16_t i;
+    for (i=0; i+8<=N; i+=8) {
+        __m128i d_i = _mm_lddqu_si128((__m128i*)&d->coeffs[i]);
+        __m128i e_i = _mm_lddqu_si128((__m128i*)&e->coeffs[i]);
+
+        /* c = 3*d+e mod q, centered */
+        __m128i c = _mm_add_epi16(_mm_add_epi16(d_i, _mm_slli_epi16(d_i, 1)), e_i);
+        c = _mm_and_si128(c, mod_mask);
+        __m128i gt = _mm_cmpgt_epi16(c, m2);
+        c = _mm_sub_epi16(c, _mm_and_si128(gt, q));
+
+        c = ntru_mod3_128(c);
+        _mm_storeu_si128((__m128i*)&d->coeffs[i], c);
+        __m128i r_i = _mm_and_si128(_mm_sub_epi16(e_i, c), mod_mask);
+        _mm_storeu_si128((__m128i*)&r->coeffs[i], r_i);
+
+        /* count zeros and ones; cmpeq yields -1 for a match */
+        w0 = _mm_sub_epi16(w0, _mm_cmpeq_epi16(c, zero));
+        w1 = _mm_sub_epi16(w1, _mm_cmpeq_epi16(c, one));
+    }
+    weights[0] = ntru_hsum_128(w0);
+    weights[1] = ntru_hsum_128(w1);
+    weights[2] = i - weights[0] - weights[1];
+
+    ntru_decrypt_post_tail(d, e, modulus, r, weights, i);
+}
+
+void ntru_encrypt_post_sse(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights) {
+    uint16_t N = m->N;
+    __m128i one = _mm_set1_epi16(1);
+    __m128i zero = _mm_setzero_si128();
+    __m128i w0 = zero;
+    __m128i w1 = zero;
+
+    uint16_t i;
+    for (i=0; i+8<=N; i+=8) {
+        __m128i m_i = _mm_lddqu_si128((__m128i*)&m->coeffs[i]);
+        __m128i mask_i = _mm_lddqu_si128((__m128i*)&mask->coeffs[i]);
+        __m128i r_i = _mm_lddqu_si128((__m128i*)&r->coeffs[i]);
+
+        __m128i c = ntru_mod3_128(_mm_add_epi16(m_i, mask_i));
+        _mm_storeu_si128((__m128i*)&m->coeffs[i], c);
+        _mm_storeu_si128((__m128i*)&r->coeffs[i], _mm_add_epi16(r_i, c));
+
+        w0 = _mm_sub_epi16(w0, _mm_cmpeq_epi16(c, zero));
+        w1 = _mm_sub_epi16(w1, _mm_cmpeq_epi16(c, one));
+    }
+    weights[0] = ntru_hsum_128(w0);
+    weights[1] = ntru_hsum_128(w1);
+    weights[2] = i - weights[0] - weights[1];
+
+    ntru_encrypt_post_tail(m, mask, r, weights, i);
 }
 
 #endif   /* __SSSE3__ */
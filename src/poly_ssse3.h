@@ -38,6 +38,54 @@ uint8_t ntru_mult_int_sse(NtruIntPoly *a, NtruIntPoly *b, NtruIntPoly *c, uint16
  */
 uint8_t ntru_mult_tern_sse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
 
+/**
+ * @brief General polynomial by sparse ternary polynomial multiplication, SSSE3 version
+ *
+ * Same as ntru_mult_tern_sse() but always uses the algorithm for ternary
+ * polynomials with few nonzero coefficients.
+ * This variant requires SSSE3 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_sse_sparse(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief General polynomial by dense ternary polynomial multiplication, SSSE3 version
+ *
+ * Same as ntru_mult_tern_sse() but always uses the algorithm for ternary
+ * polynomials with many nonzero coefficients.
+ * This variant requires SSSE3 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_sse_dense(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
+/**
+ * @brief General polynomial by ternary polynomial multiplication, constant time, SSSE3 version
+ *
+ * Same result as ntru_mult_tern_ct(). b is expanded to trits with
+ * ntru_tern_to_int_ct(), and c is accumulated in registers as the sum of
+ * b_j times a rotated by j, where the product with b_j is a sign
+ * instruction. Memory access and timing depend only on N and the weight
+ * of b.
+ * Requires SSSE3 support.
+ *
+ * @param a a general polynomial
+ * @param b a ternary polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_tern_sse_ct(NtruIntPoly *a, NtruTernPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+
 void ntru_to_arr_sse(NtruIntPoly *p, uint16_t q, uint8_t *a);
 
 /**
@@ -53,8 +101,30 @@ void ntru_to_arr_sse(NtruIntPoly *p, uint16_t q, uint8_t *a);
  */
 void ntru_to_arr_sse_2048(NtruIntPoly *p, uint8_t *a);
 
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+/**
+ * @brief General polynomial by product-form polynomial multiplication, SSSE3 version
+ *
+ * Computes a*(f1*f2+f3) in two passes: t=a*f1, then t*f2+a*f3 into the
+ * same accumulator. Intermediate results are not reduced, only the final
+ * sum is. The number of coefficients must be the same for both polynomials.
+ * Requires SSSE3 support.
+ *
+ * @param a a general polynomial
+ * @param b a product-form polynomial
+ * @param c output parameter; a pointer to store the new polynomial
+ * @param mod_mask an AND mask to apply; must be a power of two minus one
+ * @return 0 if the number of coefficients differ, 1 otherwise
+ */
+uint8_t ntru_mult_prod_sse(NtruIntPoly *a, NtruProdPoly *b, NtruIntPoly *c, uint16_t mod_mask);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+
 void ntru_mod_sse(NtruIntPoly *p, uint16_t mod_mask);
 
 void ntru_mod3_sse(NtruIntPoly *p);
 
+void ntru_decrypt_post_sse(NtruIntPoly *d, NtruIntPoly *e, uint16_t modulus, NtruIntPoly *r, uint16_t *weights);
+
+void ntru_encrypt_post_sse(NtruIntPoly *m, NtruIntPoly *mask, NtruIntPoly *r, uint16_t *weights);
+
 #endif   /* NTRU_POLY_SSSE3_H */
@@ -0,0 +1,26 @@
+#ifndef NTRU_PROBES_H
+#define NTRU_PROBES_H
+
+/*
+ * USDT probes for tracing with bpftrace, perf, or SystemTap. They are only
+ * compiled in if NTRU_USDT is defined, which requires <sys/sdt.h>. Each probe
+ * is a single nop until a tracer attaches to it. All probes belong to the
+ * "libntru" provider; see tests/test_usdt.sh for the list of names.
+ */
+#ifdef NTRU_USDT
+
+#include <sys/sdt.h>
+
+#define NTRU_PROBE(name) DTRACE_PROBE(libntru, name)
+#define NTRU_PROBE1(name, a) DTRACE_PROBE1(libntru, name, a)
+#define NTRU_PROBE2(name, a, b) DTRACE_PROBE2(libntru, name, a, b)
+
+#else
+
+#define NTRU_PROBE(name) ((void)0)
+#define NTRU_PROBE1(name, a) ((void)0)
+#define NTRU_PROBE2(name, a, b) ((void)0)
+
+#endif   /* NTRU_USDT */
+
+#endif   /* NTRU_PROBES_H */
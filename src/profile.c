@@ -0,0 +1,80 @@
+#include <string.h>
+#include <stdint.h>
+#include "profile.h"
+
+#ifdef NTRU_PROFILE
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined __MACH__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _MSC_VER
+__declspec(thread) NtruProfile ntru_prof;
+#else
+__thread NtruProfile ntru_prof;
+#endif
+
+NtruProfileCallback ntru_prof_callback = NULL;
+void *ntru_prof_callback_arg = NULL;
+
+uint64_t ntru_profile_now_ns() {
+#ifdef WIN32
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(t.QuadPart * (1000000000.0/freq.QuadPart));
+#elif defined __MACH__
+    static mach_timebase_info_data_t tb;
+    if (tb.denom == 0)
+        mach_timebase_info(&tb);
+    return mach_absolute_time() * tb.numer / tb.denom;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+#endif
+}
+
+void ntru_profile_report(uint8_t stage) {
+    if (ntru_prof_callback != NULL)
+        ntru_prof_callback(stage, &ntru_prof, ntru_prof_callback_arg);
+}
+
+uint8_t ntru_profile_enabled() {
+    return 1;
+}
+
+void ntru_profile_snapshot(NtruProfile *prof) {
+    *prof = ntru_prof;
+}
+
+void ntru_profile_reset() {
+    memset(&ntru_prof, 0, sizeof ntru_prof);
+}
+
+void ntru_profile_set_callback(NtruProfileCallback cb, void *arg) {
+    ntru_prof_callback = cb;
+    ntru_prof_callback_arg = arg;
+}
+
+#else
+
+uint8_t ntru_profile_enabled() {
+    return 0;
+}
+
+void ntru_profile_snapshot(NtruProfile *prof) {
+    memset(prof, 0, sizeof *prof);
+}
+
+void ntru_profile_reset() {
+}
+
+void ntru_profile_set_callback(NtruProfileCallback cb, void *arg) {
+}
+
+#endif   /* NTRU_PROFILE */
@@ -0,0 +1,138 @@
+#ifndef NTRU_PROFILE_H
+#define NTRU_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+
+/** multiplication kernels counted in NtruProfile.mult_calls */
+#define NTRU_PROF_MULT_INT_16 0
+#define NTRU_PROF_MULT_INT_64 1
+#define NTRU_PROF_MULT_INT_SSE 2
+#define NTRU_PROF_MULT_INT_AVX2_SCHOOLBOOK 3
+#define NTRU_PROF_MULT_INT_AVX2_TOOM4 4
+#define NTRU_PROF_MULT_TERN_32 5
+#define NTRU_PROF_MULT_TERN_64 6
+#define NTRU_PROF_MULT_TERN_SSE_SPARSE 7
+#define NTRU_PROF_MULT_TERN_SSE_DENSE 8
+#define NTRU_PROF_MULT_TERN_AVX2_SPARSE 9
+#define NTRU_PROF_MULT_TERN_AVX2_DENSE 10
+#define NTRU_PROF_MULT_TERN_CT 11
+#define NTRU_PROF_MULT_PROD_STANDARD 12
+#define NTRU_PROF_MULT_PROD_SSE 13
+#define NTRU_PROF_MULT_PROD_AVX2 14
+#define NTRU_PROF_MULT_PROD_CT 15
+#define NTRU_PROF_MULT_TERN_SSE_CT 16
+#define NTRU_PROF_MULT_TERN_AVX2_CT 17
+#define NTRU_PROF_NUM_KERNELS 18
+
+/**
+ * stages timed in NtruProfile.stage_ns. The first three are whole operations
+ * and include the time spent in the others.
+ */
+#define NTRU_PROF_STAGE_KEYGEN 0
+#define NTRU_PROF_STAGE_ENCRYPT 1
+#define NTRU_PROF_STAGE_DECRYPT 2
+#define NTRU_PROF_STAGE_IGF 3
+#define NTRU_PROF_STAGE_MGF 4
+#define NTRU_PROF_STAGE_MULT 5
+#define NTRU_PROF_NUM_STAGES 6
+
+/**
+ * Counters collected when libntru is built with NTRU_PROFILE defined.
+ * Each thread has its own set of counters.
+ */
+typedef struct NtruProfile {
+    uint64_t hash_blocks_1way;   /* SHA compressions in single-lane hash calls */
+    uint64_t hash_blocks_4way;   /* SHA compressions in 4-lane hash calls, counting each lane */
+    uint64_t hash_blocks_8way;   /* SHA compressions in 8-lane hash calls, counting each lane */
+    uint64_t rng_bytes;          /* bytes drawn via ntru_rand_generate() */
+    uint64_t encrypt_retries;    /* encryptions repeated because of a dm0 violation */
+    uint64_t igf_rejects;        /* IGF outputs discarded because they were out of range */
+    uint64_t igf_duplicates;     /* IGF indices discarded because they were already used */
+    uint64_t mult_calls[NTRU_PROF_NUM_KERNELS];   /* calls to each kernel, see NTRU_PROF_MULT_* */
+    uint64_t stage_ns[NTRU_PROF_NUM_STAGES];      /* nanoseconds per stage, see NTRU_PROF_STAGE_* */
+} NtruProfile;
+
+/**
+ * Called after each key generation, encryption, and decryption
+ * with the stage (NTRU_PROF_STAGE_KEYGEN, _ENCRYPT or _DECRYPT), the counters
+ * of the calling thread, and the arg passed to ntru_profile_set_callback().
+ */
+typedef void (*NtruProfileCallback)(uint8_t stage, const NtruProfile *prof, void *arg);
+
+/**
+ * @brief Profiling support
+ *
+ * @return 1 if libntru was built with NTRU_PROFILE defined, 0 otherwise
+ */
+uint8_t ntru_profile_enabled();
+
+/**
+ * @brief Profile counters
+ *
+ * Copies the counters of the calling thread. All counters are zero if
+ * libntru was built without NTRU_PROFILE.
+ *
+ * @param prof output parameter; the counters
+ */
+void ntru_profile_snapshot(NtruProfile *prof);
+
+/**
+ * @brief Profile counter reset
+ *
+ * Sets the counters of the calling thread to zero.
+ */
+void ntru_profile_reset();
+
+/**
+ * @brief Profile callback
+ *
+ * Sets a function to be called after each key generation, encryption, and
+ * decryption. The callback applies to all threads; it should be set before
+ * other threads use libntru. Has no effect without NTRU_PROFILE.
+ *
+ * @param cb the function to call, or NULL to remove the callback
+ * @param arg passed to cb
+ */
+void ntru_profile_set_callback(NtruProfileCallback cb, void *arg);
+
+#ifdef NTRU_PROFILE
+
+/* used inside libntru to update the counters */
+
+#ifdef _MSC_VER
+extern __declspec(thread) NtruProfile ntru_prof;
+#else
+extern __thread NtruProfile ntru_prof;
+#endif
+
+uint64_t ntru_profile_now_ns();
+
+void ntru_profile_report(uint8_t stage);
+
+#define NTRU_PROF_ADD(field, n) (ntru_prof.field += (n))
+#define NTRU_PROF_INC(field) (ntru_prof.field++)
+#define NTRU_PROF_KERNEL(k) (ntru_prof.mult_calls[k]++)
+#define NTRU_PROF_START(t) uint64_t t = ntru_profile_now_ns()
+#define NTRU_PROF_STOP(stage, t) (ntru_prof.stage_ns[stage] += ntru_profile_now_ns() - (t))
+#define NTRU_PROF_REPORT(stage) ntru_profile_report(stage)
+
+#else
+
+#define NTRU_PROF_ADD(field, n) ((void)0)
+#define NTRU_PROF_INC(field) ((void)0)
+#define NTRU_PROF_KERNEL(k) ((void)0)
+#define NTRU_PROF_START(t)
+#define NTRU_PROF_STOP(stage, t) ((void)0)
+#define NTRU_PROF_REPORT(stage) ((void)0)
+
+#endif   /* NTRU_PROFILE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_PROFILE_H */
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef WIN32
+#include <Winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+#include "pubstore.h"
+#include "ntru.h"
+#include "poly.h"
+#include "encparams.h"
+#include "types.h"
+#include "err.h"
+
+uint8_t ntru_pubstore_init(NtruPubStore *store, const NtruEncParams *params, uint32_t capacity) {
+    store->N = params->N;
+    store->q = params->q;
+    store->key_len = ntru_enc_len_Nq(params->N, params->q);
+    store->num_keys = 0;
+    store->capacity = capacity>0 ? capacity : 1;
+    store->arena = malloc((size_t)store->capacity * store->key_len);
+    return store->arena==NULL ? NTRU_ERR_OUT_OF_MEMORY : NTRU_SUCCESS;
+}
+
+/* Makes room for one more key and returns a pointer to it, or NULL */
+uint8_t *ntru_pubstore_append(NtruPubStore *store, uint32_t *key_id) {
+    if (store->num_keys >= store->capacity) {
+        uint32_t capacity = store->capacity * 2;
+        uint8_t *arena = realloc(store->arena, (size_t)capacity * store->key_len);
+        if (arena == NULL)
+            return NULL;
+        store->arena = arena;
+        store->capacity = capacity;
+    }
+    *key_id = store->num_keys;
+    store->num_keys++;
+    return store->arena + (size_t)*key_id*store->key_len;
+}
+
+void ntru_set_optimized_impl();
+
+uint8_t ntru_pubstore_add(NtruPubStore *store, NtruEncPubKey *pub, uint32_t *key_id) {
+    ntru_set_optimized_impl();
+    if (pub->h.N!=store->N || pub->q!=store->q)
+        return NTRU_ERR_INVALID_KEY;
+    uint8_t *key = ntru_pubstore_append(store, key_id);
+    if (key == NULL)
+        return NTRU_ERR_OUT_OF_MEMORY;
+    ntru_to_arr(&pub->h, pub->q, key);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_pubstore_add_arr(NtruPubStore *store, uint8_t *arr, uint32_t *key_id) {
+    uint16_t N_endian, q_endian;
+    memcpy(&N_endian, arr, sizeof N_endian);
+    memcpy(&q_endian, arr+sizeof N_endian, sizeof q_endian);
+    if (ntohs(N_endian)!=store->N || ntohs(q_endian)!=store->q)
+        return NTRU_ERR_INVALID_KEY;
+    uint8_t *key = ntru_pubstore_append(store, key_id);
+    if (key == NULL)
+        return NTRU_ERR_OUT_OF_MEMORY;
+    memcpy(key, arr+sizeof N_endian+sizeof q_endian, store->key_len);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_pubstore_get(NtruPubStore *store, uint32_t key_id, NtruEncPubKey *pub) {
+    if (key_id >= store->num_keys)
+        return NTRU_ERR_INVALID_KEY;
+    pub->q = store->q;
+    ntru_from_arr(store->arena + (size_t)key_id*store->key_len, store->N, store->q, &pub->h);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_pubstore_encrypt(uint8_t *msg, uint16_t msg_len, NtruPubStore *store, uint32_t key_id, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc) {
+    if (params->N!=store->N || params->q!=store->q)
+        return NTRU_ERR_INVALID_PARAM;
+    NtruEncPubKey pub;
+    uint8_t retcode = ntru_pubstore_get(store, key_id, &pub);
+    if (retcode != NTRU_SUCCESS)
+        return retcode;
+    return ntru_encrypt(msg, msg_len, &pub, params, rand_ctx, enc);
+}
+
+void ntru_pubstore_release(NtruPubStore *store) {
+    free(store->arena);
+    store->arena = NULL;
+    store->num_keys = store->capacity = 0;
+}
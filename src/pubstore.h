@@ -0,0 +1,114 @@
+#ifndef NTRU_PUBSTORE_H
+#define NTRU_PUBSTORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "encparams.h"
+#include "rand.h"
+
+/**
+ * A compact store of NtruEncrypt public keys that all use the same N and q.
+ * Each key is kept in the packed form written by ntru_export_pub(), minus the
+ * N and q header, i.e. log2(q) bits per coefficient. Keys are stored
+ * back to back in one arena and addressed by a key ID.
+ */
+typedef struct NtruPubStore {
+    uint16_t N;
+    uint16_t q;
+    uint16_t key_len;     /* bytes per key in the arena */
+    uint32_t num_keys;
+    uint32_t capacity;    /* number of keys the arena can hold before it is grown */
+    uint8_t *arena;
+} NtruPubStore;
+
+/**
+ * @brief Public key store initialization
+ *
+ * Initializes an empty public key store for a parameter set.
+ *
+ * @param store the store to initialize
+ * @param params the parameter set of the keys that will be stored
+ * @param capacity the initial number of keys to allocate memory for; the store
+ *                 grows as needed
+ * @return NTRU_SUCCESS on success, NTRU_ERR_OUT_OF_MEMORY if the arena could
+ *         not be allocated
+ */
+uint8_t ntru_pubstore_init(NtruPubStore *store, const NtruEncParams *params, uint32_t capacity);
+
+/**
+ * @brief Adds a public key
+ *
+ * Packs a public key and appends it to the store.
+ *
+ * @param store an initialized public key store
+ * @param pub the public key to add
+ * @param key_id output parameter; the ID of the new key
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if N or q don't match
+ *         the store, or NTRU_ERR_OUT_OF_MEMORY
+ */
+uint8_t ntru_pubstore_add(NtruPubStore *store, NtruEncPubKey *pub, uint32_t *key_id);
+
+/**
+ * @brief Adds an exported public key
+ *
+ * Appends a public key in the ntru_export_pub() format to the store without
+ * unpacking it.
+ *
+ * @param store an initialized public key store
+ * @param arr a public key exported with ntru_export_pub()
+ * @param key_id output parameter; the ID of the new key
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if N or q don't match
+ *         the store, or NTRU_ERR_OUT_OF_MEMORY
+ */
+uint8_t ntru_pubstore_add_arr(NtruPubStore *store, uint8_t *arr, uint32_t *key_id);
+
+/**
+ * @brief Retrieves a public key
+ *
+ * Unpacks a public key from the store.
+ *
+ * @param store a public key store
+ * @param key_id the ID of the key
+ * @param pub output parameter; a pointer to store the public key
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_KEY if key_id is out of range
+ */
+uint8_t ntru_pubstore_get(NtruPubStore *store, uint32_t key_id, NtruEncPubKey *pub);
+
+/**
+ * @brief Encryption with a stored public key
+ *
+ * Same as ntru_encrypt() but takes the public key from a store. The key is
+ * unpacked into a temporary NtruEncPubKey on the caller's stack, so multiple
+ * threads can encrypt with the same store concurrently as long as no keys
+ * are being added.
+ *
+ * @param msg The message to encrypt
+ * @param msg_len length of msg. Must not exceed ntru_max_msg_len(params).
+ * @param store a public key store
+ * @param key_id the ID of the key to encrypt with
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param enc output parameter; a pointer to store the encrypted message. Must accommodate
+              ntru_enc_len(params) bytes.
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_pubstore_encrypt(uint8_t *msg, uint16_t msg_len, NtruPubStore *store, uint32_t key_id, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *enc);
+
+/**
+ * @brief Public key store release
+ *
+ * Frees the memory held by a public key store.
+ *
+ * @param store the store to release
+ */
+void ntru_pubstore_release(NtruPubStore *store);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_PUBSTORE_H */
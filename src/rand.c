@@ -2,10 +2,12 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "rand.h"
 #include "err.h"
 #include "encparams.h"
 #include "nist_ctr_drbg.h"
+#include "profile.h"
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -14,6 +16,46 @@
 
 const char NTRU_PERS_STRING[] = "libntru";   /* personalization string for CTR-DRBG */
 
+static pthread_once_t ntru_ctr_once = PTHREAD_ONCE_INIT;
+static int ntru_ctr_err;
+
+static void ntru_ctr_init_tables() {
+    ntru_ctr_err = nist_ctr_initialize();
+}
+
+/**
+ * @brief CTR_DRBG tables
+ *
+ * Computes the global tables of the CTR_DRBG derivation function once per
+ * process. Every CTR_DRBG instance reads them, so they must be set up before
+ * the first instantiation, and must not be rewritten while another thread
+ * may be using them.
+ *
+ * @return 1 for success, 0 for failure
+ */
+static uint8_t ntru_ctr_init() {
+    pthread_once(&ntru_ctr_once, ntru_ctr_init_tables);
+    return ntru_ctr_err == 0;
+}
+
+/* wipes and frees the copy of a deterministic seed, which may be a private key */
+static void ntru_rand_free_seed(NtruRandContext *rand_ctx) {
+    if (rand_ctx->seed == NULL)
+        return;
+    memset(rand_ctx->seed, 0, rand_ctx->seed_len);
+    free(rand_ctx->seed);
+    rand_ctx->seed = NULL;
+}
+
+/* wipes and frees a CTR_DRBG state; nist_ctr_drbg_destroy() only zeroes it if NIST_ZEROIZE is defined */
+static uint8_t ntru_rand_free_drbg(NtruRandContext *rand_ctx) {
+    uint8_t result = nist_ctr_drbg_destroy(rand_ctx->state);
+    memset(rand_ctx->state, 0, sizeof(NIST_CTR_DRBG));
+    free(rand_ctx->state);
+    rand_ctx->state = NULL;
+    return result;
+}
+
 uint8_t ntru_rand_init(NtruRandContext *rand_ctx, struct NtruRandGen *rand_gen) {
     rand_ctx->rand_gen = rand_gen;
     rand_ctx->seed = NULL;
@@ -27,16 +69,19 @@ uint8_t ntru_rand_init_det(NtruRandContext *rand_ctx, struct NtruRandGen *rand_g
     memcpy(rand_ctx->seed, seed, seed_len);
     rand_ctx->seed_len = seed_len;
     rand_ctx->rand_gen = rand_gen;
-    return rand_gen->init(rand_ctx, rand_gen) ? NTRU_SUCCESS : NTRU_ERR_PRNG;
+    if (rand_gen->init(rand_ctx, rand_gen))
+        return NTRU_SUCCESS;
+    ntru_rand_free_seed(rand_ctx);
+    return NTRU_ERR_PRNG;
 }
 
 uint8_t ntru_rand_generate(uint8_t rand_data[], uint16_t len, NtruRandContext *rand_ctx) {
+    NTRU_PROF_ADD(rng_bytes, len);
     return rand_ctx->rand_gen->generate(rand_data, len, rand_ctx) ? NTRU_SUCCESS : NTRU_ERR_PRNG;
 }
 
 uint8_t ntru_rand_release(NtruRandContext *rand_ctx) {
-    if (rand_ctx->seed != NULL)
-        free(rand_ctx->seed);
+    ntru_rand_free_seed(rand_ctx);
     return rand_ctx->rand_gen->release(rand_ctx) ? NTRU_SUCCESS : NTRU_ERR_PRNG;
 }
 
@@ -125,11 +170,17 @@ uint8_t ntru_rand_devrandom_release(NtruRandContext *rand_ctx) {
 #endif /* !WIN32 */
 
 uint8_t ntru_rand_ctr_drbg_init(NtruRandContext *rand_ctx, struct NtruRandGen *rand_gen) {
+    /* the output would depend on whether the default RNG was initialized before */
+    if (!ntru_ctr_init())
+        return 0;
     rand_ctx->state = malloc(sizeof(NIST_CTR_DRBG));
     if (!rand_ctx->state)
         return 0;
     uint16_t pers_string_size = strlen(NTRU_PERS_STRING) * sizeof(NTRU_PERS_STRING[0]);
-    return nist_ctr_drbg_instantiate(rand_ctx->state, rand_ctx->seed, rand_ctx->seed_len, NULL, 0, NTRU_PERS_STRING, pers_string_size) == 0;
+    if (nist_ctr_drbg_instantiate(rand_ctx->state, rand_ctx->seed, rand_ctx->seed_len, NULL, 0, NTRU_PERS_STRING, pers_string_size) == 0)
+        return 1;
+    ntru_rand_free_drbg(rand_ctx);
+    return 0;
 }
 
 uint8_t ntru_rand_ctr_drbg_generate(uint8_t rand_data[], uint16_t len, NtruRandContext *rand_ctx) {
@@ -138,9 +189,7 @@ uint8_t ntru_rand_ctr_drbg_generate(uint8_t rand_data[], uint16_t len, NtruRandC
 }
 
 uint8_t ntru_rand_ctr_drbg_release(NtruRandContext *rand_ctx) {
-    uint8_t result = nist_ctr_drbg_destroy(rand_ctx->state);
-    free(rand_ctx->state);
-    return result;
+    return ntru_rand_free_drbg(rand_ctx);
 }
 
 uint8_t ntru_get_entropy(uint8_t *buffer, uint16_t len) {
@@ -178,7 +227,7 @@ uint8_t ntru_get_entropy(uint8_t *buffer, uint16_t len) {
 
 uint8_t ntru_rand_default_init(NtruRandContext *rand_ctx, struct NtruRandGen *rand_gen) {
     uint8_t result = 1;
-    result &= nist_ctr_initialize() == 0;
+    result &= ntru_ctr_init();
     rand_ctx->state = malloc(sizeof(NIST_CTR_DRBG));
     if (!rand_ctx->state)
         return 0;
@@ -186,6 +235,9 @@ uint8_t ntru_rand_default_init(NtruRandContext *rand_ctx, struct NtruRandGen *ra
     result &= ntru_get_entropy(entropy, 32);
     uint16_t pers_string_size = strlen(NTRU_PERS_STRING) * sizeof(NTRU_PERS_STRING[0]);
     result &= nist_ctr_drbg_instantiate(rand_ctx->state, entropy, 32, NULL, 0, NTRU_PERS_STRING, pers_string_size) == 0;
+    memset(entropy, 0, sizeof entropy);
+    if (!result)
+        ntru_rand_free_drbg(rand_ctx);
     return result;
 }
 
@@ -195,7 +247,5 @@ uint8_t ntru_rand_default_generate(uint8_t rand_data[], uint16_t len, NtruRandCo
 }
 
 uint8_t ntru_rand_default_release(NtruRandContext *rand_ctx) {
-    uint8_t result = nist_ctr_drbg_destroy(rand_ctx->state);
-    free(rand_ctx->state);
-    return result;
+    return ntru_rand_free_drbg(rand_ctx);
 }
@@ -0,0 +1,161 @@
+#include <string.h>
+#include <stdint.h>
+#include "stream.h"
+#include "kem.h"
+#include "ntru.h"
+#include "aes.h"
+#include "hash.h"
+#include "err.h"
+
+/*
+ * Each chunk is split into this many lanes that are hashed in parallel; the
+ * HMAC covers the hash of the lane digests.
+ */
+#define NTRU_STREAM_LANES 8
+#define NTRU_STREAM_LANE_LEN (NTRU_STREAM_CHUNK_LEN/NTRU_STREAM_LANES)
+
+/* length of the HMAC input: chunk number, last-chunk flag, chunk length, lane hash */
+#define NTRU_STREAM_MAC_MSG_LEN (8+1+4+32)
+
+/* labels for deriving the AES and HMAC keys from the KEM secret */
+#define NTRU_STREAM_LABEL_AES 1
+#define NTRU_STREAM_LABEL_MAC 2
+
+/* Derives the AES key and HMAC midstates from a KEM shared secret */
+void ntru_stream_set_keys(NtruStreamCtx *ctx, uint8_t *ss) {
+    uint8_t buf[NTRU_KEM_SECRET_LEN+1];
+    memcpy(buf, ss, NTRU_KEM_SECRET_LEN);
+    uint8_t key[32];
+    buf[NTRU_KEM_SECRET_LEN] = NTRU_STREAM_LABEL_AES;
+    ntru_sha256(buf, sizeof buf, key);
+    ntru_aes256_set_key(&ctx->key, key);
+
+    buf[NTRU_KEM_SECRET_LEN] = NTRU_STREAM_LABEL_MAC;
+    ntru_sha256(buf, sizeof buf, key);
+    uint8_t pad[64];
+    memset(pad, 0, sizeof pad);
+    memcpy(pad, key, sizeof key);
+    uint8_t i;
+    for (i=0; i<sizeof pad; i++)
+        pad[i] ^= 0x36;
+    ntru_sha256_midstate(pad, sizeof pad, &ctx->hmac_inner);
+    for (i=0; i<sizeof pad; i++)
+        pad[i] ^= 0x36 ^ 0x5c;
+    ntru_sha256_midstate(pad, sizeof pad, &ctx->hmac_outer);
+
+    ctx->chunk_idx = 0;
+    ctx->finished = 0;
+    memset(buf, 0, sizeof buf);
+    memset(key, 0, sizeof key);
+    memset(pad, 0, sizeof pad);
+}
+
+/* Computes the tag of an encrypted chunk of len bytes */
+void ntru_stream_tag(NtruStreamCtx *ctx, const uint8_t *enc, uint32_t len, uint8_t last, uint8_t *tag) {
+    uint8_t lane_digests[NTRU_STREAM_LANES][32];
+    uint8_t *in[NTRU_STREAM_LANES];
+    uint8_t *digest[NTRU_STREAM_LANES];
+    uint8_t j;
+    for (j=0; j<NTRU_STREAM_LANES; j++) {
+        in[j] = (uint8_t*)enc + j*NTRU_STREAM_LANE_LEN;
+        digest[j] = lane_digests[j];
+    }
+    if (len == NTRU_STREAM_CHUNK_LEN)
+        ntru_sha256_8way(in, NTRU_STREAM_LANE_LEN, digest);
+    else
+        for (j=0; j<NTRU_STREAM_LANES; j++) {
+            uint32_t start = j * NTRU_STREAM_LANE_LEN;
+            uint32_t lane_len = start>=len ? 0 : len-start<NTRU_STREAM_LANE_LEN ? len-start : NTRU_STREAM_LANE_LEN;
+            ntru_sha256(lane_len>0 ? in[j] : (uint8_t*)enc, lane_len, digest[j]);
+        }
+
+    uint8_t msg[NTRU_STREAM_MAC_MSG_LEN];
+    for (j=0; j<8; j++)
+        msg[j] = ctx->chunk_idx >> (8*j);
+    msg[8] = last;
+    for (j=0; j<4; j++)
+        msg[9+j] = len >> (8*j);
+    ntru_sha256((uint8_t*)lane_digests, sizeof lane_digests, msg+13);
+
+    uint8_t inner[32];
+    ntru_sha256_resume(&ctx->hmac_inner, msg, sizeof msg, inner);
+    ntru_sha256_resume(&ctx->hmac_outer, inner, sizeof inner, tag);
+}
+
+/* Encrypts a chunk of len bytes and appends the tag */
+void ntru_stream_encrypt_chunk(NtruStreamCtx *ctx, const uint8_t *in, uint32_t len, uint8_t last, uint8_t *out) {
+    uint64_t ctr = ctx->chunk_idx * (NTRU_STREAM_CHUNK_LEN/16);
+    ntru_aes256_ctr(&ctx->key, ctr, in, out, len);
+    ntru_stream_tag(ctx, out, len, last, out+len);
+    ctx->chunk_idx++;
+}
+
+/* Verifies the tag of a chunk of len bytes and decrypts it */
+uint8_t ntru_stream_decrypt_chunk(NtruStreamCtx *ctx, const uint8_t *in, uint32_t len, uint8_t last, uint8_t *out) {
+    uint8_t tag[NTRU_STREAM_TAG_LEN];
+    ntru_stream_tag(ctx, in, len, last, tag);
+    uint8_t diff = 0;
+    uint8_t i;
+    for (i=0; i<NTRU_STREAM_TAG_LEN; i++)
+        diff |= tag[i] ^ in[len+i];
+    if (diff)
+        return NTRU_ERR_INVALID_ENCODING;
+
+    uint64_t ctr = ctx->chunk_idx * (NTRU_STREAM_CHUNK_LEN/16);
+    ntru_aes256_ctr(&ctx->key, ctr, in, out, len);
+    ctx->chunk_idx++;
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_stream_encrypt_init(NtruStreamCtx *ctx, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *header) {
+    uint8_t ss[NTRU_KEM_SECRET_LEN];
+    uint8_t retcode = ntru_kem_encaps(pub, params, rand_ctx, header, ss);
+    if (retcode == NTRU_SUCCESS)
+        ntru_stream_set_keys(ctx, ss);
+    memset(ss, 0, sizeof ss);
+    return retcode;
+}
+
+uint8_t ntru_stream_encrypt_update(NtruStreamCtx *ctx, const uint8_t *in, uint8_t *out) {
+    if (ctx->finished)
+        return NTRU_ERR_INVALID_PARAM;
+    ntru_stream_encrypt_chunk(ctx, in, NTRU_STREAM_CHUNK_LEN, 0, out);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_stream_encrypt_final(NtruStreamCtx *ctx, const uint8_t *in, uint32_t len, uint8_t *out) {
+    if (ctx->finished || len>NTRU_STREAM_CHUNK_LEN)
+        return NTRU_ERR_INVALID_PARAM;
+    ntru_stream_encrypt_chunk(ctx, in, len, 1, out);
+    ntru_stream_release(ctx);
+    return NTRU_SUCCESS;
+}
+
+uint8_t ntru_stream_decrypt_init(NtruStreamCtx *ctx, uint8_t *header, NtruEncKeyPair *kp, const NtruEncParams *params) {
+    uint8_t ss[NTRU_KEM_SECRET_LEN];
+    uint8_t retcode = ntru_kem_decaps(header, kp, params, ss);
+    if (retcode == NTRU_SUCCESS)
+        ntru_stream_set_keys(ctx, ss);
+    memset(ss, 0, sizeof ss);
+    return retcode;
+}
+
+uint8_t ntru_stream_decrypt_update(NtruStreamCtx *ctx, const uint8_t *in, uint8_t *out) {
+    if (ctx->finished)
+        return NTRU_ERR_INVALID_PARAM;
+    return ntru_stream_decrypt_chunk(ctx, in, NTRU_STREAM_CHUNK_LEN, 0, out);
+}
+
+uint8_t ntru_stream_decrypt_final(NtruStreamCtx *ctx, const uint8_t *in, uint32_t in_len, uint8_t *out) {
+    if (ctx->finished || in_len<NTRU_STREAM_TAG_LEN || in_len>NTRU_STREAM_CHUNK_LEN+NTRU_STREAM_TAG_LEN)
+        return NTRU_ERR_INVALID_PARAM;
+    uint8_t retcode = ntru_stream_decrypt_chunk(ctx, in, in_len-NTRU_STREAM_TAG_LEN, 1, out);
+    if (retcode == NTRU_SUCCESS)
+        ntru_stream_release(ctx);
+    return retcode;
+}
+
+void ntru_stream_release(NtruStreamCtx *ctx) {
+    memset(ctx, 0, sizeof *ctx);
+    ctx->finished = 1;
+}
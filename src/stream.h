@@ -0,0 +1,145 @@
+#ifndef NTRU_STREAM_H
+#define NTRU_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus*/
+
+#include <stdint.h>
+#include "types.h"
+#include "encparams.h"
+#include "hash.h"
+#include "rand.h"
+#include "aes.h"
+
+/** number of plaintext bytes in each chunk except the last one */
+#define NTRU_STREAM_CHUNK_LEN 65536
+
+/** length of the authentication tag that follows each encrypted chunk */
+#define NTRU_STREAM_TAG_LEN 32
+
+/**
+ * State of a streaming encryption or decryption.
+ *
+ * The stream starts with a header, which is a KEM ciphertext (see kem.h) of
+ * ntru_enc_len(params) bytes. The shared secret yields an AES-256 key and an
+ * HMAC-SHA256 key. Then come encrypted chunks of NTRU_STREAM_CHUNK_LEN bytes.
+ * The last chunk can be shorter and may be empty. Each chunk is encrypted with
+ * AES-256-CTR and followed by a NTRU_STREAM_TAG_LEN-byte tag. The tag covers
+ * the chunk number, whether it is the last chunk, and the encrypted chunk, so
+ * chunks cannot be modified, reordered, or dropped without detection.
+ */
+typedef struct NtruStreamCtx {
+    NtruAes256Key key;
+    NtruHashMidstate hmac_inner;   /* SHA-256 state after absorbing the HMAC key XOR ipad */
+    NtruHashMidstate hmac_outer;   /* SHA-256 state after absorbing the HMAC key XOR opad */
+    uint64_t chunk_idx;
+    uint8_t finished;
+} NtruStreamCtx;
+
+/**
+ * @brief Streaming encryption setup
+ *
+ * Starts a new stream for a public key and writes the stream header.
+ *
+ * @param ctx output parameter; the stream state
+ * @param pub the public key to encrypt for
+ * @param params the NtruEncrypt parameters to use
+ * @param rand_ctx an initialized random number generator. See ntru_rand_init() in rand.h.
+ * @param header output parameter; ntru_enc_len(params) bytes to store the header
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_stream_encrypt_init(NtruStreamCtx *ctx, NtruEncPubKey *pub, const NtruEncParams *params, NtruRandContext *rand_ctx, uint8_t *header);
+
+/**
+ * @brief Streaming encryption of a chunk
+ *
+ * Encrypts NTRU_STREAM_CHUNK_LEN bytes. The result is written directly to
+ * out; in and out may be the same.
+ *
+ * @param ctx the stream state
+ * @param in NTRU_STREAM_CHUNK_LEN bytes of plaintext
+ * @param out output parameter; NTRU_STREAM_CHUNK_LEN+NTRU_STREAM_TAG_LEN bytes
+ *            to store the encrypted chunk and its tag
+ * @return NTRU_SUCCESS on success, or NTRU_ERR_INVALID_PARAM if the stream has
+ *         already been finished
+ */
+uint8_t ntru_stream_encrypt_update(NtruStreamCtx *ctx, const uint8_t *in, uint8_t *out);
+
+/**
+ * @brief Streaming encryption of the last chunk
+ *
+ * Encrypts the last chunk, which can have any length up to
+ * NTRU_STREAM_CHUNK_LEN including zero, and wipes the keys from ctx.
+ *
+ * @param ctx the stream state
+ * @param in len bytes of plaintext
+ * @param len the length of in
+ * @param out output parameter; len+NTRU_STREAM_TAG_LEN bytes to store the
+ *            encrypted chunk and its tag
+ * @return NTRU_SUCCESS on success, or NTRU_ERR_INVALID_PARAM if len is too
+ *         large or the stream has already been finished
+ */
+uint8_t ntru_stream_encrypt_final(NtruStreamCtx *ctx, const uint8_t *in, uint32_t len, uint8_t *out);
+
+/**
+ * @brief Streaming decryption setup
+ *
+ * Reads a stream header and sets up the stream state.
+ *
+ * @param ctx output parameter; the stream state
+ * @param header the ntru_enc_len(params)-byte stream header
+ * @param kp a key pair that contains the public key the stream was encrypted
+             for, and the corresponding private key
+ * @param params the NtruEncrypt parameters the stream was encrypted with
+ * @return NTRU_SUCCESS on success, or one of the NTRU_ERR_ codes on failure
+ */
+uint8_t ntru_stream_decrypt_init(NtruStreamCtx *ctx, uint8_t *header, NtruEncKeyPair *kp, const NtruEncParams *params);
+
+/**
+ * @brief Streaming decryption of a chunk
+ *
+ * Verifies the tag of a full-length chunk, then decrypts it directly to out.
+ * in and out may be the same. Nothing is written to out if the tag is wrong.
+ *
+ * @param ctx the stream state
+ * @param in NTRU_STREAM_CHUNK_LEN+NTRU_STREAM_TAG_LEN bytes: an encrypted chunk
+ *           and its tag
+ * @param out output parameter; NTRU_STREAM_CHUNK_LEN bytes to store the plaintext
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_ENCODING if the tag is wrong,
+ *         or NTRU_ERR_INVALID_PARAM if the stream has already been finished
+ */
+uint8_t ntru_stream_decrypt_update(NtruStreamCtx *ctx, const uint8_t *in, uint8_t *out);
+
+/**
+ * @brief Streaming decryption of the last chunk
+ *
+ * Verifies and decrypts the last chunk and wipes the keys from ctx.
+ *
+ * @param ctx the stream state
+ * @param in an encrypted chunk followed by its tag
+ * @param in_len the length of in, at least NTRU_STREAM_TAG_LEN and at most
+ *               NTRU_STREAM_CHUNK_LEN+NTRU_STREAM_TAG_LEN
+ * @param out output parameter; in_len-NTRU_STREAM_TAG_LEN bytes to store the plaintext
+ * @return NTRU_SUCCESS on success, NTRU_ERR_INVALID_ENCODING if the tag is wrong
+ *         (which includes the case that this is not the last chunk), or
+ *         NTRU_ERR_INVALID_PARAM if in_len is out of range or the stream has
+ *         already been finished
+ */
+uint8_t ntru_stream_decrypt_final(NtruStreamCtx *ctx, const uint8_t *in, uint32_t in_len, uint8_t *out);
+
+/**
+ * @brief Stream state release
+ *
+ * Wipes the keys from a stream state. Only needed if a stream is abandoned
+ * before the final chunk.
+ *
+ * @param ctx the stream state
+ */
+void ntru_stream_release(NtruStreamCtx *ctx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus*/
+
+#endif   /* NTRU_STREAM_H */
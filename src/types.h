@@ -6,6 +6,7 @@
 #define NTRU_MAX_DEGREE (1499+1)   /* max N value for all param sets; +1 for ntru_invert_...() and ntruprime_inv_poly() */
 #define NTRU_INT_POLY_SIZE ((NTRU_MAX_DEGREE+16+7)&0xFFF8)   /* (max #coefficients + 16) rounded to a multiple of 8 */
 #define NTRU_MAX_ONES 499   /* max(df1, df2, df3, dg) */
+#define NTRU_TERN_PACKED_WORDS ((NTRU_INT_POLY_SIZE+63)/64)   /* #uint64_t's per bitmap in NtruTernPolyPacked */
 
 /** A polynomial with 16-bit integer coefficients. */
 typedef struct NtruIntPoly {
@@ -22,6 +23,17 @@ typedef struct NtruTernPoly {
     uint16_t neg_ones[NTRU_MAX_ONES];
 } NtruTernPoly;
 
+/**
+ * A ternary polynomial stored as two bitmaps of N bits each. Bit i of ones
+ * is set iff coefficient i is 1, bit i of neg_ones is set iff it is -1.
+ * Unused bits are zero.
+ */
+typedef struct NtruTernPolyPacked {
+    uint16_t N;
+    uint64_t ones[NTRU_TERN_PACKED_WORDS];
+    uint64_t neg_ones[NTRU_TERN_PACKED_WORDS];
+} NtruTernPolyPacked;
+
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
 /**
  * A product-form polynomial, i.e. a polynomial of the form f1*f2+f3
@@ -58,7 +70,8 @@ typedef struct NtruPrimePubKey {
 typedef struct NtruPrimePrivKey {
     uint16_t p;
     NtruIntPoly f;
-    NtruIntPoly g_inv;
+    NtruIntPoly g_inv;        /* g^(-1) mod q */
+    NtruIntPoly g_inv_mod3;   /* g^(-1) mod 3 */
 } NtruPrimePrivKey;
 
 /**
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+#include <array>
+#include <type_traits>
+#include "ntru.hpp"
+
+static_assert(ntru::ees401ep1.enc_len() == 552);
+static_assert(ntru::ees401ep1.pub_len() == 556);
+static_assert(sizeof(ntru::Ciphertext<ntru::ees1499ep1>) == 2062);
+static_assert(!std::is_copy_constructible_v<ntru::EncKeyPair>);
+static_assert(std::is_nothrow_move_constructible_v<ntru::EncKeyPair>);
+static_assert(!std::is_copy_assignable_v<ntru::PubKey>);
+
+static void print_result(const char *test_name, uint8_t valid) {
+    printf("  %-25s%s\n", test_name, valid?"OK":"FAIL");
+}
+
+/* checks that the compile-time lengths match the ones computed by the C library */
+static uint8_t test_lengths() {
+    uint8_t valid = 1;
+    for (const ntru::EncParams &params : ntru::all_param_sets) {
+        valid &= params.N == params.c->N;
+        valid &= params.db == params.c->db;
+        valid &= params.enc_len() == ntru_enc_len(params.c);
+        valid &= params.pub_len() == ntru_pub_len(params.c);
+        valid &= params.priv_len() == ntru_priv_len(params.c);
+        valid &= params.max_msg_len() == ntru_max_msg_len(params.c);
+    }
+    NtruEncParams all[] = ALL_PARAM_SETS;
+    valid &= sizeof(all)/sizeof(all[0]) == ntru::all_param_sets.size();
+    print_result("test_lengths", valid);
+    return valid;
+}
+
+static uint8_t test_encr_decr() {
+    uint8_t valid = 1;
+    uint8_t seed[] = "seed value for the C++ wrapper";
+    ntru::RandContext rand_ctx(NTRU_RNG_CTR_DRBG, std::span<const uint8_t>(seed, sizeof seed));
+    valid &= rand_ctx.status() == NTRU_SUCCESS;
+
+    const ntru::EncParams &params = ntru::ees401ep1;
+    ntru::EncKeyPair kp;
+    valid &= ntru::gen_key_pair(params, kp, rand_ctx) == NTRU_SUCCESS;
+
+    /* fixed-size buffers */
+    std::array<uint8_t, 19> msg;
+    memcpy(msg.data(), "test message 123456", msg.size());
+    ntru::Ciphertext<ntru::ees401ep1> enc;
+    ntru::Plaintext<ntru::ees401ep1> dec;
+    uint16_t dec_len = 0;
+    ntru::PubKey pub = kp.pub();
+    valid &= ntru::encrypt(msg, pub, params, rand_ctx, enc) == NTRU_SUCCESS;
+    valid &= ntru::decrypt(enc, kp, params, dec, dec_len) == NTRU_SUCCESS;
+    valid &= dec_len==msg.size() && memcmp(dec.data(), msg.data(), msg.size())==0;
+
+    /* short buffers and a long message are rejected */
+    valid &= ntru::encrypt(msg, pub, params, rand_ctx, std::span<uint8_t>(enc).first(100)) == NTRU_ERR_INVALID_PARAM;
+    valid &= ntru::decrypt(std::span<const uint8_t>(enc).first(100), kp, params, dec, dec_len) == NTRU_ERR_INVALID_ENCODING;
+    std::array<uint8_t, 256> long_msg {};
+    valid &= ntru::encrypt(long_msg, pub, params, rand_ctx, enc) == NTRU_ERR_MSG_TOO_LONG;
+
+    /* the moved-from key pair is cleared and the new one still works */
+    ntru::EncKeyPair kp2(std::move(kp));
+    valid &= kp.get()->pub.h.N == 0;
+    valid &= ntru::decrypt(enc, kp2, params, dec, dec_len) == NTRU_SUCCESS;
+
+    /* export and import the public key */
+    std::array<uint8_t, ntru::ees401ep1.pub_len()> pub_arr;
+    ntru::PubKey pub2;
+    valid &= pub.export_to(pub_arr, params);
+    valid &= pub2.import_from(pub_arr, params);
+    valid &= ntru::encrypt(msg, pub2, params, rand_ctx, enc) == NTRU_SUCCESS;
+    valid &= ntru::decrypt(enc, kp2, params, dec, dec_len) == NTRU_SUCCESS;
+
+    print_result("test_encr_decr", valid);
+    return valid;
+}
+
+static uint8_t test_pmr_batch() {
+    uint8_t valid = 1;
+    ntru::RandContext rand_ctx(NTRU_RNG_DEFAULT);
+    valid &= rand_ctx.status() == NTRU_SUCCESS;
+    const ntru::EncParams &params = ntru::ees1087ep2;
+    ntru::EncKeyPair kp;
+    valid &= ntru::gen_key_pair(params, kp, rand_ctx) == NTRU_SUCCESS;
+    ntru::PubKey pub = kp.pub();
+
+    /* all allocations come from a stack buffer */
+    std::array<std::byte, 32768> pool;
+    std::pmr::monotonic_buffer_resource mr(pool.data(), pool.size(), std::pmr::null_memory_resource());
+
+    std::pmr::vector<ntru::Buffer> msgs(&mr);
+    for (uint8_t i=0; i<5; i++)
+        msgs.emplace_back(i+1, (uint8_t)(i+'a'));
+    ntru::Buffer enc(msgs.size()*params.enc_len(), &mr);
+    valid &= ntru::encrypt_batch(msgs, pub, params, rand_ctx, enc) == NTRU_SUCCESS;
+
+    std::pmr::vector<std::span<const uint8_t>> encs(&mr);
+    for (size_t i=0; i<msgs.size(); i++)
+        encs.push_back(std::span<const uint8_t>(enc).subspan(i*params.enc_len(), params.enc_len()));
+    encs[3] = encs[3].first(params.enc_len()-1);   /* fails the precheck */
+    ntru::Buffer dec(msgs.size()*params.max_msg_len(), &mr);
+    std::array<uint16_t, 5> dec_len;
+    std::array<uint8_t, 5> retcodes;
+    valid &= ntru::decrypt_batch(encs, kp, params, dec, dec_len, retcodes, NULL, &mr) == NTRU_ERR_INVALID_ENCODING;
+    for (size_t i=0; i<msgs.size(); i++) {
+        if (i == 3) {
+            valid &= retcodes[i] == NTRU_ERR_INVALID_ENCODING;
+            continue;
+        }
+        valid &= retcodes[i] == NTRU_SUCCESS;
+        valid &= dec_len[i]==msgs[i].size() && memcmp(&dec[i*params.max_msg_len()], msgs[i].data(), dec_len[i])==0;
+    }
+
+    /* output buffers too small for the batch */
+    valid &= ntru::encrypt_batch(msgs, pub, params, rand_ctx, std::span<uint8_t>(enc).first(params.enc_len())) == NTRU_ERR_INVALID_PARAM;
+
+    /* single messages into pmr buffers */
+    ntru::Buffer enc1(&mr);
+    ntru::Buffer dec1(&mr);
+    valid &= ntru::encrypt(msgs[4], pub, params, rand_ctx, enc1) == NTRU_SUCCESS;
+    valid &= enc1.size() == params.enc_len();
+    valid &= ntru::decrypt(enc1, kp, params, dec1) == NTRU_SUCCESS;
+    valid &= dec1 == msgs[4];
+
+    print_result("test_pmr_batch", valid);
+    return valid;
+}
+
+int main(int argc, char** argv) {
+    printf("Running C++ tests...\n");
+    uint8_t pass = test_lengths();
+    pass &= test_encr_decr();
+    pass &= test_pmr_batch();
+    printf("%s\n", pass?"All tests passed":"One or more tests failed");
+    return pass ? 0 : 1;
+}
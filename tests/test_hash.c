@@ -163,7 +163,87 @@ uint8_t test_hash() {
 
     valid256 &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
 
-    uint8_t valid = valid1 && valid256;
+    /* test ntru_sha*_resume*() against hashing prefix||suffix in one go */
+    uint8_t valid_mid = ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    for (i=0; i<200; i++) {
+        uint16_t prefix_len = i;
+        uint16_t suffix_len = i % (NTRU_HASH_MAX_SUFFIX_LEN+1);
+        uint16_t inp_len = prefix_len + suffix_len;
+        uint8_t inp_arr[8][200+NTRU_HASH_MAX_SUFFIX_LEN];   /* at least one byte even if inp_len==0 */
+        uint8_t *suffix[8];
+        uint8_t j;
+        valid_mid &= ntru_rand_generate(inp_arr[0], prefix_len, &rand_ctx) == NTRU_SUCCESS;
+        for (j=0; j<8; j++) {
+            memcpy(inp_arr[j], inp_arr[0], prefix_len);
+            valid_mid &= ntru_rand_generate(inp_arr[j]+prefix_len, suffix_len, &rand_ctx) == NTRU_SUCCESS;
+            suffix[j] = inp_arr[j] + prefix_len;
+        }
+        NtruHashMidstate ms;
+        uint8_t H_arr[8][32];
+        uint8_t *H[8];
+        for (j=0; j<8; j++)
+            H[j] = H_arr[j];
+        uint8_t H1[32];
+
+        ntru_sha1_midstate(inp_arr[0], prefix_len, &ms);
+        ntru_sha1_resume(&ms, suffix[0], suffix_len, H[0]);
+        ntru_sha1(inp_arr[0], inp_len, H1);
+        valid_mid &= memcmp(H[0], H1, 20) == 0;
+        ntru_sha1_resume_4way(&ms, suffix, suffix_len, H);
+        for (j=0; j<4; j++) {
+            ntru_sha1(inp_arr[j], inp_len, H1);
+            valid_mid &= memcmp(H[j], H1, 20) == 0;
+        }
+        ntru_sha1_resume_8way(&ms, suffix, suffix_len, H);
+        for (j=0; j<8; j++) {
+            ntru_sha1(inp_arr[j], inp_len, H1);
+            valid_mid &= memcmp(H[j], H1, 20) == 0;
+        }
+
+        ntru_sha256_midstate(inp_arr[0], prefix_len, &ms);
+        ntru_sha256_resume(&ms, suffix[0], suffix_len, H[0]);
+        ntru_sha256(inp_arr[0], inp_len, H1);
+        valid_mid &= memcmp(H[0], H1, 32) == 0;
+        ntru_sha256_resume_4way(&ms, suffix, suffix_len, H);
+        for (j=0; j<4; j++) {
+            ntru_sha256(inp_arr[j], inp_len, H1);
+            valid_mid &= memcmp(H[j], H1, 32) == 0;
+        }
+        ntru_sha256_resume_8way(&ms, suffix, suffix_len, H);
+        for (j=0; j<8; j++) {
+            ntru_sha256(inp_arr[j], inp_len, H1);
+            valid_mid &= memcmp(H[j], H1, 32) == 0;
+        }
+    }
+    valid_mid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    /* test the hash scheduler with jobs from different prefixes */
+    NtruHashSched sched;
+    ntru_hash_sched_init(&sched, ntru_sha256_jobs);
+    uint8_t prefix_arr[13][100];
+    uint8_t suffix_arr[13][4];
+    NtruHashMidstate ms_arr[13];
+    uint8_t H_sched[13][32];
+    valid_mid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    for (i=0; i<13; i++) {
+        valid_mid &= ntru_rand_generate(prefix_arr[i], sizeof prefix_arr[i], &rand_ctx) == NTRU_SUCCESS;
+        valid_mid &= ntru_rand_generate(suffix_arr[i], sizeof suffix_arr[i], &rand_ctx) == NTRU_SUCCESS;
+        ntru_sha256_midstate(prefix_arr[i], 7*i, &ms_arr[i]);
+        ntru_hash_sched_submit(&sched, &ms_arr[i], suffix_arr[i], sizeof suffix_arr[i], H_sched[i]);
+    }
+    ntru_hash_sched_flush(&sched);
+    for (i=0; i<13; i++) {
+        uint8_t inp[7*i + sizeof suffix_arr[i]];
+        memcpy(inp, prefix_arr[i], 7*i);
+        memcpy(inp+7*i, suffix_arr[i], sizeof suffix_arr[i]);
+        uint8_t H1[32];
+        ntru_sha256(inp, sizeof inp, H1);
+        valid_mid &= memcmp(H_sched[i], H1, 32) == 0;
+    }
+    valid_mid &= sched.num_jobs==13 && sched.num_batches==2 && sched.num_lanes==16;
+    valid_mid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    uint8_t valid = valid1 && valid256 && valid_mid;
     print_result("test_hash", valid);
     return valid;
 }
@@ -4,6 +4,8 @@
 #include <string.h>
 #include "encparams.h"
 #include "idxgen.h"
+#include "poly.h"
+#include "mgf.h"
 #include "test_util.h"
 
 /** number of calls to IGF */
@@ -61,6 +63,25 @@ uint8_t test_idxgen() {
         }
         for (j=0; j<params[i].N; j++)
             valid &= checklist[j];
+
+        /* check ntru_MGF_multi() against ntru_MGF() with more seeds than one 8-way group */
+        uint8_t *seeds[13];
+        NtruIntPoly *polys = malloc(13 * sizeof *polys);
+        NtruIntPoly *poly_ptr[13];
+        valid &= polys != NULL;
+        if (polys != NULL) {
+            for (j=0; j<13; j++) {
+                seeds[j] = seed + j;
+                poly_ptr[j] = &polys[j];
+            }
+            ntru_MGF_multi(seeds, sizeof(seed)-13, &params[i], poly_ptr, 13);
+            for (j=0; j<13; j++) {
+                NtruIntPoly p;
+                ntru_MGF(seeds[j], sizeof(seed)-13, &params[i], &p);
+                valid &= memcmp(p.coeffs, polys[j].coeffs, params[i].N*sizeof p.coeffs[0]) == 0;
+            }
+            free(polys);
+        }
     }
 
     print_result("test_idxgen", valid);
@@ -1,7 +1,12 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "test_key.h"
 #include "test_util.h"
 #include "ntru.h"
 #include "poly.h"
+#include "pubstore.h"
+#include "keyring.h"
 
 uint8_t test_export_import() {
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
@@ -77,9 +82,240 @@ uint8_t test_params_from_key() {
     return valid;
 }
 
+/* tests the NtruPubStore functions */
+uint8_t test_pubstore() {
+    NtruEncParams params = EES1087EP2;
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+
+    /* start with a capacity of 1 so the arena has to grow */
+    NtruPubStore store;
+    valid &= ntru_pubstore_init(&store, &params, 1) == NTRU_SUCCESS;
+    NtruEncKeyPair kp[3];
+    uint32_t key_ids[3];
+    uint8_t i;
+    for (i=0; i<3; i++) {
+        valid &= ntru_gen_key_pair(&params, &kp[i], &rand_ctx) == NTRU_SUCCESS;
+        if (i == 1) {
+            uint8_t pub_arr[ntru_pub_len(&params)];
+            ntru_export_pub(&kp[i].pub, pub_arr);
+            valid &= ntru_pubstore_add_arr(&store, pub_arr, &key_ids[i]) == NTRU_SUCCESS;
+        }
+        else
+            valid &= ntru_pubstore_add(&store, &kp[i].pub, &key_ids[i]) == NTRU_SUCCESS;
+        valid &= key_ids[i] == i;
+    }
+    valid &= store.num_keys == 3;
+
+    for (i=0; i<3; i++) {
+        NtruEncPubKey pub;
+        valid &= ntru_pubstore_get(&store, key_ids[i], &pub) == NTRU_SUCCESS;
+        valid &= ntru_equals_int(&kp[i].pub.h, &pub.h);
+        valid &= pub.q == kp[i].pub.q;
+
+        uint8_t plain[] = "test message";
+        uint8_t encrypted[ntru_enc_len(&params)];
+        valid &= ntru_pubstore_encrypt(plain, sizeof plain, &store, key_ids[i], &params, &rand_ctx, encrypted) == NTRU_SUCCESS;
+        uint8_t decrypted[ntru_max_msg_len(&params)];
+        uint16_t dec_len;
+        valid &= ntru_decrypt(encrypted, &kp[i], &params, decrypted, &dec_len) == NTRU_SUCCESS;
+        valid &= dec_len==sizeof plain && memcmp(plain, decrypted, dec_len)==0;
+    }
+
+    /* invalid key ID and mismatched parameters */
+    NtruEncPubKey pub;
+    valid &= ntru_pubstore_get(&store, 3, &pub) == NTRU_ERR_INVALID_KEY;
+    NtruEncParams params2 = EES401EP1;
+    NtruEncKeyPair kp2;
+    valid &= ntru_gen_key_pair(&params2, &kp2, &rand_ctx) == NTRU_SUCCESS;
+    uint32_t key_id;
+    valid &= ntru_pubstore_add(&store, &kp2.pub, &key_id) == NTRU_ERR_INVALID_KEY;
+
+    ntru_pubstore_release(&store);
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    return valid;
+}
+
+/* Little endian helpers for patching keyring files */
+static uint64_t keyring_get64(uint8_t *p) {
+    uint64_t v = 0;
+    int8_t i;
+    for (i=7; i>=0; i--)
+        v = (v<<8) | p[i];
+    return v;
+}
+
+static void keyring_put64(uint8_t *p, uint64_t v) {
+    uint8_t i;
+    for (i=0; i<8; i++, v>>=8)
+        p[i] = v;
+}
+
+/* Writes buf to a file; returns 1 on success */
+static uint8_t keyring_write_raw(char *filename, uint8_t *buf, long len) {
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL)
+        return 0;
+    uint8_t ok = fwrite(buf, 1, len, f) == (size_t)len;
+    return fclose(f)==0 && ok;
+}
+
+/*
+ * Corrupts the hash index of a valid keyring file in three ways and checks
+ * that ntru_keyring_find() rejects each one without reading out of bounds
+ * or looping.
+ */
+uint8_t test_keyring_corrupt(char *filename, uint64_t key_id) {
+    uint8_t valid = 1;
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *orig = malloc(len);
+    uint8_t *buf = malloc(len);
+    valid &= orig!=NULL && buf!=NULL && fread(orig, 1, len, f)==(size_t)len;
+    fclose(f);
+    if (!valid) {
+        free(orig);
+        free(buf);
+        return 0;
+    }
+
+    uint64_t index_off = keyring_get64(orig+24);
+    uint64_t num_slots = (uint64_t)1 << keyring_get64(orig+32);
+    uint64_t records_off = keyring_get64(orig+40);
+    uint64_t s, slot = num_slots;
+    for (s=0; s<num_slots; s++)
+        if (keyring_get64(orig+index_off+16*s) == key_id)
+            slot = s;
+    valid &= slot < num_slots;
+
+    NtruKeyring kr;
+    NtruKeyView view;
+
+    /* every slot occupied: a lookup miss must terminate */
+    memcpy(buf, orig, len);
+    for (s=0; s<num_slots; s++)
+        if (keyring_get64(buf+index_off+16*s+8) == 0)
+            keyring_put64(buf+index_off+16*s+8, records_off);
+    valid &= keyring_write_raw(filename, buf, len);
+    valid &= ntru_keyring_open(filename, &kr) == NTRU_SUCCESS;
+    if (kr.base != NULL) {
+        valid &= ntru_keyring_find(&kr, 12345, &view) == NTRU_ERR_INVALID_KEY;
+        valid &= ntru_keyring_find(&kr, key_id, &view) == NTRU_SUCCESS;
+        ntru_keyring_close(&kr);
+    }
+
+    /* record offset pointing into the header, and one that wraps when added to */
+    uint64_t bad_offs[] = {NTRU_KEYRING_ALIGN, 0xFFFFFFFFFFFFFFF0ULL};
+    uint8_t i;
+    for (i=0; i<2 && slot<num_slots; i++) {
+        memcpy(buf, orig, len);
+        keyring_put64(buf+index_off+16*slot+8, bad_offs[i]);
+        valid &= keyring_write_raw(filename, buf, len);
+        valid &= ntru_keyring_open(filename, &kr) == NTRU_SUCCESS;
+        if (kr.base != NULL) {
+            valid &= ntru_keyring_find(&kr, key_id, &view) == NTRU_ERR_INVALID_ENCODING;
+            ntru_keyring_close(&kr);
+        }
+    }
+
+    free(orig);
+    free(buf);
+    return valid;
+}
+
+uint8_t test_keyring() {
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    NtruEncParams param_arr[] = {EES439EP1, EES1087EP2, EES401EP1};
+#else
+    NtruEncParams param_arr[] = {EES1087EP2, EES401EP1, EES1087EP2};
+#endif
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+
+    /* the last key is stored without its private key */
+    NtruEncKeyPair kp[3];
+    NtruKeyringEntry entries[3];
+    uint8_t i;
+    for (i=0; i<3; i++) {
+        valid &= ntru_gen_key_pair(&param_arr[i], &kp[i], &rand_ctx) == NTRU_SUCCESS;
+        entries[i].key_id = 0x1234567890ULL * (i+1);
+        entries[i].params = &param_arr[i];
+        entries[i].pub = &kp[i].pub;
+        entries[i].priv = i<2 ? &kp[i].priv : NULL;
+    }
+    char filename[] = "test_keyring.tmp";
+    valid &= ntru_keyring_write(filename, entries, 3) == NTRU_SUCCESS;
+
+    NtruKeyring kr;
+    valid &= ntru_keyring_open(filename, &kr) == NTRU_SUCCESS;
+    valid &= kr.num_keys == 3;
+    for (i=0; i<3; i++) {
+        NtruKeyView view;
+        valid &= ntru_keyring_find(&kr, entries[i].key_id, &view) == NTRU_SUCCESS;
+        valid &= (uintptr_t)(view.h-kr.base) % NTRU_KEYRING_ALIGN == 32;
+        valid &= memcmp(view.params->oid, param_arr[i].oid, sizeof param_arr[i].oid) == 0;
+        NtruEncPubKey pub;
+        ntru_keyring_get_pub(&view, &pub);
+        valid &= ntru_equals_int(&kp[i].pub.h, &pub.h);
+
+        uint8_t plain[] = "test message";
+        uint8_t encrypted[ntru_enc_len(&param_arr[i])];
+        valid &= ntru_keyring_encrypt(plain, sizeof plain, &view, &rand_ctx, encrypted) == NTRU_SUCCESS;
+        uint8_t decrypted[ntru_max_msg_len(&param_arr[i])];
+        uint16_t dec_len;
+        if (i < 2) {
+            NtruEncKeyPair kp2;
+            valid &= ntru_keyring_get_key_pair(&view, &kp2) == NTRU_SUCCESS;
+            valid &= equals_key_pair(&kp[i], &kp2);
+            valid &= ntru_keyring_decrypt(encrypted, &view, decrypted, &dec_len) == NTRU_SUCCESS;
+            valid &= dec_len==sizeof plain && memcmp(plain, decrypted, dec_len)==0;
+        }
+        else
+            valid &= ntru_keyring_decrypt(encrypted, &view, decrypted, &dec_len) == NTRU_ERR_INVALID_KEY;
+    }
+
+    /* nonexistent key ID */
+    NtruKeyView view;
+    valid &= ntru_keyring_find(&kr, 12345, &view) == NTRU_ERR_INVALID_KEY;
+    ntru_keyring_close(&kr);
+
+    /* corrupt index entries */
+    valid &= test_keyring_corrupt(filename, entries[0].key_id);
+
+    /* duplicate key IDs */
+    entries[1].key_id = entries[0].key_id;
+    valid &= ntru_keyring_write(filename, entries, 3) == NTRU_ERR_INVALID_KEY;
+
+    /* not a keyring file */
+    FILE *f = fopen(filename, "wb");
+    valid &= f != NULL;
+    if (f != NULL) {
+        uint8_t garbage[100];
+        memset(garbage, 'x', sizeof garbage);
+        valid &= fwrite(garbage, 1, sizeof garbage, f) == sizeof garbage;
+        fclose(f);
+    }
+    valid &= ntru_keyring_open(filename, &kr) == NTRU_ERR_INVALID_ENCODING;
+    remove(filename);
+    valid &= ntru_keyring_open(filename, &kr) == NTRU_ERR_IO;
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    return valid;
+}
+
 uint8_t test_key() {
     uint8_t valid = test_export_import();
     valid &= test_params_from_key();
+    valid &= test_pubstore();
+    valid &= test_keyring();
     print_result("test_key", valid);
     return valid;
 }
@@ -1,8 +1,19 @@
 #include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
 #include "test_ntru.h"
 #include "test_util.h"
 #include "ntru.h"
 #include "poly.h"
+#include "kem.h"
+#include "stream.h"
+#include "aes.h"
+#include "profile.h"
+#include "async.h"
+#include "key.h"
+#include "hash.h"
 
 void encrypt_poly(NtruIntPoly *m, NtruTernPoly *r, NtruIntPoly *h, NtruIntPoly *e, uint16_t q) {
     ntru_mult_tern(h, r, e, q);
@@ -85,12 +96,87 @@ uint8_t test_ntru_keygen() {
         valid &= ntru_gen_key_pair(&params, &kp2, &rand_ctx2) == NTRU_SUCCESS;
         valid &= ntru_rand_release(&rand_ctx2) == NTRU_SUCCESS;
         valid &= equals_key_pair(&kp, &kp2);
+
+        /* test key generation from a seed */
+        uint8_t priv_seed[NTRU_PRIV_SEED_LEN];
+        NtruRandGen rng_seed = NTRU_RNG_DEFAULT;
+        ntru_rand_init(&rand_ctx, &rng_seed);
+        valid &= ntru_gen_key_pair_seed(&params, &kp, priv_seed, &rand_ctx) == NTRU_SUCCESS;
+        valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+        NtruEncKeyPair kp3;
+        valid &= ntru_priv_from_seed(&params, priv_seed, &kp3.priv, &kp3.pub) == NTRU_SUCCESS;
+        valid &= equals_key_pair(&kp, &kp3);
+        NtruEncPrivKey priv4;
+        valid &= ntru_priv_from_seed(&params, priv_seed, &priv4, NULL) == NTRU_SUCCESS;
+        NtruIntPoly t1, t2;
+        ntru_priv_to_int(&kp.priv.t, &t1, params.q);
+        ntru_priv_to_int(&priv4.t, &t2, params.q);
+        valid &= ntru_equals_int(&t1, &t2);
+        encrypt_poly(&m_int, &r, &kp3.pub.h, &e, params.q);
+        decrypt_poly(&e, &priv4, &c, params.q);
+        valid &= ntru_equals_int(&m_int, &c);
+
+        /* test multithreaded key generation; deterministic for a given number of threads */
+        uint8_t num_threads;
+        for (num_threads=2; num_threads<=NTRU_KEYGEN_MAX_THREADS; num_threads+=2) {
+            NtruEncKeyPair kp5, kp6;
+            ntru_rand_init_det(&rand_ctx2, &rng, seed2, strlen(seed2_char));
+            valid &= ntru_gen_key_pair_par(&params, &kp5, &rand_ctx2, num_threads) == NTRU_SUCCESS;
+            valid &= ntru_rand_release(&rand_ctx2) == NTRU_SUCCESS;
+            ntru_rand_init_det(&rand_ctx2, &rng, seed2, strlen(seed2_char));
+            valid &= ntru_gen_key_pair_par(&params, &kp6, &rand_ctx2, num_threads) == NTRU_SUCCESS;
+            valid &= ntru_rand_release(&rand_ctx2) == NTRU_SUCCESS;
+            valid &= equals_key_pair(&kp5, &kp6);
+            encrypt_poly(&m_int, &r, &kp5.pub.h, &e, params.q);
+            decrypt_poly(&e, &kp5.priv, &c, params.q);
+            valid &= ntru_equals_int(&m_int, &c);
+        }
     }
 
     print_result("test_ntru_keygen", valid);
     return valid;
 }
 
+/* returns the SHA-256 hash of the public key derived from a fixed private key seed */
+uint8_t seed_pub_digest(NtruEncParams *params, uint8_t *digest) {
+    uint8_t seed[NTRU_PRIV_SEED_LEN];
+    uint16_t i;
+    for (i=0; i<NTRU_PRIV_SEED_LEN; i++)
+        seed[i] = i;
+    NtruEncKeyPair kp;
+    if (ntru_priv_from_seed(params, seed, &kp.priv, &kp.pub) != NTRU_SUCCESS)
+        return 0;
+    uint16_t pub_len = ntru_pub_len(params);
+    uint8_t pub_arr[pub_len];
+    ntru_export_pub(&kp.pub, pub_arr);
+    ntru_sha256(pub_arr, pub_len, digest);
+    return 1;
+}
+
+/* tests that seed-derived keys don't depend on which RNGs were initialized before */
+uint8_t test_seed_kat() {
+    /* existing seeds must keep giving the same keys */
+    uint8_t expected[] = {
+        0x43, 0xf3, 0x9f, 0x93, 0xf2, 0x3e, 0xde, 0xa4, 0xb3, 0x58, 0xbc, 0x37, 0x65, 0x14, 0x67, 0x8f,
+        0xc4, 0x13, 0xf8, 0x66, 0x94, 0x86, 0xcc, 0xa5, 0xb7, 0xb8, 0xee, 0x92, 0xde, 0x42, 0x78, 0x62
+    };
+    NtruEncParams params = EES401EP1;
+    uint8_t digest[32];
+    uint8_t valid = seed_pub_digest(&params, digest);
+    valid &= memcmp(digest, expected, sizeof expected) == 0;
+
+    /* initializing the default RNG must not change the tables the CTR_DRBG uses */
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    valid &= seed_pub_digest(&params, digest);
+    valid &= memcmp(digest, expected, sizeof expected) == 0;
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    print_result("test_seed_kat", valid);
+    return valid;
+}
+
 /* tests ntru_encrypt() with a non-deterministic RNG */
 uint8_t test_encr_decr_nondet(NtruEncParams *params) {
     NtruRandGen rng = NTRU_RNG_DEFAULT;
@@ -274,14 +360,516 @@ uint8_t test_encr_decr() {
     for (i=0; i<sizeof(param_arr)/sizeof(param_arr[0]); i++) {
         valid &= test_encr_decr_nondet(&param_arr[i]);
         valid &= test_encr_decr_det(&param_arr[i], digests_expected[i]);
+
+        /* constant-time mode must produce the same ciphertexts */
+        ntru_set_constant_time(1);
+        valid &= test_encr_decr_nondet(&param_arr[i]);
+        valid &= test_encr_decr_det(&param_arr[i], digests_expected[i]);
+        ntru_set_constant_time(0);
     }
 
     print_result("test_encr_decr", valid);
     return valid;
 }
 
+uint8_t test_encrypt_multi() {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+
+    uint8_t i;
+    for (i=0; i<sizeof(param_arr)/sizeof(param_arr[0]); i++) {
+        NtruEncParams *params = &param_arr[i];
+        /* more than one group of lanes, and a partial group */
+        uint8_t num = NTRU_ENCRYPT_MULTI_LANES + 3;
+        NtruEncKeyPair kp[num];
+        NtruEncPubKey pub[num];
+        uint8_t j;
+        for (j=0; j<num; j++) {
+            valid &= ntru_gen_key_pair(params, &kp[j], &rand_ctx) == NTRU_SUCCESS;
+            pub[j] = kp[j].pub;
+        }
+
+        uint16_t max_len = ntru_max_msg_len(params);
+        uint8_t plain[max_len];
+        valid &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(params);
+        uint8_t enc[num*enc_len];
+        valid &= ntru_encrypt_multi(plain, max_len, pub, num, params, &rand_ctx, enc) == NTRU_SUCCESS;
+
+        for (j=0; j<num; j++) {
+            uint8_t dec[max_len];
+            uint16_t dec_len;
+            valid &= ntru_decrypt(enc+j*enc_len, &kp[j], params, dec, &dec_len) == NTRU_SUCCESS;
+            valid &= dec_len==max_len && memcmp(plain, dec, max_len)==0;
+        }
+        /* the same key twice must not give the same ciphertext */
+        pub[1] = pub[0];
+        valid &= ntru_encrypt_multi(plain, 0, pub, 2, params, &rand_ctx, enc) == NTRU_SUCCESS;
+        valid &= memcmp(enc, enc+enc_len, enc_len) != 0;
+        valid &= ntru_encrypt_multi(plain, max_len+1, pub, 2, params, &rand_ctx, enc) == NTRU_ERR_MSG_TOO_LONG;
+    }
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_encrypt_multi", valid);
+    return valid;
+}
+
+uint8_t test_decrypt_any() {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+
+    uint8_t i;
+    for (i=0; i<sizeof(param_arr)/sizeof(param_arr[0]); i++) {
+        NtruEncParams *params = &param_arr[i];
+        uint8_t num = 5;
+        NtruEncKeyPair kp[num+1];   /* the last one is not passed to ntru_decrypt_any() */
+        uint8_t j;
+        for (j=0; j<num+1; j++)
+            valid &= ntru_gen_key_pair(params, &kp[j], &rand_ctx) == NTRU_SUCCESS;
+
+        uint16_t max_len = ntru_max_msg_len(params);
+        uint8_t plain[max_len];
+        valid &= ntru_rand_generate(plain, max_len, &rand_ctx) == NTRU_SUCCESS;
+        uint8_t enc[ntru_enc_len(params)];
+        uint8_t dec[max_len];
+        uint16_t dec_len;
+        uint32_t key_idx;
+        for (j=0; j<num; j++) {
+            valid &= ntru_encrypt(plain, max_len, &kp[j].pub, params, &rand_ctx, enc) == NTRU_SUCCESS;
+            key_idx = num;
+            valid &= ntru_decrypt_any(enc, kp, num, params, dec, &dec_len, &key_idx) == NTRU_SUCCESS;
+            valid &= key_idx == j;
+            valid &= dec_len==max_len && memcmp(plain, dec, max_len)==0;
+        }
+
+        valid &= ntru_encrypt(plain, max_len, &kp[num].pub, params, &rand_ctx, enc) == NTRU_SUCCESS;
+        valid &= ntru_decrypt_any(enc, kp, num, params, dec, &dec_len, &key_idx) != NTRU_SUCCESS;
+        valid &= ntru_decrypt_any(enc, kp, 0, params, dec, &dec_len, &key_idx) != NTRU_SUCCESS;
+    }
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_decrypt_any", valid);
+    return valid;
+}
+
+uint8_t test_decrypt_precheck() {
+    NtruEncParams params = EES401EP1;   /* 5 unused bits in the last byte */
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruEncKeyPair kp;
+    valid &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+
+    /* item 0 is valid, 1 is too short, 2 has a padding bit set, 3 has a modified coefficient */
+    uint16_t enc_len = ntru_enc_len(&params);
+    uint8_t plain[4][10];
+    uint8_t encrypted[4][enc_len];
+    uint8_t *enc[4];
+    uint16_t enc_lens[4];
+    uint8_t i;
+    for (i=0; i<4; i++) {
+        valid &= ntru_rand_generate(plain[i], sizeof plain[i], &rand_ctx) == NTRU_SUCCESS;
+        valid &= ntru_encrypt(plain[i], sizeof plain[i], &kp.pub, &params, &rand_ctx, encrypted[i]) == NTRU_SUCCESS;
+        enc[i] = encrypted[i];
+        enc_lens[i] = enc_len;
+    }
+    enc_lens[1]--;
+    encrypted[2][enc_len-1] |= 0x80;
+    encrypted[3][enc_len/2] ^= 1;
+
+    NtruPrecheckStats stats;
+    memset(&stats, 0, sizeof stats);
+    valid &= ntru_decrypt_precheck(enc[0], enc_lens[0], &kp, &params, &stats) == NTRU_SUCCESS;
+    valid &= ntru_decrypt_precheck(enc[1], enc_lens[1], &kp, &params, &stats) == NTRU_ERR_INVALID_ENCODING;
+    valid &= ntru_decrypt_precheck(enc[2], enc_lens[2], &kp, &params, &stats) == NTRU_ERR_INVALID_ENCODING;
+    valid &= ntru_decrypt_precheck(enc[3], enc_lens[3], &kp, &params, NULL) == NTRU_SUCCESS;
+    NtruEncParams params2 = EES449EP1;
+    valid &= ntru_decrypt_precheck(enc[0], enc_lens[0], &kp, &params2, &stats) == NTRU_ERR_INVALID_PARAM;
+    valid &= stats.num_checked==4 && stats.num_accepted==1;
+    valid &= stats.num_bad_length==1 && stats.num_bad_padding==1 && stats.num_bad_params==1;
+
+    /* ntru_decrypt() ignores the padding bits, so only the precheck rejects item 2 */
+    uint8_t pad_dec[ntru_max_msg_len(&params)];
+    uint16_t pad_dec_len;
+    valid &= ntru_decrypt(enc[2], &kp, &params, pad_dec, &pad_dec_len) == NTRU_SUCCESS;
+    valid &= pad_dec_len==sizeof plain[2] && memcmp(plain[2], pad_dec, pad_dec_len)==0;
+
+    uint8_t decrypted[4][ntru_max_msg_len(&params)];
+    uint8_t *dec[4];
+    for (i=0; i<4; i++)
+        dec[i] = decrypted[i];
+    uint16_t dec_len[4];
+    uint8_t retcodes[4];
+    memset(&stats, 0, sizeof stats);
+    valid &= ntru_decrypt_batch(enc, enc_lens, 4, &kp, &params, dec, dec_len, retcodes, &stats) == NTRU_ERR_INVALID_ENCODING;
+    valid &= retcodes[0] == NTRU_SUCCESS;
+    valid &= dec_len[0]==sizeof plain[0] && memcmp(plain[0], decrypted[0], dec_len[0])==0;
+    valid &= retcodes[1]==NTRU_ERR_INVALID_ENCODING && retcodes[2]==NTRU_ERR_INVALID_ENCODING;
+    valid &= retcodes[3] != NTRU_SUCCESS;
+    valid &= stats.num_checked==4 && stats.num_accepted==2 && stats.num_decrypt_failed==1;
+    valid &= ntru_decrypt_batch(enc, enc_lens, 1, &kp, &params, dec, dec_len, retcodes, NULL) == NTRU_SUCCESS;
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_decrypt_precheck", valid);
+    return valid;
+}
+
+uint8_t test_kem() {
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+
+    uint8_t i;
+    for (i=0; i<sizeof(param_arr)/sizeof(param_arr[0]); i++) {
+        NtruEncParams *params = &param_arr[i];
+        NtruEncKeyPair kp;
+        valid &= ntru_kem_keypair(params, &kp, &rand_ctx) == NTRU_SUCCESS;
+        uint16_t enc_len = ntru_enc_len(params);
+
+        uint8_t ct[enc_len];
+        uint8_t ss[NTRU_KEM_SECRET_LEN];
+        uint8_t ss2[NTRU_KEM_SECRET_LEN];
+        valid &= ntru_kem_encaps(&kp.pub, params, &rand_ctx, ct, ss) == NTRU_SUCCESS;
+        valid &= ntru_kem_decaps(ct, &kp, params, ss2) == NTRU_SUCCESS;
+        valid &= memcmp(ss, ss2, sizeof ss) == 0;
+        ct[enc_len/2] ^= 1;
+        valid &= ntru_kem_decaps(ct, &kp, params, ss2) != NTRU_SUCCESS;
+
+        /* 13 items = 8 + 4 + 1 lanes; item 5 is modified before decapsulation */
+        uint8_t num = 13;
+        uint8_t ct_batch[num*enc_len];
+        uint8_t ss_batch[num*NTRU_KEM_SECRET_LEN];
+        uint8_t ss_batch2[num*NTRU_KEM_SECRET_LEN];
+        uint8_t retcodes[num];
+        valid &= ntru_kem_encaps_batch(&kp.pub, params, &rand_ctx, num, ct_batch, ss_batch) == NTRU_SUCCESS;
+        uint8_t j;
+        for (j=0; j<num; j++) {
+            valid &= ntru_kem_decaps(ct_batch+j*enc_len, &kp, params, ss2) == NTRU_SUCCESS;
+            valid &= memcmp(ss_batch+j*NTRU_KEM_SECRET_LEN, ss2, sizeof ss2) == 0;
+        }
+        ct_batch[5*enc_len+enc_len/2] ^= 1;
+        valid &= ntru_kem_decaps_batch(ct_batch, num, &kp, params, ss_batch2, retcodes) != NTRU_SUCCESS;
+        uint8_t zero[NTRU_KEM_SECRET_LEN];
+        memset(zero, 0, sizeof zero);
+        for (j=0; j<num; j++)
+            if (j == 5)
+                valid &= retcodes[j]!=NTRU_SUCCESS && memcmp(ss_batch2+j*NTRU_KEM_SECRET_LEN, zero, sizeof zero)==0;
+            else
+                valid &= retcodes[j]==NTRU_SUCCESS && memcmp(ss_batch+j*NTRU_KEM_SECRET_LEN, ss_batch2+j*NTRU_KEM_SECRET_LEN, NTRU_KEM_SECRET_LEN)==0;
+    }
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_kem", valid);
+    return valid;
+}
+
+uint8_t test_stream() {
+    uint8_t valid = 1;
+
+    /* AES-256-CTR known answer: key 00..1f, keystream starting at block 5 */
+    uint8_t k[32];
+    uint8_t i;
+    for (i=0; i<sizeof k; i++)
+        k[i] = i;
+    uint8_t stream_exp[] = {
+        0xa9, 0x07, 0x41, 0xe6, 0x79, 0x71, 0x46, 0xa5, 0x50, 0xb6, 0x3f, 0x26, 0x4a, 0x60, 0x4e, 0xe4,
+        0xe9, 0x6f, 0x3e, 0x0a, 0x91, 0xd1, 0x50, 0xe2, 0xd3, 0x89, 0xd3, 0xc7, 0x16, 0x24, 0x48, 0x99,
+        0x5d, 0x15, 0x36, 0x99, 0x20, 0xa8, 0x45, 0x41
+    };
+    NtruAes256Key aes_key;
+    ntru_aes256_set_key(&aes_key, k);
+    uint8_t zero[sizeof stream_exp];
+    uint8_t ks[sizeof stream_exp];
+    memset(zero, 0, sizeof zero);
+    ntru_aes256_ctr(&aes_key, 5, zero, ks, sizeof ks);
+    valid &= memcmp(ks, stream_exp, sizeof ks) == 0;
+    memset(ks, 0, sizeof ks);
+    ntru_aes256_ctr_standard(&aes_key, 5, zero, ks, sizeof ks);
+    valid &= memcmp(ks, stream_exp, sizeof ks) == 0;
+
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruEncParams params = EES401EP1;
+    NtruEncKeyPair kp;
+    valid &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+    uint16_t enc_len = ntru_enc_len(&params);
+    uint8_t header[enc_len];
+
+    /* two full chunks and a 1000-byte last chunk */
+    uint32_t last_len = 1000;
+    uint32_t plain_len = 2*NTRU_STREAM_CHUNK_LEN + last_len;
+    uint32_t enc_chunk_len = NTRU_STREAM_CHUNK_LEN + NTRU_STREAM_TAG_LEN;
+    uint8_t *plain = malloc(plain_len);
+    uint8_t *enc = malloc(3*enc_chunk_len);
+    uint8_t *dec = malloc(plain_len);
+    valid &= ntru_rand_generate(plain, plain_len, &rand_ctx) == NTRU_SUCCESS;
+
+    NtruStreamCtx ctx;
+    valid &= ntru_stream_encrypt_init(&ctx, &kp.pub, &params, &rand_ctx, header) == NTRU_SUCCESS;
+    valid &= ntru_stream_encrypt_update(&ctx, plain, enc) == NTRU_SUCCESS;
+    valid &= ntru_stream_encrypt_update(&ctx, plain+NTRU_STREAM_CHUNK_LEN, enc+enc_chunk_len) == NTRU_SUCCESS;
+    valid &= ntru_stream_encrypt_final(&ctx, plain+2*NTRU_STREAM_CHUNK_LEN, last_len, enc+2*enc_chunk_len) == NTRU_SUCCESS;
+    valid &= ntru_stream_encrypt_update(&ctx, plain, enc) == NTRU_ERR_INVALID_PARAM;
+    valid &= memcmp(plain, enc, NTRU_STREAM_CHUNK_LEN) != 0;
+
+    valid &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc, dec) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc+enc_chunk_len, dec+NTRU_STREAM_CHUNK_LEN) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_final(&ctx, enc+2*enc_chunk_len, last_len+NTRU_STREAM_TAG_LEN, dec+2*NTRU_STREAM_CHUNK_LEN) == NTRU_SUCCESS;
+    valid &= memcmp(plain, dec, plain_len) == 0;
+
+    /* a modified chunk */
+    enc[enc_chunk_len+100] ^= 1;
+    valid &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc, dec) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc+enc_chunk_len, dec+NTRU_STREAM_CHUNK_LEN) == NTRU_ERR_INVALID_ENCODING;
+    ntru_stream_release(&ctx);
+    enc[enc_chunk_len+100] ^= 1;
+
+    /* chunks in the wrong order */
+    valid &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc+enc_chunk_len, dec) == NTRU_ERR_INVALID_ENCODING;
+    ntru_stream_release(&ctx);
+
+    /* a truncated stream: a full chunk passed as the last one */
+    valid &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_update(&ctx, enc, dec) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_final(&ctx, enc+enc_chunk_len, enc_chunk_len, dec) == NTRU_ERR_INVALID_ENCODING;
+    ntru_stream_release(&ctx);
+
+    /* an empty stream */
+    valid &= ntru_stream_encrypt_init(&ctx, &kp.pub, &params, &rand_ctx, header) == NTRU_SUCCESS;
+    valid &= ntru_stream_encrypt_final(&ctx, plain, 0, enc) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_init(&ctx, header, &kp, &params) == NTRU_SUCCESS;
+    valid &= ntru_stream_decrypt_final(&ctx, enc, NTRU_STREAM_TAG_LEN, dec) == NTRU_SUCCESS;
+
+    free(plain);
+    free(enc);
+    free(dec);
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_stream", valid);
+    return valid;
+}
+
+/* records the last stage reported to the profile callback */
+void test_profile_cb(uint8_t stage, const NtruProfile *prof, void *arg) {
+    *(uint8_t*)arg = stage;
+}
+
+uint8_t test_profile() {
+    uint8_t valid = 1;
+    NtruRandContext rand_ctx;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruEncParams params = EES401EP1;
+    NtruEncKeyPair kp;
+    valid &= ntru_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+
+    uint8_t stage = 0xff;
+    ntru_profile_set_callback(test_profile_cb, &stage);
+    ntru_profile_reset();
+    uint8_t plain[19];
+    memset(plain, 1, sizeof plain);
+    uint8_t enc[ntru_enc_len(&params)];
+    valid &= ntru_encrypt(plain, sizeof plain, &kp.pub, &params, &rand_ctx, enc) == NTRU_SUCCESS;
+    NtruProfile prof;
+    ntru_profile_snapshot(&prof);
+
+    if (ntru_profile_enabled()) {
+        valid &= stage == NTRU_PROF_STAGE_ENCRYPT;
+        valid &= prof.rng_bytes >= params.db/8;
+        valid &= prof.hash_blocks_1way+prof.hash_blocks_4way+prof.hash_blocks_8way > 0;
+        uint64_t num_mult = 0;
+        uint8_t i;
+        for (i=0; i<NTRU_PROF_NUM_KERNELS; i++)
+            num_mult += prof.mult_calls[i];
+        valid &= num_mult > 0;
+        valid &= prof.stage_ns[NTRU_PROF_STAGE_ENCRYPT] > 0;
+        valid &= prof.stage_ns[NTRU_PROF_STAGE_ENCRYPT] >= prof.stage_ns[NTRU_PROF_STAGE_MGF];
+        valid &= prof.stage_ns[NTRU_PROF_STAGE_DECRYPT] == 0;
+
+        uint8_t dec[ntru_max_msg_len(&params)];
+        uint16_t dec_len;
+        valid &= ntru_decrypt(enc, &kp, &params, dec, &dec_len) == NTRU_SUCCESS;
+        valid &= stage == NTRU_PROF_STAGE_DECRYPT;
+        ntru_profile_snapshot(&prof);
+        valid &= prof.stage_ns[NTRU_PROF_STAGE_DECRYPT] > 0;
+        ntru_profile_reset();
+        ntru_profile_snapshot(&prof);
+        valid &= prof.rng_bytes==0 && prof.stage_ns[NTRU_PROF_STAGE_ENCRYPT]==0;
+
+        /* a keygen that fails its parameter check still reports the stage */
+        NtruEncParams bad_params = params;
+        bad_params.q = 2047;
+        stage = 0xff;
+        valid &= ntru_gen_key_pair_par(&bad_params, &kp, &rand_ctx, 2) == NTRU_ERR_INVALID_PARAM;
+        valid &= stage == NTRU_PROF_STAGE_KEYGEN;
+        ntru_profile_reset();
+    }
+    else {
+        valid &= stage == 0xff;
+        NtruProfile zero;
+        memset(&zero, 0, sizeof zero);
+        valid &= memcmp(&prof, &zero, sizeof prof) == 0;
+    }
+    ntru_profile_set_callback(NULL, NULL);
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_profile", valid);
+    return valid;
+}
+
+/* Collects num completed jobs from a pool without a callback; returns 0 on timeout */
+uint8_t test_async_wait(NtruAsyncPool *pool, NtruAsyncJob **done, uint32_t num) {
+    uint32_t num_done = 0;
+    uint32_t i;
+    for (i=0; i<10000 && num_done<num; i++) {
+#ifndef _WIN32
+        struct pollfd pfd;
+        pfd.fd = ntru_async_fd(pool);
+        pfd.events = POLLIN;
+        poll(&pfd, 1, 1);
+#endif
+        num_done += ntru_async_poll(pool, done+num_done, num-num_done);
+    }
+    return num_done == num;
+}
+
+void test_async_cb(NtruAsyncJob *job, void *arg) {
+    __atomic_add_fetch((uint32_t*)arg, job->retcode==NTRU_SUCCESS, __ATOMIC_SEQ_CST);
+}
+
+uint8_t test_async() {
+    uint8_t valid = 1;
+    NtruEncParams params = EES401EP1;
+    NtruAsyncPool *pool;
+    valid &= ntru_async_create(4, 64, NTRU_ASYNC_PIN_CPUS, NULL, NULL, &pool) == NTRU_SUCCESS;
+#ifndef _WIN32
+    valid &= ntru_async_fd(pool) >= 0;
+#endif
+
+    NtruEncKeyPair kp;
+    NtruAsyncJob keygen;
+    memset(&keygen, 0, sizeof keygen);
+    keygen.type = NTRU_ASYNC_KEYGEN;
+    keygen.params = &params;
+    keygen.kp = &kp;
+    valid &= ntru_async_submit(pool, &keygen) == NTRU_SUCCESS;
+    NtruAsyncJob *done[32];
+    valid &= test_async_wait(pool, done, 1);
+    valid &= done[0]==&keygen && keygen.retcode==NTRU_SUCCESS;
+
+    /* 20 encryptions; the first 16 have the same message so they can be coalesced */
+    uint16_t enc_len = ntru_enc_len(&params);
+    uint8_t num = 20;
+    uint8_t plain[num][19];
+    uint8_t enc[num][enc_len];
+    uint8_t dec[num][ntru_max_msg_len(&params)];
+    NtruAsyncJob jobs[num];
+    uint8_t i;
+    for (i=0; i<num; i++) {
+        memset(plain[i], i<16 ? 1 : i, sizeof plain[i]);
+        memset(&jobs[i], 0, sizeof jobs[i]);
+        jobs[i].type = NTRU_ASYNC_ENCRYPT;
+        jobs[i].params = &params;
+        jobs[i].pub = &kp.pub;
+        jobs[i].msg = plain[i];
+        jobs[i].msg_len = sizeof plain[i];
+        jobs[i].enc = enc[i];
+        jobs[i].user_data = &dec[i];
+        valid &= ntru_async_submit(pool, &jobs[i]) == NTRU_SUCCESS;
+    }
+    valid &= test_async_wait(pool, done, num);
+    for (i=0; i<num; i++)
+        valid &= jobs[i].retcode == NTRU_SUCCESS;
+
+    for (i=0; i<num; i++) {
+        jobs[i].type = NTRU_ASYNC_DECRYPT;
+        jobs[i].kp = &kp;
+        jobs[i].msg = dec[i];
+        jobs[i].msg_len = 0;
+        valid &= ntru_async_submit(pool, &jobs[i]) == NTRU_SUCCESS;
+    }
+    valid &= test_async_wait(pool, done, num);
+    for (i=0; i<num; i++) {
+        valid &= jobs[i].retcode == NTRU_SUCCESS;
+        valid &= jobs[i].msg_len==sizeof plain[i] && memcmp(dec[i], plain[i], sizeof plain[i])==0;
+    }
+
+    /* encryptions of the same message interleaved with key generation */
+    NtruEncKeyPair kp_mixed[2];
+    NtruAsyncJob keygen_mixed[2];
+    for (i=0; i<2; i++) {
+        memset(&keygen_mixed[i], 0, sizeof keygen_mixed[i]);
+        keygen_mixed[i].type = NTRU_ASYNC_KEYGEN;
+        keygen_mixed[i].params = &params;
+        keygen_mixed[i].kp = &kp_mixed[i];
+    }
+    for (i=0; i<8; i++) {
+        jobs[i].type = NTRU_ASYNC_ENCRYPT;
+        jobs[i].msg = plain[i];
+        jobs[i].msg_len = sizeof plain[i];
+        valid &= ntru_async_submit(pool, &jobs[i]) == NTRU_SUCCESS;
+        if (i==1 || i==4)
+            valid &= ntru_async_submit(pool, &keygen_mixed[i/4]) == NTRU_SUCCESS;
+    }
+    valid &= test_async_wait(pool, done, 10);
+    for (i=0; i<2; i++)
+        valid &= keygen_mixed[i].retcode == NTRU_SUCCESS;
+    for (i=0; i<8; i++) {
+        uint16_t dec_len;
+        valid &= jobs[i].retcode == NTRU_SUCCESS;
+        valid &= ntru_decrypt(enc[i], &kp, &params, dec[i], &dec_len) == NTRU_SUCCESS;
+        valid &= dec_len==sizeof plain[i] && memcmp(dec[i], plain[i], sizeof plain[i])==0;
+        jobs[i].type = NTRU_ASYNC_DECRYPT;
+        jobs[i].msg = dec[i];
+    }
+    valid &= ntru_async_poll(pool, done, 32) == 0;
+    ntru_async_destroy(pool);
+
+    /* completed jobs count towards queue_len until they are polled */
+    valid &= ntru_async_create(1, 2, 0, NULL, NULL, &pool) == NTRU_SUCCESS;
+    jobs[0].type = jobs[1].type = jobs[2].type = NTRU_ASYNC_DECRYPT;
+    valid &= ntru_async_submit(pool, &jobs[0]) == NTRU_SUCCESS;
+    valid &= ntru_async_submit(pool, &jobs[1]) == NTRU_SUCCESS;
+    valid &= ntru_async_submit(pool, &jobs[2]) == NTRU_ERR_QUEUE_FULL;
+    valid &= test_async_wait(pool, done, 2);
+    valid &= ntru_async_submit(pool, &jobs[2]) == NTRU_SUCCESS;
+    ntru_async_destroy(pool);
+
+    /* completion callback; ntru_async_destroy() waits for all jobs */
+    uint32_t num_ok = 0;
+    valid &= ntru_async_create(2, 32, 0, test_async_cb, &num_ok, &pool) == NTRU_SUCCESS;
+    valid &= ntru_async_fd(pool) == -1;
+    for (i=0; i<num; i++)
+        valid &= ntru_async_submit(pool, &jobs[i]) == NTRU_SUCCESS;
+    ntru_async_destroy(pool);
+    valid &= num_ok == num;
+
+    print_result("test_async", valid);
+    return valid;
+}
+
 uint8_t test_ntru() {
-    uint8_t valid = test_ntru_keygen();
+    uint8_t valid = test_seed_kat();
+    valid &= test_ntru_keygen();
     valid &= test_encr_decr();
+    valid &= test_encrypt_multi();
+    valid &= test_decrypt_any();
+    valid &= test_decrypt_precheck();
+    valid &= test_kem();
+    valid &= test_stream();
+    valid &= test_profile();
+    valid &= test_async();
     return valid;
 }
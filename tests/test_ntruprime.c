@@ -1,6 +1,8 @@
 #include <string.h>
 #include "test_ntruprime.h"
 #include "poly.h"
+#include "kem.h"
+#include "hash.h"
 #include "test_util.h"
 
 uint8_t test_ntruprime_keygen() {
@@ -23,7 +25,113 @@ uint8_t test_ntruprime_keygen() {
     return valid;
 }
 
+uint8_t test_ntruprime_rand_tern() {
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    uint8_t valid = ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruPrimeParams params = NTRUPRIME_739;
+    uint16_t i, j;
+    for (i=0; i<10; i++) {
+        NtruIntPoly r;
+        valid &= ntruprime_rand_tern_t(params.p, params.t, &r, &rand_ctx);
+        uint16_t num[3] = {0, 0, 0};
+        for (j=0; j<params.p; j++)
+            if (r.coeffs[j]>=0 && r.coeffs[j]<=2)
+                num[r.coeffs[j]]++;
+        valid &= num[1]+num[2]==params.t && num[0]==params.p-params.t;
+        valid &= num[1]>0 && num[2]>0;
+    }
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    print_result("test_ntruprime_rand_tern", valid);
+    return valid;
+}
+
+uint8_t test_ntruprime_kem() {
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    uint8_t valid = ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruPrimeKeyPair kp;
+    NtruPrimeParams params = NTRUPRIME_739;
+    valid &= ntruprime_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+
+    uint16_t enc_len = ntruprime_enc_len(&params);
+    uint8_t ct[enc_len];
+    uint8_t ss[NTRU_KEM_SECRET_LEN];
+    uint8_t ss2[NTRU_KEM_SECRET_LEN];
+    uint16_t i;
+    for (i=0; i<10; i++) {
+        valid &= ntruprime_kem_encaps(&kp.pub, &params, &rand_ctx, ct, ss) == NTRU_SUCCESS;
+        valid &= ntruprime_kem_decaps(ct, &kp, &params, ss2) == NTRU_SUCCESS;
+        valid &= memcmp(ss, ss2, sizeof ss) == 0;
+    }
+
+    /* modified ciphertexts must be rejected */
+    uint16_t pos[] = {0, NTRUPRIME_CONFIRM_LEN-1, NTRUPRIME_CONFIRM_LEN, enc_len/2, enc_len-2};
+    for (i=0; i<sizeof pos/sizeof pos[0]; i++) {
+        ct[pos[i]] ^= 1;
+        valid &= ntruprime_kem_decaps(ct, &kp, &params, ss2) == NTRU_ERR_INVALID_ENCODING;
+        ct[pos[i]] ^= 1;
+    }
+    valid &= ntruprime_kem_decaps(ct, &kp, &params, ss2) == NTRU_SUCCESS;
+
+    /* a different key pair can't decapsulate */
+    NtruPrimeKeyPair kp2;
+    valid &= ntruprime_gen_key_pair(&params, &kp2, &rand_ctx) == NTRU_SUCCESS;
+    valid &= ntruprime_kem_decaps(ct, &kp2, &params, ss2) == NTRU_ERR_INVALID_ENCODING;
+
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_ntruprime_kem", valid);
+    return valid;
+}
+
+/* known-answer test with a deterministic RNG */
+uint8_t test_ntruprime_kat() {
+    NtruRandGen rng = NTRU_RNG_CTR_DRBG;
+    NtruRandContext rand_ctx;
+    uint8_t seed[] = "seed value for NTRU Prime";
+    uint8_t valid = ntru_rand_init_det(&rand_ctx, &rng, seed, sizeof seed) == NTRU_SUCCESS;
+    NtruPrimeKeyPair kp;
+    NtruPrimeParams params = NTRUPRIME_739;
+    valid &= ntruprime_gen_key_pair(&params, &kp, &rand_ctx) == NTRU_SUCCESS;
+
+    uint16_t enc_len = ntruprime_enc_len(&params);
+    valid &= enc_len == 1141;
+    uint8_t ct[enc_len];
+    uint8_t ss[NTRU_KEM_SECRET_LEN];
+    valid &= ntruprime_kem_encaps(&kp.pub, &params, &rand_ctx, ct, ss) == NTRU_SUCCESS;
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    uint8_t digest[32];
+    ntru_sha256(ct, enc_len, digest);
+    /* SHA-256 of the ciphertext */
+    uint8_t ct_digest_expected[] = {
+        0xb1, 0x6e, 0xf2, 0x1d, 0x64, 0xe0, 0x8b, 0xdc,
+        0xa7, 0x9b, 0x01, 0x24, 0x5c, 0x97, 0xbc, 0xec,
+        0xa8, 0xcf, 0x92, 0xdc, 0x1e, 0xce, 0xa4, 0x25,
+        0x0e, 0xcb, 0xcf, 0x24, 0xac, 0x76, 0x6f, 0x42
+    };
+    valid &= memcmp(digest, ct_digest_expected, sizeof digest) == 0;
+    uint8_t ss_expected[] = {
+        0xb2, 0xd8, 0xdf, 0xfa, 0x99, 0xaa, 0xdf, 0x06,
+        0xbc, 0x3c, 0xe1, 0x9b, 0x3e, 0xe2, 0xc8, 0x80,
+        0x19, 0x45, 0x16, 0xcc, 0x6a, 0x5d, 0x37, 0xf8,
+        0x2c, 0x31, 0x15, 0x36, 0x31, 0x8f, 0x59, 0xe9
+    };
+    valid &= memcmp(ss, ss_expected, sizeof ss) == 0;
+
+    uint8_t ss2[NTRU_KEM_SECRET_LEN];
+    valid &= ntruprime_kem_decaps(ct, &kp, &params, ss2) == NTRU_SUCCESS;
+    valid &= memcmp(ss2, ss_expected, sizeof ss2) == 0;
+
+    print_result("test_ntruprime_kat", valid);
+    return valid;
+}
+
 uint8_t test_ntruprime() {
     uint8_t valid = test_ntruprime_keygen();
+    valid &= test_ntruprime_rand_tern();
+    valid &= test_ntruprime_kem();
+    valid &= test_ntruprime_kat();
     return valid;
 }
@@ -4,6 +4,8 @@
 #include "poly.h"
 #include "ntru.h"
 #include "poly_ssse3.h"
+#include "poly_avx2.h"
+#include "kernels.h"
 #include "test_util.h"
 #include "test_poly.h"
 
@@ -43,6 +45,76 @@ uint8_t test_ntruprime_inv_poly() {
     return valid;
 }
 
+/** tests ntruprime_mult_small() against ntruprime_mult_poly() */
+uint8_t test_ntruprime_mult() {
+    uint16_t moduli[] = {3, NTRUPRIME_739.q};
+    uint8_t valid = 1;
+    uint16_t i, j;
+    for (i=0; i<10; i++)
+        for (j=0; j<sizeof moduli/sizeof moduli[0]; j++) {
+            uint16_t q = moduli[j];
+            NtruIntPoly a, b, c_exp, c;
+            rand_poly(&a, NTRUPRIME_739.p, q);
+            rand_poly(&b, NTRUPRIME_739.p, 3);
+            if (i == 0) {
+                /* largest possible sums */
+                uint16_t k;
+                for (k=0; k<a.N; k++) {
+                    a.coeffs[k] = q - 1;
+                    b.coeffs[k] = 2;
+                }
+            }
+            valid &= ntruprime_mult_poly(&a, &b, &c_exp, q);
+            valid &= ntruprime_mult_small_standard(&a, &b, &c, q);
+            valid &= equals_poly(&c_exp, &c);
+            valid &= ntruprime_mult_small(&a, &b, &c, q);
+            valid &= equals_poly(&c_exp, &c);
+#ifdef __AVX2__
+            valid &= ntruprime_mult_small_avx2(&a, &b, &c, q);
+            valid &= equals_poly(&c_exp, &c);
+#endif
+        }
+    print_result("test_ntruprime_mult", valid);
+    return valid;
+}
+
+/** tests ntruprime_round3_to_arr() and ntruprime_from_arr_round3() */
+uint8_t test_ntruprime_round3() {
+    uint16_t p = NTRUPRIME_739.p;
+    uint16_t q = NTRUPRIME_739.q;
+    uint8_t arr[(12*p+7)/8];
+    uint8_t valid = 1;
+    uint16_t i, j;
+    for (i=0; i<10; i++) {
+        NtruIntPoly a, c;
+        rand_poly(&a, p, q);
+        a.coeffs[0] = 0;
+        a.coeffs[1] = q / 2;       /* largest centered value */
+        a.coeffs[2] = q / 2 + 1;   /* smallest centered value */
+        ntruprime_round3_to_arr(&a, q, arr);
+        valid &= ntruprime_from_arr_round3(arr, p, q, &c);
+        for (j=0; j<p; j++) {
+            int16_t a_j = a.coeffs[j]>q/2 ? a.coeffs[j]-q : a.coeffs[j];
+            int16_t c_j = c.coeffs[j]>q/2 ? c.coeffs[j]-q : c.coeffs[j];
+            valid &= c.coeffs[j]>=0 && c.coeffs[j]<q;
+            valid &= c_j%3==0 && a_j-c_j>=-1 && a_j-c_j<=1;
+        }
+    }
+
+    /* values above (q-1)/3 and nonzero padding bits are invalid */
+    NtruIntPoly c;
+    arr[0] = 0xff;
+    arr[1] |= 0x0f;
+    valid &= !ntruprime_from_arr_round3(arr, p, q, &c);
+    arr[0] = arr[1] = 0;
+    valid &= ntruprime_from_arr_round3(arr, p, q, &c);
+    arr[sizeof arr - 1] |= 0x10;
+    valid &= !ntruprime_from_arr_round3(arr, p, q, &c);
+
+    print_result("test_ntruprime_round3", valid);
+    return valid;
+}
+
 /**
  * @brief Multiplication of two general polynomials
  *
@@ -110,6 +182,12 @@ uint8_t test_mult_int() {
 #ifndef __ARMEL__
         valid &= ntru_mult_int_64(&a3, &b3, &c3, 2048-1);
         valid &= equals_poly_mod(&c3_exp, &c3, 2048);
+#endif
+        valid &= ntru_mult_int(&a3, &b3, &c3, 2048-1);
+        valid &= equals_poly_mod(&c3_exp, &c3, 2048);
+#ifdef __AVX2__
+        valid &= ntru_mult_int_avx2_toom4(&a3, &b3, &c3, 2048-1);
+        valid &= equals_poly_mod(&c3_exp, &c3, 2048);
 #endif
     }
 
@@ -171,6 +249,29 @@ uint8_t test_mult_tern() {
         ntru_mult_tern_sse(&b, &a, &c_tern, 2048-1);
         valid &= equals_poly_mod(&c_tern, &c_int, 2048);
 #endif
+        ntru_mult_tern_ct(&b, &a, &c_tern, 2048-1);
+        valid &= equals_poly_mod(&c_tern, &c_int, 2048);
+        NtruIntPoly a_ct;
+        ntru_tern_to_int_ct(&a, &a_ct);
+        valid &= equals_poly(&a_ct, &a_int);
+
+        /* packed representation */
+        NtruTernPolyPacked a_packed;
+        ntru_tern_pack(&a, &a_packed);
+        NtruTernPoly a_unpacked;
+        ntru_tern_unpack(&a_packed, &a_unpacked);
+        NtruIntPoly a_unpacked_int;
+        ntru_tern_to_int(&a_unpacked, &a_unpacked_int);
+        valid &= equals_poly(&a_unpacked_int, &a_int);
+        valid &= a_unpacked.num_ones==a.num_ones && a_unpacked.num_neg_ones==a.num_neg_ones;
+        ntru_tern_packed_to_int_standard(&a_packed, &a_ct);
+        valid &= equals_poly(&a_ct, &a_int);
+#ifdef __AVX2__
+        ntru_tern_packed_to_int_avx2(&a_packed, &a_ct);
+        valid &= equals_poly(&a_ct, &a_int);
+#endif
+        ntru_mult_tern_packed(&b, &a_packed, &c_tern, 2048-1);
+        valid &= equals_poly_mod(&c_tern, &c_int, 2048);
     }
 
     valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
@@ -201,6 +302,18 @@ uint8_t test_mult_prod() {
         NtruIntPoly c_int;
         ntru_mult_int(&a_int, &b, &c_int, modulus-1);
         valid &= equals_poly_mod(&c_prod, &c_int, log_modulus);
+        ntru_mult_prod_standard(&b, &a, &c_prod, modulus-1);
+        valid &= equals_poly_mod(&c_prod, &c_int, log_modulus);
+#ifdef __SSSE3__
+        ntru_mult_prod_sse(&b, &a, &c_prod, modulus-1);
+        valid &= equals_poly_mod(&c_prod, &c_int, log_modulus);
+#endif
+#ifdef __AVX2__
+        ntru_mult_prod_avx2(&b, &a, &c_prod, modulus-1);
+        valid &= equals_poly_mod(&c_prod, &c_int, log_modulus);
+#endif
+        ntru_mult_prod_ct(&b, &a, &c_prod, modulus-1);
+        valid &= equals_poly_mod(&c_prod, &c_int, log_modulus);
     }
     valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
 
@@ -234,6 +347,10 @@ uint8_t test_inv() {
     invertible &= ntru_invert_64(&a1, 32-1, &b1);
     valid &= invertible;
     valid &= verify_inverse(&a1, &b1, 32);
+    NtruTernPolyPacked a1_packed;
+    ntru_tern_pack(&a1.poly.tern, &a1_packed);
+    valid &= ntru_invert_tern_packed(&a1_packed, 32-1, &b1);
+    valid &= verify_inverse(&a1, &b1, 32);
 
     /* test 3 random polynomials */
     uint16_t num_invertible = 0;
@@ -247,8 +364,13 @@ uint8_t test_inv() {
 
         NtruIntPoly b;
         uint8_t invertible = ntru_invert(&a2, 2048-1, &b);
+        NtruTernPolyPacked a2_packed;
+        ntru_tern_pack(&a2.poly.tern, &a2_packed);
+        NtruIntPoly b_packed;
+        valid &= ntru_invert_tern_packed(&a2_packed, 2048-1, &b_packed) == invertible;
         if (invertible) {
             valid &= verify_inverse(&a2, &b, 2048);
+            valid &= equals_poly(&b, &b_packed);
             num_invertible++;
         }
     }
@@ -274,6 +396,9 @@ uint8_t test_inv() {
     NtruIntPoly b2;
     invertible = ntru_invert(&a2, 32-1, &b2);
     valid &= !invertible;
+    NtruTernPolyPacked a2_packed;
+    ntru_tern_pack(&a2.poly.tern, &a2_packed);
+    valid &= !ntru_invert_tern_packed(&a2_packed, 32-1, &b2);
 
     print_result("test_inv", valid);
     return valid;
@@ -302,14 +427,343 @@ uint8_t test_arr() {
     valid &= memcmp(a, b, sizeof a) == 0;
 #endif
 
+    ntru_from_arr_standard(a, params.N, params.q, &p2);
+    valid &= equals_poly(&p1, &p2);
+#ifdef __AVX2__
+    /* all remainders of N mod 16 */
+    uint16_t N;
+    for (N=params.N-16; N<params.N; N++) {
+        ntru_to_arr_32(&p1, params.q, a);
+        ntru_from_arr_avx2_2048(a, N, &p2);
+        NtruIntPoly p1_trunc = p1;
+        p1_trunc.N = N;
+        valid &= equals_poly(&p1_trunc, &p2);
+    }
+#endif
+
     print_result("test_arr", valid);
     return valid;
 }
 
+/* checks the output of a fused post-processing function against the expected values */
+uint8_t check_post(NtruIntPoly *p, NtruIntPoly *p_exp, NtruIntPoly *r, NtruIntPoly *r_exp, uint16_t *weights, uint16_t *weights_exp) {
+    return equals_poly(p, p_exp) && equals_poly(r, r_exp) &&
+            weights[0]==weights_exp[0] && weights[1]==weights_exp[1] && weights[2]==weights_exp[2];
+}
+
+/* tests ntru_decrypt_post() and ntru_encrypt_post() */
+uint8_t test_post() {
+    uint8_t valid = 1;
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    valid &= ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    uint16_t q = 2048;
+    int i;
+    for (i=0; i<10; i++) {
+        uint16_t N;
+        valid &= rand_ctx.rand_gen->generate((uint8_t*)&N, sizeof N, &rand_ctx);
+        N = 100 + (N%(NTRU_MAX_DEGREE-100));
+        uint16_t j;
+
+        /* decryption: unfused reference */
+        NtruIntPoly d, e, d_exp, r, r_exp;
+        valid &= rand_poly_pow2(N, 11, &d, &rand_ctx);
+        valid &= rand_poly_pow2(N, 11, &e, &rand_ctx);
+        d_exp = d;
+        ntru_mult_fac(&d_exp, 3);
+        ntru_add(&d_exp, &e);
+        ntru_mod_center(&d_exp, q);
+        ntru_mod3(&d_exp);
+        r_exp = e;
+        ntru_sub(&r_exp, &d_exp);
+        ntru_mod_mask(&r_exp, q-1);
+        uint16_t weights[3];
+        uint16_t weights_exp[3] = {0, 0, 0};
+        for (j=0; j<N; j++)
+            weights_exp[d_exp.coeffs[j]]++;
+
+        NtruIntPoly d_fused = d;
+        ntru_decrypt_post(&d_fused, &e, q, &r, weights);
+        valid &= check_post(&d_fused, &d_exp, &r, &r_exp, weights, weights_exp);
+        d_fused = d;
+        ntru_decrypt_post_standard(&d_fused, &e, q, &r, weights);
+        valid &= check_post(&d_fused, &d_exp, &r, &r_exp, weights, weights_exp);
+#ifdef __SSSE3__
+        d_fused = d;
+        ntru_decrypt_post_sse(&d_fused, &e, q, &r, weights);
+        valid &= check_post(&d_fused, &d_exp, &r, &r_exp, weights, weights_exp);
+#endif
+#ifdef __AVX2__
+        d_fused = d;
+        ntru_decrypt_post_avx2(&d_fused, &e, q, &r, weights);
+        valid &= check_post(&d_fused, &d_exp, &r, &r_exp, weights, weights_exp);
+#endif
+
+        /* encryption: unfused reference */
+        NtruIntPoly m, mask, m_exp, R;
+        uint8_t rand_data[2*N];
+        valid &= rand_ctx.rand_gen->generate(rand_data, 2*N, &rand_ctx);
+        m.N = mask.N = N;
+        for (j=0; j<N; j++) {
+            m.coeffs[j] = rand_data[j] % 3;
+            mask.coeffs[j] = rand_data[N+j]%3 - 1;
+        }
+        valid &= rand_poly_pow2(N, 11, &R, &rand_ctx);
+        m_exp = m;
+        ntru_add(&m_exp, &mask);
+        ntru_mod3(&m_exp);
+        r_exp = R;
+        ntru_add(&r_exp, &m_exp);
+        weights_exp[0] = weights_exp[1] = weights_exp[2] = 0;
+        for (j=0; j<N; j++)
+            weights_exp[m_exp.coeffs[j]]++;
+
+        NtruIntPoly m_fused = m;
+        r = R;
+        ntru_encrypt_post(&m_fused, &mask, &r, weights);
+        valid &= check_post(&m_fused, &m_exp, &r, &r_exp, weights, weights_exp);
+        m_fused = m;
+        r = R;
+        ntru_encrypt_post_standard(&m_fused, &mask, &r, weights);
+        valid &= check_post(&m_fused, &m_exp, &r, &r_exp, weights, weights_exp);
+#ifdef __SSSE3__
+        m_fused = m;
+        r = R;
+        ntru_encrypt_post_sse(&m_fused, &mask, &r, weights);
+        valid &= check_post(&m_fused, &m_exp, &r, &r_exp, weights, weights_exp);
+#endif
+#ifdef __AVX2__
+        m_fused = m;
+        r = R;
+        ntru_encrypt_post_avx2(&m_fused, &mask, &r, weights);
+        valid &= check_post(&m_fused, &m_exp, &r, &r_exp, weights, weights_exp);
+#endif
+    }
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+
+    print_result("test_post", valid);
+    return valid;
+}
+
+/* Fills args with random operands for a parameter set; weight is the number of ones and of negative ones in tern */
+uint8_t kernel_args_rand(NtruEncParams *params, uint16_t weight, NtruKernelArgs *args, NtruRandContext *rand_ctx) {
+    uint16_t N = params->N;
+    memset(args, 0, sizeof *args);
+    args->q = params->q;
+    uint8_t valid = rand_poly_pow2(N, 11, &args->a, rand_ctx);
+    valid &= rand_poly_pow2(N, 11, &args->b, rand_ctx);
+    valid &= ntru_rand_tern(N, weight, weight, &args->tern, rand_ctx);
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    if (params->prod_flag)
+        valid &= ntru_rand_prod(N, params->df1, params->df2, params->df3, params->df3, &args->prod, rand_ctx);
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    return valid;
+}
+
+/* Runs a kernel on a copy of args and stores the result in out */
+uint8_t kernel_args_run(const NtruKernel *k, NtruKernelArgs *args, NtruKernelArgs *out) {
+    memcpy(out, args, sizeof *out);
+    ntru_kernel_prepare(k, out);
+    return ntru_kernel_run(k, out);
+}
+
+/* checks that the outputs of two kernels for the same primitive are identical */
+uint8_t kernel_outputs_equal(const NtruKernel *k, NtruKernelArgs *out1, NtruKernelArgs *out2, NtruEncParams *params) {
+    if (k->primitive == NTRU_KERNEL_TO_ARR) {
+        uint16_t len = ntru_enc_len(params);
+        return memcmp(out1->arr, out2->arr, len) == 0;
+    }
+    if (k->primitive == NTRU_KERNEL_TERN_PACK)
+        return out1->packed.N==out2->packed.N &&
+                memcmp(out1->packed.ones, out2->packed.ones, sizeof out1->packed.ones)==0 &&
+                memcmp(out1->packed.neg_ones, out2->packed.neg_ones, sizeof out1->packed.neg_ones)==0;
+    uint8_t equal = out1->c.N==out2->c.N && memcmp(out1->c.coeffs, out2->c.coeffs, out1->c.N*sizeof out1->c.coeffs[0])==0;
+    if (k->primitive==NTRU_KERNEL_ENCRYPT_POST || k->primitive==NTRU_KERNEL_DECRYPT_POST) {
+        equal &= memcmp(out1->r.coeffs, out2->r.coeffs, out1->c.N*sizeof out1->r.coeffs[0]) == 0;
+        equal &= memcmp(out1->weights, out2->weights, sizeof out1->weights) == 0;
+    }
+    return equal;
+}
+
+/*
+ * Runs every kernel the CPU supports on random operands for each parameter
+ * set and checks that all kernels of a primitive produce the same output as
+ * the generic one, bit for bit.
+ */
+uint8_t test_kernel_matrix() {
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    uint8_t valid = ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruKernelArgs *args = malloc(sizeof *args);
+    NtruKernelArgs *ref = malloc(sizeof *ref);
+    NtruKernelArgs *out = malloc(sizeof *out);
+    valid &= args!=NULL && ref!=NULL && out!=NULL;
+
+    NtruEncParams param_arr[] = ALL_PARAM_SETS;
+    uint8_t i;
+    for (i=0; valid && i<sizeof(param_arr)/sizeof(param_arr[0]); i++) {
+        NtruEncParams params = param_arr[i];
+        /* a sparse and a dense ternary operand */
+        uint16_t weights[] = {params.df1<8 ? params.df1 : 8, params.N/3<NTRU_MAX_ONES ? params.N/3 : NTRU_MAX_ONES};
+        uint8_t w;
+        for (w=0; w<sizeof(weights)/sizeof(weights[0]); w++) {
+            valid &= kernel_args_rand(&params, weights[w], args, &rand_ctx);
+            const NtruKernel *ref_kernel = NULL;
+            uint16_t j;
+            for (j=0; j<ntru_kernel_count(); j++) {
+                const NtruKernel *k = ntru_kernel_get(j);
+                if (!ntru_kernel_applies(k, params.N, params.q))
+                    continue;
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+                if (k->primitive==NTRU_KERNEL_MULT_PROD && !params.prod_flag)
+                    continue;
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+                if (ref_kernel==NULL || ref_kernel->primitive!=k->primitive) {
+                    ref_kernel = k;
+                    valid &= kernel_args_run(k, args, ref);
+                    continue;
+                }
+                valid &= kernel_args_run(k, args, out);
+                uint8_t same = kernel_outputs_equal(k, ref, out, &params);
+                if (!same)
+                    printf("%s differs from %s for N=%d\n", k->name, ref_kernel->name, params.N);
+                valid &= same;
+            }
+        }
+    }
+
+    /* Toom-4 is only exact for q<=2^13 and from_arr_avx2_2048 only for q=2048 */
+    uint16_t j;
+    for (j=0; j<ntru_kernel_count(); j++) {
+        const NtruKernel *k = ntru_kernel_get(j);
+        if (strcmp(k->name, "mult_int_avx2_toom4") == 0) {
+            valid &= !ntru_kernel_applies(k, 1087, 16384);
+            valid &= !ntru_kernel_applies(k, 11, 2048);
+            valid &= ntru_kernel_applies(k, 1087, 2048) == ntru_kernel_supported(k);
+        }
+        if (strcmp(k->name, "from_arr_avx2_2048") == 0)
+            valid &= !ntru_kernel_applies(k, 439, 4096);
+    }
+
+    free(args);
+    free(ref);
+    free(out);
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    print_result("test_kernel_matrix", valid);
+    return valid;
+}
+
+/* Encrypts and decrypts a random message with a new key pair */
+uint8_t kernel_encr_decr(NtruEncParams *params) {
+    NtruRandGen rng = NTRU_RNG_DEFAULT;
+    NtruRandContext rand_ctx;
+    uint8_t valid = ntru_rand_init(&rand_ctx, &rng) == NTRU_SUCCESS;
+    NtruEncKeyPair kp;
+    valid &= ntru_gen_key_pair(params, &kp, &rand_ctx) == NTRU_SUCCESS;
+    uint8_t plain[params->N];
+    uint8_t plain_len = ntru_max_msg_len(params);
+    valid &= ntru_rand_generate(plain, plain_len, &rand_ctx) == NTRU_SUCCESS;
+    uint8_t encrypted[ntru_enc_len(params)];
+    valid &= ntru_encrypt(plain, plain_len, &kp.pub, params, &rand_ctx, encrypted) == NTRU_SUCCESS;
+    uint8_t decrypted[params->N];
+    uint16_t dec_len;
+    valid &= ntru_decrypt(encrypted, &kp, params, decrypted, &dec_len) == NTRU_SUCCESS;
+    valid &= dec_len==plain_len && equals_arr(plain, decrypted, plain_len);
+    valid &= ntru_rand_release(&rand_ctx) == NTRU_SUCCESS;
+    return valid;
+}
+
+/*
+ * Autotunes the multiplication kernels, checks that encryption still works
+ * with the tuned dispatch table, and round-trips the table through a file.
+ */
+uint8_t test_kernel_autotune() {
+#ifndef NTRU_AVOID_HAMMING_WT_PATENT
+    NtruEncParams param_arr[] = {EES401EP1, EES401EP2};
+#else
+    NtruEncParams param_arr[] = {EES401EP1};
+#endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
+    uint8_t num_params = sizeof(param_arr) / sizeof(param_arr[0]);
+    uint8_t valid = ntru_kernel_autotune(param_arr, num_params) == NTRU_SUCCESS;
+    uint16_t num_tuned = ntru_kernel_tuned_count();
+    valid &= num_tuned > 0;
+    uint8_t i;
+    for (i=0; i<num_params; i++) {
+        NtruEncParams *params = &param_arr[i];
+        const NtruKernel *k = ntru_kernel_tuned_lookup(NTRU_KERNEL_MULT_TERN, params->N, params->df1, params->q);
+        valid &= k!=NULL && k->primitive==NTRU_KERNEL_MULT_TERN;
+        valid &= ntru_kernel_tuned_lookup(NTRU_KERNEL_MULT_INT, params->N, 0, params->q) != NULL;
+        valid &= kernel_encr_decr(params);
+    }
+    valid &= ntru_kernel_tuned_lookup(NTRU_KERNEL_MULT_TERN, 1, 1, 2048) == NULL;
+    valid &= ntru_kernel_tuned_get(num_tuned) == NULL;
+
+    /* save, reset, and load */
+    char filename[] = "test_kernels.tmp";
+    valid &= ntru_kernel_tuned_save(filename) == NTRU_SUCCESS;
+    const NtruKernelChoice *c = ntru_kernel_tuned_get(0);
+    const NtruKernel *k = c==NULL ? NULL : c->kernel;
+    uint16_t N = c==NULL ? 0 : c->N;
+    ntru_kernel_tuned_reset();
+    valid &= ntru_kernel_tuned_count() == 0;
+    valid &= ntru_kernel_tuned_load(filename) == NTRU_SUCCESS;
+    valid &= ntru_kernel_tuned_count() == num_tuned;
+    c = ntru_kernel_tuned_get(0);
+    valid &= c!=NULL && c->kernel==k && c->N==N;
+    valid &= kernel_encr_decr(&param_arr[0]);
+
+    /* a malformed file is rejected */
+    FILE *f = fopen(filename, "w");
+    valid &= f != NULL;
+    if (f != NULL) {
+        fprintf(f, "libntru-kernels 1\n1 401 garbage\n");
+        fclose(f);
+    }
+    valid &= ntru_kernel_tuned_load(filename) == NTRU_ERR_INVALID_ENCODING;
+    valid &= ntru_kernel_tuned_count() == num_tuned;
+
+    /* a file with an invalid decision is rejected as a whole */
+    ntru_kernel_tuned_reset();
+    f = fopen(filename, "w");
+    valid &= f != NULL;
+    if (f != NULL) {
+        fprintf(f, "libntru-kernels 1\n0 401 0 2048 mult_int_16 1.0\n0 401 0 3000 mult_int_16 1.0\n");
+        fclose(f);
+    }
+    valid &= ntru_kernel_tuned_load(filename) == NTRU_ERR_INVALID_ENCODING;
+    valid &= ntru_kernel_tuned_count() == 0;
+
+    /* Toom-4 is not exact for q=16384; the decision is ignored where AVX2 is missing */
+    const NtruKernel *toom4 = NULL;
+    uint16_t j;
+    for (j=0; j<ntru_kernel_count(); j++)
+        if (strcmp(ntru_kernel_get(j)->name, "mult_int_avx2_toom4") == 0)
+            toom4 = ntru_kernel_get(j);
+    f = fopen(filename, "w");
+    valid &= f != NULL;
+    if (f != NULL) {
+        fprintf(f, "libntru-kernels 1\n0 1087 0 16384 mult_int_avx2_toom4 1.0\n");
+        fclose(f);
+    }
+    uint8_t toom4_supported = toom4!=NULL && ntru_kernel_supported(toom4);
+    valid &= ntru_kernel_tuned_load(filename) == (toom4_supported ? NTRU_ERR_INVALID_ENCODING : NTRU_SUCCESS);
+    valid &= ntru_kernel_tuned_count() == 0;
+    remove(filename);
+    valid &= ntru_kernel_tuned_load(filename) == NTRU_ERR_IO;
+    valid &= ntru_kernel_tuned_count() == 0;
+
+    ntru_kernel_tuned_reset();
+    valid &= ntru_kernel_tuned_count() == 0;
+    print_result("test_kernel_autotune", valid);
+    return valid;
+}
+
 uint8_t test_poly() {
     uint8_t valid = 1;
     valid &= test_ntruprime_inv_int();
     valid &= test_ntruprime_inv_poly();
+    valid &= test_ntruprime_mult();
+    valid &= test_ntruprime_round3();
     valid &= test_mult_int();
     valid &= test_mult_tern();
 #ifndef NTRU_AVOID_HAMMING_WT_PATENT
@@ -317,5 +771,8 @@ uint8_t test_poly() {
 #endif   /* NTRU_AVOID_HAMMING_WT_PATENT */
     valid &= test_inv();
     valid &= test_arr();
+    valid &= test_post();
+    valid &= test_kernel_matrix();
+    valid &= test_kernel_autotune();
     return valid;
 }
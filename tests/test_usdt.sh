@@ -0,0 +1,39 @@
+#!/bin/sh
+# Checks that a library built with USDT=yes contains all libntru probes.
+# Usage: test_usdt.sh libntru.so
+
+LIB=${1:-libntru.so}
+PROBES="keygen_entry keygen_return
+encrypt_entry encrypt_return encrypt_retry
+decrypt_entry decrypt_return
+seed_start seed_done blind_start blind_done
+mult_start mult_done mgf_start mgf_done
+recheck_start recheck_done"
+
+if ! command -v readelf >/dev/null 2>&1; then
+    echo "readelf not found, skipping USDT test"
+    exit 0
+fi
+
+NOTES=$(readelf -n "$LIB") || exit 1
+if ! echo "$NOTES" | grep -q stapsdt; then
+    echo "$LIB has no USDT probes; is <sys/sdt.h> installed?"
+    exit 1
+fi
+
+FAILED=0
+for probe in $PROBES; do
+    if echo "$NOTES" | grep -q "Name: $probe\$"; then
+        echo "libntru:$probe OK"
+    else
+        echo "libntru:$probe missing"
+        FAILED=1
+    fi
+done
+
+if [ $FAILED -eq 0 ]; then
+    echo "All USDT probes found"
+else
+    echo "USDT probes missing"
+fi
+exit $FAILED